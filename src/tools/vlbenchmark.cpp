@@ -0,0 +1,2606 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <vlCore/VisualizationLibrary.hpp>
+#include <vlCore/GlobalSettings.hpp>
+#include <vlCore/Time.hpp>
+#include <vlGraphics/Camera.hpp>
+#include <vlGraphics/Actor.hpp>
+#include <vlGraphics/ActorKdTree.hpp>
+#include <vlGraphics/SceneManagerLinearBVH.hpp>
+#include <vlGraphics/RenderQueue.hpp>
+#include <vlGraphics/Rendering.hpp>
+#include <vlGraphics/GeometryPrimitives.hpp>
+#include <vlGraphics/VertexCacheOptimizer.hpp>
+#include <vlGraphics/DoubleVertexRemover.hpp>
+#include <vlGraphics/PolygonSimplifier.hpp>
+#include <vlGraphics/EdgeExtractor.hpp>
+#include <vlVolume/MarchingCubes.hpp>
+#include <vlVolume/VolumeUtils.hpp>
+#include <vlVolume/RaycastVolume.hpp>
+#include <vlVolume/RaycastVolumeCPU.hpp>
+#include <vlGraphics/plugins/ioOBJ.hpp>
+#include <vlGraphics/plugins/ioSTL.hpp>
+#include <vlGraphics/plugins/ioPLY.hpp>
+#include <vlCore/MemoryFile.hpp>
+#include <vlCore/ZippedDirectory.hpp>
+#include <vlCore/GZipCodec.hpp>
+#include <vlCore/CRC32CheckSum.hpp>
+
+using namespace vl;
+
+// Benchmarks of VL's CPU side algorithms: they do not require an OpenGL context.
+
+//-----------------------------------------------------------------------------
+// Counts the heap allocations performed by the whole process, see benchRenderQueueAlloc().
+size_t gAllocationCount = 0;
+
+void* operator new(size_t size)
+{
+  ++gAllocationCount;
+  void* ptr = malloc(size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) throw()
+{
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) throw()
+{
+  free(ptr);
+}
+
+//-----------------------------------------------------------------------------
+// culling
+//-----------------------------------------------------------------------------
+// Same scene as App_CullingBenchmark: spheres randomly scattered in a cube, culled by a kd-tree.
+int benchCulling(int argc, const char* argv[])
+{
+  int actor_count = argc > 0 ? atoi(argv[0]) : 200000;
+  int frames      = argc > 1 ? atoi(argv[1]) : 50;
+
+  printf("culling: %d actors, %d frames, %d threads\n", actor_count, frames, globalSettings()->threadCount());
+
+  ref<Effect> effect = new Effect;
+  ref<Geometry> ball = makeUVSphere(vec3(0,0,0),1,20,20);
+  ball->computeBounds();
+
+  srand(0);
+  int volume = 1000;
+  ActorCollection actors;
+  for(int i=0; i<actor_count; ++i)
+  {
+    ref<Actor> actor = new Actor(ball.get(), effect.get(), new Transform);
+    actor->transform()->setLocalMatrix(mat4::getTranslation(rand()%volume-volume/2.0f, rand()%volume-volume/2.0f, rand()%volume-volume/2.0f));
+    actor->transform()->computeWorldMatrix();
+    actors.push_back(actor.get());
+  }
+
+  Time timer;
+  timer.start();
+  ref<ActorKdTree> kdtree = new ActorKdTree;
+  kdtree->buildKdTree(actors);
+  printf("  kd-tree build: %.3fs\n", timer.elapsed());
+
+  ref<Camera> camera = new Camera;
+  camera->viewport()->set(0, 0, 1024, 768);
+  camera->setProjectionPerspective();
+
+  ActorCollection serial_list, parallel_list;
+  double serial_time = 0, parallel_time = 0;
+  size_t visible = 0;
+  for(int f=0; f<frames; ++f)
+  {
+    real angle = 360.0f * f / frames;
+    vec3 eye = mat4::getRotation(angle, 0, 1, 0) * vec3(0, 0, (real)volume * 0.6f);
+    camera->setViewMatrixLookAt(eye, vec3(0,0,0), vec3(0,1,0));
+    camera->computeFrustumPlanes();
+
+    serial_list.clear();
+    timer.start();
+    kdtree->extractVisibleActors(serial_list, camera.get());
+    serial_time += timer.elapsed();
+
+    parallel_list.clear();
+    timer.start();
+    kdtree->extractVisibleActorsParallel(parallel_list, camera.get());
+    parallel_time += timer.elapsed();
+
+    if (serial_list.size() != parallel_list.size())
+    {
+      printf("  FAILED: serial and parallel culling differ at frame %d\n", f);
+      return 1;
+    }
+    for(size_t i=0; i<serial_list.size(); ++i)
+    {
+      if (serial_list[i] != parallel_list[i])
+      {
+        printf("  FAILED: serial and parallel culling order differ at frame %d\n", f);
+        return 1;
+      }
+    }
+    visible += serial_list.size();
+  }
+
+  printf("  visible actors/frame: %d\n", (int)(visible / frames));
+  printf("  serial:   %.3fms/frame\n", serial_time * 1000.0 / frames);
+  printf("  parallel: %.3fms/frame (%.2fx)\n", parallel_time * 1000.0 / frames, serial_time / parallel_time);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// kdtree
+//-----------------------------------------------------------------------------
+int countNodes(const ActorTreeAbstract* node)
+{
+  int count = 1;
+  for(int i=0; i<node->childrenCount(); ++i)
+    count += countNodes(node->child(i));
+  return count;
+}
+//-----------------------------------------------------------------------------
+// Number of actor bounding volumes tested by ActorTreeAbstract::extractVisibleActors().
+int countTestedActors(const ActorTreeAbstract* node, const Frustum& frustum)
+{
+  if ( frustum.cull(node->aabb()) )
+    return 0;
+  int count = (int)node->actors()->size();
+  for(int i=0; i<node->childrenCount(); ++i)
+    count += countTestedActors(node->child(i), frustum);
+  return count;
+}
+//-----------------------------------------------------------------------------
+// Median vs SAH ActorKdTree construction on the scene used by the culling benchmark.
+int benchKdTree(int argc, const char* argv[])
+{
+  int actor_count = argc > 0 ? atoi(argv[0]) : 200000;
+  int frames      = argc > 1 ? atoi(argv[1]) : 50;
+
+  printf("kdtree: %d actors, %d frames, %d threads\n", actor_count, frames, globalSettings()->threadCount());
+
+  ref<Effect> effect = new Effect;
+  ref<Geometry> ball = makeUVSphere(vec3(0,0,0),1,20,20);
+  ball->computeBounds();
+
+  srand(0);
+  int volume = 1000;
+  ActorCollection actors;
+  for(int i=0; i<actor_count; ++i)
+  {
+    ref<Actor> actor = new Actor(ball.get(), effect.get(), new Transform);
+    actor->transform()->setLocalMatrix(mat4::getTranslation(rand()%volume-volume/2.0f, rand()%volume-volume/2.0f, rand()%volume-volume/2.0f));
+    actor->transform()->computeWorldMatrix();
+    actors.push_back(actor.get());
+  }
+
+  ref<Camera> camera = new Camera;
+  camera->viewport()->set(0, 0, 1024, 768);
+  camera->setProjectionPerspective();
+
+  const char* method_name[] = { "median", "sah" };
+  EKdTreeBuildMethod method[] = { KDBM_Median, KDBM_SAH };
+  for(int m=0; m<2; ++m)
+  {
+    ActorCollection acts = actors;
+    Time timer;
+    timer.start();
+    ref<ActorKdTree> kdtree = new ActorKdTree;
+    kdtree->setBuildMethod(method[m]);
+    kdtree->buildKdTree(acts);
+    double build_time = timer.elapsed();
+
+    ActorCollection all;
+    kdtree->extractActors(all);
+    if ((int)all.size() != actor_count)
+    {
+      printf("  FAILED: the %s kd-tree contains %d actors instead of %d\n", method_name[m], (int)all.size(), actor_count);
+      return 1;
+    }
+
+    double cull_time = 0;
+    size_t visible = 0;
+    size_t tested = 0;
+    ActorCollection list;
+    for(int f=0; f<frames; ++f)
+    {
+      real angle = 360.0f * f / frames;
+      vec3 eye = mat4::getRotation(angle, 0, 1, 0) * vec3(0, 0, (real)volume * 0.6f);
+      camera->setViewMatrixLookAt(eye, vec3(0,0,0), vec3(0,1,0));
+      camera->computeFrustumPlanes();
+
+      list.clear();
+      timer.start();
+      kdtree->extractVisibleActors(list, camera.get());
+      cull_time += timer.elapsed();
+
+      visible += list.size();
+      tested += countTestedActors(kdtree.get(), camera->frustum());
+    }
+
+    printf("  %-6s build %.3fs, %d nodes, %d actors tested/cull, %d visible/cull, %.3fms/cull\n",
+      method_name[m], build_time, countNodes(kdtree.get()), (int)(tested / frames), (int)(visible / frames), cull_time * 1000.0 / frames);
+  }
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// kdtree-update
+//-----------------------------------------------------------------------------
+bool containsAABB(const AABB& outer, const AABB& inner)
+{
+  return inner.isNull() || ((outer + inner).minCorner() == outer.minCorner() && (outer + inner).maxCorner() == outer.maxCorner());
+}
+//-----------------------------------------------------------------------------
+// Checks that every node's AABB contains its Actors and its children and that no Actor is contained twice.
+bool validateTree(const ActorTreeAbstract* node, std::set<const Actor*>& actors)
+{
+  for(size_t i=0; i<node->actors()->size(); ++i)
+  {
+    if ( !actors.insert(node->actors()->at(i)).second || !containsAABB(node->aabb(), node->actors()->at(i)->boundingBox()) )
+      return false;
+  }
+  for(int i=0; i<node->childrenCount(); ++i)
+  {
+    if ( !containsAABB(node->aabb(), node->child(i)->aabb()) || !validateTree(node->child(i), actors) )
+      return false;
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+// ActorKdTree::updateKdTree() with a few moving actors among many static ones against a full rebuild.
+int benchKdTreeUpdate(int argc, const char* argv[])
+{
+  int actor_count  = argc > 0 ? atoi(argv[0]) : 200000;
+  int moving_count = argc > 1 ? atoi(argv[1]) : 2000;
+  int frames       = argc > 2 ? atoi(argv[2]) : 50;
+  moving_count = moving_count < actor_count ? moving_count : actor_count;
+
+  printf("kdtree-update: %d actors, %d moving, %d frames\n", actor_count, moving_count, frames);
+
+  ref<Effect> effect = new Effect;
+  ref<Geometry> ball = makeUVSphere(vec3(0,0,0),1,20,20);
+  ball->computeBounds();
+
+  srand(0);
+  int volume = 1000;
+  ActorCollection actors;
+  std::vector<vec3> position;
+  for(int i=0; i<actor_count; ++i)
+  {
+    position.push_back( vec3((real)(rand()%volume-volume/2), (real)(rand()%volume-volume/2), (real)(rand()%volume-volume/2)) );
+    ref<Actor> actor = new Actor(ball.get(), effect.get(), new Transform);
+    actor->transform()->setLocalMatrix(mat4::getTranslation(position.back()));
+    actor->transform()->computeWorldMatrix();
+    actors.push_back(actor.get());
+  }
+
+  ref<ActorKdTree> kdtree = new ActorKdTree;
+  kdtree->setBuildMethod(KDBM_SAH);
+  kdtree->buildKdTree(actors);
+  for(int i=0; i<moving_count; ++i)
+    kdtree->trackActor(actors[i].get());
+
+  Time timer;
+  double update_time = 0;
+  int reinserted = 0, rebuilt = 0;
+  for(int f=0; f<frames; ++f)
+  {
+    for(int i=0; i<moving_count; ++i)
+    {
+      position[i] += vec3((real)(rand()%11-5), (real)(rand()%11-5), (real)(rand()%11-5));
+      actors[i]->transform()->setLocalMatrix(mat4::getTranslation(position[i]));
+      actors[i]->transform()->computeWorldMatrix();
+    }
+
+    timer.start();
+    kdtree->updateKdTree();
+    update_time += timer.elapsed();
+    reinserted += kdtree->statsReinsertedActors();
+    rebuilt += kdtree->statsRebuiltSubtrees();
+  }
+
+  std::set<const Actor*> contained;
+  if ( !validateTree(kdtree.get(), contained) || (int)contained.size() != actor_count )
+  {
+    printf("  FAILED: the updated kd-tree is not consistent\n");
+    return 1;
+  }
+
+  // untracking swaps the last tracked actor in the freed slot, tracking twice is a no-op
+  for(int i=0; i<moving_count; i+=2)
+    kdtree->untrackActor(actors[i].get());
+  bool untracked = kdtree->trackedActorCount() == moving_count / 2;
+  for(int i=0; i<moving_count; ++i)
+    kdtree->trackActor(actors[i].get());
+  if ( !untracked || kdtree->trackedActorCount() != moving_count )
+  {
+    printf("  FAILED: inconsistent tracked actor count\n");
+    return 1;
+  }
+
+  // a tracked actor removed from the tree behind the tracker's back is inserted again when it moves far away
+  kdtree->eraseActor(actors[0].get());
+  position[0] += vec3((real)volume, 0, 0);
+  actors[0]->transform()->setLocalMatrix(mat4::getTranslation(position[0]));
+  actors[0]->transform()->computeWorldMatrix();
+  kdtree->updateKdTree();
+  contained.clear();
+  if ( !validateTree(kdtree.get(), contained) || (int)contained.size() != actor_count )
+  {
+    printf("  FAILED: the kd-tree is not consistent after updating an actor erased from it\n");
+    return 1;
+  }
+
+  timer.start();
+  kdtree->rebuildKdTree();
+  double rebuild_time = timer.elapsed();
+
+  printf("  update:  %.3fms/frame, %d re-inserted/frame, %d subtrees rebuilt\n", update_time * 1000.0 / frames, reinserted / frames, rebuilt);
+  printf("  rebuild: %.3fms\n", rebuild_time * 1000.0);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// linear-bvh
+//-----------------------------------------------------------------------------
+// SceneManagerLinearBVH against an SAH ActorKdTree on the scene used by the culling benchmark.
+int benchLinearBVH(int argc, const char* argv[])
+{
+  int actor_count = argc > 0 ? atoi(argv[0]) : 200000;
+  int frames      = argc > 1 ? atoi(argv[1]) : 50;
+
+  printf("linear-bvh: %d actors, %d frames, %d threads\n", actor_count, frames, globalSettings()->threadCount());
+
+  ref<Effect> effect = new Effect;
+  ref<Geometry> ball = makeUVSphere(vec3(0,0,0),1,20,20);
+  ball->computeBounds();
+
+  srand(0);
+  int volume = 1000;
+  ActorCollection actors;
+  for(int i=0; i<actor_count; ++i)
+  {
+    ref<Actor> actor = new Actor(ball.get(), effect.get(), new Transform);
+    actor->transform()->setLocalMatrix(mat4::getTranslation(rand()%volume-volume/2.0f, rand()%volume-volume/2.0f, rand()%volume-volume/2.0f));
+    actor->transform()->computeWorldMatrix();
+    actors.push_back(actor.get());
+  }
+
+  Time timer;
+  timer.start();
+  ref<ActorKdTree> kdtree = new ActorKdTree;
+  kdtree->setBuildMethod(KDBM_SAH);
+  ActorCollection acts = actors;
+  kdtree->buildKdTree(acts);
+  double kdtree_build = timer.elapsed();
+
+  timer.start();
+  ref<SceneManagerLinearBVH> scene_manager = new SceneManagerLinearBVH;
+  scene_manager->tree()->buildBVH(actors);
+  double bvh_build = timer.elapsed();
+
+  ActorCollection all;
+  scene_manager->extractActors(all);
+  if ((int)all.size() != actor_count)
+  {
+    printf("  FAILED: the linear BVH contains %d actors instead of %d\n", (int)all.size(), actor_count);
+    return 1;
+  }
+
+  ref<Camera> camera = new Camera;
+  camera->viewport()->set(0, 0, 1024, 768);
+  camera->setProjectionPerspective();
+
+  ActorCollection kdtree_list, bvh_list, parallel_list;
+  double kdtree_time = 0, bvh_time = 0, parallel_time = 0, refit_time = 0;
+  for(int f=0; f<frames; ++f)
+  {
+    real angle = 360.0f * f / frames;
+    vec3 eye = mat4::getRotation(angle, 0, 1, 0) * vec3(0, 0, (real)volume * 0.6f);
+    camera->setViewMatrixLookAt(eye, vec3(0,0,0), vec3(0,1,0));
+    camera->computeFrustumPlanes();
+
+    // move a few actors without rebuilding the hierarchy: they must be culled at their new position
+    for(int i=0; i<100 && i<actor_count; ++i)
+    {
+      actors[i]->transform()->setLocalMatrix(mat4::getTranslation(rand()%volume-volume/2.0f, rand()%volume-volume/2.0f, rand()%volume-volume/2.0f));
+      actors[i]->transform()->computeWorldMatrix();
+    }
+
+    kdtree_list.clear();
+    timer.start();
+    kdtree->extractVisibleActors(kdtree_list, camera.get());
+    kdtree_time += timer.elapsed();
+
+    timer.start();
+    scene_manager->tree()->refitBVH();
+    refit_time += timer.elapsed();
+
+    bvh_list.clear();
+    scene_manager->setParallelCullingEnabled(false);
+    timer.start();
+    scene_manager->extractVisibleActors(bvh_list, camera.get());
+    bvh_time += timer.elapsed();
+
+    parallel_list.clear();
+    scene_manager->setParallelCullingEnabled(true);
+    timer.start();
+    scene_manager->extractVisibleActors(parallel_list, camera.get());
+    parallel_time += timer.elapsed();
+
+    bool same = bvh_list.size() == parallel_list.size();
+    for(size_t i=0; same && i<bvh_list.size(); ++i)
+      same = bvh_list[i] == parallel_list[i];
+    if (!same)
+    {
+      printf("  FAILED: serial and parallel linear BVH culling differ at frame %d\n", f);
+      return 1;
+    }
+
+    // every actor whose sphere and box are both visible must be found and no sphere clearly outside must be returned
+    std::set<const Actor*> found;
+    for(size_t i=0; i<bvh_list.size(); ++i)
+    {
+      found.insert(bvh_list[i].get());
+      const Sphere& sphere = bvh_list[i]->boundingSphere();
+      if (camera->frustum().cull(Sphere(sphere.center(), sphere.radius() + 0.01f)))
+      {
+        printf("  FAILED: the linear BVH returned a culled actor at frame %d\n", f);
+        return 1;
+      }
+    }
+    for(int i=0; i<actor_count; ++i)
+    {
+      if (!camera->frustum().cull(actors[i]->boundingSphere()) && !camera->frustum().cull(actors[i]->boundingBox()) && !found.count(actors[i].get()))
+      {
+        printf("  FAILED: the linear BVH missed a visible actor at frame %d\n", f);
+        return 1;
+      }
+    }
+  }
+
+  printf("  kd-tree (sah): build %.3fs, %.3fms/cull\n", kdtree_build, kdtree_time * 1000.0 / frames);
+  printf("  linear bvh:    build %.3fs, %d nodes, %.3fms/cull, %.3fms/cull parallel\n",
+    bvh_build, (int)scene_manager->tree()->nodes().size(), bvh_time * 1000.0 / frames, parallel_time * 1000.0 / frames);
+  printf("  linear bvh:    %.3fms/refit\n", refit_time * 1000.0 / frames);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// render-queue
+//-----------------------------------------------------------------------------
+struct QueueScene
+{
+  ActorCollection mActors;
+  std::vector< ref<Shader> > mShaders;
+  std::vector<int> mShaderIndex;
+};
+//-----------------------------------------------------------------------------
+void fillQueue(RenderQueue* queue, QueueScene& scene)
+{
+  queue->clear();
+  for(size_t i=0; i<scene.mActors.size(); ++i)
+  {
+    RenderToken* tok = queue->newToken(false);
+    tok->mNextPass = NULL;
+    tok->mActor = scene.mActors.at(i);
+    tok->mRenderable = tok->mActor->lod(0);
+    tok->mShader = scene.mShaders[scene.mShaderIndex[i]].get();
+    tok->mEffectRenderRank = 0;
+  }
+}
+//-----------------------------------------------------------------------------
+// Number of times the Shader changes along the queue.
+int countShaderChanges(const RenderQueue* queue)
+{
+  int changes = 0;
+  for(int i=1; i<queue->size(); ++i)
+    changes += queue->at(i)->mShader != queue->at(i-1)->mShader ? 1 : 0;
+  return changes;
+}
+//-----------------------------------------------------------------------------
+// RenderQueue::sort() with radix sorted keys against std::sort() and RenderQueueSorterStandard::operator().
+int benchRenderQueue(int argc, const char* argv[])
+{
+  int token_count = argc > 0 ? atoi(argv[0]) : 100000;
+  int runs        = argc > 1 ? atoi(argv[1]) : 10;
+
+  printf("render-queue: %d tokens, %d runs\n", token_count, runs);
+
+  srand(0);
+  std::vector< ref<Geometry> > geometries;
+  for(int i=0; i<1000; ++i)
+  {
+    geometries.push_back( new Geometry );
+    geometries.back()->setBoundingBox( AABB(vec3(0,0,0), 1) );
+  }
+
+  QueueScene scene;
+  for(int i=0; i<200; ++i)
+  {
+    scene.mShaders.push_back( new Shader );
+    if (i % 4 == 0)
+      scene.mShaders.back()->enable(EN_BLEND);
+  }
+
+  ref<Effect> effect = new Effect;
+  for(int i=0; i<token_count; ++i)
+  {
+    ref<Actor> actor = new Actor(geometries[rand() % geometries.size()].get(), effect.get(), new Transform);
+    actor->transform()->setLocalMatrix(mat4::getTranslation(rand()%1000-500.0f, rand()%1000-500.0f, rand()%1000-500.0f));
+    actor->transform()->computeWorldMatrix();
+    actor->setRenderRank(rand() % 3);
+    scene.mActors.push_back(actor.get());
+    scene.mShaderIndex.push_back(rand() % scene.mShaders.size());
+  }
+
+  ref<Camera> camera = new Camera;
+  camera->viewport()->set(0, 0, 1024, 768);
+  camera->setProjectionPerspective();
+  camera->setViewMatrixLookAt(vec3(0,0,800), vec3(0,0,0), vec3(0,1,0));
+
+  ref<RenderQueueSorterStandard> sorter = new RenderQueueSorterStandard;
+  ref<RenderQueue> std_queue = new RenderQueue;
+  ref<RenderQueue> radix_queue = new RenderQueue;
+  std_queue->setRadixSortEnabled(false);
+
+  Time timer;
+  double std_time = 0, radix_time = 0;
+  for(int r=0; r<runs; ++r)
+  {
+    fillQueue(std_queue.get(), scene);
+    timer.start();
+    std_queue->sort(sorter.get(), camera.get());
+    std_time += timer.elapsed();
+
+    fillQueue(radix_queue.get(), scene);
+    timer.start();
+    radix_queue->sort(sorter.get(), camera.get());
+    radix_time += timer.elapsed();
+  }
+
+  // the two orders must agree on everything but the order of the Shader and Renderable groups
+  for(int i=0; i<token_count; ++i)
+  {
+    const RenderToken* a = std_queue->at(i);
+    const RenderToken* b = radix_queue->at(i);
+    bool blend = a->mShader->isBlendingEnabled();
+    if ( a->mActor->renderRank() != b->mActor->renderRank() || blend != b->mShader->isBlendingEnabled() || (blend && a->mCameraDistance != b->mCameraDistance) )
+    {
+      printf("  FAILED: radix and std::sort orders differ at token %d\n", i);
+      return 1;
+    }
+  }
+
+  printf("  std::sort: %.3fms, %d shader changes\n", std_time * 1000.0 / runs, countShaderChanges(std_queue.get()));
+  printf("  radix:     %.3fms, %d shader changes (%.2fx)\n", radix_time * 1000.0 / runs, countShaderChanges(radix_queue.get()), std_time / radix_time);
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// render-queue-reuse
+//-----------------------------------------------------------------------------
+// Exposes the render queue update of Rendering::render(), which would require an OpenGL context.
+class QueueRendering: public Rendering
+{
+public:
+  QueueRendering()
+  {
+    setAutomaticResourceInit(false);
+    camera()->viewport()->set(0, 0, 1024, 768);
+    camera()->setProjectionPerspective();
+    camera()->setViewMatrixLookAt(vec3(0,0,800), vec3(0,0,0), vec3(0,1,0));
+  }
+
+  void updateQueue(const ActorCollection& actors)
+  {
+    actorQueue()->clear();
+    for(size_t i=0; i<actors.size(); ++i)
+      actorQueue()->push_back( const_cast<Actor*>(actors.at(i)) );
+    if ( renderQueueReuseEnabled() )
+      updateRenderQueue();
+    else
+    {
+      renderQueue()->clear();
+      fillRenderQueue( actorQueue() );
+      renderQueue()->sort( renderQueueSorter(), camera() );
+    }
+  }
+
+  const RenderQueue* queue() const { return mRenderQueue.get(); }
+};
+//-----------------------------------------------------------------------------
+// Actors randomly scattered in a cube using 200 Effects, some of them transparent or multipass.
+void makeEffectScene(int actor_count, ActorCollection& actors)
+{
+  srand(0);
+  std::vector< ref<Geometry> > geometries;
+  for(int i=0; i<1000; ++i)
+  {
+    geometries.push_back( new Geometry );
+    geometries.back()->setBoundingBox( AABB(vec3(0,0,0), 1) );
+  }
+
+  std::vector< ref<Effect> > effects;
+  for(int i=0; i<200; ++i)
+  {
+    effects.push_back( new Effect );
+    if (i % 4 == 0)
+      effects.back()->shader()->enable(EN_BLEND);
+    // a few multipass effects
+    if (i % 10 == 0)
+      effects.back()->lod(0)->push_back( new Shader );
+  }
+
+  for(int i=0; i<actor_count; ++i)
+  {
+    ref<Actor> actor = new Actor(geometries[rand() % geometries.size()].get(), effects[rand() % effects.size()].get(), new Transform);
+    actor->transform()->setLocalMatrix(mat4::getTranslation(rand()%1000-500.0f, rand()%1000-500.0f, rand()%1000-500.0f));
+    actor->transform()->computeWorldMatrix();
+    actor->setRenderRank(rand() % 3);
+    actors.push_back(actor.get());
+  }
+}
+//-----------------------------------------------------------------------------
+// Compares the order of two queues of the same tokens like benchRenderQueue() does.
+bool sameQueueOrder(const RenderQueue* a, const RenderQueue* b)
+{
+  if (a->size() != b->size())
+    return false;
+  std::set< std::pair<const Actor*, const Shader*> > tokens_a, tokens_b;
+  for(int i=0; i<a->size(); ++i)
+  {
+    const RenderToken* ta = a->at(i);
+    const RenderToken* tb = b->at(i);
+    tokens_a.insert( std::make_pair(ta->mActor, ta->mShader) );
+    tokens_b.insert( std::make_pair(tb->mActor, tb->mShader) );
+    bool blend = ta->mShader->isBlendingEnabled();
+    if ( ta->mActor->renderRank() != tb->mActor->renderRank() || blend != tb->mShader->isBlendingEnabled() || (blend && ta->mCameraDistance != tb->mCameraDistance) )
+      return false;
+  }
+  return tokens_a == tokens_b;
+}
+//-----------------------------------------------------------------------------
+// Rendering's render queue reuse against refilling and sorting the queue every frame, moving a few Actors per frame.
+int benchRenderQueueReuse(int argc, const char* argv[])
+{
+  int actor_count  = argc > 0 ? atoi(argv[0]) : 50000;
+  int moving_count = argc > 1 ? atoi(argv[1]) : 100;
+  int frames       = argc > 2 ? atoi(argv[2]) : 20;
+
+  printf("render-queue-reuse: %d actors, %d moving, %d frames\n", actor_count, moving_count, frames);
+
+  ActorCollection actors;
+  makeEffectScene(actor_count, actors);
+
+  ref<QueueRendering> rendering[2];
+  for(int i=0; i<2; ++i)
+  {
+    rendering[i] = new QueueRendering;
+    rendering[i]->setRenderQueueReuseEnabled(i == 1);
+  }
+
+  Time timer;
+  double time[2] = { 0, 0 };
+  for(int f=0; f<frames; ++f)
+  {
+    // move a few Actors, every other frame the scene is static
+    if (f % 2)
+    {
+      for(int i=0; i<moving_count; ++i)
+      {
+        Actor* actor = actors.at(rand() % actors.size());
+        actor->transform()->setLocalMatrix(mat4::getTranslation(rand()%1000-500.0f, rand()%1000-500.0f, rand()%1000-500.0f));
+        actor->transform()->computeWorldMatrix();
+      }
+    }
+
+    for(int i=0; i<2; ++i)
+    {
+      timer.start();
+      rendering[i]->updateQueue(actors);
+      time[i] += timer.elapsed();
+    }
+
+    if ( !sameQueueOrder(rendering[0]->queue(), rendering[1]->queue()) )
+    {
+      printf("  FAILED: reused and rebuilt queues differ at frame %d\n", f);
+      return 1;
+    }
+  }
+
+  printf("  rebuild: %.3fms/frame\n", time[0] * 1000.0 / frames);
+  printf("  reuse:   %.3fms/frame (%.2fx), %d hits, %d patches, %d misses\n", time[1] * 1000.0 / frames, time[0] / time[1],
+    rendering[1]->statsRenderQueueHits(), rendering[1]->statsRenderQueuePatches(), rendering[1]->statsRenderQueueMisses());
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// render-queue-alloc
+//-----------------------------------------------------------------------------
+// Counts the heap allocations of the render queue filling and sorting once the queue reached its steady state size.
+int benchRenderQueueAlloc(int argc, const char* argv[])
+{
+  int actor_count = argc > 0 ? atoi(argv[0]) : 50000;
+  int frames      = argc > 1 ? atoi(argv[1]) : 10;
+
+  printf("render-queue-alloc: %d actors, %d frames\n", actor_count, frames);
+
+  ActorCollection actors;
+  makeEffectScene(actor_count, actors);
+
+  const char* modes[] = { "rebuild", "reuse" };
+  for(int m=0; m<2; ++m)
+  {
+    ref<QueueRendering> rendering = new QueueRendering;
+    rendering->setAutomaticResourceInit(true);
+    rendering->setRenderQueueReuseEnabled(m == 1);
+
+    // warm up: grow the queue and the sorting buffers
+    rendering->updateQueue(actors);
+    rendering->updateQueue(actors);
+
+    Time timer;
+    timer.start();
+    size_t allocations = gAllocationCount;
+    for(int f=0; f<frames; ++f)
+      rendering->updateQueue(actors);
+    allocations = gAllocationCount - allocations;
+    double time = timer.elapsed();
+
+    printf("  %-8s %.3fms/frame, %d allocations/frame\n", modes[m], time * 1000.0 / frames, (int)(allocations / frames));
+    if (allocations)
+    {
+      printf("  FAILED: %d heap allocations in %d steady state frames\n", (int)allocations, frames);
+      return 1;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// vertex-cache
+//-----------------------------------------------------------------------------
+// Icosphere whose triangles are shuffled, as a single PT_TRIANGLES DrawElementsUInt.
+ref<Geometry> makeShuffledSphere(int detail)
+{
+  ref<Geometry> geom = makeIcosphere(vec3(0,0,0), 10, detail);
+  std::vector<u32> tris;
+  for(size_t i=0; i<geom->drawCalls().size(); ++i)
+  {
+    for(TriangleIterator it = geom->drawCalls().at(i)->triangleIterator(); it.hasNext(); it.next())
+    {
+      tris.push_back(it.a());
+      tris.push_back(it.b());
+      tris.push_back(it.c());
+    }
+  }
+
+  srand(0);
+  for(size_t i=tris.size()/3; i>1; --i)
+  {
+    size_t j = rand() % i;
+    for(int k=0; k<3; ++k)
+      std::swap(tris[(i-1)*3+k], tris[j*3+k]);
+  }
+
+  ref<DrawElementsUInt> de = new DrawElementsUInt(PT_TRIANGLES);
+  de->indexBuffer()->resize(tris.size());
+  memcpy(de->indexBuffer()->ptr(), &tris[0], tris.size() * sizeof(u32));
+  geom->drawCalls().clear();
+  geom->drawCalls().push_back(de.get());
+  return geom;
+}
+//-----------------------------------------------------------------------------
+// The triangles of a Geometry as sorted position triplets, independent from the vertex and triangle order.
+std::vector< std::vector<float> > triangleSet(Geometry* geom)
+{
+  std::vector< std::vector<float> > set;
+  ArrayAbstract* pos = geom->vertexArray();
+  for(size_t i=0; i<geom->drawCalls().size(); ++i)
+  {
+    for(TriangleIterator it = geom->drawCalls().at(i)->triangleIterator(); it.hasNext(); it.next())
+    {
+      std::vector<float> tri;
+      int idx[] = { it.a(), it.b(), it.c() };
+      for(int k=0; k<3; ++k)
+      {
+        vec3 v = pos->getAsVec3(idx[k]);
+        tri.push_back((float)v.x());
+        tri.push_back((float)v.y());
+        tri.push_back((float)v.z());
+      }
+      set.push_back(tri);
+    }
+  }
+  std::sort(set.begin(), set.end());
+  return set;
+}
+//-----------------------------------------------------------------------------
+// VertexCacheOptimizer on a shuffled icosphere for a few cache sizes, with and without the overdraw pass.
+int benchVertexCache(int argc, const char* argv[])
+{
+  int detail = argc > 0 ? atoi(argv[0]) : 6;
+
+  ref<Geometry> reference = makeShuffledSphere(detail);
+  std::vector< std::vector<float> > reference_set = triangleSet(reference.get());
+  printf("vertex-cache: %d triangles, %d vertices\n", (int)reference_set.size(), (int)reference->vertexArray()->size());
+
+  int cache_sizes[] = { 16, 32, 64 };
+  for(int c=0; c<3; ++c)
+  {
+    for(int overdraw=0; overdraw<2; ++overdraw)
+    {
+      ref<Geometry> geom = makeShuffledSphere(detail);
+      VertexCacheOptimizer optimizer;
+      optimizer.setCacheSize(cache_sizes[c]);
+      optimizer.setOverdrawOptimizationEnabled(overdraw == 1);
+
+      Time timer;
+      timer.start();
+      if ( !optimizer.optimize(geom.get()) )
+      {
+        printf("  FAILED: optimize() returned false\n");
+        return 1;
+      }
+      double time = timer.elapsed();
+
+      if ( triangleSet(geom.get()) != reference_set )
+      {
+        printf("  FAILED: the optimized triangles differ from the original ones\n");
+        return 1;
+      }
+
+      printf("  cache %2d%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %.1fms\n", cache_sizes[c], overdraw ? " + overdraw" : "           ",
+        optimizer.acmrBefore(), optimizer.acmrAfter(), optimizer.atvrBefore(), optimizer.atvrAfter(), time * 1000.0);
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// double-vertex
+//-----------------------------------------------------------------------------
+// DoubleVertexRemover's DVRM_Sort against DVRM_Hash, and DVRM_Hash welding on jittered positions.
+int benchDoubleVertex(int argc, const char* argv[])
+{
+  int detail = argc > 0 ? atoi(argv[0]) : 6;
+
+  ref<Geometry> reference = makeIcosphere(vec3(0,0,0), 10, detail, false);
+  const int vert_count = (int)reference->vertexArray()->size();
+  printf("double-vertex: %d vertices\n", vert_count);
+
+  ref<Geometry> sorted = reference->deepCopy();
+  DoubleVertexRemover sort_dvr;
+  Time timer;
+  timer.start();
+  sort_dvr.removeDoubles(sorted.get());
+  double sort_time = timer.elapsed();
+  printf("  sort:  %.1fms, %d unique vertices\n", sort_time * 1000.0, (int)sort_dvr.mapNewToOld().size());
+
+  ref<Geometry> hashed = reference->deepCopy();
+  DoubleVertexRemover hash_dvr;
+  hash_dvr.setMethod(DVRM_Hash);
+  timer.start();
+  hash_dvr.removeDoubles(hashed.get());
+  double hash_time = timer.elapsed();
+  printf("  hash:  %.1fms, %d unique vertices (%.2fx)\n", hash_time * 1000.0, (int)hash_dvr.mapNewToOld().size(), sort_time / hash_time);
+
+  if ( hash_dvr.mapNewToOld().size() != sort_dvr.mapNewToOld().size() || triangleSet(hashed.get()) != triangleSet(sorted.get()) )
+  {
+    printf("  FAILED: the sort and hash methods produced different geometries\n");
+    return 1;
+  }
+
+  if ( hash_dvr.mapNewToOld() != sort_dvr.mapNewToOld() || hash_dvr.mapOldToNew() != sort_dvr.mapOldToNew() )
+  {
+    printf("  FAILED: the sort and hash methods produced different vertex maps\n");
+    return 1;
+  }
+
+  // move the vertices by less than a tenth of the welding distance
+  const float epsilon = 1e-3f;
+  ref<Geometry> jittered = reference->deepCopy();
+  ArrayFloat3* pos = cast<ArrayFloat3>(jittered->vertexArray());
+  if (!pos)
+  {
+    printf("  FAILED: unexpected vertex array format\n");
+    return 1;
+  }
+  srand(0);
+  for(int i=0; i<vert_count; ++i)
+    pos->at(i) += fvec3((float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f, (float)rand() / RAND_MAX - 0.5f) * (epsilon * 0.1f);
+
+  DoubleVertexRemover weld_dvr;
+  weld_dvr.setMethod(DVRM_Hash);
+  weld_dvr.setWeldEpsilon(epsilon);
+  timer.start();
+  weld_dvr.removeDoubles(jittered.get());
+  printf("  weld:  %.1fms, %d unique vertices\n", timer.elapsed() * 1000.0, (int)weld_dvr.mapNewToOld().size());
+
+  if ( weld_dvr.mapNewToOld().size() != sort_dvr.mapNewToOld().size() )
+  {
+    printf("  FAILED: welding produced a different number of vertices\n");
+    return 1;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// geometry-kernels
+//-----------------------------------------------------------------------------
+// Enabling primitive restart on a DrawElementsUInt without restart indices does not change its triangles but makes
+// Geometry take the generic IndexIterator/TriangleIterator path, which is then used as the reference.
+ref<Geometry> makeGenericPathCopy(Geometry* geom)
+{
+  ref<Geometry> copy = geom->shallowCopy();
+  ref<DrawElementsUInt> de = new DrawElementsUInt;
+  *de = *geom->drawCalls().at(0)->as<DrawElementsUInt>();
+  de->setPrimitiveRestartEnabled(true);
+  copy->drawCalls().clear();
+  copy->drawCalls().push_back(de.get());
+  return copy;
+}
+//-----------------------------------------------------------------------------
+double maxDifference(const ArrayFloat3* a, const ArrayFloat3* b)
+{
+  double diff = 0;
+  for(size_t i=0; i<a->size(); ++i)
+  {
+    fvec3 d = a->at(i) - b->at(i);
+    diff = std::max( diff, std::max( fabs(d.x()), std::max( fabs(d.y()), fabs(d.z()) ) ) );
+  }
+  return diff;
+}
+//-----------------------------------------------------------------------------
+// Typed ArrayFloat3 + DrawElementsUInt kernels of Geometry::computeBounds(), computeNormals() and computeTangentSpace()
+// against the generic virtual iterator path.
+int benchGeometryKernels(int argc, const char* argv[])
+{
+  int detail = argc > 0 ? atoi(argv[0]) : 7;
+  int runs   = argc > 1 ? atoi(argv[1]) : 10;
+
+  ref<Geometry> fast = makeShuffledSphere(detail);
+  ref<Geometry> generic = makeGenericPathCopy(fast.get());
+  const int vert_count = (int)fast->vertexArray()->size();
+  printf("geometry-kernels: %d vertices, %d triangles, %d runs\n", vert_count, (int)fast->drawCalls().at(0)->countTriangles(), runs);
+
+  Time timer;
+
+  // bounds
+  double generic_time = 0, fast_time = 0;
+  for(int i=0; i<runs; ++i)
+  {
+    timer.start();
+    generic->computeBounds();
+    generic_time += timer.elapsed();
+    timer.start();
+    fast->computeBounds();
+    fast_time += timer.elapsed();
+  }
+  printf("  bounds:  generic %.2fms, typed %.2fms (%.2fx)\n", generic_time * 1000 / runs, fast_time * 1000 / runs, generic_time / fast_time);
+  if ( fast->boundingBox().minCorner() != generic->boundingBox().minCorner() || fast->boundingBox().maxCorner() != generic->boundingBox().maxCorner() ||
+       fabs( fast->boundingSphere().radius() - generic->boundingSphere().radius() ) > 1e-6 * generic->boundingSphere().radius() )
+  {
+    printf("  FAILED: the typed and generic bounds differ\n");
+    return 1;
+  }
+
+  // normals
+  generic_time = fast_time = 0;
+  for(int i=0; i<runs; ++i)
+  {
+    timer.start();
+    generic->computeNormals();
+    generic_time += timer.elapsed();
+    timer.start();
+    fast->computeNormals();
+    fast_time += timer.elapsed();
+  }
+  double diff = maxDifference( fast->normalArray()->as<ArrayFloat3>(), generic->normalArray()->as<ArrayFloat3>() );
+  printf("  normals: generic %.2fms, typed %.2fms (%.2fx), max difference %g\n", generic_time * 1000 / runs, fast_time * 1000 / runs, generic_time / fast_time, diff);
+  if ( diff > 1e-5 )
+  {
+    printf("  FAILED: the typed and generic normals differ\n");
+    return 1;
+  }
+
+  // tangent space, using the positions as texture coordinates
+  const ArrayFloat3* pos = fast->vertexArray()->as<ArrayFloat3>();
+  const ArrayFloat3* norm = fast->normalArray()->as<ArrayFloat3>();
+  std::vector<fvec2> texcoord(vert_count);
+  for(int i=0; i<vert_count; ++i)
+    texcoord[i] = fvec2( pos->at(i).x(), pos->at(i).y() + pos->at(i).z() );
+  ref<ArrayFloat3> fast_tangent = new ArrayFloat3;
+  ref<ArrayFloat3> generic_tangent = new ArrayFloat3;
+  fast_tangent->resize(vert_count);
+  generic_tangent->resize(vert_count);
+  generic_time = fast_time = 0;
+  for(int i=0; i<runs; ++i)
+  {
+    timer.start();
+    Geometry::computeTangentSpace( vert_count, pos->begin(), norm->begin(), &texcoord[0], generic->drawCalls().at(0), generic_tangent->begin(), NULL );
+    generic_time += timer.elapsed();
+    timer.start();
+    Geometry::computeTangentSpace( vert_count, pos->begin(), norm->begin(), &texcoord[0], fast->drawCalls().at(0), fast_tangent->begin(), NULL );
+    fast_time += timer.elapsed();
+  }
+  diff = maxDifference( fast_tangent.get(), generic_tangent.get() );
+  printf("  tangent: generic %.2fms, typed %.2fms (%.2fx), max difference %g\n", generic_time * 1000 / runs, fast_time * 1000 / runs, generic_time / fast_time, diff);
+  if ( diff != 0 )
+  {
+    printf("  FAILED: the typed and generic tangents differ\n");
+    return 1;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// simplify
+//-----------------------------------------------------------------------------
+// Maximum distance from the sphere surface and maximum normal error of a simplified icosphere.
+bool checkSimplifiedSphere(Geometry* geom, float radius, float& max_distance, float& max_normal_error)
+{
+  const ArrayFloat3* pos = geom->vertexArray()->as<ArrayFloat3>();
+  const ArrayFloat3* norm = geom->normalArray() ? geom->normalArray()->as<ArrayFloat3>() : NULL;
+  const ArrayFloat2* uv = geom->texCoordArray(0) ? geom->texCoordArray(0)->as<ArrayFloat2>() : NULL;
+  const ArrayUByte4* col = geom->colorArray() ? geom->colorArray()->as<ArrayUByte4>() : NULL;
+  if ( !pos || !norm || !uv || !col || norm->size() != pos->size() || uv->size() != pos->size() || col->size() != pos->size() )
+    return false;
+
+  max_distance = max_normal_error = 0;
+  for(size_t i=0; i<pos->size(); ++i)
+  {
+    max_distance = std::max( max_distance, (float)fabs( pos->at(i).length() - radius ) );
+    max_normal_error = std::max( max_normal_error, ( norm->at(i) - normalize( pos->at(i) ) ).length() );
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+// Serial PolygonSimplifier against the partitioned one on an icosphere with normals, texture coordinates and colors.
+int benchSimplify(int argc, const char* argv[])
+{
+  int detail     = argc > 0 ? atoi(argv[0]) : 6;
+  int partitions = argc > 1 ? atoi(argv[1]) : 8;
+
+  const float radius = 5;
+  ref<Geometry> input = makeIcosphere(vec3(0,0,0), radius * 2, detail);
+  input->computeNormals();
+  ArrayFloat3* pos = input->vertexArray()->as<ArrayFloat3>();
+  ref<ArrayFloat2> uv = new ArrayFloat2;
+  ref<ArrayUByte4> col = new ArrayUByte4;
+  uv->resize(pos->size());
+  col->resize(pos->size());
+  for(size_t i=0; i<pos->size(); ++i)
+  {
+    uv->at(i) = fvec2( pos->at(i).x(), pos->at(i).y() );
+    col->at(i) = ubvec4( 255, 128, 0, 255 );
+  }
+  input->setTexCoordArray(0, uv.get());
+  input->setColorArray(col.get());
+
+  const int vert_count = (int)pos->size();
+  printf("simplify: %d vertices, %d triangles, %d partitions\n", vert_count, (int)input->drawCalls().at(0)->countTriangles(), partitions);
+
+  float ratios[] = { 0.5f, 0.25f, 0.1f };
+  for(int mode=0; mode<2; ++mode)
+  {
+    PolygonSimplifier simplifier;
+    simplifier.setVerbose(false);
+    simplifier.setIntput(input.get());
+    simplifier.setPartitionCount(mode ? partitions : 1);
+    for(int i=0; i<3; ++i)
+      simplifier.targets().push_back( (u32)(vert_count * ratios[i]) );
+
+    Time timer;
+    timer.start();
+    simplifier.simplify();
+    double time = timer.elapsed();
+
+    printf("  %s: %.1fms\n", mode ? "partitioned" : "serial     ", time * 1000.0);
+    if (simplifier.output().size() != 3)
+    {
+      printf("  FAILED: %d LODs generated instead of 3\n", (int)simplifier.output().size());
+      return 1;
+    }
+    for(int i=0; i<3; ++i)
+    {
+      Geometry* lod = simplifier.output()[i].get();
+      float max_distance = 0, max_normal_error = 0;
+      if ( !checkSimplifiedSphere(lod, radius, max_distance, max_normal_error) )
+      {
+        printf("  FAILED: the vertex attributes of LOD %d were not preserved\n", i+1);
+        return 1;
+      }
+      printf("    LOD %d: %6d vertices, %6d triangles, max distance %.4f, max normal error %.4f\n", i+1, (int)lod->vertexArray()->size(),
+        (int)lod->drawCalls().at(0)->countTriangles(), max_distance, max_normal_error);
+      if ( (int)lod->vertexArray()->size() > (int)simplifier.targets()[i] )
+      {
+        printf("  FAILED: LOD %d has more vertices than its target\n", i+1);
+        return 1;
+      }
+    }
+
+    ref<Actor> actor = new Actor;
+    simplifier.setupLODs(actor.get());
+    if ( actor->lod(0) != input.get() || actor->lod(3) != simplifier.output()[2].get() )
+    {
+      printf("  FAILED: setupLODs() did not install the LOD chain\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// edges
+//-----------------------------------------------------------------------------
+// The std::set based edge extraction EdgeExtractor used before its hash table, used as the reference.
+// Goes through the protected EdgeExtractor::addEdge() kept for subclasses.
+class ReferenceEdgeExtractor: public EdgeExtractor
+{
+public:
+  void extract(Geometry* geom, float crease_angle, std::vector<EdgeExtractor::Edge>& out);
+};
+void ReferenceEdgeExtractor::extract(Geometry* geom, float crease_angle, std::vector<EdgeExtractor::Edge>& out)
+{
+  std::set<EdgeExtractor::Edge> edges;
+  ArrayAbstract* verts = geom->vertexArray();
+  for(size_t iprim=0; iprim<geom->drawCalls().size(); ++iprim)
+  {
+    for(TriangleIterator trit = geom->drawCalls().at(iprim)->triangleIterator(); trit.hasNext(); trit.next())
+    {
+      size_t a = trit.a();
+      size_t b = trit.b();
+      size_t c = trit.c();
+      if (a == b || b == c || c == a)
+        continue;
+      fvec3 v0 = (fvec3)verts->getAsVec3(a);
+      fvec3 n = cross((fvec3)verts->getAsVec3(b) - v0, (fvec3)verts->getAsVec3(c) - v0).normalize();
+      if (n.isNull())
+        continue;
+      size_t tri[] = { a, b, c };
+      for(int k=0; k<3; ++k)
+      {
+        addEdge( edges, EdgeExtractor::Edge( (fvec3)verts->getAsVec3(tri[k]), (fvec3)verts->getAsVec3(tri[(k+1)%3]) ), n );
+      }
+    }
+  }
+  for(std::set<EdgeExtractor::Edge>::iterator it = edges.begin(); it != edges.end(); ++it)
+  {
+    EdgeExtractor::Edge e = *it;
+    if (e.normal2().isNull())
+      e.setIsCrease(true);
+    else
+    if ( acos( clamp( dot(e.normal1(), e.normal2()), -1.0f, +1.0f ) ) / fPi * 180.0f > crease_angle )
+      e.setIsCrease(true);
+    out.push_back(e);
+  }
+}
+//-----------------------------------------------------------------------------
+bool sameEdges(std::vector<EdgeExtractor::Edge> a, std::vector<EdgeExtractor::Edge> b)
+{
+  if (a.size() != b.size())
+    return false;
+  std::sort(a.begin(), a.end());
+  std::sort(b.begin(), b.end());
+  for(size_t i=0; i<a.size(); ++i)
+  {
+    if ( a[i].vertex1() != b[i].vertex1() || a[i].vertex2() != b[i].vertex2() || a[i].normal1() != b[i].normal1() ||
+         a[i].normal2() != b[i].normal2() || a[i].isCrease() != b[i].isCrease() )
+      return false;
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+// EdgeExtractor against the std::set based extraction on an unwelded icosphere, as one and as several draw calls.
+int benchEdges(int argc, const char* argv[])
+{
+  int detail   = argc > 0 ? atoi(argv[0]) : 6;
+  int dc_count = argc > 1 ? atoi(argv[1]) : 4;
+
+  ref<Geometry> geom = makeIcosphere(vec3(0,0,0), 10, detail, false);
+  printf("edges: %d vertices, %d triangles\n", (int)geom->vertexArray()->size(), (int)geom->drawCalls().at(0)->countTriangles());
+
+  // the same triangles split in several draw calls
+  ref<Geometry> split = geom->shallowCopy();
+  split->drawCalls().clear();
+  std::vector<u32> tris;
+  for(TriangleIterator it = geom->drawCalls().at(0)->triangleIterator(); it.hasNext(); it.next())
+  {
+    tris.push_back(it.a());
+    tris.push_back(it.b());
+    tris.push_back(it.c());
+  }
+  size_t tri_count = tris.size() / 3;
+  for(int i=0; i<dc_count; ++i)
+  {
+    size_t first = tri_count * i / dc_count;
+    size_t last  = tri_count * (i+1) / dc_count;
+    ref<DrawElementsUInt> de = new DrawElementsUInt(PT_TRIANGLES);
+    de->indexBuffer()->resize((last - first) * 3);
+    memcpy(de->indexBuffer()->ptr(), &tris[first*3], (last - first) * 3 * sizeof(u32));
+    split->drawCalls().push_back(de.get());
+  }
+
+  Time timer;
+  timer.start();
+  std::vector<EdgeExtractor::Edge> reference;
+  ReferenceEdgeExtractor().extract(geom.get(), 45.0f, reference);
+  double reference_time = timer.elapsed();
+  printf("  std::set:   %.1fms, %d edges\n", reference_time * 1000, (int)reference.size());
+
+  Geometry* inputs[] = { geom.get(), split.get() };
+  for(int i=0; i<2; ++i)
+  {
+    EdgeExtractor extractor;
+    timer.start();
+    extractor.extractEdges(inputs[i]);
+    double time = timer.elapsed();
+    printf("  hash %d dc%s: %.1fms, %d edges (%.2fx)\n", (int)inputs[i]->drawCalls().size(), i ? "s" : " ", time * 1000, (int)extractor.edges().size(), reference_time / time);
+    if ( !sameEdges(extractor.edges(), reference) )
+    {
+      printf("  FAILED: the extracted edges differ from the reference ones\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// marching-cubes
+//-----------------------------------------------------------------------------
+// A size^3 volume containing a few metaballs.
+ref<Volume> makeMetaballs(int size)
+{
+  ref<Volume> vol = new Volume;
+  vol->setup(NULL, false, false, fvec3(-1,-1,-1), fvec3(1,1,1), ivec3(size,size,size));
+  const fvec3 balls[] = { fvec3(-0.3f,-0.2f,0.1f), fvec3(0.35f,0.1f,-0.2f), fvec3(0.0f,0.4f,0.3f), fvec3(0.1f,-0.45f,-0.35f) };
+  for(int z=0; z<size; ++z)
+    for(int y=0; y<size; ++y)
+      for(int x=0; x<size; ++x)
+      {
+        fvec3 p = vol->coordinate(x,y,z);
+        float v = 0;
+        for(int i=0; i<4; ++i)
+          v += 0.04f / (0.001f + (p-balls[i]).lengthSquared());
+        vol->value(x,y,z) = v;
+      }
+  return vol;
+}
+//-----------------------------------------------------------------------------
+template<class T>
+bool sameArray(const T* a, const T* b)
+{
+  return a->size() == b->size() && (a->size() == 0 || memcmp(a->ptr(), b->ptr(), a->bytesUsed()) == 0);
+}
+//-----------------------------------------------------------------------------
+// Single slab MarchingCubes against the one splitting the volumes in several z-slabs, with two volumes and two thresholds.
+int benchMarchingCubes(int argc, const char* argv[])
+{
+  int size  = argc > 0 ? atoi(argv[0]) : 96;
+  int slabs = argc > 1 ? atoi(argv[1]) : 8;
+
+  printf("marching-cubes: %d^3 volume, %d slabs\n", size, slabs);
+
+  ref<Volume> vol_a = makeMetaballs(size);
+  ref<Volume> vol_b = makeMetaballs(size/2+1);
+
+  MarchingCubes mc[2];
+  mc[0].setSlabCount(1);
+  mc[1].setSlabCount(slabs);
+
+  Time timer;
+  double times[2] = { 0, 0 };
+  const float thresholds[] = { 1.0f, 2.5f };
+  for(int ithreshold=0; ithreshold<2; ++ithreshold)
+  {
+    for(int i=0; i<2; ++i)
+    {
+      mc[i].volumeInfo()->clear();
+      mc[i].volumeInfo()->push_back( new VolumeInfo(vol_a.get(), thresholds[ithreshold], fvec4(1,0,0,1)) );
+      mc[i].volumeInfo()->push_back( new VolumeInfo(vol_b.get(), thresholds[1-ithreshold], fvec4(0,1,0,1)) );
+      vol_a->setDataDirty();
+      vol_b->setDataDirty();
+      timer.start();
+      mc[i].run(true);
+      times[i] = timer.elapsed();
+    }
+
+    printf("  threshold %.1f: 1 slab %.1fms, %d slabs %.1fms (%.2fx), %d vertices, %d triangles\n", thresholds[ithreshold],
+      times[0]*1000, slabs, times[1]*1000, times[0]/times[1], (int)mc[1].mVertsArray->size(), (int)mc[1].mDrawElements->indexBuffer()->size()/3);
+
+    if ( !sameArray(mc[0].mVertsArray.get(), mc[1].mVertsArray.get()) ||
+         !sameArray(mc[0].mNormsArray.get(), mc[1].mNormsArray.get()) ||
+         !sameArray(mc[0].mColorArray.get(), mc[1].mColorArray.get()) ||
+         !sameArray(mc[0].mDrawElements->indexBuffer(), mc[1].mDrawElements->indexBuffer()) ||
+         mc[0].volumeInfo()->at(1)->vert0() != mc[1].volumeInfo()->at(1)->vert0() )
+    {
+      printf("  FAILED: the slabs generated a different geometry\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// volume-pyramid
+//-----------------------------------------------------------------------------
+// Adds a ball of the given radius, 1 at the center and 0 at the border, returns the box of the modified values.
+void splatBall(Volume* vol, const ivec3& center, int radius, ivec3& box_min, ivec3& box_max)
+{
+  box_min = ivec3( std::max(center.x()-radius, 0), std::max(center.y()-radius, 0), std::max(center.z()-radius, 0) );
+  box_max = ivec3( std::min(center.x()+radius, vol->slices().x()-1), std::min(center.y()+radius, vol->slices().y()-1), std::min(center.z()+radius, vol->slices().z()-1) );
+  for(int z=box_min.z(); z<=box_max.z(); ++z)
+    for(int y=box_min.y(); y<=box_max.y(); ++y)
+      for(int x=box_min.x(); x<=box_max.x(); ++x)
+      {
+        int dx = x-center.x(), dy = y-center.y(), dz = z-center.z();
+        float v = 1.0f - (float)(dx*dx + dy*dy + dz*dz) / (radius*radius);
+        if (v > vol->value(x,y,z))
+          vol->value(x,y,z) = v;
+      }
+}
+//-----------------------------------------------------------------------------
+// A size^3 volume of zeros containing count balls at random positions.
+ref<Volume> makeSparseVolume(int size, int count, int radius)
+{
+  ref<Volume> vol = new Volume;
+  vol->setup(NULL, false, false, fvec3(0,0,0), fvec3(1,1,1), ivec3(size,size,size));
+  memset(vol->values(), 0, sizeof(float)*size*size*size);
+  ivec3 box_min, box_max;
+  for(int i=0; i<count; ++i)
+    splatBall(vol.get(), ivec3(rand()%size, rand()%size, rand()%size), radius, box_min, box_max);
+  return vol;
+}
+//-----------------------------------------------------------------------------
+// The number of vertices MarchingCubes generates: one for every edge between two different values crossing the threshold.
+int countCrossedEdges(const Volume* vol, float threshold)
+{
+  int count = 0;
+  const ivec3& n = vol->slices();
+  for(int z=0; z<n.z(); ++z)
+    for(int y=0; y<n.y(); ++y)
+      for(int x=0; x<n.x(); ++x)
+      {
+        float v0 = vol->value(x,y,z);
+        float v[] = { x+1<n.x() ? vol->value(x+1,y,z) : v0, y+1<n.y() ? vol->value(x,y+1,z) : v0, z+1<n.z() ? vol->value(x,y,z+1) : v0 };
+        for(int i=0; i<3; ++i)
+          if (v[i] != v0 && threshold >= std::min(v0, v[i]) && threshold <= std::max(v0, v[i]))
+            ++count;
+      }
+  return count;
+}
+//-----------------------------------------------------------------------------
+// MarchingCubes extraction time against the fraction of the min/max pyramid blocks containing the threshold,
+// and incremental setupInternalData() after editing a small box against a full rebuild.
+int benchVolumePyramid(int argc, const char* argv[])
+{
+  int size = argc > 0 ? atoi(argv[0]) : 128;
+
+  printf("volume-pyramid: %d^3 volume\n", size);
+
+  srand(0);
+  Time timer;
+  const float thresholds[] = { 0.25f, 0.5f, 0.75f };
+  for(int count=1; count<=1024; count*=4)
+  {
+    ref<Volume> vol = makeSparseVolume(size, count, 5);
+    MarchingCubes mc;
+    mc.setHighQualityNormals(false);
+    mc.volumeInfo()->push_back( new VolumeInfo(vol.get(), thresholds[0]) );
+    mc.run(false);
+
+    // threshold changes only, the pyramid is not rebuilt
+    timer.start();
+    for(int i=0; i<3; ++i)
+    {
+      mc.volumeInfo()->at(0)->setThreshold(thresholds[i]);
+      mc.run(false);
+    }
+    double time = timer.elapsed() / 3;
+
+    int occupied = 0;
+    const ivec3& blocks = vol->pyramidLevelSize(0);
+    for(int z=0; z<blocks.z(); ++z)
+      for(int y=0; y<blocks.y(); ++y)
+        for(int x=0; x<blocks.x(); ++x)
+          occupied += vol->block(0,x,y,z).includes(thresholds[2]) ? 1 : 0;
+
+    printf("  %4d balls: %5.1f%% blocks occupied, %.2fms per extraction, %d triangles\n", count,
+      100.0f * occupied / (blocks.x()*blocks.y()*blocks.z()), time * 1000, (int)mc.mDrawElements->indexBuffer()->size()/3);
+
+    int expected = countCrossedEdges(vol.get(), thresholds[2]);
+    if ((int)mc.mVertsArray->size() != expected)
+    {
+      printf("  FAILED: %d vertices generated instead of %d\n", (int)mc.mVertsArray->size(), expected);
+      return 1;
+    }
+  }
+
+  // edit a small box of a volume and compare the incremental update with a full rebuild
+  ref<Volume> vol = makeSparseVolume(size, 64, 5);
+  vol->setupInternalData();
+  ivec3 box_min, box_max;
+  splatBall(vol.get(), ivec3(size/2, size/2, size/2), 4, box_min, box_max);
+
+  vol->setDataDirty(box_min, box_max);
+  timer.start();
+  vol->setupInternalData();
+  double incremental_time = timer.elapsed();
+
+  ref<Volume> copy = new Volume;
+  copy->setup(vol->values(), false, true, vol->bottomLeft(), vol->topRight(), vol->slices());
+  timer.start();
+  copy->setupInternalData();
+  double full_time = timer.elapsed();
+
+  printf("  setupInternalData(): full %.2fms, %dx%dx%d dirty box %.3fms (%.1fx)\n", full_time * 1000,
+    box_max.x()-box_min.x()+1, box_max.y()-box_min.y()+1, box_max.z()-box_min.z()+1, incremental_time * 1000, full_time / incremental_time);
+
+  MarchingCubes mc[2];
+  mc[0].volumeInfo()->push_back( new VolumeInfo(vol.get(), 0.5f) );
+  mc[1].volumeInfo()->push_back( new VolumeInfo(copy.get(), 0.5f) );
+  mc[0].run(false);
+  mc[1].run(false);
+  if ( !sameArray(mc[0].mVertsArray.get(), mc[1].mVertsArray.get()) ||
+       !sameArray(mc[0].mDrawElements->indexBuffer(), mc[1].mDrawElements->indexBuffer()) )
+  {
+    printf("  FAILED: the incremental update generated a different geometry\n");
+    return 1;
+  }
+  for(int level=0; level<vol->pyramidLevelCount(); ++level)
+  {
+    const ivec3& blocks = vol->pyramidLevelSize(level);
+    for(int z=0; z<blocks.z(); ++z)
+      for(int y=0; y<blocks.y(); ++y)
+        for(int x=0; x<blocks.x(); ++x)
+          if (vol->block(level,x,y,z).mMin != copy->block(level,x,y,z).mMin || vol->block(level,x,y,z).mMax != copy->block(level,x,y,z).mMax)
+          {
+            printf("  FAILED: the incremental update generated a different min/max pyramid\n");
+            return 1;
+          }
+  }
+
+  // a single slice contains no cubes and must not hang the pyramid construction
+  ref<Volume> flat = new Volume;
+  flat->setup(NULL, false, false, fvec3(0,0,0), fvec3(1,1,1), ivec3(size,size,1));
+  for(int i=0; i<size*size; ++i)
+    flat->values()[i] = (float)(i % 2);
+  MarchingCubes flat_mc;
+  flat_mc.volumeInfo()->push_back( new VolumeInfo(flat.get(), 0.5f) );
+  flat_mc.run(false);
+  if (flat->pyramidLevelCount() != 0 || flat_mc.mVertsArray->size() != 0)
+  {
+    printf("  FAILED: a single slice volume generated %d vertices\n", (int)flat_mc.mVertsArray->size());
+    return 1;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// isosurface-edit
+//-----------------------------------------------------------------------------
+// The sorted distinct vertex positions of a MarchingCubes output.
+std::vector<fvec3> distinctVertices(const MarchingCubes& mc)
+{
+  std::vector<fvec3> verts(mc.mVertsArray->begin(), mc.mVertsArray->end());
+  std::sort(verts.begin(), verts.end());
+  verts.erase( std::unique(verts.begin(), verts.end()), verts.end() );
+  return verts;
+}
+//-----------------------------------------------------------------------------
+// Bricked MarchingCubes updated after editing boxes of increasing size against a full extraction.
+int benchIsosurfaceEdit(int argc, const char* argv[])
+{
+  int size       = argc > 0 ? atoi(argv[0]) : 128;
+  int brick_size = argc > 1 ? atoi(argv[1]) : 16;
+
+  printf("isosurface-edit: %d^3 volume, %d^3 cubes bricks\n", size, brick_size);
+
+  srand(0);
+  ref<Volume> vol = makeSparseVolume(size, 256, 5);
+
+  MarchingCubes bricked, full;
+  bricked.setBrickSize(brick_size);
+  bricked.volumeInfo()->push_back( new VolumeInfo(vol.get(), 0.5f) );
+  full.volumeInfo()->push_back( new VolumeInfo(vol.get(), 0.5f) );
+
+  Time timer;
+  timer.start();
+  bricked.run(false);
+  printf("  first run: %.1fms, %d bricks, %d triangles\n", timer.elapsed() * 1000, bricked.extractedBrickCount(), (int)bricked.mDrawElements->indexBuffer()->size()/3);
+
+  for(int radius=2; radius<=16; radius*=2)
+  {
+    ivec3 box_min, box_max;
+    splatBall(vol.get(), ivec3(rand()%size, rand()%size, rand()%size), radius, box_min, box_max);
+    vol->setDataDirty(box_min, box_max);
+
+    timer.start();
+    bricked.run(false);
+    double bricked_time = timer.elapsed();
+
+    timer.start();
+    full.run(false);
+    double full_time = timer.elapsed();
+
+    printf("  %2d^3 edit: %3d bricks %.2fms, full extraction %.1fms (%.1fx)\n", radius*2+1, bricked.extractedBrickCount(), bricked_time * 1000, full_time * 1000, full_time / bricked_time);
+  }
+
+  // an incremental update must produce the same geometry of the bricks computed from scratch
+  MarchingCubes scratch;
+  scratch.setBrickSize(brick_size);
+  scratch.volumeInfo()->push_back( new VolumeInfo(vol.get(), 0.5f) );
+  scratch.run(false);
+  if ( !sameArray(bricked.mVertsArray.get(), scratch.mVertsArray.get()) ||
+       !sameArray(bricked.mNormsArray.get(), scratch.mNormsArray.get()) ||
+       !sameArray(bricked.mDrawElements->indexBuffer(), scratch.mDrawElements->indexBuffer()) )
+  {
+    printf("  FAILED: the incremental update differs from the extraction from scratch\n");
+    return 1;
+  }
+
+  // the bricks duplicate the vertices on their sides
+  if ( distinctVertices(bricked) != distinctVertices(full) )
+  {
+    printf("  FAILED: the bricks generated different vertices than the full extraction\n");
+    return 1;
+  }
+
+  // edits next to a brick side change the high quality normals of the adjacent brick:
+  // a plane crossing the last cubes of a brick edited one value after its side, and one crossing the first cubes edited one value before it,
+  // both close to the side so that the normals sample the edited values, with a slope changing along y to tilt the normals
+  int n = brick_size * 3 + 1;
+  for(int side=0; side<2; ++side)
+  {
+    float plane_x = side == 0 ? 2*brick_size - 0.1f : 2*brick_size + 0.1f;
+    int edit_x  = side == 0 ? 2*brick_size + 1 : 2*brick_size - 1;
+    ref<Volume> plane = new Volume;
+    plane->setup(NULL, false, false, fvec3(0,0,0), fvec3(1,1,1), ivec3(n,n,n));
+    for(int z=0; z<n; ++z)
+      for(int y=0; y<n; ++y)
+        for(int x=0; x<n; ++x)
+          plane->value(x,y,z) = 0.5f + (x - plane_x) * (0.1f + 0.01f * y);
+
+    MarchingCubes edited;
+    edited.setBrickSize(brick_size);
+    edited.volumeInfo()->push_back( new VolumeInfo(plane.get(), 0.5f) );
+    edited.run(false);
+
+    for(int z=n/4; z<=n/2; ++z)
+      for(int y=n/4; y<=n/2; ++y)
+        plane->value(edit_x,y,z) += 0.3f;
+    plane->setDataDirty( ivec3(edit_x, n/4, n/4), ivec3(edit_x, n/2, n/2) );
+    edited.run(false);
+
+    MarchingCubes reference;
+    reference.setBrickSize(brick_size);
+    reference.volumeInfo()->push_back( new VolumeInfo(plane.get(), 0.5f) );
+    reference.run(false);
+    if ( !sameArray(edited.mVertsArray.get(), reference.mVertsArray.get()) ||
+         !sameArray(edited.mNormsArray.get(), reference.mNormsArray.get()) )
+    {
+      printf("  FAILED: an edit at x=%d left stale normals in the bricks sharing the side at x=%d\n", edit_x, 2*brick_size);
+      return 1;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// volume-utils
+//-----------------------------------------------------------------------------
+// The voxel by voxel genRGBAVolume() used before the transfer tables and the SSE2 kernels, used as the reference.
+template<typename data_type>
+ref<Image> referenceRGBAVolume(const Image* data, const Image* trfunc, const fvec3* light_dir, bool alpha_from_data, float normalizer_num)
+{
+  int w = data->width(), h = data->height(), d = data->depth();
+  int pitch = data->pitch();
+  const unsigned char* lum_px = data->pixels();
+  ref<Image> volume = new Image( w, h, d, 1, IF_RGBA, IT_UNSIGNED_BYTE );
+  ubvec4* rgba_px = (ubvec4*)volume->pixels();
+  for(int z=0; z<d; ++z)
+    for(int y=0; y<h; ++y)
+      for(int x=0; x<w; ++x, ++rgba_px)
+      {
+        float lum = (*(data_type*)(lum_px + x*sizeof(data_type) + y*pitch + z*pitch*h)) * normalizer_num;
+        float xval = lum*trfunc->width();
+        if (xval > trfunc->width()-1.001f)
+          xval = trfunc->width()-1.001f;
+        int ix1 = (int)xval;
+        float w21  = (float)fract(xval);
+        float w11  = 1.0f - w21;
+        fvec4 rgba = ((fvec4)((ubvec4*)trfunc->pixels())[ix1]*w11 + (fvec4)((ubvec4*)trfunc->pixels())[ix1+1]*w21)*(1.0f/255.0f);
+        if (light_dir)
+        {
+          fvec3 L = normalize(*light_dir);
+          int x1 = clamp(x-1, 0, w-1), x2 = clamp(x+1, 0, w-1);
+          int y1 = clamp(y-1, 0, h-1), y2 = clamp(y+1, 0, h-1);
+          int z1 = clamp(z-1, 0, d-1), z2 = clamp(z+1, 0, d-1);
+          data_type vx1 = (*(data_type*)(lum_px + x1*sizeof(data_type) + y *pitch + z *pitch*h));
+          data_type vx2 = (*(data_type*)(lum_px + x2*sizeof(data_type) + y *pitch + z *pitch*h));
+          data_type vy1 = (*(data_type*)(lum_px + x *sizeof(data_type) + y1*pitch + z *pitch*h));
+          data_type vy2 = (*(data_type*)(lum_px + x *sizeof(data_type) + y2*pitch + z *pitch*h));
+          data_type vz1 = (*(data_type*)(lum_px + x *sizeof(data_type) + y *pitch + z1*pitch*h));
+          data_type vz2 = (*(data_type*)(lum_px + x *sizeof(data_type) + y *pitch + z2*pitch*h));
+          fvec3 N1(float(vx1-vx2), float(vy1-vy2), float(vz1-vz2));
+          N1.normalize();
+          fvec3 N2 = -N1 * 0.15f;
+          float l1 = max(dot(N1,L),0.0f);
+          float l2 = max(dot(N2,L),0.0f);
+          rgba.r() = clamp(rgba.r()*l1 + rgba.r()*l2+0.2f, 0.0f, 1.0f);
+          rgba.g() = clamp(rgba.g()*l1 + rgba.g()*l2+0.2f, 0.0f, 1.0f);
+          rgba.b() = clamp(rgba.b()*l1 + rgba.b()*l2+0.2f, 0.0f, 1.0f);
+        }
+        rgba_px->r() = (unsigned char)(rgba.r()*255.0f);
+        rgba_px->g() = (unsigned char)(rgba.g()*255.0f);
+        rgba_px->b() = (unsigned char)(rgba.b()*255.0f);
+        rgba_px->a() = alpha_from_data ? (unsigned char)(lum*255.0f) : (unsigned char)(rgba.a()*255.0f);
+      }
+  return volume;
+}
+//-----------------------------------------------------------------------------
+// The genGradientNormals() used before the SSE2 kernels, used as the reference.
+ref<Image> referenceGradientNormals(const Image* in_img)
+{
+  ref<Image> img = in_img->convertFormat( IF_LUMINANCE )->convertType( IT_FLOAT );
+  ref<Image> gradient = new Image;
+  gradient->allocate3D(img->width(), img->height(), img->depth(), 1, IF_RGB, IT_FLOAT);
+  const float* src_px = (const float*)img->pixels();
+  fvec3* dst_px = (fvec3*)gradient->pixels();
+  int w = img->width(), h = img->height(), d = img->depth();
+  for(int z=0; z<d; ++z)
+    for(int y=0; y<h; ++y)
+      for(int x=0; x<w; ++x)
+      {
+        int xn = std::max(x-1, 0), xp = std::min(x+1, w-1);
+        int yn = std::max(y-1, 0), yp = std::min(y+1, h-1);
+        int zn = std::max(z-1, 0), zp = std::min(z+1, d-1);
+        fvec3 A(src_px[xn + w*y + w*h*z], src_px[x + w*yn + w*h*z], src_px[x + w*y + w*h*zn]);
+        fvec3 B(src_px[xp + w*y + w*h*z], src_px[x + w*yp + w*h*z], src_px[x + w*y + w*h*zp]);
+        dst_px[x + w*y + w*h*z] = normalize(A - B) * 0.5f + 0.5f;
+      }
+  return gradient;
+}
+//-----------------------------------------------------------------------------
+bool sameImage(const Image* a, const Image* b)
+{
+  return a && b && a->requiredMemory() == b->requiredMemory() && memcmp(a->pixels(), b->pixels(), a->requiredMemory()) == 0;
+}
+//-----------------------------------------------------------------------------
+// A size^3 luminance volume containing a noisy sphere.
+template<typename data_type>
+ref<Image> makeLuminanceVolume(int size, EImageType type, float max_value)
+{
+  ref<Image> img = new Image(size, size, size, 1, IF_LUMINANCE, type);
+  data_type* px = (data_type*)img->pixels();
+  for(int z=0; z<size; ++z)
+    for(int y=0; y<size; ++y)
+      for(int x=0; x<size; ++x)
+      {
+        fvec3 p = fvec3((float)x, (float)y, (float)z) * (2.0f/size) - 1.0f;
+        float v = clamp(1.0f - p.length() + 0.1f * sinf(p.x()*17.0f) * cosf(p.y()*13.0f) + 0.02f * (rand() % 100) / 100.0f, 0.0f, 1.0f);
+        *px++ = (data_type)(v * max_value);
+      }
+  return img;
+}
+//-----------------------------------------------------------------------------
+// Runs genRGBAVolume() with and without lighting and genGradientNormals() on a volume and compares them with the references.
+template<typename data_type>
+bool benchVolumeUtilsType(const char* name, const Image* data, const Image* trfunc, float normalizer)
+{
+  const fvec3 light_dir(1, 2, 3);
+  const int voxels = data->width() * data->height() * data->depth();
+  const int threads = globalSettings()->threadCount();
+  Time timer;
+
+  for(int lit=1; lit>=0; --lit)
+  {
+    timer.start();
+    ref<Image> reference = referenceRGBAVolume<data_type>(data, trfunc, lit ? &light_dir : NULL, lit == 0, normalizer);
+    double reference_time = timer.elapsed();
+    timer.start();
+    ref<Image> img = lit ? genRGBAVolume(data, trfunc, light_dir, false) : genRGBAVolume(data, trfunc, true);
+    double time = timer.elapsed();
+    printf("  %-6s %-9s voxel by voxel %6.1f Mvoxels/s, %6.1f Mvoxels/s per core on %d threads (%.2fx)\n", name, lit ? "lit" : "unlit",
+      voxels / reference_time / 1e6, voxels / time / 1e6 / threads, threads, reference_time / time);
+    if (!sameImage(img.get(), reference.get()))
+    {
+      printf("  FAILED: genRGBAVolume() differs from the voxel by voxel reference\n");
+      return false;
+    }
+  }
+
+  timer.start();
+  ref<Image> reference = referenceGradientNormals(data);
+  double reference_time = timer.elapsed();
+  timer.start();
+  ref<Image> img = genGradientNormals(data);
+  double time = timer.elapsed();
+  printf("  %-6s %-9s voxel by voxel %6.1f Mvoxels/s, %6.1f Mvoxels/s per core on %d threads (%.2fx)\n", name, "gradient",
+    voxels / reference_time / 1e6, voxels / time / 1e6 / threads, threads, reference_time / time);
+  if (!sameImage(img.get(), reference.get()))
+  {
+    printf("  FAILED: genGradientNormals() differs from the voxel by voxel reference\n");
+    return false;
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+// genRGBAVolume() and genGradientNormals() against their voxel by voxel versions on 8 bits, 16 bits and float volumes.
+int benchVolumeUtils(int argc, const char* argv[])
+{
+  int size = argc > 0 ? atoi(argv[0]) : 96;
+
+  printf("volume-utils: %d^3 volume\n", size);
+
+  srand(0);
+  ref<Image> trfunc = makeColorSpectrum(128, fvec4(0,0,0,0), fvec4(1,0,0,0.2f), fvec4(1,1,0,0.6f), fvec4(1,1,1,1));
+  ref<Image> data_ub = makeLuminanceVolume<unsigned char>(size, IT_UNSIGNED_BYTE, 255.0f);
+  ref<Image> data_us = makeLuminanceVolume<unsigned short>(size, IT_UNSIGNED_SHORT, 65535.0f);
+  ref<Image> data_f  = makeLuminanceVolume<float>(size, IT_FLOAT, 1.0f);
+
+  if ( !benchVolumeUtilsType<unsigned char>("uint8", data_ub.get(), trfunc.get(), 1.0f/255.0f) ||
+       !benchVolumeUtilsType<unsigned short>("uint16", data_us.get(), trfunc.get(), 1.0f/65535.0f) ||
+       !benchVolumeUtilsType<float>("float", data_f.get(), trfunc.get(), 1.0f) )
+    return 1;
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// volume-raycast
+//-----------------------------------------------------------------------------
+// RaycastVolumeCPU with and without empty space skipping, the image must not depend on the skipping, the tiles or the threads.
+int benchVolumeRaycast(int argc, const char* argv[])
+{
+  int size = argc > 0 ? atoi(argv[0]) : 96;
+  int resolution = argc > 1 ? atoi(argv[1]) : 256;
+
+  printf("volume-raycast: %d^3 volume, %dx%d pixels\n", size, resolution, resolution);
+
+  srand(0);
+  ref<Image> volume = makeLuminanceVolume<unsigned char>(size, IT_UNSIGNED_BYTE, 255.0f);
+  // transparent below 0.3 and increasingly opaque above, makeColorSpectrum() leaves the alpha at 1
+  ref<Image> trfunc = makeColorSpectrum(128, vl::black, vl::red, vl::yellow, vl::white);
+  for(int i=0; i<trfunc->width(); ++i)
+    trfunc->pixels()[i*4+3] = (unsigned char)(255.0f * clamp((float)i / trfunc->width() - 0.3f, 0.0f, 1.0f) * 0.4f);
+
+  ref<RaycastVolume> raycast_volume = new RaycastVolume;
+  raycast_volume->setBox( AABB( vec3(-10,-10,-10), vec3(+10,+10,+10) ) );
+  raycast_volume->generateTextureCoordinates( ivec3(size, size, size) );
+  ref<Transform> transform = new Transform( mat4::getRotation(30, 0, 1, 0) );
+  transform->computeWorldMatrix();
+
+  ref<Camera> camera = new Camera;
+  camera->viewport()->set(0, 0, resolution, resolution);
+  camera->setProjectionPerspective();
+  camera->setViewMatrixLookAt(vec3(15,20,30), vec3(0,0,0), vec3(0,1,0));
+
+  ref<RaycastVolumeCPU> raycaster = new RaycastVolumeCPU;
+  Time timer;
+  timer.start();
+  raycaster->setVolume(volume.get());
+  raycaster->setTransferFunction(trfunc.get());
+  printf("  setup:       %7.2fms\n", timer.elapsed()*1000);
+
+  raycaster->setEmptySpaceSkipping(false);
+  timer.start();
+  ref<Image> reference = raycaster->render(raycast_volume.get(), camera.get(), transform.get());
+  double brute_time = timer.elapsed();
+  printf("  no skipping: %7.2fms, %6.2f Mrays/s, %lld rays, %lld samples\n", brute_time*1000,
+    raycaster->statsRayCount() / brute_time / 1e6, raycaster->statsRayCount(), raycaster->statsSampleCount());
+  if (!reference || !raycaster->statsRayCount() || !raycaster->statsSampleCount())
+  {
+    printf("  FAILED: the volume is not visible\n");
+    return 1;
+  }
+
+  raycaster->setEmptySpaceSkipping(true);
+  timer.start();
+  ref<Image> img = raycaster->render(raycast_volume.get(), camera.get(), transform.get());
+  double time = timer.elapsed();
+  printf("  skipping:    %7.2fms, %6.2f Mrays/s, %lld rays, %lld samples, %lld skipped (%.2fx)\n", time*1000,
+    raycaster->statsRayCount() / time / 1e6, raycaster->statsRayCount(), raycaster->statsSampleCount(), raycaster->statsSkippedSampleCount(), brute_time / time);
+  if (!sameImage(img.get(), reference.get()))
+  {
+    printf("  FAILED: empty space skipping changed the image\n");
+    return 1;
+  }
+
+  // tiles and threads
+  const int threads = globalSettings()->threadCount();
+  const int tile_sizes[] = { 1, 7, 64 };
+  for(int i=0; i<3; ++i)
+  {
+    globalSettings()->setThreadCount(i == 0 ? 1 : threads);
+    raycaster->setTileSize(tile_sizes[i]);
+    timer.start();
+    img = raycaster->render(raycast_volume.get(), camera.get(), transform.get());
+    time = timer.elapsed();
+    printf("  tile %2d:     %7.2fms, %6.2f Mrays/s on %d threads\n", tile_sizes[i], time*1000, raycaster->statsRayCount() / time / 1e6, globalSettings()->threadCount());
+    if (!sameImage(img.get(), reference.get()))
+    {
+      printf("  FAILED: the tile size or the thread count changed the image\n");
+      globalSettings()->setThreadCount(threads);
+      return 1;
+    }
+  }
+  globalSettings()->setThreadCount(threads);
+
+  // an odd width with rows aligned to 4 bytes leaves padding at the end of each row, the image must not change
+  const int odd = size - 1;
+  ref<Image> packed = new Image(odd, size, size, 1, IF_LUMINANCE, IT_UNSIGNED_BYTE);
+  ref<Image> padded = new Image(odd, size, size, 4, IF_LUMINANCE, IT_UNSIGNED_BYTE);
+  memset(padded->pixels(), 255, padded->requiredMemory());
+  for(int z=0; z<size; ++z)
+    for(int y=0; y<size; ++y)
+    {
+      const unsigned char* row = volume->pixels() + volume->pitch() * (y + size * z);
+      memcpy(packed->pixels() + packed->pitch() * (y + size * z), row, odd);
+      memcpy(padded->pixels() + padded->pitch() * (y + size * z), row, odd);
+    }
+  raycaster->setVolume(packed.get());
+  reference = raycaster->render(raycast_volume.get(), camera.get(), transform.get());
+  raycaster->setVolume(padded.get());
+  img = raycaster->render(raycast_volume.get(), camera.get(), transform.get());
+  if (padded->pitch() == odd || !sameImage(img.get(), reference.get()))
+  {
+    printf("  FAILED: the padding of the rows changed the image\n");
+    return 1;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// obj-loader
+//-----------------------------------------------------------------------------
+// A size x size grid with normals and texture coordinates split in two objects, it also contains
+// comments, a statement spanning two lines and faces using negative indices.
+std::string makeObjText(int size)
+{
+  std::string text = "# vlbenchmark grid\no grid_a\n";
+  char line[256];
+  for(int y=0; y<size; ++y)
+  {
+    for(int x=0; x<size; ++x)
+    {
+      float h = sinf(x * 0.1f) * cosf(y * 0.1f);
+      sprintf(line, "v %f %f %f\nvt %.7g %.7g\nvn %.7g %.7g %.7g\n", (float)x, h, (float)y, x / (float)size, y / (float)size, h * 1e-3f, 1.0f, -h * 1e-5f);
+      text += line;
+    }
+  }
+  for(int y=0; y<size-1; ++y)
+  {
+    if (y == size/2)
+      text += "# second half\no grid_b\nusemtl missing\n";
+    for(int x=0; x<size-1; ++x)
+    {
+      int a = y*size + x + 1, b = a + 1, c = a + size + 1, d = a + size;
+      if (y % 2)
+        sprintf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a,a,a, b,b,b, c,c,c, d,d,d);
+      else
+        sprintf(line, "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n", a,a,a, b,b,b, c,c,c, a,a,a, c,c,c, d,d,d);
+      text += line;
+    }
+  }
+  text += "f -1/-1/-1 -2/-2/-2 \\\n  -3/-3/-3\n";
+  return text;
+}
+//-----------------------------------------------------------------------------
+// ObjLoader's parallel block parser against its line by line parser.
+int benchObjLoader(int argc, const char* argv[])
+{
+  int size = argc > 0 ? atoi(argv[0]) : 300;
+
+  std::string text = makeObjText(size);
+  double megabytes = text.size() / (1024.0 * 1024.0);
+  printf("obj-loader: %dx%d grid, %.1f MB\n", size, size, megabytes);
+
+  ref<MemoryFile> file = new MemoryFile;
+  file->setPath("grid.obj");
+  file->allocateBuffer(text.size());
+  memcpy(file->ptr(), text.data(), text.size());
+
+  Time timer;
+  ObjLoader lines;
+  lines.setBlockParser(false);
+  timer.start();
+  ref<ResourceDatabase> lines_db = lines.loadOBJ(file.get());
+  double lines_time = timer.elapsed();
+
+  ObjLoader blocks;
+  timer.start();
+  ref<ResourceDatabase> blocks_db = blocks.loadOBJ(file.get());
+  double blocks_time = timer.elapsed();
+
+  printf("  line by line: %8.2fms, %6.2f MB/s\n", lines_time*1000, megabytes / lines_time);
+  printf("  blocks:       %8.2fms, %6.2f MB/s on %d threads (%.2fx)\n", blocks_time*1000, megabytes / blocks_time, globalSettings()->threadCount(), lines_time / blocks_time);
+
+  bool same = lines.vertexArray() == blocks.vertexArray() &&
+              lines.normalArray() == blocks.normalArray() &&
+              lines.texCoordsArray() == blocks.texCoordsArray() &&
+              lines.meshes().size() == blocks.meshes().size() &&
+              lines_db->resources().size() == blocks_db->resources().size();
+  for(size_t i=0; same && i<lines.meshes().size(); ++i)
+  {
+    const ObjMesh* a = lines.meshes()[i].get();
+    const ObjMesh* b = blocks.meshes()[i].get();
+    same = a->objectName() == b->objectName() &&
+           a->face_type() == b->face_type() &&
+           a->facePositionIndex() == b->facePositionIndex() &&
+           a->faceNormalIndex() == b->faceNormalIndex() &&
+           a->faceTexCoordIndex() == b->faceTexCoordIndex();
+  }
+  printf("  %d vertices, %d meshes\n", (int)blocks.vertexArray().size(), (int)blocks.meshes().size());
+  if (!same || blocks.meshes().size() != 2)
+  {
+    printf("  FAILED: the block parser and the line by line parser differ\n");
+    return 1;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// stl-loader
+//-----------------------------------------------------------------------------
+// A binary STL file containing a size x size height field with flat areas, two triangles per grid cell.
+ref<MemoryFile> makeBinarySTL(int size)
+{
+  unsigned int tri_count = (size-1) * (size-1) * 2;
+  ref<MemoryFile> file = new MemoryFile;
+  file->setPath("grid.stl");
+  file->allocateBuffer(84 + tri_count * 50);
+  memset(file->ptr(), 0, 84);
+  memcpy(file->ptr() + 80, &tri_count, 4);
+  unsigned char* ptr = file->ptr() + 84;
+  for(int y=0; y<size-1; ++y)
+  {
+    for(int x=0; x<size-1; ++x)
+    {
+      fvec3 p[4];
+      for(int i=0; i<4; ++i)
+      {
+        int px = x + (i == 1 || i == 2), py = y + (i >= 2);
+        p[i] = fvec3((float)px, max(0.0f, sinf(px * 0.1f) * cosf(py * 0.1f)), (float)py);
+      }
+      const int tris[2][3] = { {0, 2, 1}, {0, 3, 2} };
+      for(int t=0; t<2; ++t)
+      {
+        const fvec3& a = p[tris[t][0]];
+        const fvec3& b = p[tris[t][1]];
+        const fvec3& c = p[tris[t][2]];
+        fvec3 rec[4] = { cross(b - a, c - a).normalize(), a, b, c };
+        memcpy(ptr, rec, 48);
+        memset(ptr + 48, 0, 2);
+        ptr += 50;
+      }
+    }
+  }
+  return file;
+}
+//-----------------------------------------------------------------------------
+// Checks that the welded Geometry draws the same triangles as the unwelded one.
+bool sameTriangles(const Geometry* welded, const Geometry* unwelded, bool normals)
+{
+  const ArrayFloat3* wv = welded->vertexArray()->as<ArrayFloat3>();
+  const ArrayFloat3* uv = unwelded->vertexArray()->as<ArrayFloat3>();
+  const ArrayFloat3* wn = welded->normalArray() ? welded->normalArray()->as<ArrayFloat3>() : NULL;
+  const ArrayFloat3* un = unwelded->normalArray()->as<ArrayFloat3>();
+  const DrawElementsUInt* de = welded->drawCalls().at(0)->as<DrawElementsUInt>();
+  if ( !de || de->indexBuffer()->size() != uv->size() || (normals != (wn != NULL)) )
+    return false;
+  for(size_t i=0; i<uv->size(); ++i)
+  {
+    u32 idx = de->indexBuffer()->at(i);
+    if ( wv->at(idx) != uv->at(i) || (wn && wn->at(idx) != un->at(i)) )
+      return false;
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+// STLLoader's welded output against the default unindexed one.
+int benchSTLLoader(int argc, const char* argv[])
+{
+  int size = argc > 0 ? atoi(argv[0]) : 500;
+
+  ref<MemoryFile> file = makeBinarySTL(size);
+  printf("stl-loader: %dx%d grid, %d triangles, %.1f MB\n", size, size, (size-1)*(size-1)*2, file->size() / (1024.0*1024.0));
+
+  Time timer;
+  STLLoader loader;
+  timer.start();
+  ref<ResourceDatabase> unwelded_db = loader.loadSTL(file.get());
+  double unwelded_time = timer.elapsed();
+  const Geometry* unwelded = unwelded_db->get<Geometry>(0);
+  printf("  unwelded:           %7.2fms, %8d vertices\n", unwelded_time*1000, (int)unwelded->vertexArray()->size());
+
+  for(int face_normals=1; face_normals>=0; --face_normals)
+  {
+    loader.setWeldVertices(true);
+    loader.setFaceNormals(face_normals != 0);
+    loader.setBlockSize(4096);
+    timer.start();
+    ref<ResourceDatabase> welded_db = loader.loadSTL(file.get());
+    double welded_time = timer.elapsed();
+    const Geometry* welded = welded_db->get<Geometry>(0);
+    printf("  welded %-12s %7.2fms, %8d vertices, %.1f MB saved\n", face_normals ? "normals:" : "positions:", welded_time*1000,
+      (int)welded->vertexArray()->size(), loader.statsMemorySaved() / (1024.0*1024.0));
+    if ( !sameTriangles(welded, unwelded, face_normals != 0) || (!face_normals && (int)welded->vertexArray()->size() != size*size) )
+    {
+      printf("  FAILED: the welded triangles differ from the unwelded ones\n");
+      return 1;
+    }
+
+    // the block size must not matter
+    loader.setBlockSize(7);
+    ref<ResourceDatabase> small_db = loader.loadSTL(file.get());
+    const Geometry* small = small_db->get<Geometry>(0);
+    if ( !sameArray(small->vertexArray(), welded->vertexArray()) ||
+         !sameArray(small->drawCalls().at(0)->as<DrawElementsUInt>()->indexBuffer(), welded->drawCalls().at(0)->as<DrawElementsUInt>()->indexBuffer()) )
+    {
+      printf("  FAILED: the block size changed the welded geometry\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// ply-loader
+//-----------------------------------------------------------------------------
+// A binary PLY point cloud on a spiral, with normals and optionally colors and a few faces.
+ref<MemoryFile> makeBinaryPLY(int count, bool little_endian, bool colors, bool faces)
+{
+  std::string header = "ply\n";
+  header += little_endian ? "format binary_little_endian 1.0\n" : "format binary_big_endian 1.0\n";
+  header += "comment vlbenchmark\n";
+  header += String::printf("element vertex %d\n", count).toStdString();
+  header += "property float x\nproperty float y\nproperty float z\n";
+  header += "property float nx\nproperty float ny\nproperty float nz\n";
+  if (colors)
+    header += "property uchar red\nproperty uchar green\nproperty uchar blue\n";
+  int face_count = faces ? count / 3 : 0;
+  if (faces)
+    header += String::printf("element face %d\nproperty list uchar int vertex_indices\n", face_count).toStdString();
+  header += "end_header\n";
+
+  const int stride = 24 + (colors ? 3 : 0);
+  ref<MemoryFile> file = new MemoryFile;
+  file->setPath("cloud.ply");
+  file->allocateBuffer(header.size() + (long long)count * stride + (long long)face_count * 13);
+  memcpy(file->ptr(), header.data(), header.size());
+  unsigned char* ptr = file->ptr() + header.size();
+  unsigned short bet = 0x00FF;
+  bool swap = ( ((unsigned char*)&bet)[0] == 0xFF ) != little_endian;
+  for(int i=0; i<count; ++i)
+  {
+    float t = i * 0.001f;
+    float v[] = { cosf(t) * t, sinf(t) * t, t * 0.5f, cosf(t), sinf(t), 0.0f };
+    for(int j=0; j<6; ++j, ptr+=4)
+    {
+      if (swap)
+        swapBytes(v[j]);
+      memcpy(ptr, &v[j], 4);
+    }
+    if (colors)
+    {
+      *ptr++ = (unsigned char)i;
+      *ptr++ = (unsigned char)(i >> 8);
+      *ptr++ = (unsigned char)(i >> 16);
+    }
+  }
+  for(int i=0; i<face_count; ++i)
+  {
+    *ptr++ = 3;
+    for(int j=0; j<3; ++j, ptr+=4)
+    {
+      int idx = i*3 + j;
+      if (swap)
+        swapBytes(idx);
+      memcpy(ptr, &idx, 4);
+    }
+  }
+  return file;
+}
+//-----------------------------------------------------------------------------
+// PlyLoader's bulk decoding of the binary vertices against the property by property reads.
+int benchPlyLoader(int argc, const char* argv[])
+{
+  int count = argc > 0 ? atoi(argv[0]) : 1000000;
+
+  printf("ply-loader: %d points\n", count);
+
+  const char* names[] = { "little endian, normals, colors", "big endian, normals, colors", "big endian, normals", "little endian, normals, faces" };
+  for(int test=0; test<4; ++test)
+  {
+    bool little_endian = test == 0 || test == 3;
+    bool colors = test < 2;
+    bool faces = test == 3;
+    ref<MemoryFile> file = makeBinaryPLY(count, little_endian, colors, faces);
+
+    Time timer;
+    PlyLoader generic;
+    generic.setBulkDecoding(false);
+    timer.start();
+    ref<ResourceDatabase> generic_db = generic.loadPly(file.get());
+    double generic_time = timer.elapsed();
+
+    PlyLoader bulk;
+    timer.start();
+    ref<ResourceDatabase> bulk_db = bulk.loadPly(file.get());
+    double bulk_time = timer.elapsed();
+
+    printf("  %s:\n", names[test]);
+    printf("    per property: %8.2fms, %6.2f Mpoints/s\n", generic_time*1000, count / generic_time / 1000000.0);
+    printf("    bulk:         %8.2fms, %6.2f Mpoints/s (%.2fx)\n", bulk_time*1000, count / bulk_time / 1000000.0, generic_time / bulk_time);
+
+    const Geometry* a = generic_db ? generic_db->get<Actor>(0)->lod(0)->as<Geometry>() : NULL;
+    const Geometry* b = bulk_db ? bulk_db->get<Actor>(0)->lod(0)->as<Geometry>() : NULL;
+    bool same = a && b &&
+                (int)b->vertexArray()->size() == count &&
+                sameArray<ArrayAbstract>(a->vertexArray(), b->vertexArray()) &&
+                sameArray<ArrayAbstract>(a->normalArray(), b->normalArray()) &&
+                (colors ? b->colorArray() && sameArray<ArrayAbstract>(a->colorArray(), b->colorArray()) : !b->colorArray()) &&
+                (faces ? b->drawCalls().at(0)->primitiveType() == PT_TRIANGLES : b->drawCalls().at(0)->primitiveType() == PT_POINTS);
+    if (same && colors)
+    {
+      const ArrayUByte4* c = b->colorArray()->as<ArrayUByte4>();
+      same = c->at(count-1) == ubvec4((unsigned char)(count-1), (unsigned char)((count-1) >> 8), (unsigned char)((count-1) >> 16), 255);
+    }
+    if (!same)
+    {
+      printf("  FAILED: the bulk decoded vertices differ from the per property ones\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// zip-seek
+//-----------------------------------------------------------------------------
+// Compressible text made of numbered lines.
+std::vector<unsigned char> makeZipData(int megabytes)
+{
+  std::vector<unsigned char> data;
+  data.reserve((size_t)megabytes * 1024 * 1024);
+  char line[64];
+  for(int i=0; data.size() < (size_t)megabytes * 1024 * 1024; ++i)
+  {
+    int len = sprintf(line, "line %d value %d\n", i, (i * 7919) % 10007);
+    data.insert(data.end(), line, line + len);
+  }
+  data.resize((size_t)megabytes * 1024 * 1024);
+  return data;
+}
+//-----------------------------------------------------------------------------
+// A ZippedFile reading the given data deflated or stored in a memory zip stream.
+ref<ZippedFile> makeZippedFile(const std::vector<unsigned char>& data, bool deflate)
+{
+  // raw deflate data: strip the zlib header and the adler32 trailer
+  std::vector<unsigned char> zdata;
+  if (deflate)
+    compress(&data[0], data.size(), zdata, 6);
+  else
+  {
+    zdata.resize(data.size() + 6);
+    memcpy(&zdata[2], &data[0], data.size());
+  }
+  const int offset = 30;
+  ref<MemoryFile> zip = new MemoryFile;
+  zip->setPath("data.zip");
+  zip->allocateBuffer(offset + zdata.size() - 6);
+  memset(zip->ptr(), 0, offset);
+  memcpy(zip->ptr() + offset, &zdata[2], zdata.size() - 6);
+
+  ref<ZippedFileInfo> info = new ZippedFileInfo;
+  info->mVersionNeeded = 20;
+  info->mCompressionMethod = deflate ? 8 : 0;
+  info->mCompressedSize = (unsigned int)zdata.size() - 6;
+  info->mUncompressedSize = (unsigned int)data.size();
+  info->mZippedFileOffset = offset;
+  info->mFileName = "data.txt";
+  info->setSourceZipFile(zip.get());
+  ref<ZippedFile> file = new ZippedFile;
+  file->setZippedFileInfo(info.get());
+  file->setPath("data.zip/data.txt");
+  return file;
+}
+//-----------------------------------------------------------------------------
+// A GZipCodec reading the given data gzipped in a memory file.
+ref<GZipCodec> makeGZipCodec(const std::vector<unsigned char>& data)
+{
+  std::vector<unsigned char> zdata;
+  compress(&data[0], data.size(), zdata, 6);
+  const unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+  unsigned int crc = CRC32CheckSum().compute(&data[0], (int)data.size());
+  unsigned int size = (unsigned int)data.size();
+  ref<MemoryFile> gz = new MemoryFile;
+  gz->setPath("data.txt.gz");
+  gz->allocateBuffer(10 + zdata.size() - 6 + 8);
+  memcpy(gz->ptr(), header, 10);
+  memcpy(gz->ptr() + 10, &zdata[2], zdata.size() - 6);
+  memcpy(gz->ptr() + 10 + zdata.size() - 6, &crc, 4);
+  memcpy(gz->ptr() + 10 + zdata.size() - 6 + 4, &size, 4);
+  ref<GZipCodec> file = new GZipCodec(gz.get());
+  file->setWarnOnSeek(false);
+  return file;
+}
+//-----------------------------------------------------------------------------
+// Reads the whole file then seeks to random positions checking the bytes read, returns the time spent seeking or -1 on error.
+double randomSeeks(VirtualFile* file, const std::vector<unsigned char>& data, int seeks)
+{
+  std::vector<unsigned char> buffer(4096);
+  file->open(OM_ReadOnly);
+  for(long long pos=0; pos<(long long)data.size(); pos+=(long long)buffer.size())
+    file->read(&buffer[0], buffer.size());
+  Time timer;
+  timer.start();
+  srand(0);
+  bool ok = true;
+  for(int i=0; ok && i<seeks; ++i)
+  {
+    long long pos = ((long long)rand() * RAND_MAX + rand()) % (long long)(data.size() - buffer.size());
+    ok = file->seekSet(pos) && file->read(&buffer[0], buffer.size()) == (long long)buffer.size() &&
+         memcmp(&buffer[0], &data[(size_t)pos], buffer.size()) == 0;
+  }
+  double time = timer.elapsed();
+  file->close();
+  return ok ? time : -1;
+}
+//-----------------------------------------------------------------------------
+// Random seeks in ZippedFile and GZipCodec with and without inflate checkpoints.
+int benchZipSeek(int argc, const char* argv[])
+{
+  int megabytes = argc > 0 ? atoi(argv[0]) : 32;
+  int seeks     = argc > 1 ? atoi(argv[1]) : 20;
+
+  printf("zip-seek: %d MB, %d random seeks\n", megabytes, seeks);
+
+  std::vector<unsigned char> data = makeZipData(megabytes);
+
+  ref<ZippedFile> stored = makeZippedFile(data, false);
+  double stored_time = randomSeeks(stored.get(), data, seeks);
+  printf("  stored ZippedFile: %9.2fms\n", stored_time*1000);
+  if (stored_time < 0)
+  {
+    printf("  FAILED: the data read after a seek differs from the original\n");
+    return 1;
+  }
+
+  for(int test=0; test<2; ++test)
+  {
+    ref<VirtualFile> files[2];
+    InflateCheckpoints* checkpoints[2];
+    for(int i=0; i<2; ++i)
+    {
+      if (test == 0)
+      {
+        ref<ZippedFile> file = makeZippedFile(data, true);
+        checkpoints[i] = file->checkpoints();
+        files[i] = file;
+      }
+      else
+      {
+        ref<GZipCodec> file = makeGZipCodec(data);
+        checkpoints[i] = file->checkpoints();
+        files[i] = file;
+      }
+    }
+    // the checkpoints are disabled by default, the second file keeps them across the reopening done by randomSeeks()
+    checkpoints[1]->setSpacing(1024*1024);
+    checkpoints[1]->setKeepOnClose(true);
+
+    double restart_time = randomSeeks(files[0].get(), data, seeks);
+    double checkpoint_time = randomSeeks(files[1].get(), data, seeks);
+    printf("  %s:\n", test == 0 ? "ZippedFile" : "GZipCodec");
+    printf("    from the start:   %9.2fms, %.2fms per seek\n", restart_time*1000, restart_time*1000 / seeks);
+    printf("    from checkpoints: %9.2fms, %.2fms per seek (%.2fx), %d checkpoints, %.1f MB\n", checkpoint_time*1000, checkpoint_time*1000 / seeks, restart_time / checkpoint_time,
+      checkpoints[1]->checkpointCount(), checkpoints[1]->memoryUsed() / (1024.0*1024.0));
+    if (restart_time < 0 || checkpoint_time < 0)
+    {
+      printf("  FAILED: the data read after a seek differs from the original\n");
+      return 1;
+    }
+    if (checkpoints[0]->checkpointCount() != 0 || checkpoints[1]->checkpointCount() == 0)
+    {
+      printf("  FAILED: the checkpoints must be saved only when enabled\n");
+      return 1;
+    }
+
+    // a tight budget thins out the checkpoints but keeps them usable
+    checkpoints[1]->setSpacing(64*1024);
+    checkpoints[1]->setMemoryBudget(512*1024);
+    double thin_time = randomSeeks(files[1].get(), data, seeks);
+    printf("    512K budget:      %9.2fms, %.2fms per seek, %d checkpoints, %.1f MB\n", thin_time*1000, thin_time*1000 / seeks, checkpoints[1]->checkpointCount(), checkpoints[1]->memoryUsed() / (1024.0*1024.0));
+    if (thin_time < 0 || checkpoints[1]->memoryUsed() > 512*1024)
+    {
+      printf("  FAILED: the data read after a seek differs from the original\n");
+      return 1;
+    }
+
+    // without keepOnClose() the checkpoints are freed by close()
+    checkpoints[1]->setKeepOnClose(false);
+    if (randomSeeks(files[1].get(), data, seeks) < 0 || checkpoints[1]->checkpointCount() != 0 || checkpoints[1]->memoryUsed() != 0)
+    {
+      printf("  FAILED: the checkpoints must be freed when the file is closed\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// zip-directory
+//-----------------------------------------------------------------------------
+// A zip archive in memory containing the given entries, deflated.
+ref<MemoryFile> makeZipArchive(const std::vector< std::vector<unsigned char> >& entries)
+{
+  std::vector<unsigned char> zip;
+  for(size_t i=0; i<entries.size(); ++i)
+  {
+    const std::vector<unsigned char>& data = entries[i];
+    std::vector<unsigned char> zdata;
+    compress(&data[0], data.size(), zdata, 6);
+    std::string name = String::printf("textures/tex_%03d.raw", (int)i).toStdString();
+    unsigned int header[] = { 0x04034b50, 20 | (0 << 16), 8 | (0 << 16), 0,
+                              CRC32CheckSum().compute(&data[0], (int)data.size()), (unsigned int)zdata.size() - 6, (unsigned int)data.size() };
+    // 30 bytes local file header: the fields after the signature are 16 bit aligned
+    unsigned char local_header[30];
+    memcpy(local_header, &header[0], 4);
+    memcpy(local_header + 4, &header[1], 4);
+    memcpy(local_header + 8, &header[2], 2);
+    memset(local_header + 10, 0, 4);
+    memcpy(local_header + 14, &header[4], 4);
+    memcpy(local_header + 18, &header[5], 4);
+    memcpy(local_header + 22, &header[6], 4);
+    unsigned short name_length = (unsigned short)name.size(), extra_length = 0;
+    memcpy(local_header + 26, &name_length, 2);
+    memcpy(local_header + 28, &extra_length, 2);
+    zip.insert(zip.end(), local_header, local_header + 30);
+    zip.insert(zip.end(), name.begin(), name.end());
+    // raw deflate data: strip the zlib header and the adler32 trailer
+    zip.insert(zip.end(), zdata.begin() + 2, zdata.end() - 4);
+  }
+  ref<MemoryFile> file = new MemoryFile;
+  file->setPath("textures.zip");
+  file->allocateBuffer(zip.size());
+  memcpy(file->ptr(), &zip[0], zip.size());
+  return file;
+}
+//-----------------------------------------------------------------------------
+// ZippedDirectory's parallel extractFiles() and prefetch() against reading the entries one after the other.
+int benchZipDirectory(int argc, const char* argv[])
+{
+  int count    = argc > 0 ? atoi(argv[0]) : 200;
+  int entry_kb = argc > 1 ? atoi(argv[1]) : 256;
+
+  std::vector<unsigned char> data = makeZipData( std::max(1, count * entry_kb / 1024 + 1) );
+  std::vector< std::vector<unsigned char> > entries(count);
+  for(int i=0; i<count; ++i)
+    entries[i].assign(data.begin() + (size_t)i * entry_kb * 1024, data.begin() + (size_t)(i+1) * entry_kb * 1024);
+  double megabytes = count * entry_kb / 1024.0;
+
+  ref<ZippedDirectory> dir = new ZippedDirectory( makeZipArchive(entries).get() );
+  std::vector<String> names;
+  dir->listFilesRecursive(names);
+  printf("zip-directory: %d entries of %dKB, %.1f MB\n", (int)names.size(), entry_kb, megabytes);
+  if ((int)names.size() != count)
+  {
+    printf("  FAILED: the archive contains %d entries\n", (int)names.size());
+    return 1;
+  }
+
+  // one entry after the other, as FileSystem::locateFile() does
+  Time timer;
+  timer.start();
+  std::vector< ref<MemoryFile> > sequential(count);
+  for(int i=0; i<count; ++i)
+  {
+    sequential[i] = new MemoryFile;
+    sequential[i]->copy( dir->file(names[i]).get() );
+  }
+  double sequential_time = timer.elapsed();
+
+  timer.start();
+  std::vector< ref<MemoryFile> > parallel;
+  int extracted = dir->extractFiles("*.raw", parallel, false);
+  double parallel_time = timer.elapsed();
+
+  timer.start();
+  std::vector< ref<MemoryFile> > checked;
+  extracted = std::min(extracted, dir->extractFiles(names, checked, true));
+  double checked_time = timer.elapsed();
+
+  // prefetch with a budget of a quarter of the archive and a look-ahead matching the threads, then request the entries in order
+  dir->setPrefetchMemoryBudget( (long long)(megabytes * 1024 * 1024 / 4) );
+  dir->setPrefetchLookAhead( std::max(3, globalSettings()->threadCount() - 1) );
+  timer.start();
+  dir->prefetch(names);
+  bool same = extracted == count;
+  long long max_prefetched = 0;
+  for(int i=0; same && i<count; ++i)
+  {
+    ref<MemoryFile> file = cast<MemoryFile>( dir->file(names[i]).get() );
+    max_prefetched = std::max(max_prefetched, dir->prefetchedBytes());
+    same = file && file->size() == (long long)entries[i].size() && memcmp(file->ptr(), &entries[i][0], entries[i].size()) == 0 &&
+           memcmp(sequential[i]->ptr(), &entries[i][0], entries[i].size()) == 0 &&
+           memcmp(parallel[i]->ptr(), &entries[i][0], entries[i].size()) == 0 &&
+           memcmp(checked[i]->ptr(), &entries[i][0], entries[i].size()) == 0;
+  }
+  double prefetch_time = timer.elapsed();
+
+  printf("  one by one:    %8.2fms, %7.2f MB/s\n", sequential_time*1000, megabytes / sequential_time);
+  printf("  extractFiles:  %8.2fms, %7.2f MB/s on %d threads (%.2fx)\n", parallel_time*1000, megabytes / parallel_time, globalSettings()->threadCount(), sequential_time / parallel_time);
+  printf("    with CRC32:  %8.2fms, %7.2f MB/s\n", checked_time*1000, megabytes / checked_time);
+  printf("  prefetch:      %8.2fms, %7.2f MB/s, at most %.1f MB held\n", prefetch_time*1000, megabytes / prefetch_time, max_prefetched / (1024.0*1024.0));
+  if (!same || max_prefetched > dir->prefetchMemoryBudget() || max_prefetched > (long long)dir->prefetchLookAhead() * entry_kb * 1024 || dir->prefetchedBytes() != 0)
+  {
+    printf("  FAILED: the extracted entries differ from the original data\n");
+    return 1;
+  }
+  return 0;
+}
+//-----------------------------------------------------------------------------
+// frustum
+//-----------------------------------------------------------------------------
+// Batched Frustum::cullSpheres()/cullAABBs() against the per-volume Frustum::cull().
+int benchFrustum(int argc, const char* argv[])
+{
+  int count = argc > 0 ? atoi(argv[0]) : 1000000;
+
+  printf("frustum: %d volumes\n", count);
+
+  ref<Camera> camera = new Camera;
+  camera->viewport()->set(0, 0, 1024, 768);
+  camera->setProjectionPerspective();
+  camera->setViewMatrixLookAt(vec3(0,0,600), vec3(0,0,0), vec3(0,1,0));
+  camera->computeFrustumPlanes();
+  const Frustum& frustum = camera->frustum();
+
+  srand(0);
+  std::vector<float> cx(count), cy(count), cz(count), r(count);
+  std::vector<float> max_x(count), max_y(count), max_z(count);
+  std::vector<float> min_x(count), min_y(count), min_z(count);
+  for(int i=0; i<count; ++i)
+  {
+    cx[i] = (float)(rand()%1000 - 500);
+    cy[i] = (float)(rand()%1000 - 500);
+    cz[i] = (float)(rand()%1000 - 500);
+    r[i]  = (float)(rand()%10);
+    min_x[i] = cx[i] - r[i]; max_x[i] = cx[i] + r[i];
+    min_y[i] = cy[i] - r[i]; max_y[i] = cy[i] + r[i];
+    min_z[i] = cz[i] - r[i]; max_z[i] = cz[i] + r[i];
+  }
+  std::vector<u32> visible( (count+31)/32 );
+  std::vector<char> scalar_mask(count);
+
+  Time timer;
+
+  // spheres
+  timer.start();
+  int scalar_visible = 0;
+  for(int i=0; i<count; ++i)
+    scalar_visible += scalar_mask[i] = frustum.cull( Sphere(vec3(cx[i],cy[i],cz[i]), r[i]) ) ? 0 : 1;
+  double scalar_time = timer.elapsed();
+
+  timer.start();
+  frustum.cullSpheres(count, &cx[0], &cy[0], &cz[0], &r[0], &visible[0]);
+  double batch_time = timer.elapsed();
+
+  // the batched path is conservative: it may keep objects touching a plane but must never cull a visible one
+  int batch_visible = 0, missed = 0;
+  for(int i=0; i<count; ++i)
+  {
+    int v = (visible[i>>5] >> (i&31)) & 1;
+    batch_visible += v;
+    missed += scalar_mask[i] && !v;
+  }
+
+  printf("  spheres: scalar %.3fms, batched %.3fms (%.2fx), visible %d/%d\n", scalar_time*1000, batch_time*1000, scalar_time/batch_time, batch_visible, scalar_visible);
+  if (missed)
+  {
+    printf("  FAILED: batched sphere culling dropped %d visible spheres\n", missed);
+    return 1;
+  }
+
+  // boxes
+  timer.start();
+  scalar_visible = 0;
+  for(int i=0; i<count; ++i)
+    scalar_visible += scalar_mask[i] = frustum.cull( AABB(vec3(min_x[i],min_y[i],min_z[i]), vec3(max_x[i],max_y[i],max_z[i])) ) ? 0 : 1;
+  scalar_time = timer.elapsed();
+
+  timer.start();
+  frustum.cullAABBs(count, &min_x[0], &min_y[0], &min_z[0], &max_x[0], &max_y[0], &max_z[0], &visible[0]);
+  batch_time = timer.elapsed();
+
+  batch_visible = missed = 0;
+  for(int i=0; i<count; ++i)
+  {
+    int v = (visible[i>>5] >> (i&31)) & 1;
+    batch_visible += v;
+    missed += scalar_mask[i] && !v;
+  }
+
+  printf("  boxes:   scalar %.3fms, batched %.3fms (%.2fx), visible %d/%d\n", scalar_time*1000, batch_time*1000, scalar_time/batch_time, batch_visible, scalar_visible);
+  if (missed)
+  {
+    printf("  FAILED: batched box culling dropped %d visible boxes\n", missed);
+    return 1;
+  }
+
+  return 0;
+}
+//-----------------------------------------------------------------------------
+typedef int (*BenchmarkFunc)(int argc, const char* argv[]);
+
+struct Benchmark
+{
+  const char* mName;
+  const char* mArgs;
+  BenchmarkFunc mFunc;
+};
+
+Benchmark gBenchmarks[] =
+{
+  { "culling", "[actor_count] [frames]", benchCulling },
+  { "kdtree",  "[actor_count] [frames]", benchKdTree },
+  { "kdtree-update", "[actor_count] [moving_count] [frames]", benchKdTreeUpdate },
+  { "linear-bvh", "[actor_count] [frames]", benchLinearBVH },
+  { "render-queue", "[token_count] [runs]", benchRenderQueue },
+  { "render-queue-reuse", "[actor_count] [moving_count] [frames]", benchRenderQueueReuse },
+  { "render-queue-alloc", "[actor_count] [frames]", benchRenderQueueAlloc },
+  { "vertex-cache", "[icosphere_detail]", benchVertexCache },
+  { "double-vertex", "[icosphere_detail]", benchDoubleVertex },
+  { "geometry-kernels", "[icosphere_detail] [runs]", benchGeometryKernels },
+  { "simplify", "[icosphere_detail] [partitions]", benchSimplify },
+  { "edges", "[icosphere_detail] [draw_calls]", benchEdges },
+  { "marching-cubes", "[volume_size] [slabs]", benchMarchingCubes },
+  { "volume-pyramid", "[volume_size]", benchVolumePyramid },
+  { "isosurface-edit", "[volume_size] [brick_size]", benchIsosurfaceEdit },
+  { "volume-utils", "[volume_size]", benchVolumeUtils },
+  { "volume-raycast", "[volume_size] [resolution]", benchVolumeRaycast },
+  { "obj-loader", "[grid_size]", benchObjLoader },
+  { "stl-loader", "[grid_size]", benchSTLLoader },
+  { "ply-loader", "[points]", benchPlyLoader },
+  { "zip-seek", "[megabytes] [seeks]", benchZipSeek },
+  { "zip-directory", "[entries] [entry_kb]", benchZipDirectory },
+  { "frustum", "[volume_count]", benchFrustum },
+};
+
+const int gBenchmarkCount = sizeof(gBenchmarks) / sizeof(gBenchmarks[0]);
+//-----------------------------------------------------------------------------
+void printHelp()
+{
+  printf("\nusage:\n");
+  printf("  vlbenchmark <benchmark> [arguments]\n");
+  printf("  vlbenchmark all\n");
+  printf("\nbenchmarks:\n");
+  for(int i=0; i<gBenchmarkCount; ++i)
+    printf("  %s %s\n", gBenchmarks[i].mName, gBenchmarks[i].mArgs);
+  printf("\nThe number of threads used can be set with the VL_THREAD_COUNT environment variable.\n");
+}
+//-----------------------------------------------------------------------------
+int main(int argc, const char* argv[])
+{
+  VisualizationLibrary::init(false);
+
+  printf("vlbenchmark 1.0 - Visualization Library CPU Benchmarks\n\n");
+
+  if (argc < 2)
+  {
+    printHelp();
+    return 1;
+  }
+
+  for(int i=0; i<gBenchmarkCount; ++i)
+  {
+    if ( strcmp(argv[1], "all") == 0 )
+    {
+      if ( gBenchmarks[i].mFunc(0, NULL) != 0 )
+        return 1;
+    }
+    else
+    if ( strcmp(argv[1], gBenchmarks[i].mName) == 0 )
+      return gBenchmarks[i].mFunc(argc-2, argv+2);
+  }
+
+  if ( strcmp(argv[1], "all") == 0 )
+    return 0;
+
+  printf("Unknown benchmark:'%s'\n", argv[1]);
+  printHelp();
+  return 1;
+}
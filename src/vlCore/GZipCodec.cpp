@@ -47,6 +47,7 @@ GZipCodec::GZipCodec(VirtualFile* stream): mStream(stream)
   mWrittenBytes = -1;
   mZStream = new z_stream_s;
   memset(mZStream, 0, sizeof(z_stream_s));
+  mCheckpoints = new InflateCheckpoints;
   mUncompressedSize = -1;
   mWarnOnSeek = true;
 }
@@ -58,6 +59,7 @@ GZipCodec::GZipCodec(const String& gz_path): mStream(NULL)
   mWrittenBytes = -1;
   mZStream = new z_stream_s;
   memset(mZStream, 0, sizeof(z_stream_s));
+  mCheckpoints = new InflateCheckpoints;
   mUncompressedSize = -1;
   setPath(gz_path);
   mWarnOnSeek = true;
@@ -173,6 +175,8 @@ void GZipCodec::close()
   mWrittenBytes = -1;
   mUncompressedBufferPtr = 0;
   mUncompressedBuffer.clear();
+  if ( !mCheckpoints->keepOnClose() )
+    mCheckpoints->clear();
 }
 //-----------------------------------------------------------------------------
 ref<VirtualFile> GZipCodec::clone() const
@@ -189,6 +193,9 @@ GZipCodec& GZipCodec::operator=(const GZipCodec& other)
   mCompressionLevel = other.mCompressionLevel;
   if (other.mStream)
     mStream = other.mStream->clone();
+  mCheckpoints->setSpacing( other.mCheckpoints->spacing() );
+  mCheckpoints->setMemoryBudget( other.mCheckpoints->memoryBudget() );
+  mCheckpoints->setKeepOnClose( other.mCheckpoints->keepOnClose() );
   return *this;
 }
 //-----------------------------------------------------------------------------
@@ -264,7 +271,11 @@ long long GZipCodec::position_Implementation() const
 //-----------------------------------------------------------------------------
 void GZipCodec::resetStream()
 {
+  // the checkpoints still index the same stream
+  bool keep = mCheckpoints->keepOnClose();
+  mCheckpoints->setKeepOnClose(true);
   close();
+  mCheckpoints->setKeepOnClose(keep);
   open(OM_ReadOnly);
 }
 //-----------------------------------------------------------------------------
@@ -275,7 +286,8 @@ bool GZipCodec::seekSet_Implementation(long long pos)
     if (warnOnSeek())
       Log::print( Say("Performance warning: GZipCodec::seek() requested for file %s. For maximum performances avoid seeking a GZipCodec, especially avoid seeking backwards.\n") << path() );
 
-    if (pos<position())
+    // resume from a checkpoint when seeking backwards or when a checkpoint is closer than the current position
+    if ( (pos < position() || mCheckpoints->nearest(pos) > position()) && !restoreCheckpoint(pos) && pos < position() )
       resetStream();
 
     unsigned char buffer[CHUNK_SIZE];
@@ -292,6 +304,28 @@ bool GZipCodec::seekSet_Implementation(long long pos)
   }
 }
 //-----------------------------------------------------------------------------
+bool GZipCodec::restoreCheckpoint(long long pos)
+{
+  if ( !isOpen() || mCheckpoints->nearest(pos) < 0 )
+    return false;
+
+  long long uncompressed_offset = 0;
+  long long compressed_offset = 0;
+  if ( !mCheckpoints->restore(mZStream, pos, uncompressed_offset, compressed_offset) || !stream()->seekSet(compressed_offset) )
+  {
+    Log::error("GZipCodec::seek(): could not resume from the inflate checkpoint.\n");
+    resetStream();
+    return false;
+  }
+
+  mZStream->next_in  = mZipBufferIn;
+  mZStream->avail_in = 0;
+  mReadBytes = uncompressed_offset;
+  mUncompressedBufferPtr = 0;
+  mUncompressedBuffer.clear();
+  return true;
+}
+//-----------------------------------------------------------------------------
 bool GZipCodec::fillUncompressedBuffer()
 {
   VL_CHECK(mUncompressedBufferPtr == (int)mUncompressedBuffer.size())
@@ -311,6 +345,7 @@ bool GZipCodec::fillUncompressedBuffer()
   if (mZStream->avail_in == 0)
     return true;
   mZStream->next_in = mZipBufferIn;
+  long long compressed_end = stream()->position();
   do
   {
     mZStream->avail_out = CHUNK_SIZE;
@@ -332,6 +367,8 @@ bool GZipCodec::fillUncompressedBuffer()
     int start = (int)mUncompressedBuffer.size();
     mUncompressedBuffer.resize(start + have);
     memcpy(&mUncompressedBuffer[0] + start, mZipBufferOut, have);
+
+    mCheckpoints->update(mZStream, mReadBytes + mUncompressedBuffer.size(), compressed_end - mZStream->avail_in);
   }
   while ( mZStream->avail_out == 0 );
   return true;
@@ -377,6 +414,7 @@ void GZipCodec::setStream(VirtualFile* str)
   if (stream() && stream()->isOpen())
     stream()->close();
   mStream = str;
+  mCheckpoints->clear();
   mUncompressedSize = -1;
   mWrittenBytes = -1;
   setPath( str ? str->path() : String() );
@@ -33,12 +33,16 @@
 #define GZipCodec_INCLUDE_ONCE
 
 #include <vlCore/VirtualFile.hpp>
+#include <vlCore/InflateCheckpoints.hpp>
 struct z_stream_s;
 
 namespace vl
 {
   /**
    * The GZipCodec class is a VirtualFile that transparently encodes and decodes a stream of data using the GZip compression algorithm.
+   *
+   * Seeking a stream open in OM_ReadOnly mode inflates the data up to the requested position, starting from the closest of the
+   * checkpoints() saved while the stream was being read, see InflateCheckpoints.
    */
   class VLCORE_EXPORT GZipCodec: public VirtualFile
   {
@@ -110,17 +114,26 @@ namespace vl
 
     void setWarnOnSeek(bool warn_on) { mWarnOnSeek = warn_on; }
 
+    //! The inflate checkpoints used to seek the decompressed stream, disabled by default and discarded by close() unless InflateCheckpoints::keepOnClose().
+    //! The settings are copied by clone(), the checkpoints are not.
+    InflateCheckpoints* checkpoints() { return mCheckpoints.get(); }
+
+    //! The inflate checkpoints used to seek the decompressed stream, disabled by default and discarded by close() unless InflateCheckpoints::keepOnClose().
+    const InflateCheckpoints* checkpoints() const { return mCheckpoints.get(); }
+
   protected:
     virtual long long read_Implementation(void* buffer, long long bytes_to_read);
     virtual long long write_Implementation(const void* buffer, long long byte_count);
     virtual long long position_Implementation() const;
     void resetStream();
     bool seekSet_Implementation(long long pos);
+    bool restoreCheckpoint(long long pos);
     bool fillUncompressedBuffer();
 
   protected:
     int mCompressionLevel;
     ref<VirtualFile> mStream;
+    ref<InflateCheckpoints> mCheckpoints;
     long long mReadBytes;
     long long mWrittenBytes;
     bool mWarnOnSeek;
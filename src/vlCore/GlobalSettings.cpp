@@ -32,6 +32,9 @@
 #include <vlCore/GlobalSettings.hpp>
 #include <cstdlib>
 #include <cstdio>
+#ifdef VL_OPENMP
+  #include <omp.h>
+#endif
 
 using namespace vl;
 
@@ -48,10 +51,18 @@ GlobalSettings::GlobalSettings()
     mCheckOpenGLStates = false;
   #endif
 
+  mThreadCount = 0;
+
   // initialize from environment variables
 
   char* val = NULL;
 
+  // thread count
+
+  val = getenv("VL_THREAD_COUNT");
+  if (val)
+    mThreadCount = atoi(val);
+
   // log file
 
   val = getenv("VL_LOGFILE_PATH");
@@ -109,3 +120,12 @@ GlobalSettings::GlobalSettings()
   }
 }
 //-----------------------------------------------------------------------------
+int GlobalSettings::threadCount() const
+{
+#ifdef VL_OPENMP
+  return mThreadCount > 0 ? mThreadCount : omp_get_num_procs();
+#else
+  return 1;
+#endif
+}
+//-----------------------------------------------------------------------------
@@ -67,6 +67,14 @@ namespace vl
     /** The verbosity level of VL. This applies to all the logs generated via vl::Log::*. */
     EVerbosityLevel verbosityLevel() const { return mVerbosityLevel; }
 
+    /** The maximum number of threads used by VL's multithreaded algorithms, 0 means one thread per available core (default).
+      * Can also be set via the VL_THREAD_COUNT environment variable.
+      * \note Has effect only if VL has been compiled with OpenMP support (VL_OPENMP), otherwise all the algorithms run on the calling thread. */
+    void setThreadCount(int count) { mThreadCount = count; }
+
+    /** The actual number of threads used by VL's multithreaded algorithms, always >= 1. See setThreadCount(). */
+    int threadCount() const;
+
     /** The path of the default log file. */
     const String& defaultLogPath() const { return mDefaultLogPath; }
 
@@ -76,6 +84,7 @@ namespace vl
   protected:
     EVerbosityLevel mVerbosityLevel;
     bool mCheckOpenGLStates;
+    int mThreadCount;
     String mDefaultLogPath;
     String mDefaultDataPath;
   };
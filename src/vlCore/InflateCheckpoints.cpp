@@ -0,0 +1,195 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+#include <vlCore/InflateCheckpoints.hpp>
+#include <stdlib.h>
+#include <string.h>
+#include "zlib.h"
+
+using namespace vl;
+
+namespace
+{
+  // Allocator of the saved inflate states, counts the allocated bytes when opaque is not NULL.
+  voidpf checkpointAlloc(voidpf opaque, uInt items, uInt size)
+  {
+    if (opaque)
+      *(long long*)opaque += (long long)items * size;
+    return malloc((size_t)items * size);
+  }
+
+  void checkpointFree(voidpf /*opaque*/, voidpf address)
+  {
+    free(address);
+  }
+}
+//-----------------------------------------------------------------------------
+// InflateCheckpoints
+//-----------------------------------------------------------------------------
+InflateCheckpoints::InflateCheckpoints()
+{
+  VL_DEBUG_SET_OBJECT_NAME()
+  mSpacing = 0;
+  mCurrentSpacing = mSpacing;
+  mMemoryBudget = 4*1024*1024;
+  mMemoryUsed = 0;
+  mKeepOnClose = false;
+}
+//-----------------------------------------------------------------------------
+InflateCheckpoints::~InflateCheckpoints()
+{
+  clear();
+}
+//-----------------------------------------------------------------------------
+void InflateCheckpoints::setSpacing(long long bytes)
+{
+  clear();
+  mSpacing = bytes;
+  mCurrentSpacing = bytes;
+}
+//-----------------------------------------------------------------------------
+void InflateCheckpoints::clear()
+{
+  for(size_t i=0; i<mCheckpoints.size(); ++i)
+  {
+    inflateEnd(mCheckpoints[i].mState);
+    delete mCheckpoints[i].mState;
+  }
+  mCheckpoints.clear();
+  mCurrentSpacing = mSpacing;
+  mMemoryUsed = 0;
+}
+//-----------------------------------------------------------------------------
+void InflateCheckpoints::update(z_stream_s* zstream, long long uncompressed_offset, long long compressed_offset)
+{
+  if ( mSpacing <= 0 )
+    return;
+
+  long long last = mCheckpoints.empty() ? 0 : mCheckpoints.back().mUncompressedOffset;
+  if ( uncompressed_offset < last + mCurrentSpacing )
+    return;
+
+  Checkpoint checkpoint;
+  checkpoint.mUncompressedOffset = uncompressed_offset;
+  checkpoint.mCompressedOffset = compressed_offset;
+  checkpoint.mMemory = sizeof(z_stream_s);
+  checkpoint.mState = new z_stream_s;
+  memset(checkpoint.mState, 0, sizeof(z_stream_s));
+
+  // inflateCopy() allocates the copy with the allocator of the source stream
+  alloc_func zalloc = zstream->zalloc;
+  free_func  zfree  = zstream->zfree;
+  voidpf     opaque = zstream->opaque;
+  zstream->zalloc = checkpointAlloc;
+  zstream->zfree  = checkpointFree;
+  zstream->opaque = &checkpoint.mMemory;
+  int ret = inflateCopy(checkpoint.mState, zstream);
+  zstream->zalloc = zalloc;
+  zstream->zfree  = zfree;
+  zstream->opaque = opaque;
+  checkpoint.mState->opaque = Z_NULL;
+
+  if (ret != Z_OK)
+  {
+    delete checkpoint.mState;
+    return;
+  }
+
+  // keep one checkpoint out of two and double the spacing until the new checkpoint fits the budget
+  while( !mCheckpoints.empty() && mMemoryUsed + checkpoint.mMemory > mMemoryBudget )
+  {
+    size_t count = 0;
+    for(size_t i=0; i<mCheckpoints.size(); ++i)
+    {
+      if (i % 2)
+      {
+        mMemoryUsed -= mCheckpoints[i].mMemory;
+        inflateEnd(mCheckpoints[i].mState);
+        delete mCheckpoints[i].mState;
+      }
+      else
+        mCheckpoints[count++] = mCheckpoints[i];
+    }
+    mCheckpoints.resize(count);
+    mCurrentSpacing *= 2;
+  }
+
+  if ( mMemoryUsed + checkpoint.mMemory > mMemoryBudget ||
+       (!mCheckpoints.empty() && uncompressed_offset < mCheckpoints.back().mUncompressedOffset + mCurrentSpacing) )
+  {
+    inflateEnd(checkpoint.mState);
+    delete checkpoint.mState;
+    return;
+  }
+
+  mMemoryUsed += checkpoint.mMemory;
+  mCheckpoints.push_back(checkpoint);
+}
+//-----------------------------------------------------------------------------
+int InflateCheckpoints::findCheckpoint(long long pos) const
+{
+  // the checkpoints are sorted by offset
+  int found = -1;
+  for(int a=0, b=(int)mCheckpoints.size()-1; a<=b; )
+  {
+    int mid = (a + b) / 2;
+    if (mCheckpoints[mid].mUncompressedOffset <= pos)
+    {
+      found = mid;
+      a = mid + 1;
+    }
+    else
+      b = mid - 1;
+  }
+  return found;
+}
+//-----------------------------------------------------------------------------
+long long InflateCheckpoints::nearest(long long pos) const
+{
+  int i = findCheckpoint(pos);
+  return i < 0 ? -1 : mCheckpoints[i].mUncompressedOffset;
+}
+//-----------------------------------------------------------------------------
+bool InflateCheckpoints::restore(z_stream_s* zstream, long long pos, long long& uncompressed_offset, long long& compressed_offset) const
+{
+  int i = findCheckpoint(pos);
+  if (i < 0)
+    return false;
+
+  inflateEnd(zstream);
+  if ( inflateCopy(zstream, mCheckpoints[i].mState) != Z_OK )
+    return false;
+
+  uncompressed_offset = mCheckpoints[i].mUncompressedOffset;
+  compressed_offset   = mCheckpoints[i].mCompressedOffset;
+  return true;
+}
+//-----------------------------------------------------------------------------
@@ -0,0 +1,137 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+#ifndef InflateCheckpoints_INCLUDE_ONCE
+#define InflateCheckpoints_INCLUDE_ONCE
+
+#include <vlCore/Object.hpp>
+#include <vector>
+struct z_stream_s;
+
+namespace vl
+{
+  /**
+   * Random access index of a deflate stream, used by ZippedFile and GZipCodec to seek without inflating the data from the beginning.
+   *
+   * While a stream is inflated a snapshot of the zlib inflate state, including its 32K window, is saved every spacing() uncompressed
+   * bytes. A seek can then resume inflating from the closest checkpoint preceding the target position, so that seeking backwards or
+   * far ahead costs at most spacing() inflated bytes instead of a pass over the whole stream.
+   *
+   * A checkpoint takes about 40K. When a new checkpoint would exceed memoryBudget() every other checkpoint is discarded and the
+   * spacing of the next ones is doubled, so that the checkpoints keep covering the whole stream.
+   *
+   * The checkpoints are disabled by default, call setSpacing() to enable them. They are discarded when the file is closed unless
+   * setKeepOnClose() is enabled, in which case they are reused when the same file is reopened.
+   *
+   * \sa
+   * - ZippedFile
+   * - GZipCodec
+  */
+  class VLCORE_EXPORT InflateCheckpoints: public Object
+  {
+    VL_INSTRUMENT_CLASS(vl::InflateCheckpoints, Object)
+
+  public:
+    InflateCheckpoints();
+
+    ~InflateCheckpoints();
+
+    //! The distance in uncompressed bytes between two checkpoints, 0 disables the checkpoints. The default is 0, 1MB is a good value.
+    //! Changing the spacing discards the current checkpoints.
+    void setSpacing(long long bytes);
+
+    //! The distance in uncompressed bytes between two checkpoints, 0 disables the checkpoints. The default is 0.
+    long long spacing() const { return mSpacing; }
+
+    //! Whether the checkpoints are kept when the file is closed, to be reused when it is reopened. The default is false.
+    void setKeepOnClose(bool keep) { mKeepOnClose = keep; }
+
+    //! Whether the checkpoints are kept when the file is closed, to be reused when it is reopened. The default is false.
+    bool keepOnClose() const { return mKeepOnClose; }
+
+    //! The maximum amount of memory used by the checkpoints. The default is 4MB.
+    void setMemoryBudget(long long bytes) { mMemoryBudget = bytes; }
+
+    //! The maximum amount of memory used by the checkpoints. The default is 4MB.
+    long long memoryBudget() const { return mMemoryBudget; }
+
+    //! The amount of memory used by the current checkpoints.
+    long long memoryUsed() const { return mMemoryUsed; }
+
+    //! The number of checkpoints saved so far.
+    int checkpointCount() const { return (int)mCheckpoints.size(); }
+
+    //! Discards all the checkpoints.
+    void clear();
+
+    /**
+     * Saves a snapshot of \p zstream if it inflated at least the current spacing since the last checkpoint.
+     * \param zstream The stream being inflated, in a state in which \p inflate() can be called again.
+     * \param uncompressed_offset The number of bytes inflated by \p zstream.
+     * \param compressed_offset The number of compressed bytes consumed by \p zstream, not counting its \p avail_in bytes.
+     */
+    void update(z_stream_s* zstream, long long uncompressed_offset, long long compressed_offset);
+
+    //! Returns the uncompressed offset of the closest checkpoint preceding or at \p pos, -1 if there is none.
+    long long nearest(long long pos) const;
+
+    /**
+     * Replaces the state of \p zstream with the closest checkpoint preceding or at \p pos.
+     * On success the caller must seek the compressed data to \p compressed_offset and reset \p next_in and \p avail_in.
+     * On failure \p zstream might have been ended with \p inflateEnd() and must be initialized again.
+     */
+    bool restore(z_stream_s* zstream, long long pos, long long& uncompressed_offset, long long& compressed_offset) const;
+
+  private:
+    InflateCheckpoints(const InflateCheckpoints&);
+    InflateCheckpoints& operator=(const InflateCheckpoints&);
+    //! Index of the closest checkpoint preceding or at \p pos, -1 if there is none.
+    int findCheckpoint(long long pos) const;
+
+  protected:
+    struct Checkpoint
+    {
+      long long mUncompressedOffset;
+      long long mCompressedOffset;
+      long long mMemory;
+      z_stream_s* mState;
+    };
+
+    std::vector<Checkpoint> mCheckpoints;
+    long long mSpacing;
+    long long mCurrentSpacing;
+    long long mMemoryBudget;
+    long long mMemoryUsed;
+    bool mKeepOnClose;
+  };
+}
+
+#endif
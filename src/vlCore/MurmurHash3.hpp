@@ -10,6 +10,7 @@
 #define _MURMURHASH3_H_
 
 #include <vlCore/std_types.hpp>
+#include <cstring>
 
 namespace vl
 {
@@ -18,6 +19,26 @@ namespace vl
   VLCORE_EXPORT void MurmurHash3_x86_128 ( const void * key, int len, u32 seed, void * out );
 
   VLCORE_EXPORT void MurmurHash3_x64_128 ( const void * key, int len, u32 seed, void * out );
+
+  //! The 64 bit finalization mix of MurmurHash3 truncated to 32 bits, hashes the keys of the open addressing tables without a call to MurmurHash3_x86_32().
+  inline u32 murmurFinalize64( u64 key )
+  {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return (u32)key;
+  }
+
+  //! Folds the bit patterns of three floats in a 64 bit key for murmurFinalize64(), -0 and +0 give the same key.
+  inline u64 floatBitsKey( float x, float y, float z )
+  {
+    float f[] = { x + 0.0f, y + 0.0f, z + 0.0f };
+    u32 bits[3];
+    memcpy(bits, f, sizeof(bits));
+    return ( (u64)bits[0] << 32 | bits[1] ) ^ ( (u64)bits[2] * 0x9e3779b97f4a7c15ULL );
+  }
 }
 
 #endif // _MURMURHASH3_H_
@@ -32,13 +32,15 @@
 #include <vlCore/ZippedDirectory.hpp>
 #include <vlCore/VisualizationLibrary.hpp>
 #include <vlCore/FileSystem.hpp>
+#include <vlCore/GlobalSettings.hpp>
+#include <vlCore/ScopedMutex.hpp>
 #include <set>
 
 using namespace vl;
 //-----------------------------------------------------------------------------
-ZippedDirectory::ZippedDirectory() {}
+ZippedDirectory::ZippedDirectory(): mPrefetchedBytes(0), mPrefetchMemoryBudget(64*1024*1024), mPrefetchLookAhead(3), mPrefetchMutex(NULL) {}
 //-----------------------------------------------------------------------------
-ZippedDirectory::ZippedDirectory(const String& zip_file)
+ZippedDirectory::ZippedDirectory(const String& zip_file): mPrefetchedBytes(0), mPrefetchMemoryBudget(64*1024*1024), mPrefetchLookAhead(3), mPrefetchMutex(NULL)
 {
   ref<VirtualFile> v_file = defFileSystem()->locateFile(zip_file);
   if (v_file)
@@ -47,7 +49,7 @@ ZippedDirectory::ZippedDirectory(const String& zip_file)
     Log::error( Say("ZippedDirectory() could not locate zip file '%s'.\n") << zip_file );
 }
 //-----------------------------------------------------------------------------
-ZippedDirectory::ZippedDirectory(VirtualFile* zip_file)
+ZippedDirectory::ZippedDirectory(VirtualFile* zip_file): mPrefetchedBytes(0), mPrefetchMemoryBudget(64*1024*1024), mPrefetchLookAhead(3), mPrefetchMutex(NULL)
 {
   if (zip_file)
     setSourceZipFile(zip_file);
@@ -84,6 +86,7 @@ bool ZippedDirectory::setPath(const String& name)
   }
   mFiles = file_map;
   mPath = root;
+  clearPrefetch();
   return true;
 }
 //-----------------------------------------------------------------------------
@@ -109,6 +112,7 @@ void ZippedDirectory::reset()
 {
   mSourceZipFile = NULL;
   mFiles.clear();
+  clearPrefetch();
 }
 //-----------------------------------------------------------------------------
 bool ZippedDirectory::init()
@@ -247,6 +251,21 @@ bool ZippedDirectory::init()
 //-----------------------------------------------------------------------------
 ref<VirtualFile> ZippedDirectory::file(const String& name) const
 {
+  ScopedMutex mutex(mPrefetchMutex);
+  if ( !mPrefetchQueue.empty() || !mPrefetched.empty() )
+  {
+    String p = translatePath(name);
+    if ( mPrefetchQueued.count(p) )
+      extractPrefetchBatch(p);
+    std::map< String, ref<MemoryFile> >::iterator it = mPrefetched.find(p);
+    if ( it != mPrefetched.end() )
+    {
+      ref<MemoryFile> mem_file = it->second;
+      mPrefetched.erase(it);
+      mPrefetchedBytes -= mem_file->size();
+      return mem_file;
+    }
+  }
   return zippedFile(name);
 }
 //-----------------------------------------------------------------------------
@@ -383,6 +402,135 @@ void ZippedDirectory::listFiles(std::vector<String>& file_list, bool append) con
   }
 }
 //-----------------------------------------------------------------------------
+int ZippedDirectory::extractFiles(const std::vector<String>& names, std::vector< ref<MemoryFile> >& files, bool check_sum) const
+{
+  files.clear();
+  files.resize(names.size());
+
+  int thread_count = globalSettings()->threadCount();
+  // each ZippedFile allocates its own inflate buffers: prepare only a few entries per thread at a time
+  const int batch_size = thread_count * 4;
+  int extracted = 0;
+  for(int first=0; first<(int)names.size(); first+=batch_size)
+  {
+    int count = std::min(batch_size, (int)names.size() - first);
+
+    // the reference counting is not thread safe: the ZippedFiles, their source streams and the MemoryFiles are created here
+    std::vector< ref<ZippedFile> > zipped_files(count);
+    for(int i=0; i<count; ++i)
+    {
+      std::map< String, ref<ZippedFile> >::const_iterator it = mFiles.find( translatePath(names[first+i]) );
+      if ( it == mFiles.end() )
+        continue;
+      zipped_files[i] = new ZippedFile;
+      zipped_files[i]->operator=(*it->second);
+      files[first+i] = new MemoryFile;
+      files[first+i]->setPath( it->second->path() );
+      files[first+i]->allocateBuffer( it->second->size() );
+    }
+
+    std::vector<char> ok(count, 0);
+    #ifdef VL_OPENMP
+      #pragma omp parallel for schedule(dynamic, 1) num_threads(thread_count)
+    #endif
+    for(int i=0; i<count; ++i)
+    {
+      if ( zipped_files[i] )
+        ok[i] = zipped_files[i]->extract( (char*)files[first+i]->ptr(), check_sum );
+    }
+
+    for(int i=0; i<count; ++i)
+    {
+      if ( zipped_files[i] && !ok[i] )
+      {
+        Log::error( Say("ZippedDirectory::extractFiles(): could not extract '%s'.\n") << zipped_files[i]->path() );
+        files[first+i] = NULL;
+      }
+      extracted += ok[i];
+    }
+  }
+
+  return extracted;
+}
+//-----------------------------------------------------------------------------
+int ZippedDirectory::extractFiles(const String& match, std::vector< ref<MemoryFile> >& files, bool check_sum) const
+{
+  std::vector<String> names;
+  VirtualDirectory::listFilesRecursive(names, match);
+  return extractFiles(names, files, check_sum);
+}
+//-----------------------------------------------------------------------------
+void ZippedDirectory::prefetch(const std::vector<String>& names)
+{
+  ScopedMutex mutex(mPrefetchMutex);
+  for(size_t i=0; i<names.size(); ++i)
+  {
+    String p = translatePath(names[i]);
+    if ( mFiles.count(p) && !mPrefetched.count(p) && mPrefetchQueued.insert(p).second )
+      mPrefetchQueue.push_back(p);
+  }
+}
+//-----------------------------------------------------------------------------
+void ZippedDirectory::prefetch(const String& match)
+{
+  std::vector<String> names;
+  VirtualDirectory::listFilesRecursive(names, match);
+  prefetch(names);
+}
+//-----------------------------------------------------------------------------
+void ZippedDirectory::flushPrefetch()
+{
+  ScopedMutex mutex(mPrefetchMutex);
+  if ( !mPrefetchQueue.empty() )
+    extractPrefetchBatch( mPrefetchQueue.front() );
+}
+//-----------------------------------------------------------------------------
+void ZippedDirectory::clearPrefetch()
+{
+  ScopedMutex mutex(mPrefetchMutex);
+  mPrefetchQueue.clear();
+  mPrefetchQueued.clear();
+  mPrefetched.clear();
+  mPrefetchedBytes = 0;
+}
+//-----------------------------------------------------------------------------
+void ZippedDirectory::extractPrefetchBatch(const String& first) const
+{
+  // the requested entry first, then the next queued entries in order as long as they fit the look-ahead and the budget
+  std::vector<String> batch;
+  batch.push_back(first);
+  long long bytes = mPrefetchedBytes + mFiles.find(first)->second->size();
+  std::vector<String> queue;
+  for(size_t i=0; i<mPrefetchQueue.size(); ++i)
+  {
+    const String& p = mPrefetchQueue[i];
+    if ( p == first )
+      continue;
+    long long size = mFiles.find(p)->second->size();
+    if ( queue.empty() && (int)batch.size() <= mPrefetchLookAhead && bytes + size <= mPrefetchMemoryBudget )
+    {
+      batch.push_back(p);
+      bytes += size;
+    }
+    else
+      queue.push_back(p);
+  }
+  mPrefetchQueue.swap(queue);
+  for(size_t i=0; i<batch.size(); ++i)
+    mPrefetchQueued.erase(batch[i]);
+
+  std::vector< ref<MemoryFile> > files;
+  extractFiles(batch, files, false);
+  for(size_t i=0; i<batch.size(); ++i)
+  {
+    if ( files[i] )
+    {
+      mPrefetched[batch[i]] = files[i];
+      mPrefetchedBytes += files[i]->size();
+    }
+  }
+}
+//-----------------------------------------------------------------------------
 bool ZippedDirectory::isCorrupted()
 {
   if ( !init() )
@@ -35,7 +35,10 @@
 #include <vlCore/VirtualDirectory.hpp>
 #include <vlCore/DiskFile.hpp>
 #include <vlCore/ZippedFile.hpp>
+#include <vlCore/MemoryFile.hpp>
+#include <vlCore/IMutex.hpp>
 #include <algorithm>
+#include <set>
 
 namespace vl
 {
@@ -45,6 +48,14 @@ namespace vl
   /**
    * A VirtualDirectory capable of reading files from a .zip file.
    *
+   * Several entries can be decompressed at once with extractFiles(), or announced with prefetch() before they are requested
+   * with file(). In both cases the entries are decompressed concurrently when VL is compiled with OpenMP support,
+   * using up to GlobalSettings::threadCount() threads.
+   *
+   * \note
+   * file() updates the prefetch queue and the prefetched entries. When file() is called from several threads at the same time
+   * install a mutex with setPrefetchMutex(), it is then locked by file() and by the prefetch methods.
+   *
    * \sa
    * - VirtualDirectory
    * - DiskDirectory
@@ -77,6 +88,7 @@ namespace vl
     //! Sets the source zip file to NULL and disposes all the files contained in this directory.
     void reset();
 
+    //! Returns the prefetched MemoryFile if \p name has been queued with prefetch(), a ZippedFile otherwise.
     ref<VirtualFile> file(const String& name) const;
 
     //! Accepts absolute and relative paths
@@ -98,12 +110,73 @@ namespace vl
 
   bool isCorrupted();
 
+    /**
+     * Decompresses the given entries into MemoryFiles, several entries at a time in parallel.
+     * \param names Absolute or relative paths of the entries.
+     * \param files Receives one MemoryFile per name, NULL if the entry does not exist or could not be extracted.
+     * \param check_sum If true the CRC32 of each entry is verified.
+     * \return The number of entries extracted.
+     */
+    int extractFiles(const std::vector<String>& names, std::vector< ref<MemoryFile> >& files, bool check_sum=true) const;
+
+    //! Decompresses the entries matching \p match into MemoryFiles, see VirtualDirectory::listFilesRecursive() for the syntax.
+    int extractFiles(const String& match, std::vector< ref<MemoryFile> >& files, bool check_sum=true) const;
+
+    /**
+     * Queues entries that will be requested soon with file(), so that they can be decompressed in batches.
+     * When a queued entry is requested file() decompresses it together with up to prefetchLookAhead() of the next queued
+     * entries that fit in prefetchMemoryBudget(), in parallel, and returns when the whole batch is done: the extraction
+     * is batched, not asynchronous. The following requests of the batch are then served from memory.
+     * An entry is released as soon as it is returned by file(). Like the data read from a ZippedFile, the prefetched
+     * entries are not verified with their CRC32.
+     */
+    void prefetch(const std::vector<String>& names);
+
+    //! Queues the entries matching \p match, see prefetch() and VirtualDirectory::listFilesRecursive().
+    void prefetch(const String& match);
+
+    //! Decompresses the next batch of queued entries without waiting for them to be requested, see prefetch().
+    void flushPrefetch();
+
+    //! Discards the queued and the already decompressed prefetched entries.
+    void clearPrefetch();
+
+    //! The maximum amount of decompressed data held by the prefetched entries not yet requested. The default is 64MB.
+    void setPrefetchMemoryBudget(long long bytes) { mPrefetchMemoryBudget = bytes; }
+
+    //! The maximum amount of decompressed data held by the prefetched entries not yet requested. The default is 64MB.
+    long long prefetchMemoryBudget() const { return mPrefetchMemoryBudget; }
+
+    //! The amount of decompressed data held by the prefetched entries not yet requested.
+    long long prefetchedBytes() const { return mPrefetchedBytes; }
+
+    //! The maximum number of queued entries decompressed together with the requested one, see prefetch(). The default is 3.
+    void setPrefetchLookAhead(int entries) { mPrefetchLookAhead = entries; }
+
+    //! The maximum number of queued entries decompressed together with the requested one, see prefetch(). The default is 3.
+    int prefetchLookAhead() const { return mPrefetchLookAhead; }
+
+    //! The mutex locked by file() and by the prefetch methods, NULL by default. See also vl::Object::setRefCountMutex().
+    void setPrefetchMutex(IMutex* mutex) { mPrefetchMutex = mutex; }
+
+    //! The mutex locked by file() and by the prefetch methods, NULL by default.
+    IMutex* prefetchMutex() const { return mPrefetchMutex; }
+
   protected:
     bool init();
+    //! Decompresses \p first and the next queued entries within prefetchLookAhead() and the budget. The mutex must be locked.
+    void extractPrefetchBatch(const String& first) const;
 
   protected:
     std::map< String, ref<ZippedFile> > mFiles;
     ref<VirtualFile> mSourceZipFile;
+    mutable std::vector<String> mPrefetchQueue;
+    mutable std::set<String> mPrefetchQueued;
+    mutable std::map< String, ref<MemoryFile> > mPrefetched;
+    mutable long long mPrefetchedBytes;
+    long long mPrefetchMemoryBudget;
+    int mPrefetchLookAhead;
+    IMutex* mPrefetchMutex;
   };
 
 }
@@ -343,6 +343,7 @@ ZippedFile::ZippedFile()
   mReadBytes = -1;
   mZStream = new z_stream_s;
   memset(mZStream, 0, sizeof(z_stream_s));
+  mCheckpoints = new InflateCheckpoints;
 }
 //-----------------------------------------------------------------------------
 ZippedFile::~ZippedFile()
@@ -356,7 +357,7 @@ const ZippedFileInfo* ZippedFile::zippedFileInfo() const { return mZippedFileInf
 //-----------------------------------------------------------------------------
 ZippedFileInfo* ZippedFile::zippedFileInfo() { return mZippedFileInfo.get(); }
 //-----------------------------------------------------------------------------
-void ZippedFile::setZippedFileInfo(ZippedFileInfo* info) { mZippedFileInfo = info; }
+void ZippedFile::setZippedFileInfo(ZippedFileInfo* info) { mZippedFileInfo = info; mCheckpoints->clear(); }
 //-----------------------------------------------------------------------------
 bool ZippedFile::exists() const
 {
@@ -451,6 +452,8 @@ void ZippedFile::close()
     zippedFileInfo()->sourceZipFile()->close();
   mUncompressedBufferPtr = 0;
   mUncompressedBuffer.clear();
+  if ( !mCheckpoints->keepOnClose() )
+    mCheckpoints->clear();
 }
 //-----------------------------------------------------------------------------
 long long ZippedFile::size() const
@@ -463,13 +466,26 @@ long long ZippedFile::size() const
 //-----------------------------------------------------------------------------
 void ZippedFile::resetStream()
 {
+  // the checkpoints still index the same file
+  bool keep = mCheckpoints->keepOnClose();
+  mCheckpoints->setKeepOnClose(true);
   close();
+  mCheckpoints->setKeepOnClose(keep);
   open(OM_ReadOnly);
 }
 //-----------------------------------------------------------------------------
 bool ZippedFile::seekSet_Implementation(long long pos)
 {
-  if (pos<position())
+  if ( isOpen() && zippedFileInfo()->compressionMethod() == 0 )
+  {
+    if ( pos < 0 || pos > size() || !zippedFileInfo()->sourceZipFile()->seekSet( zippedFileInfo()->zippedFileOffset() + pos ) )
+      return false;
+    mReadBytes = pos;
+    return true;
+  }
+
+  // resume from a checkpoint when seeking backwards or when a checkpoint is closer than the current position
+  if ( (pos < position() || mCheckpoints->nearest(pos) > position()) && !restoreCheckpoint(pos) && pos < position() )
     resetStream();
 
   unsigned char buffer[CHUNK_SIZE];
@@ -481,6 +497,29 @@ bool ZippedFile::seekSet_Implementation(long long pos)
   return position() == pos;
 }
 //-----------------------------------------------------------------------------
+bool ZippedFile::restoreCheckpoint(long long pos)
+{
+  if ( !isOpen() || zippedFileInfo()->compressionMethod() != 8 || mCheckpoints->nearest(pos) < 0 )
+    return false;
+
+  long long uncompressed_offset = 0;
+  long long compressed_offset = 0;
+  if ( !mCheckpoints->restore(mZStream, pos, uncompressed_offset, compressed_offset) ||
+       !zippedFileInfo()->sourceZipFile()->seekSet( zippedFileInfo()->zippedFileOffset() + compressed_offset ) )
+  {
+    Log::error("ZippedFile::seek(): could not resume from the inflate checkpoint.\n");
+    resetStream();
+    return false;
+  }
+
+  mZStream->next_in  = mZipBufferIn;
+  mZStream->avail_in = 0;
+  mReadBytes = uncompressed_offset;
+  mUncompressedBufferPtr = 0;
+  mUncompressedBuffer.clear();
+  return true;
+}
+//-----------------------------------------------------------------------------
 long long ZippedFile::read_Implementation(void* buffer, long long bytes_to_read)
 {
   if ( bytes_to_read < 1 )
@@ -648,6 +687,7 @@ bool ZippedFile::fillUncompressedBuffer()
   if (mZStream->avail_in == 0)
     return false;
   mZStream->next_in = mZipBufferIn;
+  long long compressed_end = compressed_read_bytes + mZStream->avail_in;
 
   do
   {
@@ -673,6 +713,8 @@ bool ZippedFile::fillUncompressedBuffer()
     int start = (int)mUncompressedBuffer.size();
     mUncompressedBuffer.resize(start + have);
     memcpy(&mUncompressedBuffer[0] + start, mZipBufferOut, have);
+
+    mCheckpoints->update(mZStream, mReadBytes + mUncompressedBuffer.size(), compressed_end - mZStream->avail_in);
   }
   while ( mZStream->avail_out == 0 );
 
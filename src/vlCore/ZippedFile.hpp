@@ -33,6 +33,7 @@
 #define ZippedFile_INCLUDE_ONCE
 
 #include <vlCore/VirtualFile.hpp>
+#include <vlCore/InflateCheckpoints.hpp>
 struct z_stream_s;
 
 namespace vl
@@ -120,6 +121,9 @@ namespace vl
   /**
    * A VirtualFile used to read a file contained in a .zip archive.
    *
+   * Seeking a stored file moves directly to the requested position. Seeking a deflated file inflates the data up to the requested
+   * position, starting from the closest of the checkpoints() saved while the file was being read, see InflateCheckpoints.
+   *
    * \sa
    * - VirtualDirectory
    * - DiskDirectory
@@ -172,6 +176,9 @@ namespace vl
         ref<VirtualFile> src_zip_copy = mZippedFileInfo->sourceZipFile()->clone();
         mZippedFileInfo->setSourceZipFile(src_zip_copy.get());
       }
+      mCheckpoints->setSpacing( other.mCheckpoints->spacing() );
+      mCheckpoints->setMemoryBudget( other.mCheckpoints->memoryBudget() );
+      mCheckpoints->setKeepOnClose( other.mCheckpoints->keepOnClose() );
       return *this;
     }
 
@@ -179,6 +186,13 @@ namespace vl
 
     void resetStream();
 
+    //! The inflate checkpoints used to seek a deflated file, disabled by default and discarded by close() unless InflateCheckpoints::keepOnClose().
+    //! The settings are copied by clone(), the checkpoints are not.
+    InflateCheckpoints* checkpoints() { return mCheckpoints.get(); }
+
+    //! The inflate checkpoints used to seek a deflated file, disabled by default and discarded by close() unless InflateCheckpoints::keepOnClose().
+    const InflateCheckpoints* checkpoints() const { return mCheckpoints.get(); }
+
   protected:
     virtual long long read_Implementation(void* buffer, long long bytes_to_read);
 
@@ -190,8 +204,12 @@ namespace vl
 
     virtual bool seekSet_Implementation(long long);
 
+    //! Resumes inflating from the closest checkpoint preceding \p pos.
+    bool restoreCheckpoint(long long pos);
+
   protected:
     ref<ZippedFileInfo> mZippedFileInfo;
+    ref<InflateCheckpoints> mCheckpoints;
     long long mReadBytes;
 
     z_stream_s* mZStream;
@@ -1556,6 +1556,20 @@ namespace vl
     SilhouetteClosed, 
     SilhouetteOpen 
   } ESilhouetteMode;
+
+  //! Splitting strategy used by ActorKdTree::buildKdTree().
+  typedef enum
+  {
+    KDBM_Median, //!< Splits at the median actor's min-corner along a round-robin axis.
+    KDBM_SAH     //!< Splits where the Surface Area Heuristic estimates the lowest culling cost, evaluated over binned actor bounds.
+  } EKdTreeBuildMethod;
+
+  //! Strategy used by DoubleVertexRemover::removeDoubles() to find the duplicated vertices.
+  typedef enum
+  {
+    DVRM_Sort, //!< Sorts the vertices comparing their attributes with ArrayAbstract::compare(), the new vertices follow the attributes order.
+    DVRM_Hash  //!< Hashes the attribute bytes of each vertex into an open addressing table, the new vertices follow the order of first appearance.
+  } EDoubleVertexRemoverMethod;
 }
 
 #endif
@@ -31,6 +31,7 @@
 
 #include <vlGraphics/ActorKdTree.hpp>
 #include <vlCore/Log.hpp>
+#include <vlCore/GlobalSettings.hpp>
 #include <algorithm>
 
 using namespace vl;
@@ -64,6 +65,28 @@ namespace
     VL_CHECK(a2->lod(0))
     return a1->boundingBox().minCorner().z() < a2->boundingBox().minCorner().z();
   }
+  //-----------------------------------------------------------------------------
+  // Number of bins along each axis evaluated by the SAH builder.
+  const int SAHBinCount = 32;
+  // Subtrees with fewer actors than this are built by the thread that created them.
+  const int ParallelBuildThreshold = 1024;
+  // Subtrees are not rebuilt by updateKdTree() before receiving at least this many actors.
+  const int MinRebuildReinsertCount = 16;
+  //-----------------------------------------------------------------------------
+  inline real surfaceArea(real w, real h, real d)
+  {
+    return 2 * (w*h + h*d + d*w);
+  }
+  //-----------------------------------------------------------------------------
+  inline long long transformTick(const Actor* actor)
+  {
+    return actor->transform() ? actor->transform()->worldMatrixUpdateTick() : -1;
+  }
+  //-----------------------------------------------------------------------------
+  inline long long boundsTick(const Actor* actor)
+  {
+    return actor->lod(0) ? actor->lod(0)->boundsUpdateTick() : -1;
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -101,11 +124,34 @@ void ActorKdTree::computeLocalAABB(const ActorCollection& acts)
   }
 }
 //-----------------------------------------------------------------------------
+ActorKdTree::~ActorKdTree()
+{
+  delete mTracking;
+}
+//-----------------------------------------------------------------------------
 void ActorKdTree::buildKdTree(ActorCollection& acts, int max_depth, float minimum_volume)
 {
   int counter = 0;
   prepareActors(acts);
+
+#ifdef VL_OPENMP
+  int thread_count = globalSettings()->threadCount();
+  if (thread_count > 1 && (int)acts.size() >= ParallelBuildThreshold)
+  {
+    // compileTree_internal() spawns a task for each large enough subtree.
+    #pragma omp parallel num_threads(thread_count)
+    {
+      #pragma omp single
+      compileTree_internal(acts, counter, max_depth, minimum_volume);
+    }
+  }
+  else
+#endif
   compileTree_internal(acts, counter, max_depth, minimum_volume);
+
+  // the nodes of the tracked actors have been destroyed
+  if (mTracking && !mTracking->mActors.empty())
+    relocateTrackedActors();
 }
 //-----------------------------------------------------------------------------
 void ActorKdTree::rebuildKdTree(int max_depth, float minimum_volume)
@@ -122,6 +168,8 @@ void ActorKdTree::compileTree_internal(ActorCollection& acts, int& counter, int
   actors()->clear();
   mAABB.setNull();
   mPlane = Plane();
+  mBuildActorCount = (int)acts.size();
+  mReinsertCount = 0;
 
   if (acts.size() == 0)
     return;
@@ -134,7 +182,8 @@ void ActorKdTree::compileTree_internal(ActorCollection& acts, int& counter, int
     return;
   }
 
-  if ( !findBestPlane(mPlane, counter, acts) )
+  bool split = mBuildMethod == KDBM_SAH ? findBestPlaneSAH(mPlane, acts) : findBestPlane(mPlane, counter, acts);
+  if ( !split )
   {
     mActors = acts;
     return;
@@ -159,17 +208,28 @@ void ActorKdTree::compileTree_internal(ActorCollection& acts, int& counter, int
   int counter1 = counter;
   int counter2 = counter;
   if (actorsN.size())
-  {
-    setChildN(new ActorKdTree);
-    childN()->compileTree_internal(actorsN, counter1, max_depth-1, minimum_volume);
-  }
+    setChildN(newChild());
 
   if (actorsP.size())
-  {
-    setChildP(new ActorKdTree);
+    setChildP(newChild());
+
+  // The two subtrees own disjoint sets of nodes and actors thus they can be built concurrently.
+  // Outside of a parallel region (see buildKdTree()) the tasks are executed immediately.
+#ifdef VL_OPENMP
+  #pragma omp task shared(actorsN, counter1) if((int)actorsN.size() >= ParallelBuildThreshold)
+#endif
+  if (childN())
+    childN()->compileTree_internal(actorsN, counter1, max_depth-1, minimum_volume);
+
+#ifdef VL_OPENMP
+  #pragma omp task shared(actorsP, counter2) if((int)actorsP.size() >= ParallelBuildThreshold)
+#endif
+  if (childP())
     childP()->compileTree_internal(actorsP, counter2, max_depth-1, minimum_volume);
-  }
 
+#ifdef VL_OPENMP
+  #pragma omp taskwait
+#endif
 }
 //-----------------------------------------------------------------------------
 int ActorKdTree::scorePlane(const Plane& plane, const ActorCollection& acts)
@@ -266,6 +326,79 @@ bool ActorKdTree::findBestPlane(Plane& plane, int& counter, ActorCollection& act
   return true;
 }
 //-----------------------------------------------------------------------------
+//! Evaluates the Surface Area Heuristic at the bin boundaries of each axis without sorting the actors:
+//! the min and max corners of the actors are histogrammed so that for every candidate plane the number
+//! of actors falling in the negative side, in the positive side and straddling it can be computed with
+//! a prefix sum. The straddling actors are kept in the node and are tested every time the node is visited.
+bool ActorKdTree::findBestPlaneSAH(Plane& plane, const ActorCollection& acts)
+{
+  const vec3 node_min  = mAABB.minCorner();
+  const vec3 node_size = mAABB.maxCorner() - mAABB.minCorner();
+  const real node_area = surfaceArea(node_size.x(), node_size.y(), node_size.z());
+  if (node_area <= 0)
+    return false;
+
+  const int count = (int)acts.size();
+  // cost of keeping all the actors in this node
+  real best_cost = (real)count;
+  int best_axis = -1;
+  real best_pos = 0;
+
+  for(int axis=0; axis<3; ++axis)
+  {
+    const real extent = node_size[axis];
+    if (extent <= 0)
+      continue;
+
+    int min_bins[SAHBinCount] = { 0 };
+    int max_bins[SAHBinCount] = { 0 };
+    const real scale = SAHBinCount / extent;
+    for(int i=0; i<count; ++i)
+    {
+      VL_CHECK(acts[i]->lod(0))
+      const AABB& aabb = acts[i]->boundingBox();
+      int bmin = (int)((aabb.minCorner()[axis] - node_min[axis]) * scale);
+      int bmax = (int)((aabb.maxCorner()[axis] - node_min[axis]) * scale);
+      min_bins[ clamp(bmin, 0, SAHBinCount-1) ]++;
+      max_bins[ clamp(bmax, 0, SAHBinCount-1) ]++;
+    }
+
+    // sweep the bin boundaries: an actor is on the negative side if its max corner is in a bin below
+    // the boundary and on the positive side if its min corner is in a bin above it.
+    int count_n = 0;
+    int count_p = count;
+    vec3 size_n = node_size;
+    vec3 size_p = node_size;
+    for(int b=1; b<SAHBinCount; ++b)
+    {
+      count_n += max_bins[b-1];
+      count_p -= min_bins[b-1];
+      const int count_c = count - count_n - count_p;
+      const real pos = node_min[axis] + extent * b / SAHBinCount;
+      size_n[axis] = pos - node_min[axis];
+      size_p[axis] = extent - size_n[axis];
+      // unit cost for the node traversal and for each actor test
+      real cost = 1 + count_c +
+        ( surfaceArea(size_n.x(), size_n.y(), size_n.z()) * count_n +
+          surfaceArea(size_p.x(), size_p.y(), size_p.z()) * count_p ) / node_area;
+      if (cost < best_cost)
+      {
+        best_cost = cost;
+        best_axis = axis;
+        best_pos  = pos;
+      }
+    }
+  }
+
+  if (best_axis == -1)
+    return false;
+
+  vec3 normal;
+  normal[best_axis] = 1;
+  plane = Plane(best_pos, normal);
+  return true;
+}
+//-----------------------------------------------------------------------------
 ActorKdTree* ActorKdTree::insertActor(Actor* actor)
 {
   VL_CHECK(actor->lod(0))
@@ -275,14 +408,237 @@ ActorKdTree* ActorKdTree::insertActor(Actor* actor)
   {
     switch( mPlane.classify(actor->boundingBox()) )
     {
-      case -1: if (!childN()) setChildN(new ActorKdTree); return childN()->insertActor(actor);
+      case -1: if (!childN()) setChildN(newChild()); return childN()->insertActor(actor);
       case 0:  actors()->push_back(actor); break;
-      case +1: if (!childP()) setChildP(new ActorKdTree); return childP()->insertActor(actor);
+      case +1: if (!childP()) setChildP(newChild()); return childP()->insertActor(actor);
     }
   }
   return this;
 }
 //-----------------------------------------------------------------------------
+ActorKdTree* ActorKdTree::locateNode(const AABB& aabb)
+{
+  if (childN() == 0 && childP() == 0)
+    return this;
+  switch( mPlane.classify(aabb) )
+  {
+    case -1: return childN() ? childN()->locateNode(aabb) : NULL;
+    case +1: return childP() ? childP()->locateNode(aabb) : NULL;
+    default: return this;
+  }
+}
+//-----------------------------------------------------------------------------
+ActorKdTree* ActorKdTree::findActorNode(Actor* actor)
+{
+  if (actors()->find(actor) != ActorCollection::not_found)
+    return this;
+  ActorKdTree* node = childN() ? childN()->findActorNode(actor) : NULL;
+  if (!node && childP())
+    node = childP()->findActorNode(actor);
+  return node;
+}
+//-----------------------------------------------------------------------------
+void ActorKdTree::refitAABB()
+{
+  mAABB.setNull();
+  for(int i=0; i<(int)actors()->size(); ++i)
+    mAABB += actors()->at(i)->boundingBox();
+  if (childN())
+    mAABB += childN()->aabb();
+  if (childP())
+    mAABB += childP()->aabb();
+}
+//-----------------------------------------------------------------------------
+void ActorKdTree::refitNodes(Tracking& tracking)
+{
+  // collect the nodes and their ancestors sorted by decreasing depth, mRefitPending marks the nodes already collected
+  tracking.mRefitSorted.clear();
+  for(size_t i=0; i<tracking.mRefitQueue.size(); ++i)
+  {
+    int depth = 0;
+    for(ActorTreeAbstract* p = tracking.mRefitQueue[i]->parent(); p; p = p->parent())
+      ++depth;
+    for(ActorKdTree* node = tracking.mRefitQueue[i]; node && !node->mRefitPending; node = static_cast<ActorKdTree*>(node->parent()), --depth)
+    {
+      node->mRefitPending = true;
+      tracking.mRefitSorted.push_back( std::make_pair(-depth, node) );
+    }
+  }
+  std::sort(tracking.mRefitSorted.begin(), tracking.mRefitSorted.end());
+
+  for(size_t i=0; i<tracking.mRefitSorted.size(); ++i)
+  {
+    tracking.mRefitSorted[i].second->refitAABB();
+    tracking.mRefitSorted[i].second->mRefitPending = false;
+  }
+  tracking.mRefitQueue.clear();
+}
+//-----------------------------------------------------------------------------
+void ActorKdTree::relocateTrackedActors()
+{
+  Tracking& tracking = *mTracking;
+  std::vector<TrackedActor> tracked;
+  tracked.reserve(tracking.mActors.size());
+  tracking.mIndex.clear();
+  for(size_t i=0; i<tracking.mActors.size(); ++i)
+  {
+    Actor* actor = tracking.mActors[i].mActor.get();
+    ActorKdTree* node = locateNode(actor->boundingBox());
+    if (!node || node->actors()->find(actor) == ActorCollection::not_found)
+      node = findActorNode(actor);
+    if (node)
+    {
+      tracking.mIndex[actor] = (int)tracked.size();
+      tracked.push_back(tracking.mActors[i]);
+      tracked.back().mNode = node;
+    }
+  }
+  tracking.mActors.swap(tracked);
+}
+//-----------------------------------------------------------------------------
+void ActorKdTree::trackActor(Actor* actor)
+{
+  VL_CHECK(actor->lod(0))
+  Tracking& tracking = this->tracking();
+  if (tracking.mIndex.find(actor) != tracking.mIndex.end())
+    return;
+
+  actor->computeBounds();
+
+  TrackedActor tracked;
+  tracked.mActor = actor;
+  tracked.mTransformTick = transformTick(actor);
+  tracked.mBoundsTick = boundsTick(actor);
+  tracked.mNode = locateNode(actor->boundingBox());
+  if (!tracked.mNode || tracked.mNode->actors()->find(actor) == ActorCollection::not_found)
+    tracked.mNode = findActorNode(actor);
+  if (!tracked.mNode)
+  {
+    tracked.mNode = insertActor(actor);
+    tracking.mRefitQueue.push_back(tracked.mNode);
+    refitNodes(tracking);
+  }
+  tracking.mIndex[actor] = (int)tracking.mActors.size();
+  tracking.mActors.push_back(tracked);
+}
+//-----------------------------------------------------------------------------
+void ActorKdTree::untrackActor(Actor* actor)
+{
+  if (!mTracking)
+    return;
+  Tracking& tracking = *mTracking;
+  std::map<const Actor*, int>::iterator it = tracking.mIndex.find(actor);
+  if (it == tracking.mIndex.end())
+    return;
+
+  // move the last tracked actor in the freed slot
+  int index = it->second;
+  tracking.mIndex.erase(it);
+  if (index != (int)tracking.mActors.size() - 1)
+  {
+    tracking.mActors[index] = tracking.mActors.back();
+    tracking.mIndex[tracking.mActors[index].mActor.get()] = index;
+  }
+  tracking.mActors.pop_back();
+}
+//-----------------------------------------------------------------------------
+void ActorKdTree::untrackAllActors()
+{
+  delete mTracking;
+  mTracking = NULL;
+}
+//-----------------------------------------------------------------------------
+void ActorKdTree::updateKdTree(float rebuild_ratio)
+{
+  mStatsMovedActors = 0;
+  mStatsReinsertedActors = 0;
+  mStatsRebuiltSubtrees = 0;
+  if (!mTracking)
+    return;
+  Tracking& tracking = *mTracking;
+
+  tracking.mRefitQueue.clear();
+  tracking.mInsertedNodes.clear();
+  for(size_t i=0; i<tracking.mActors.size(); ++i)
+  {
+    TrackedActor& tracked = tracking.mActors[i];
+    Actor* actor = tracked.mActor.get();
+    long long transform_tick = transformTick(actor);
+    long long bounds_tick = boundsTick(actor);
+    if (transform_tick == tracked.mTransformTick && bounds_tick == tracked.mBoundsTick)
+      continue;
+    tracked.mTransformTick = transform_tick;
+    tracked.mBoundsTick = bounds_tick;
+    ++mStatsMovedActors;
+
+    actor->computeBounds();
+    tracking.mRefitQueue.push_back(tracked.mNode);
+    if (locateNode(actor->boundingBox()) == tracked.mNode)
+      continue;
+
+    // the actor left its node, or was removed from it without untracking it
+    size_t pos = tracked.mNode->actors()->find(actor);
+    if (pos != ActorCollection::not_found)
+      tracked.mNode->actors()->erase(pos, 1);
+    tracked.mNode = insertActor(actor);
+    tracking.mRefitQueue.push_back(tracked.mNode);
+    tracking.mInsertedNodes.push_back(tracked.mNode);
+    ++mStatsReinsertedActors;
+    for(ActorKdTree* node = tracked.mNode; node; node = static_cast<ActorKdTree*>(node->parent()))
+      ++node->mReinsertCount;
+  }
+
+  refitNodes(tracking);
+
+  // find the largest degraded subtrees
+  std::sort(tracking.mInsertedNodes.begin(), tracking.mInsertedNodes.end());
+  tracking.mInsertedNodes.erase(std::unique(tracking.mInsertedNodes.begin(), tracking.mInsertedNodes.end()), tracking.mInsertedNodes.end());
+  tracking.mRebuildNodes.clear();
+  for(size_t i=0; i<tracking.mInsertedNodes.size(); ++i)
+  {
+    ActorKdTree* degraded = NULL;
+    for(ActorKdTree* node = tracking.mInsertedNodes[i]; node; node = static_cast<ActorKdTree*>(node->parent()))
+      if (node->mReinsertCount >= MinRebuildReinsertCount && node->mReinsertCount > rebuild_ratio * node->mBuildActorCount)
+        degraded = node;
+    if (degraded)
+      tracking.mRebuildNodes.push_back(degraded);
+  }
+  std::sort(tracking.mRebuildNodes.begin(), tracking.mRebuildNodes.end());
+  tracking.mRebuildNodes.erase(std::unique(tracking.mRebuildNodes.begin(), tracking.mRebuildNodes.end()), tracking.mRebuildNodes.end());
+
+  // skip the subtrees contained in another degraded subtree before any node is destroyed
+  size_t root_count = 0;
+  for(size_t i=0; i<tracking.mRebuildNodes.size(); ++i)
+  {
+    bool nested = false;
+    for(ActorKdTree* node = static_cast<ActorKdTree*>(tracking.mRebuildNodes[i]->parent()); node && !nested; node = static_cast<ActorKdTree*>(node->parent()))
+      nested = std::binary_search(tracking.mRebuildNodes.begin(), tracking.mRebuildNodes.end(), node);
+    if (!nested)
+      tracking.mInsertedNodes[root_count++] = tracking.mRebuildNodes[i];
+  }
+  // mInsertedNodes is not needed anymore and holds at least as many entries as mRebuildNodes
+  tracking.mInsertedNodes.resize(root_count);
+
+  for(size_t i=0; i<tracking.mInsertedNodes.size(); ++i)
+  {
+    ActorKdTree* root = tracking.mInsertedNodes[i];
+    int absorbed = root->mReinsertCount;
+    root->rebuildKdTree();
+    ++mStatsRebuiltSubtrees;
+    // the rebuilt subtree is balanced again: its re-insertions must not count against its ancestors anymore
+    for(ActorKdTree* node = static_cast<ActorKdTree*>(root->parent()); node; node = static_cast<ActorKdTree*>(node->parent()))
+      node->mReinsertCount = node->mReinsertCount > absorbed ? node->mReinsertCount - absorbed : 0;
+    if (root->parent())
+      tracking.mRefitQueue.push_back(static_cast<ActorKdTree*>(root->parent()));
+  }
+
+  if (mStatsRebuiltSubtrees)
+  {
+    refitNodes(tracking);
+    relocateTrackedActors();
+  }
+}
+//-----------------------------------------------------------------------------
 int ActorKdTree::childrenCount() const
 {
   if (mChildN && mChildP)
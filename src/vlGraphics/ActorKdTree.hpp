@@ -38,6 +38,8 @@
 #include <vlCore/Plane.hpp>
 #include <vlCore/Collection.hpp>
 #include <vlGraphics/ActorTreeAbstract.hpp>
+#include <vector>
+#include <map>
 
 namespace vl
 {
@@ -59,10 +61,12 @@ namespace vl
     VL_INSTRUMENT_CLASS(vl::ActorKdTree, ActorTreeAbstract)
 
   public:
-    ActorKdTree()
+    ActorKdTree(): mBuildMethod(KDBM_Median), mTracking(NULL), mBuildActorCount(0), mReinsertCount(0), mRefitPending(false),
+      mStatsMovedActors(0), mStatsReinsertedActors(0), mStatsRebuiltSubtrees(0)
     {
       VL_DEBUG_SET_OBJECT_NAME()
     }
+    virtual ~ActorKdTree();
     virtual int childrenCount() const;
     virtual ActorTreeAbstract* child(int i);
     virtual const ActorTreeAbstract* child(int i) const;
@@ -72,6 +76,10 @@ namespace vl
    * The ActorKdTree generation routine will try to minimize the ActorKdTree depth. Note that this function
    * is relatively quick, but is not for free. Consider that using a Core 2 Duo @2.0GHz you can
    * process around 22.000 objects/sec.
+   *
+   * The splitting planes are chosen according to buildMethod(). When VL is compiled with OpenMP support
+   * and GlobalSettings::threadCount() is greater than 1 the independent subtrees are built in parallel,
+   * the resulting tree is the same as the one built by a single thread.
    * \note This method calls prepareActors() before computing the KdTree.
    */
   void buildKdTree(ActorCollection& actors, int max_depth=100, float minimum_volume=0);
@@ -80,6 +88,13 @@ namespace vl
   //! \note This method calls prepareActors() before computing the KdTree.
   void rebuildKdTree(int max_depth=100, float minimum_volume=0);
 
+  //! The splitting strategy used by buildKdTree() and rebuildKdTree(), the default is KDBM_Median.
+  //! The child nodes created during the build inherit the build method of their parent.
+  void setBuildMethod(EKdTreeBuildMethod method) { mBuildMethod = method; }
+
+  //! The splitting strategy used by buildKdTree() and rebuildKdTree(), the default is KDBM_Median.
+  EKdTreeBuildMethod buildMethod() const { return mBuildMethod; }
+
   //! Returns the splitting plane used to divide its two child nodes
   const Plane& plane() const { return mPlane; }
 
@@ -96,6 +111,7 @@ namespace vl
   /**
    * Inserts an Actor in the ActorKdTree node hierarchy.
    * Note that the Actor is likely to be inserted in a node whose bounding volume does not surround the Actor's bounding volume.
+   * The nodes created to host the Actor inherit buildMethod() so that a later rebuildKdTree() of the subtree uses the same strategy.
    * For this reason after you inserted one or more Actors in the ActorKdTree you should call computeAABB() on the root node of
    * the ActorKdTree. Inserting and removing Actors is an expensive operation and produces an ActorKdTree that is
    * less balanced than the one you would get by recompiling the whole ActorKdTree from scratch.
@@ -118,7 +134,86 @@ namespace vl
    */
   void harvestNonLeafActors(ActorCollection& actors);
 
+  /**
+   * Registers an Actor that is expected to move, see updateKdTree().
+   * If the Actor is not already contained in the ActorKdTree it is inserted with insertActor().
+   * \note Actors should be tracked and updated on the root node of the ActorKdTree.
+   */
+  void trackActor(Actor* actor);
+
+  //! Removes an Actor from the list of the tracked actors, the Actor is not removed from the ActorKdTree.
+  void untrackActor(Actor* actor);
+
+  //! Removes all the Actors from the list of the tracked actors.
+  void untrackAllActors();
+
+  //! The number of Actors registered with trackActor().
+  int trackedActorCount() const { return mTracking ? (int)mTracking->mActors.size() : 0; }
+
+  /**
+   * Incrementally updates the ActorKdTree for the tracked Actors whose Transform or LOD 0 Renderable changed since the last update.
+   * The moved Actors that do not belong anymore to their node are removed and re-inserted, then the bounding boxes of the
+   * affected nodes and of their ancestors are recomputed bottom-up. The cost of an update depends on the number of tracked
+   * Actors and on the depth of the tree but not on the total number of Actors contained in the tree.
+   * There is no list of the moved Actors: the Transform and bounds ticks of every tracked Actor are compared at each update,
+   * so the Actors that stopped moving should be untracked with untrackActor().
+   *
+   * Each node counts the Actors re-inserted in its subtree since the subtree was built: when this number is greater than
+   * \p rebuild_ratio times the number of Actors the subtree was built with the subtree is rebuilt with rebuildKdTree().
+   * If more than one subtree qualifies only the largest one containing the others is rebuilt.
+   */
+  void updateKdTree(float rebuild_ratio=0.25f);
+
+  //! Number of tracked Actors that moved during the last updateKdTree().
+  int statsMovedActors() const { return mStatsMovedActors; }
+
+  //! Number of tracked Actors that left their node and were re-inserted during the last updateKdTree().
+  int statsReinsertedActors() const { return mStatsReinsertedActors; }
+
+  //! Number of subtrees rebuilt during the last updateKdTree().
+  int statsRebuiltSubtrees() const { return mStatsRebuiltSubtrees; }
+
   private:
+    struct TrackedActor
+    {
+      TrackedActor(): mNode(NULL), mTransformTick(-1), mBoundsTick(-1) {}
+      ref<Actor> mActor;
+      ActorKdTree* mNode;
+      long long mTransformTick;
+      long long mBoundsTick;
+    };
+
+    //! The state of the tracked Actors, allocated by the root node on the first trackActor().
+    struct Tracking
+    {
+      std::vector<TrackedActor> mActors;
+      std::map<const Actor*, int> mIndex;
+      // work buffers reused across updateKdTree() calls
+      std::vector<ActorKdTree*> mRefitQueue;
+      std::vector<ActorKdTree*> mInsertedNodes;
+      std::vector<ActorKdTree*> mRebuildNodes;
+      std::vector< std::pair<int, ActorKdTree*> > mRefitSorted;
+    };
+
+    // mTracking is owned by the node
+    ActorKdTree(const ActorKdTree&);
+    ActorKdTree& operator=(const ActorKdTree&);
+
+    //! Returns mTracking, allocating it if needed.
+    Tracking& tracking()
+    {
+      if (!mTracking)
+        mTracking = new Tracking;
+      return *mTracking;
+    }
+
+    //! Creates a child node inheriting the build method of this node.
+    ActorKdTree* newChild() const
+    {
+      ActorKdTree* child = new ActorKdTree;
+      child->mBuildMethod = mBuildMethod;
+      return child;
+    }
     void setChildN(ActorKdTree* child)
     {
       VL_CHECK(child);
@@ -140,15 +235,36 @@ namespace vl
     //! Finds the best plane among different x/y/z orientation in order to divide the given
     //! list of actors included in the given AABB.
     bool findBestPlane(Plane& plane, int& counter, ActorCollection& actors);
+    //! Finds the plane with the lowest Surface Area Heuristic cost, returns false if splitting
+    //! the node is estimated to be more expensive than keeping all the actors in it.
+    bool findBestPlaneSAH(Plane& plane, const ActorCollection& actors);
     //!
     void compileTree_internal(ActorCollection& acts, int& counter, int max_depth=100, float minimum_volume=0);
     //!
     void computeLocalAABB(const ActorCollection& actors);
+    //! Returns the node in which insertActor() would put an Actor with the given bounding box or NULL if such node does not exist yet.
+    ActorKdTree* locateNode(const AABB& aabb);
+    //! Searches the whole subtree for the node containing the given Actor.
+    ActorKdTree* findActorNode(Actor* actor);
+    //! Updates the node's AABB from its Actors and from its children's AABB.
+    void refitAABB();
+    //! Refits the nodes in the refit queue of \p tracking and their ancestors, the deepest nodes first, then clears the queue.
+    static void refitNodes(Tracking& tracking);
+    //! Finds the node of every tracked Actor, the Actors not contained in the tree anymore are untracked.
+    void relocateTrackedActors();
 
   protected:
     Plane mPlane;
     ref<ActorKdTree> mChildN;
     ref<ActorKdTree> mChildP;
+    EKdTreeBuildMethod mBuildMethod;
+    Tracking* mTracking;
+    int mBuildActorCount;
+    int mReinsertCount;
+    bool mRefitPending;
+    int mStatsMovedActors;
+    int mStatsReinsertedActors;
+    int mStatsRebuiltSubtrees;
   };
 
 }
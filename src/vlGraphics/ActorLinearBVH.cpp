@@ -0,0 +1,523 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+
+#include <vlGraphics/ActorLinearBVH.hpp>
+#include <vlGraphics/Camera.hpp>
+#include <vlCore/GlobalSettings.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace vl;
+
+namespace
+{
+  typedef ActorLinearBVH::Node Node;
+
+  //-----------------------------------------------------------------------------
+  // Spreads the lower 10 bits of v so that there are two zero bits between each bit.
+  inline u32 expandBits(u32 v)
+  {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+  }
+  //-----------------------------------------------------------------------------
+  // 30 bits Morton code of a point in the unit cube.
+  inline u32 mortonCode(float x, float y, float z)
+  {
+    x = std::min(std::max(x * 1024.0f, 0.0f), 1023.0f);
+    y = std::min(std::max(y * 1024.0f, 0.0f), 1023.0f);
+    z = std::min(std::max(z * 1024.0f, 0.0f), 1023.0f);
+    return (expandBits((u32)x) << 2) | (expandBits((u32)y) << 1) | expandBits((u32)z);
+  }
+  //-----------------------------------------------------------------------------
+  // Returns the first index of the second half of the sorted range [begin,end) with at least 2 elements.
+  int findSplit(const std::vector<u32>& codes, int begin, int end)
+  {
+    u32 first = codes[begin];
+    u32 last  = codes[end-1];
+    if (first == last)
+      return (begin + end) / 2;
+
+    // the highest bit in which the first and last codes differ
+    u32 bit = 1u << 31;
+    while( !((first ^ last) & bit) )
+      bit >>= 1;
+
+    // binary search of the first code with that bit set
+    int lo = begin, hi = end-1;
+    while(lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+      if (codes[mid] & bit)
+        hi = mid;
+      else
+        lo = mid + 1;
+    }
+    return lo;
+  }
+  //-----------------------------------------------------------------------------
+  void buildSubtree(const std::vector<u32>& codes, int begin, int end, int max_leaf_actors, std::vector<Node>& nodes)
+  {
+    int index = (int)nodes.size();
+    nodes.push_back(Node());
+    if (end - begin <= max_leaf_actors)
+    {
+      nodes[index].mFirstActor = begin;
+      nodes[index].mActorCount = end - begin;
+    }
+    else
+    {
+      int split = findSplit(codes, begin, end);
+      buildSubtree(codes, begin, split, max_leaf_actors, nodes);
+      buildSubtree(codes, split, end, max_leaf_actors, nodes);
+      nodes[index].mFirstActor = begin;
+      nodes[index].mActorCount = 0;
+    }
+    nodes[index].mSkip = (int)nodes.size();
+  }
+  //-----------------------------------------------------------------------------
+  struct Range
+  {
+    Range(int begin, int end): mBegin(begin), mEnd(end) {}
+    int mBegin;
+    int mEnd;
+  };
+  //-----------------------------------------------------------------------------
+  // Collects the subtrees found \p depth levels below the root, in depth-first order.
+  void splitSubtrees(const std::vector<u32>& codes, int begin, int end, int max_leaf_actors, int depth, std::vector<Range>& subtrees)
+  {
+    if (depth == 0 || end - begin <= max_leaf_actors)
+    {
+      subtrees.push_back( Range(begin, end) );
+      return;
+    }
+    int split = findSplit(codes, begin, end);
+    splitSubtrees(codes, begin, split, max_leaf_actors, depth-1, subtrees);
+    splitSubtrees(codes, split, end, max_leaf_actors, depth-1, subtrees);
+  }
+  //-----------------------------------------------------------------------------
+  // Emits the top levels of the hierarchy generated by splitSubtrees() and appends to them the subtrees built independently.
+  void spliceSubtrees(const std::vector<u32>& codes, int begin, int end, int max_leaf_actors, int depth,
+                      const std::vector< std::vector<Node> >& subtrees, int& next_subtree, std::vector<Node>& nodes)
+  {
+    if (depth == 0 || end - begin <= max_leaf_actors)
+    {
+      const std::vector<Node>& subtree = subtrees[next_subtree++];
+      int offset = (int)nodes.size();
+      for(size_t i=0; i<subtree.size(); ++i)
+      {
+        nodes.push_back(subtree[i]);
+        nodes.back().mSkip += offset;
+      }
+      return;
+    }
+    int index = (int)nodes.size();
+    nodes.push_back(Node());
+    int split = findSplit(codes, begin, end);
+    spliceSubtrees(codes, begin, split, max_leaf_actors, depth-1, subtrees, next_subtree, nodes);
+    spliceSubtrees(codes, split, end, max_leaf_actors, depth-1, subtrees, next_subtree, nodes);
+    nodes[index].mFirstActor = begin;
+    nodes[index].mActorCount = 0;
+    nodes[index].mSkip = (int)nodes.size();
+  }
+  //-----------------------------------------------------------------------------
+  inline void setNull(Node& node)
+  {
+    node.mMin[0] = node.mMin[1] = node.mMin[2] = +1;
+    node.mMax[0] = node.mMax[1] = node.mMax[2] = -1;
+  }
+  //-----------------------------------------------------------------------------
+  inline bool isNull(const Node& node)
+  {
+    return node.mMin[0] > node.mMax[0] || node.mMin[1] > node.mMax[1] || node.mMin[2] > node.mMax[2];
+  }
+  //-----------------------------------------------------------------------------
+  inline void merge(Node& node, const float* min, const float* max)
+  {
+    if (isNull(node))
+    {
+      for(int i=0; i<3; ++i)
+      {
+        node.mMin[i] = min[i];
+        node.mMax[i] = max[i];
+      }
+    }
+    else
+    {
+      for(int i=0; i<3; ++i)
+      {
+        node.mMin[i] = std::min(node.mMin[i], min[i]);
+        node.mMax[i] = std::max(node.mMax[i], max[i]);
+      }
+    }
+  }
+  //-----------------------------------------------------------------------------
+  // The frustum planes converted to single precision once per traversal, the planes beyond MaxPlanes are tested in double precision.
+  class FrustumPlanes
+  {
+  public:
+    enum { MaxPlanes = 16 };
+
+    FrustumPlanes(const Frustum& frustum): mFrustum(frustum)
+    {
+      mCount = std::min( (int)frustum.planes().size(), (int)MaxPlanes );
+      for(int i=0; i<mCount; ++i)
+      {
+        const Plane& plane = frustum.planes()[i];
+        mPlanes[i*4+0] = (float)plane.normal().x();
+        mPlanes[i*4+1] = (float)plane.normal().y();
+        mPlanes[i*4+2] = (float)plane.normal().z();
+        mPlanes[i*4+3] = (float)plane.origin();
+      }
+    }
+
+    // Same as Frustum::cull(const AABB&) with the same conservative slack used by Frustum::cullAABBs()
+    bool cull(const Node& node) const
+    {
+      if (isNull(node))
+        return false;
+      for(int i=0; i<mCount; ++i)
+      {
+        const float* p = &mPlanes[i*4];
+        float x = p[0] * ( p[0] >= 0 ? node.mMin[0] : node.mMax[0] );
+        float y = p[1] * ( p[1] >= 0 ? node.mMin[1] : node.mMax[1] );
+        float z = p[2] * ( p[2] >= 0 ? node.mMin[2] : node.mMax[2] );
+        float eps = ( fabsf(x) + fabsf(y) + fabsf(z) + fabsf(p[3]) ) * 1e-5f;
+        if (x + y + z - p[3] > eps)
+          return true;
+      }
+      for(size_t i=mCount; i<mFrustum.planes().size(); ++i)
+      {
+        const Plane& plane = mFrustum.planes()[i];
+        vec3 corner( plane.normal().x() >= 0 ? node.mMin[0] : node.mMax[0],
+                     plane.normal().y() >= 0 ? node.mMin[1] : node.mMax[1],
+                     plane.normal().z() >= 0 ? node.mMin[2] : node.mMax[2] );
+        if (plane.distance(corner) >= 0)
+          return true;
+      }
+      return false;
+    }
+
+  private:
+    const Frustum& mFrustum;
+    float mPlanes[MaxPlanes*4];
+    int mCount;
+  };
+  //-----------------------------------------------------------------------------
+  // Collects the enabled Actors of the visited leaves and culls their bounding spheres 64 at a time, see Frustum::cullSpheres().
+  class SphereBatch
+  {
+  public:
+    enum { Size = 64 };
+
+    SphereBatch(const Frustum& frustum, ActorCollection& list): mFrustum(frustum), mList(list), mCount(0) {}
+
+    void add(Actor* actor)
+    {
+      const Sphere& sphere = actor->boundingSphere();
+      mActors[mCount] = actor;
+      mCX[mCount]     = (float)sphere.center().x();
+      mCY[mCount]     = (float)sphere.center().y();
+      mCZ[mCount]     = (float)sphere.center().z();
+      mRadius[mCount] = (float)sphere.radius();
+      if (++mCount == Size)
+        flush();
+    }
+
+    void flush()
+    {
+      mFrustum.cullSpheres( mCount, mCX, mCY, mCZ, mRadius, mVisible );
+      for(int j=0; j<mCount; ++j)
+      {
+        if ( mVisible[j >> 5] & ( 1u << ( j & 31 ) ) )
+          mList.push_back( mActors[j] );
+      }
+      mCount = 0;
+    }
+
+  private:
+    const Frustum& mFrustum;
+    ActorCollection& mList;
+    int mCount;
+    Actor* mActors[Size];
+    float mCX[Size], mCY[Size], mCZ[Size], mRadius[Size];
+    u32 mVisible[Size / 32];
+  };
+}
+//-----------------------------------------------------------------------------
+void ActorLinearBVH::buildBVH(ActorCollection& actors)
+{
+  clear();
+
+  int count = (int)actors.size();
+  if (count == 0)
+    return;
+
+  // bounds of the actor centers
+  AABB centers;
+  for(int i=0; i<count; ++i)
+  {
+    actors[i]->computeBounds();
+    if ( !actors[i]->boundingBox().isNull() )
+      centers.addPoint( actors[i]->boundingBox().center() );
+  }
+  vec3 origin = centers.isNull() ? vec3(0,0,0) : centers.minCorner();
+  vec3 scale(1,1,1);
+  for(int i=0; i<3 && !centers.isNull(); ++i)
+  {
+    real extent = centers.maxCorner()[i] - centers.minCorner()[i];
+    scale[i] = extent > 0 ? 1 / extent : 0;
+  }
+
+  int thread_count = globalSettings()->threadCount();
+
+  // sort the actors along the Morton curve
+  std::vector< std::pair<u32, int> > keys(count);
+#ifdef VL_OPENMP
+  #pragma omp parallel for num_threads(thread_count)
+#endif
+  for(int i=0; i<count; ++i)
+  {
+    const AABB& aabb = actors[i]->boundingBox();
+    vec3 p = aabb.isNull() ? vec3(0,0,0) : (aabb.center() - origin) * scale;
+    keys[i] = std::make_pair( mortonCode((float)p.x(), (float)p.y(), (float)p.z()), i );
+  }
+  std::sort(keys.begin(), keys.end());
+
+  std::vector<u32> codes(count);
+  mActors.resize(count);
+  for(int i=0; i<count; ++i)
+  {
+    codes[i] = keys[i].first;
+    mActors[i] = actors[keys[i].second];
+  }
+
+  // split the top of the hierarchy in ~8 subtrees per thread built independently
+  int depth = 0;
+  while( thread_count > 1 && (1 << depth) < thread_count * 8 && depth < 16 )
+    ++depth;
+
+  std::vector<Range> ranges;
+  splitSubtrees(codes, 0, count, mMaxLeafActors, depth, ranges);
+  std::vector< std::vector<Node> > subtrees( ranges.size() );
+
+#ifdef VL_OPENMP
+  #pragma omp parallel for schedule(dynamic, 1) num_threads(thread_count)
+#endif
+  for(int i=0; i<(int)ranges.size(); ++i)
+  {
+    subtrees[i].reserve( 2 * (ranges[i].mEnd - ranges[i].mBegin) / mMaxLeafActors + 1 );
+    buildSubtree(codes, ranges[i].mBegin, ranges[i].mEnd, mMaxLeafActors, subtrees[i]);
+  }
+
+  if (subtrees.size() == 1)
+    mNodes.swap(subtrees[0]);
+  else
+  {
+    int next_subtree = 0;
+    spliceSubtrees(codes, 0, count, mMaxLeafActors, depth, subtrees, next_subtree, mNodes);
+  }
+
+  refitBVH();
+}
+//-----------------------------------------------------------------------------
+void ActorLinearBVH::rebuildBVH()
+{
+  ActorCollection actors = mActors;
+  buildBVH(actors);
+}
+//-----------------------------------------------------------------------------
+void ActorLinearBVH::refitBVH()
+{
+  // Actors can share Transforms and Renderables whose bounds are computed lazily: not thread safe
+  for(int i=0; i<(int)mActors.size(); ++i)
+    mActors[i]->computeBounds();
+
+  int thread_count = globalSettings()->threadCount();
+
+  // leaves
+#ifdef VL_OPENMP
+  #pragma omp parallel for num_threads(thread_count)
+#endif
+  for(int i=0; i<(int)mNodes.size(); ++i)
+  {
+    Node& node = mNodes[i];
+    if (node.mActorCount == 0)
+      continue;
+    setNull(node);
+    for(int j=node.mFirstActor; j<node.mFirstActor+node.mActorCount; ++j)
+    {
+      const AABB& aabb = mActors[j]->boundingBox();
+      if (aabb.isNull())
+        continue;
+      float min[] = { (float)aabb.minCorner().x(), (float)aabb.minCorner().y(), (float)aabb.minCorner().z() };
+      float max[] = { (float)aabb.maxCorner().x(), (float)aabb.maxCorner().y(), (float)aabb.maxCorner().z() };
+      merge(node, min, max);
+    }
+  }
+
+  // inner nodes, children always follow their parent
+  for(int i=(int)mNodes.size()-1; i>=0; --i)
+  {
+    Node& node = mNodes[i];
+    if (node.mActorCount)
+      continue;
+    const Node& left  = mNodes[i+1];
+    const Node& right = mNodes[left.mSkip];
+    setNull(node);
+    if (!isNull(left))
+      merge(node, left.mMin, left.mMax);
+    if (!isNull(right))
+      merge(node, right.mMin, right.mMax);
+  }
+}
+//-----------------------------------------------------------------------------
+AABB ActorLinearBVH::aabb() const
+{
+  AABB aabb;
+  if (!mNodes.empty() && !isNull(mNodes[0]))
+  {
+    aabb.setMinCorner(mNodes[0].mMin[0], mNodes[0].mMin[1], mNodes[0].mMin[2]);
+    aabb.setMaxCorner(mNodes[0].mMax[0], mNodes[0].mMax[1], mNodes[0].mMax[2]);
+  }
+  return aabb;
+}
+//-----------------------------------------------------------------------------
+void ActorLinearBVH::extractActors(ActorCollection& list)
+{
+  list.push_back(mActors);
+}
+//-----------------------------------------------------------------------------
+void ActorLinearBVH::extractVisibleRange(ActorCollection& list, const Camera* camera, unsigned enable_mask, int begin, int end)
+{
+  if (!camera)
+  {
+    for(int i=begin; i<end; ++i)
+    {
+      const Node& node = mNodes[i];
+      for(int j=node.mFirstActor; j<node.mFirstActor+node.mActorCount; ++j)
+      {
+        Actor* actor = mActors.at(j);
+        if ( actor->isEnabled() && (enable_mask & actor->enableMask()) )
+          list.push_back(actor);
+      }
+    }
+    return;
+  }
+
+  FrustumPlanes frustum(camera->frustum());
+  SphereBatch batch(camera->frustum(), list);
+  int i = begin;
+  while(i < end)
+  {
+    const Node& node = mNodes[i];
+    if (frustum.cull(node))
+    {
+      i = node.mSkip;
+      continue;
+    }
+    for(int j=node.mFirstActor; j<node.mFirstActor+node.mActorCount; ++j)
+    {
+      Actor* actor = mActors.at(j);
+      if ( actor->isEnabled() && (enable_mask & actor->enableMask()) )
+        batch.add(actor);
+    }
+    ++i;
+  }
+  batch.flush();
+}
+//-----------------------------------------------------------------------------
+void ActorLinearBVH::extractVisibleActors(ActorCollection& list, const Camera* camera, unsigned enable_mask)
+{
+  if (mAutoRefit && camera)
+    refitBVH();
+  extractVisibleRange(list, camera, enable_mask, 0, (int)mNodes.size());
+}
+//-----------------------------------------------------------------------------
+void ActorLinearBVH::extractVisibleActorsParallel(ActorCollection& list, const Camera* camera, unsigned enable_mask)
+{
+  int thread_count = globalSettings()->threadCount();
+  if ( thread_count < 2 || mNodes.empty() )
+  {
+    extractVisibleActors( list, camera, enable_mask );
+    return;
+  }
+
+  if (mAutoRefit && camera)
+    refitBVH();
+
+  // each subtree is a contiguous range of nodes: walk the top of the hierarchy until there are ~8 ranges per thread
+  std::vector<Range> ranges;
+  std::vector<Range> next;
+  ranges.push_back( Range(0, (int)mNodes.size()) );
+  while( (int)ranges.size() < thread_count * 8 )
+  {
+    bool split = false;
+    next.clear();
+    for(size_t i=0; i<ranges.size(); ++i)
+    {
+      const Node& node = mNodes[ranges[i].mBegin];
+      if (node.mActorCount)
+        next.push_back(ranges[i]);
+      else
+      {
+        // inner nodes contain no actors: their two children cover the rest of the range
+        next.push_back( Range(ranges[i].mBegin+1, mNodes[ranges[i].mBegin+1].mSkip) );
+        next.push_back( Range(mNodes[ranges[i].mBegin+1].mSkip, ranges[i].mEnd) );
+        split = true;
+      }
+    }
+    ranges.swap(next);
+    if (!split)
+      break;
+  }
+
+  std::vector<ActorCollection> results( ranges.size() );
+
+#ifdef VL_OPENMP
+  #pragma omp parallel for schedule(dynamic, 1) num_threads(thread_count)
+#endif
+  for( int i = 0; i < (int)ranges.size(); ++i )
+    extractVisibleRange( results[i], camera, enable_mask, ranges[i].mBegin, ranges[i].mEnd );
+
+  // deterministic merge
+  size_t count = list.size();
+  for( size_t i = 0; i < results.size(); ++i )
+    count += results[i].size();
+  list.reserve( count );
+  for( size_t i = 0; i < results.size(); ++i )
+    list.push_back( results[i] );
+}
+//-----------------------------------------------------------------------------
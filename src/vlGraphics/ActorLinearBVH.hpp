@@ -0,0 +1,143 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+
+#ifndef ActorLinearBVH_INCLUDE_ONCE
+#define ActorLinearBVH_INCLUDE_ONCE
+
+#include <vlGraphics/Actor.hpp>
+#include <vlCore/AABB.hpp>
+#include <vector>
+
+namespace vl
+{
+  class Camera;
+
+  /**
+   * The ActorLinearBVH class implements a bounding volume hierarchy stored as a flat array of nodes in depth-first order.
+   *
+   * Unlike ActorKdTree and ActorTree the nodes are not Objects: each node stores a single precision AABB, the index of the
+   * node that follows its subtree (used to skip the subtree when it is culled) and the range of Actors it contains, so that
+   * culling walks a contiguous array without chasing pointers or touching reference counts.
+   *
+   * The hierarchy is built by sorting the Actors along a Morton curve (Z-order) computed from the center of their bounding
+   * boxes and by splitting the sorted sequence recursively where the Morton codes differ in the highest bit. Building is
+   * O(n log n) and when VL is compiled with OpenMP support the code computation, the subtrees and the bounding boxes are
+   * computed in parallel, see GlobalSettings::threadCount().
+   *
+   * The hierarchy is static and the culling uses the Actor bounds computed by the last buildBVH() or refitBVH(): after moving
+   * some Actors call refitBVH(), or enable setAutoRefit(). When many Actors moved far away from their original position
+   * call rebuildBVH() to regenerate the hierarchy.
+   *
+   * \sa
+   * - SceneManagerLinearBVH
+   * - ActorKdTree
+   * - Actor
+  */
+  class VLGRAPHICS_EXPORT ActorLinearBVH: public Object
+  {
+    VL_INSTRUMENT_CLASS(vl::ActorLinearBVH, Object)
+
+  public:
+    //! A node of the ActorLinearBVH.
+    struct Node
+    {
+      float mMin[3];
+      float mMax[3];
+      //! The index of the first node following this node's subtree.
+      int mSkip;
+      //! The index in actors() of the first Actor of a leaf node.
+      int mFirstActor;
+      //! The number of Actors contained in a leaf node, 0 for inner nodes.
+      int mActorCount;
+    };
+
+  public:
+    ActorLinearBVH(): mMaxLeafActors(4), mAutoRefit(false)
+    {
+      VL_DEBUG_SET_OBJECT_NAME()
+    }
+
+    //! Builds the hierarchy with the given Actors, the bounds of the Actors are updated using Actor::computeBounds().
+    void buildBVH(ActorCollection& actors);
+
+    //! Builds the hierarchy with the Actors it already contains.
+    void rebuildBVH();
+
+    //! Updates the bounds of the Actors using Actor::computeBounds() and recomputes the bounding boxes of the nodes without changing the hierarchy.
+    void refitBVH();
+
+    //! If enabled extractVisibleActors() and extractVisibleActorsParallel() call refitBVH() before culling so that moved Actors
+    //! are tested at their current position. Disabled by default: refitBVH() visits all the Actors, call it only after moving some.
+    void setAutoRefit(bool enable) { mAutoRefit = enable; }
+
+    //! Whether extractVisibleActors() calls refitBVH() before culling, see setAutoRefit().
+    bool autoRefit() const { return mAutoRefit; }
+
+    //! Removes all the Actors and nodes.
+    void clear() { mNodes.clear(); mActors.clear(); }
+
+    //! The maximum number of Actors contained in a leaf node, the default is 4.
+    void setMaxLeafActors(int count) { mMaxLeafActors = count < 1 ? 1 : count; }
+
+    //! The maximum number of Actors contained in a leaf node, the default is 4.
+    int maxLeafActors() const { return mMaxLeafActors; }
+
+    //! The nodes of the hierarchy in depth-first order, the first node is the root.
+    const std::vector<Node>& nodes() const { return mNodes; }
+
+    //! The Actors contained in the hierarchy sorted along the Morton curve, see Node::mFirstActor.
+    const ActorCollection* actors() const { return &mActors; }
+
+    //! Returns the bounding box of the whole hierarchy.
+    AABB aabb() const;
+
+    //! Appends all the Actors contained in the hierarchy to the given ActorCollection.
+    void extractActors(ActorCollection& list);
+
+    //! Extracts the enabled Actors whose bounding sphere is not culled by the given camera, if \p camera is NULL all the enabled Actors are extracted.
+    void extractVisibleActors(ActorCollection& list, const Camera* camera, unsigned enable_mask=0xFFFFFFFF);
+
+    //! Multithreaded version of extractVisibleActors() returning the same Actors in the same order, see GlobalSettings::threadCount().
+    void extractVisibleActorsParallel(ActorCollection& list, const Camera* camera, unsigned enable_mask=0xFFFFFFFF);
+
+  protected:
+    void extractVisibleRange(ActorCollection& list, const Camera* camera, unsigned enable_mask, int begin, int end);
+
+  protected:
+    std::vector<Node> mNodes;
+    ActorCollection mActors;
+    int mMaxLeafActors;
+    bool mAutoRefit;
+  };
+}
+
+#endif
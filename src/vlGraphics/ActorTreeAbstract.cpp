@@ -31,6 +31,7 @@
 
 #include <vlGraphics/ActorTreeAbstract.hpp>
 #include <vlGraphics/Camera.hpp>
+#include <vlCore/GlobalSettings.hpp>
 
 using namespace vl;
 
@@ -76,6 +77,11 @@ void ActorTreeAbstract::extractActors(ActorCollection& list)
 }
 //-----------------------------------------------------------------------------
 void ActorTreeAbstract::extractVisibleActors(ActorCollection& list, const Camera* camera, unsigned enable_mask)
+{
+  extractVisibleActors_internal( list, camera, enable_mask, true );
+}
+//-----------------------------------------------------------------------------
+void ActorTreeAbstract::extractVisibleActors_internal(ActorCollection& list, const Camera* camera, unsigned enable_mask, bool compute_bounds)
 {
   // If enabled try and cull the whole node
   if ( ! isEnabled() || ( camera && camera->frustum().cull( aabb() ) ) ) {
@@ -83,24 +89,155 @@ void ActorTreeAbstract::extractVisibleActors(ActorCollection& list, const Camera
   }
 
   // Cull / extract this node's Actors
-  for( size_t i = 0; i < actors()->size(); ++i )
+  extractVisibleNodeActors( list, camera, enable_mask, compute_bounds );
+
+  // Descend to child nodes
+  for( int i = 0; i < childrenCount(); ++i ) {
+    if ( child(i) ) {
+      child(i)->extractVisibleActors_internal( list, camera, enable_mask, compute_bounds );
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void ActorTreeAbstract::computeVisibleBounds(const Camera* camera, unsigned enable_mask)
+{
+  if ( ! isEnabled() || ( camera && camera->frustum().cull( aabb() ) ) ) {
+    return;
+  }
+
+  for( size_t i = 0; i < actors()->size(); ++i ) {
+    Actor* actor = actors()->at(i);
+    if ( actor->isEnabled() && ( enable_mask & actor->enableMask() ) ) {
+      actor->computeBounds();
+    }
+  }
+
+  for( int i = 0; i < childrenCount(); ++i ) {
+    if ( child(i) ) {
+      child(i)->computeVisibleBounds( camera, enable_mask );
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void ActorTreeAbstract::extractVisibleNodeActors(ActorCollection& list, const Camera* camera, unsigned enable_mask, bool compute_bounds)
+{
+  // Actors are culled in batches of up to 64 bounding spheres at a time, see Frustum::cullSpheres().
+  const int batch_size = 64;
+  Actor* batch[batch_size];
+  float cx[batch_size], cy[batch_size], cz[batch_size], radius[batch_size];
+  u32 visible[batch_size / 32];
+
+  size_t i = 0;
+  while( i < actors()->size() )
   {
-    if ( actors()->at(i)->isEnabled() && ( enable_mask & actors()->at(i)->enableMask() ) )
+    int count = 0;
+    for( ; i < actors()->size() && count < batch_size; ++i )
     {
-      actors()->at(i)->computeBounds();
-      if ( camera && camera->frustum().cull( actors()->at(i)->boundingSphere() ) ) {
-        continue;
-      } else {
-        list.push_back(actors()->at(i));
+      Actor* actor = actors()->at(i);
+      if ( actor->isEnabled() && ( enable_mask & actor->enableMask() ) )
+      {
+        if ( compute_bounds ) {
+          actor->computeBounds();
+        }
+        batch[count]  = actor;
+        cx[count]     = (float)actor->boundingSphere().center().x();
+        cy[count]     = (float)actor->boundingSphere().center().y();
+        cz[count]     = (float)actor->boundingSphere().center().z();
+        radius[count] = (float)actor->boundingSphere().radius();
+        ++count;
+      }
+    }
+
+    if ( camera ) {
+      camera->frustum().cullSpheres( count, cx, cy, cz, radius, visible );
+    }
+
+    for( int j = 0; j < count; ++j ) {
+      if ( ! camera || ( visible[j >> 5] & ( 1u << ( j & 31 ) ) ) ) {
+        list.push_back( batch[j] );
       }
     }
   }
+}
+//-----------------------------------------------------------------------------
+namespace
+{
+  // A unit of work of the parallel culling: either the Actors of a single node or a whole subtree.
+  struct CullTask
+  {
+    CullTask(ActorTreeAbstract* node, bool subtree): mNode(node), mSubtree(subtree) {}
+    ActorTreeAbstract* mNode;
+    bool mSubtree;
+  };
 
-  // Descend to child nodes
-  for( int i = 0; i < childrenCount(); ++i ) {
-    if ( child(i) ) {
-      child(i)->extractVisibleActors( list, camera );
+  // Splits the tree in depth-first order so that concatenating the task outputs reproduces the serial traversal.
+  void splitCullTasks(std::vector<CullTask>& tasks, ActorTreeAbstract* node, const Camera* camera, int depth)
+  {
+    if ( depth == 0 || node->childrenCount() == 0 )
+    {
+      tasks.push_back( CullTask(node, true) );
+      return;
     }
+
+    if ( ! node->isEnabled() || ( camera && camera->frustum().cull( node->aabb() ) ) ) {
+      return;
+    }
+
+    if ( ! node->actors()->empty() ) {
+      tasks.push_back( CullTask(node, false) );
+    }
+
+    for( int i = 0; i < node->childrenCount(); ++i ) {
+      if ( node->child(i) ) {
+        splitCullTasks( tasks, node->child(i), camera, depth - 1 );
+      }
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void ActorTreeAbstract::extractVisibleActorsParallel(ActorCollection& list, const Camera* camera, unsigned enable_mask)
+{
+  int thread_count = globalSettings()->threadCount();
+  if ( thread_count < 2 )
+  {
+    extractVisibleActors( list, camera, enable_mask );
+    return;
+  }
+
+  // aim at ~8 tasks per thread to balance uneven subtrees
+  int depth = 0;
+  while( (1 << depth) < thread_count * 8 && depth < 16 ) {
+    ++depth;
+  }
+
+  // Actor::computeBounds() is not thread safe: the concurrent culling only reads the bounds
+  computeVisibleBounds( camera, enable_mask );
+
+  std::vector<CullTask> tasks;
+  splitCullTasks( tasks, this, camera, depth );
+
+  std::vector<ActorCollection> results( tasks.size() );
+
+  #ifdef VL_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(thread_count)
+  #endif
+  for( int i = 0; i < (int)tasks.size(); ++i )
+  {
+    if ( tasks[i].mSubtree ) {
+      tasks[i].mNode->extractVisibleActors_internal( results[i], camera, enable_mask, false );
+    } else {
+      tasks[i].mNode->extractVisibleNodeActors( results[i], camera, enable_mask, false );
+    }
+  }
+
+  // deterministic merge
+  size_t count = list.size();
+  for( size_t i = 0; i < results.size(); ++i ) {
+    count += results[i].size();
+  }
+  list.reserve( count );
+  for( size_t i = 0; i < results.size(); ++i ) {
+    list.push_back( results[i] );
   }
 }
 //-----------------------------------------------------------------------------
@@ -98,6 +98,16 @@ namespace vl
      */
     void extractVisibleActors(ActorCollection& list, const Camera* camera, unsigned enable_mask=0xFFFFFFFF);
 
+    /**
+     * Multithreaded version of extractVisibleActors() producing exactly the same Actors in exactly the same order.
+     * The upper levels of the tree are split into independent subtrees which are culled concurrently,
+     * each into its own ActorCollection, and the results are then appended to \p list in depth-first order.
+     * Falls back to extractVisibleActors() if only one thread is available, see GlobalSettings::threadCount().
+     * The bounds of the Actors of the nodes not culled are updated serially with Actor::computeBounds() before the concurrent
+     * culling, which only reads them, since Renderables shared by several Actors update their bounds lazily.
+     */
+    void extractVisibleActorsParallel(ActorCollection& list, const Camera* camera, unsigned enable_mask=0xFFFFFFFF);
+
     /**
      * Removes the given Actor from the ActorTreeAbstract.
      */
@@ -128,6 +138,16 @@ namespace vl
     //! \see Actor::enableMask(), Actor::isEnabled(), ActorTreeAbstract::isEnabled(), SceneManager::enableMask(), Rendering::enableMask(), Rendering::effectOverrideMask(), Renderer::enableMask(), Renderer::shaderOverrideMask().
     bool isEnabled() const { return mEnabled; }
 
+  protected:
+    //! Culls and extracts the Actors of this node and of its children, updating the Actors bounds only if \p compute_bounds is \p true.
+    void extractVisibleActors_internal(ActorCollection& list, const Camera* camera, unsigned enable_mask, bool compute_bounds);
+
+    //! Culls and extracts the Actors of this node only, without descending to the children.
+    void extractVisibleNodeActors(ActorCollection& list, const Camera* camera, unsigned enable_mask, bool compute_bounds);
+
+    //! Updates the bounds of the enabled Actors of the nodes not culled by \p camera.
+    void computeVisibleBounds(const Camera* camera, unsigned enable_mask);
+
   protected:
     ActorTreeAbstract* mParent;
     ActorCollection mActors;
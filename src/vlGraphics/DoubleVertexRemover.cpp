@@ -31,6 +31,9 @@
 
 #include <vlGraphics/DoubleVertexRemover.hpp>
 #include <vlCore/Time.hpp>
+#include <vlCore/MurmurHash3.hpp>
+#include <vlCore/GlobalSettings.hpp>
+#include <cmath>
 
 using namespace vl;
 
@@ -84,6 +87,87 @@ namespace
   protected:
     std::vector< const ArrayAbstract* > mAttribs;
   };
+
+  // Raw bytes of the vertex attributes, compared and hashed without virtual calls.
+  class AttribBytes
+  {
+  public:
+    AttribBytes(const Geometry* geom, const ArrayAbstract* skip=NULL)
+    {
+      for(int i=0; i<VA_MaxAttribCount; ++i)
+      {
+        const ArrayAbstract* attrib = geom->vertexAttribArray(i);
+        if (attrib && attrib != skip && attrib->size())
+        {
+          mPtr.push_back(attrib->ptr());
+          mStride.push_back(attrib->bytesUsed() / attrib->size());
+        }
+      }
+    }
+
+    u32 hash(u32 v, u32 seed=0) const
+    {
+      u32 h = seed;
+      for(size_t i=0; i<mPtr.size(); ++i)
+        MurmurHash3_x86_32(mPtr[i] + v*mStride[i], (int)mStride[i], h, &h);
+      return h;
+    }
+
+    bool equal(u32 a, u32 b) const
+    {
+      for(size_t i=0; i<mPtr.size(); ++i)
+        if ( memcmp(mPtr[i] + a*mStride[i], mPtr[i] + b*mStride[i], mStride[i]) != 0 )
+          return false;
+      return true;
+    }
+
+  protected:
+    std::vector<const unsigned char*> mPtr;
+    std::vector<size_t> mStride;
+  };
+
+  inline size_t tableSize(size_t count)
+  {
+    // power of two at least twice the count
+    size_t size = 16;
+    while(size < count * 2)
+      size *= 2;
+    return size;
+  }
+
+  // Finds for each vertex in the list the first one, in list order, with the same attributes.
+  void findFirstEqual(const std::vector<u32>& verts, const std::vector<u32>& hashes, const AttribBytes& attribs, std::vector<u32>& first)
+  {
+    std::vector<u32> table(tableSize(verts.size()), 0xFFFFFFFF);
+    const size_t mask = table.size() - 1;
+    for(size_t i=0; i<verts.size(); ++i)
+    {
+      u32 v = verts[i];
+      for(size_t slot = hashes[v] & mask; ; slot = (slot + 1) & mask)
+      {
+        u32 other = table[slot];
+        if (other == 0xFFFFFFFF)
+        {
+          table[slot] = v;
+          first[v] = v;
+          break;
+        }
+        if ( hashes[other] == hashes[v] && attribs.equal(other, v) )
+        {
+          first[v] = other;
+          break;
+        }
+      }
+    }
+  }
+
+  inline u32 hashCell(const long long cell[3], u32 seed)
+  {
+    u32 h = seed;
+    for(int i=0; i<3; ++i)
+      h = murmurFinalize64( (u64)cell[i] ^ ((u64)h << 32) );
+    return h;
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -221,35 +305,10 @@ void DoubleVertexRemover::removeDoubles(Geometry* geom)
   if (!vert_count)
     return;
 
-  std::vector<u32> verti;
-  verti.resize(vert_count);
-  mMapOldToNew.resize(vert_count);
-
-  for(u32 i=0; i<verti.size(); ++i)
-  {
-    verti[i] = i;
-    mMapOldToNew[i] = 0xFFFFFFFF;
-  }
-
-  std::sort(verti.begin(), verti.end(), LessCompare(geom));
-  EqualsCompare equal_vertex(geom);
-  mMapNewToOld.reserve(vert_count);
-  u32 unique_vert_idx = 0;
-  for(unsigned i=1; i<verti.size(); ++i)
-  {
-    if ( !equal_vertex(verti[unique_vert_idx], verti[i]) )
-    {
-      for(unsigned j=unique_vert_idx; j<i; ++j)
-        mMapOldToNew[verti[j]] = (u32)mMapNewToOld.size();
-      mMapNewToOld.push_back(verti[unique_vert_idx]);
-      unique_vert_idx = i;
-    }
-  }
-  for(unsigned j=unique_vert_idx; j<verti.size(); ++j)
-  {
-    mMapOldToNew[verti[j]] = (u32)mMapNewToOld.size();
-    mMapNewToOld.push_back(verti[unique_vert_idx]);
-  }
+  if (method() == DVRM_Hash)
+    computeMapsHash(geom);
+  else
+    computeMapsSort(geom);
 
   // regenerate vertices
 
@@ -273,6 +332,156 @@ void DoubleVertexRemover::removeDoubles(Geometry* geom)
       de->indexBuffer()->at(i) = mMapOldToNew[it.index()];
   }
 
-  Log::debug( Say("DoubleVertexRemover : time=%.2ns, verts=%n/%n, saved=%n, ratio=%.2n\n") << timer.elapsed() << mMapNewToOld.size() << verti.size() << verti.size() - mMapNewToOld.size() << (float)mMapNewToOld.size()/verti.size() );
+  Log::debug( Say("DoubleVertexRemover : time=%.2ns, verts=%n/%n, saved=%n, ratio=%.2n\n") << timer.elapsed() << mMapNewToOld.size() << vert_count << vert_count - mMapNewToOld.size() << (float)mMapNewToOld.size()/vert_count );
+}
+//-----------------------------------------------------------------------------
+void DoubleVertexRemover::computeMapsSort(Geometry* geom)
+{
+  u32 vert_count = (u32)geom->vertexArray()->size();
+
+  std::vector<u32> verti;
+  verti.resize(vert_count);
+
+  for(u32 i=0; i<verti.size(); ++i)
+    verti[i] = i;
+
+  std::sort(verti.begin(), verti.end(), LessCompare(geom));
+  EqualsCompare equal_vertex(geom);
+
+  // std::sort() is not stable: use the lowest index of each group of equal vertices as its representative
+  // so that the vertices are numbered in order of first appearance exactly like computeMapsHash() does.
+  std::vector<u32> first(vert_count);
+  for(u32 begin=0, end=0; begin<vert_count; begin=end)
+  {
+    u32 lowest = verti[begin];
+    for(end=begin+1; end<vert_count && equal_vertex(verti[begin], verti[end]); ++end)
+      lowest = std::min(lowest, verti[end]);
+    for(u32 j=begin; j<end; ++j)
+      first[verti[j]] = lowest;
+  }
+
+  computeMapsFromFirst(first);
+}
+//-----------------------------------------------------------------------------
+void DoubleVertexRemover::computeMapsFromFirst(const std::vector<u32>& first)
+{
+  const u32 vert_count = (u32)first.size();
+  mMapOldToNew.resize(vert_count);
+  mMapNewToOld.reserve(vert_count);
+  for(u32 i=0; i<vert_count; ++i)
+  {
+    // the first equal vertex precedes or is the vertex itself
+    if (first[i] == i)
+    {
+      mMapOldToNew[i] = (u32)mMapNewToOld.size();
+      mMapNewToOld.push_back(i);
+    }
+    else
+      mMapOldToNew[i] = mMapOldToNew[first[i]];
+  }
+}
+//-----------------------------------------------------------------------------
+void DoubleVertexRemover::computeMapsHash(Geometry* geom)
+{
+  const ArrayAbstract* posarr = geom->vertexArray();
+  const int vert_count = (int)posarr->size();
+  const bool weld = weldEpsilon() > 0;
+
+  // when welding the positions are compared separately from the other attributes
+  AttribBytes attribs(geom, weld ? posarr : NULL);
+
+  int thread_count = globalSettings()->threadCount();
+
+  std::vector<u32> hashes(vert_count);
+#ifdef VL_OPENMP
+  #pragma omp parallel for num_threads(thread_count)
+#endif
+  for(int i=0; i<vert_count; ++i)
+    hashes[i] = attribs.hash(i);
+
+  std::vector<u32> first(vert_count);
+
+  if (!weld)
+  {
+    // shard the vertices by hash, equal vertices always fall in the same shard and keep their relative order
+    int shard_count = vert_count >= 65536 ? thread_count : 1;
+    std::vector< std::vector<u32> > shards(shard_count);
+    for(int i=0; i<vert_count; ++i)
+      shards[ (hashes[i] >> 16) % shard_count ].push_back(i);
+#ifdef VL_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(thread_count)
+#endif
+    for(int s=0; s<shard_count; ++s)
+      findFirstEqual(shards[s], hashes, attribs, first);
+  }
+  else
+  {
+    // welding: positions are bucketed in cells of twice weldEpsilon() side, the matching vertices can only lie in the
+    // cell of the vertex and in the neighboring ones on the side of the nearest cell faces: 8 cells are searched
+
+    const double inv_cell = 0.5 / weldEpsilon();
+    std::vector<fvec3> positions(vert_count);
+    std::vector<long long> cells(vert_count * 3);
+    std::vector<signed char> sides(vert_count * 3);
+    for(int i=0; i<vert_count; ++i)
+    {
+      positions[i] = (fvec3)posarr->getAsVec3(i);
+      for(int k=0; k<3; ++k)
+      {
+        double c = positions[i][k] * inv_cell;
+        cells[i*3+k] = (long long)floor(c);
+        sides[i*3+k] = c - floor(c) < 0.5 ? -1 : +1;
+      }
+    }
+
+    // each table slot points to the last unique vertex of a (cell, attributes) bucket, the others are chained
+    std::vector<u32> table(tableSize(vert_count), 0xFFFFFFFF);
+    std::vector<u32> chain(vert_count, 0xFFFFFFFF);
+    const size_t mask = table.size() - 1;
+    for(int i=0; i<vert_count; ++i)
+    {
+      first[i] = i;
+      u32 match = 0xFFFFFFFF;
+      for(int n=0; n<8 && match == 0xFFFFFFFF; ++n)
+      {
+        long long cell[3] = { cells[i*3+0] + (n & 1 ? sides[i*3+0] : 0), cells[i*3+1] + (n & 2 ? sides[i*3+1] : 0), cells[i*3+2] + (n & 4 ? sides[i*3+2] : 0) };
+        for(size_t slot = hashCell(cell, hashes[i]) & mask; table[slot] != 0xFFFFFFFF; slot = (slot + 1) & mask)
+        {
+          u32 head = table[slot];
+          if ( hashes[head] != hashes[i] || memcmp(&cells[head*3], cell, sizeof(cell)) != 0 || !attribs.equal(head, i) )
+            continue;
+          for(u32 v = head; v != 0xFFFFFFFF && match == 0xFFFFFFFF; v = chain[v])
+          {
+            fvec3 d = positions[v] - positions[i];
+            if ( fabs(d.x()) <= weldEpsilon() && fabs(d.y()) <= weldEpsilon() && fabs(d.z()) <= weldEpsilon() )
+              match = v;
+          }
+          break;
+        }
+      }
+
+      if (match != 0xFFFFFFFF)
+      {
+        first[i] = match;
+        continue;
+      }
+
+      // new unique vertex: push it in the bucket of its own cell
+      const long long* cell = &cells[i*3];
+      size_t slot = hashCell(cell, hashes[i]) & mask;
+      for(; table[slot] != 0xFFFFFFFF; slot = (slot + 1) & mask)
+      {
+        u32 head = table[slot];
+        if ( hashes[head] == hashes[i] && memcmp(&cells[head*3], cell, sizeof(long long)*3) == 0 && attribs.equal(head, i) )
+        {
+          chain[i] = head;
+          break;
+        }
+      }
+      table[slot] = i;
+    }
+  }
+
+  computeMapsFromFirst(first);
 }
 //-----------------------------------------------------------------------------
@@ -60,19 +60,48 @@ namespace vl
   //-----------------------------------------------------------------------------
   //! Removes from a Geometry the vertices with the same attributes.
   //! As a result also all the DrawArrays prensent in the Geometry are substituted with DrawElements.
+  //!
+  //! The DVRM_Hash method hashes the attribute bytes of each vertex with MurmurHash3 and deduplicates the vertices through
+  //! an open addressing table. When VL is compiled with OpenMP support the hashing is done in parallel and the table is
+  //! sharded across GlobalSettings::threadCount() threads, the result does not depend on the number of threads.
+  //! Vertices are considered equal when their attributes are bitwise equal, thus for example 0.0f and -0.0f are kept distinct.
+  //!
+  //! Both methods number the new vertices in order of first appearance in the old vertex array and use the first
+  //! vertex of each group of duplicates as its representative, thus they produce identical maps for the same Geometry.
   class VLGRAPHICS_EXPORT DoubleVertexRemover: public VertexMapper
   {
     VL_INSTRUMENT_CLASS(vl::DoubleVertexRemover, VertexMapper)
 
   public:
-    DoubleVertexRemover() {}
+    DoubleVertexRemover(): mMethod(DVRM_Sort), mWeldEpsilon(0) {}
     void removeDoubles(Geometry* geom);
     const std::vector<u32>& mapNewToOld() const { return mMapNewToOld; }
     const std::vector<u32>& mapOldToNew() const { return mMapOldToNew; }
 
+    //! The strategy used to find the duplicated vertices, the default is DVRM_Sort.
+    void setMethod(EDoubleVertexRemoverMethod method) { mMethod = method; }
+
+    //! The strategy used to find the duplicated vertices, the default is DVRM_Sort.
+    EDoubleVertexRemoverMethod method() const { return mMethod; }
+
+    //! If greater than 0 the DVRM_Hash method welds the vertices whose positions are within the given distance
+    //! along each axis and whose other attributes are equal. The welding is done by a single thread. The default is 0.
+    void setWeldEpsilon(float epsilon) { mWeldEpsilon = epsilon; }
+
+    //! If greater than 0 the DVRM_Hash method welds the vertices whose positions are within the given distance.
+    float weldEpsilon() const { return mWeldEpsilon; }
+
+  protected:
+    void computeMapsSort(Geometry* geom);
+    void computeMapsHash(Geometry* geom);
+    //! Numbers the vertices in order of first appearance given the first equal vertex of each one.
+    void computeMapsFromFirst(const std::vector<u32>& first);
+
   protected:
     std::vector<u32> mMapNewToOld;
     std::vector<u32> mMapOldToNew;
+    EDoubleVertexRemoverMethod mMethod;
+    float mWeldEpsilon;
   };
 }
 
@@ -36,9 +36,176 @@
 #include <vlCore/Log.hpp>
 #include <vlGraphics/Array.hpp>
 #include <vlGraphics/Geometry.hpp>
+#include <vlCore/GlobalSettings.hpp>
+#include <vlCore/MurmurHash3.hpp>
+#include <cstring>
 
 using namespace vl;
 
+namespace
+{
+  inline u32 positionHash(const fvec3& v)
+  {
+    return murmurFinalize64( floatBitsKey(v.x(), v.y(), v.z()) );
+  }
+
+  // Maps each vertex to the first vertex with the same position, as the edges are defined by their end points.
+  void weldVertices(const std::vector<fvec3>& pos, std::vector<u32>& ids)
+  {
+    u32 table_size = 16;
+    while( table_size < pos.size() * 2 )
+      table_size <<= 1;
+    std::vector<u32> table(table_size, 0xFFFFFFFF);
+    ids.resize(pos.size());
+    for(u32 i=0; i<pos.size(); ++i)
+    {
+      for(u32 h = positionHash(pos[i]) & (table_size-1); ; h = (h+1) & (table_size-1))
+      {
+        if (table[h] == 0xFFFFFFFF)
+        {
+          table[h] = i;
+          ids[i] = i;
+          break;
+        }
+        if (pos[table[h]] == pos[i])
+        {
+          ids[i] = table[h];
+          break;
+        }
+      }
+    }
+  }
+
+  // An edge being extracted: its end points and the normals of the first and last triangles sharing it.
+  struct EdgeSlot
+  {
+    u64 mKey;
+    u32 mVertex1;
+    u32 mVertex2;
+    fvec3 mNormal1;
+    fvec3 mNormal2;
+    int mTriangleCount;
+  };
+
+  // Open addressing hash map from the welded vertex ids of an edge to its EdgeSlot.
+  // The slots are stored contiguously in the order in which the edges are first found.
+  class EdgeMap
+  {
+  public:
+    EdgeMap(): mNonManifold(false) {}
+
+    void reserve(size_t edge_count)
+    {
+      mSlots.reserve(edge_count);
+      rehash(edge_count * 2);
+    }
+
+    const std::vector<EdgeSlot>& slots() const { return mSlots; }
+
+    bool nonManifold() const { return mNonManifold; }
+
+    // Adds a triangle's edge, a and b are welded vertex ids.
+    void addEdge(u32 a, u32 b, const fvec3& n)
+    {
+      EdgeSlot& slot = findOrInsert( a < b ? (u64)a << 32 | b : (u64)b << 32 | a );
+      if (slot.mTriangleCount++ == 0)
+      {
+        slot.mVertex1 = a;
+        slot.mVertex2 = b;
+        slot.mNormal1 = n;
+      }
+      else
+      {
+        mNonManifold |= slot.mTriangleCount > 2;
+        slot.mNormal2 = n;
+      }
+    }
+
+    // Merges the edges of another map as if its triangles were added after the ones of this map.
+    void merge(const EdgeMap& other)
+    {
+      mNonManifold |= other.mNonManifold;
+      for(size_t i=0; i<other.mSlots.size(); ++i)
+      {
+        const EdgeSlot& src = other.mSlots[i];
+        EdgeSlot& slot = findOrInsert(src.mKey);
+        if (slot.mTriangleCount == 0)
+          slot = src;
+        else
+        {
+          slot.mNormal2 = src.mTriangleCount > 1 ? src.mNormal2 : src.mNormal1;
+          slot.mTriangleCount += src.mTriangleCount;
+          mNonManifold |= slot.mTriangleCount > 2;
+        }
+      }
+    }
+
+  protected:
+    EdgeSlot& findOrInsert(u64 key)
+    {
+      if ( (mSlots.size() + 1) * 2 > mTable.size() )
+        rehash( mTable.size() * 2 );
+      u32 mask = (u32)mTable.size() - 1;
+      for(u32 h = murmurFinalize64(key) & mask; ; h = (h+1) & mask)
+      {
+        if (mTable[h] == 0xFFFFFFFF)
+        {
+          mTable[h] = (u32)mSlots.size();
+          mSlots.push_back( EdgeSlot() );
+          mSlots.back().mKey = key;
+          mSlots.back().mTriangleCount = 0;
+          return mSlots.back();
+        }
+        if (mSlots[mTable[h]].mKey == key)
+          return mSlots[mTable[h]];
+      }
+    }
+
+    void rehash(size_t min_size)
+    {
+      size_t size = 16;
+      while( size < min_size )
+        size <<= 1;
+      mTable.assign(size, 0xFFFFFFFF);
+      u32 mask = (u32)size - 1;
+      for(u32 i=0; i<mSlots.size(); ++i)
+      {
+        u32 h = murmurFinalize64(mSlots[i].mKey) & mask;
+        while(mTable[h] != 0xFFFFFFFF)
+          h = (h+1) & mask;
+        mTable[h] = i;
+      }
+    }
+
+  protected:
+    std::vector<EdgeSlot> mSlots;
+    std::vector<u32> mTable;
+    bool mNonManifold;
+  };
+
+  void extractDrawCallEdges(const DrawCall* dc, const std::vector<fvec3>& pos, const std::vector<u32>& ids, EdgeMap& edge_map)
+  {
+    edge_map.reserve( dc->countTriangles() * 3 / 2 + 16 );
+    for(TriangleIterator trit = dc->triangleIterator(); trit.hasNext(); trit.next())
+    {
+      size_t a = trit.a();
+      size_t b = trit.b();
+      size_t c = trit.c();
+      if (a == b || b == c || c == a)
+        continue;
+      // compute normal
+      fvec3 v0 = pos[a];
+      fvec3 v1 = pos[b] - v0;
+      fvec3 v2 = pos[c] - v0;
+      fvec3 n = cross(v1,v2).normalize();
+      if (n.isNull())
+        continue;
+      edge_map.addEdge( ids[a], ids[b], n );
+      edge_map.addEdge( ids[b], ids[c], n );
+      edge_map.addEdge( ids[c], ids[a], n );
+    }
+  }
+}
 //-----------------------------------------------------------------------------
 void EdgeExtractor::addEdge(std::set<EdgeExtractor::Edge>& edges, const EdgeExtractor::Edge& e, const fvec3& n)
 {
@@ -66,49 +233,58 @@ void EdgeExtractor::addEdge(std::set<EdgeExtractor::Edge>& edges, const EdgeExtr
 }
 //-----------------------------------------------------------------------------
 //! Extracts the edges from the given Geometry and appends them to edges().
+//! The vertices with the same position are welded and the edges are collected in a hash table, in the order in which
+//! they are first found. When VL is compiled with OpenMP support the draw calls are processed in parallel.
 void EdgeExtractor::extractEdges(Geometry* geom)
 {
   ArrayAbstract* verts = geom->vertexArray();
 
-  // mic fixme:
-  // here the bottle-neck seems to be the continuous allocation/deallocation and insertion/search time,
-  // maybe a memory-pool-managed hash table would help?
   if (!verts)
   {
-    vl::Log::error("EdgeExtractor::extractEdges(geom): 'geom' must have a vertex array of type ArrayFloat3.\n");
+    vl::Log::error("EdgeExtractor::extractEdges(geom): 'geom' must have a vertex array.\n");
     return;
   }
 
-  std::set<Edge> edges;
-
-  // iterate all primitives
-  for(size_t iprim=0; iprim<geom->drawCalls().size(); ++iprim)
+  std::vector<fvec3> pos;
+  if ( const ArrayFloat3* verts3f = verts->as<ArrayFloat3>() )
+    pos.assign( verts3f->begin(), verts3f->end() );
+  else
   {
-    DrawCall* prim = geom->drawCalls().at(iprim);
-    // iterate triangles (if present)
-    for(TriangleIterator trit = prim->triangleIterator(); trit.hasNext(); trit.next())
-    {
-      size_t a = trit.a();
-      size_t b = trit.b();
-      size_t c = trit.c();
-      if (a == b || b == c || c == a)
-        continue;
-      // compute normal
-      fvec3 v0 = (fvec3)verts->getAsVec3(a);
-      fvec3 v1 = (fvec3)verts->getAsVec3(b) - v0;
-      fvec3 v2 = (fvec3)verts->getAsVec3(c) - v0;
-      fvec3 n = cross(v1,v2).normalize();
-      if (n.isNull())
-        continue;
-      addEdge(edges, Edge( (fvec3)verts->getAsVec3(a), (fvec3)verts->getAsVec3(b) ), n );
-      addEdge(edges, Edge( (fvec3)verts->getAsVec3(b), (fvec3)verts->getAsVec3(c) ), n );
-      addEdge(edges, Edge( (fvec3)verts->getAsVec3(c), (fvec3)verts->getAsVec3(a) ), n );
-    }
+    pos.resize(verts->size());
+    for(size_t i=0; i<pos.size(); ++i)
+      pos[i] = (fvec3)verts->getAsVec3(i);
   }
 
-  for(std::set<Edge>::iterator it = edges.begin(); it != edges.end(); ++it)
+  std::vector<u32> ids;
+  weldVertices(pos, ids);
+
+  // one edge map per draw call, merged in order
+  const int dc_count = (int)geom->drawCalls().size();
+  std::vector<EdgeMap> edge_maps(dc_count);
+  int thread_count = globalSettings()->threadCount();
+#ifdef VL_OPENMP
+  #pragma omp parallel for schedule(dynamic) num_threads(thread_count)
+#endif
+  for(int idc=0; idc<dc_count; ++idc)
+    extractDrawCallEdges( geom->drawCalls().at(idc), pos, ids, edge_maps[idc] );
+
+  for(int idc=1; idc<dc_count; ++idc)
+    edge_maps[0].merge( edge_maps[idc] );
+
+  if (edge_maps.empty())
+    return;
+
+  if (mWarnNonManifold && edge_maps[0].nonManifold())
+    vl::Log::error("EdgeExtractor: non-manifold mesh detected!\n");
+
+  const std::vector<EdgeSlot>& slots = edge_maps[0].slots();
+  mEdges.reserve( mEdges.size() + slots.size() );
+  for(size_t i=0; i<slots.size(); ++i)
   {
-    Edge e = *it;
+    Edge e( pos[slots[i].mVertex1], pos[slots[i].mVertex2] );
+    e.setNormal1( slots[i].mNormal1 );
+    if (slots[i].mTriangleCount > 1)
+      e.setNormal2( slots[i].mNormal2 );
     // boundary edge
     if (e.normal2().isNull())
       e.setIsCrease(true);
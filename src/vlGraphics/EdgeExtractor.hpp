@@ -160,6 +160,7 @@ namespace vl
     void setWarnNonManifold(bool warn_on) { mWarnNonManifold = warn_on; }
 
   protected:
+    //! Adds a triangle's edge to a set of edges keyed by position, kept for subclasses: extractEdges() no longer uses it.
     void addEdge(std::set<EdgeExtractor::Edge>& edges, const EdgeExtractor::Edge& e, const fvec3& n);
 
   protected:
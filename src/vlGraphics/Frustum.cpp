@@ -0,0 +1,272 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+#include <vlGraphics/Frustum.hpp>
+#include <vlCore/simd.hpp>
+#include <cstring>
+#include <cmath>
+
+using namespace vl;
+
+namespace
+{
+  // Relative slack applied to the single precision distances so that rounding (including the conversion of the
+  // planes from double precision) can only keep objects, never cull visible ones. The rounding error of
+  // n.c - o is bounded by a few ulps of |nx*cx| + |ny*cy| + |nz*cz| + |o|, which is never smaller than |d|.
+  const float CullSlack = 1e-5f;
+
+  // Up to 16 frustum planes converted to single precision SoA, larger frusta are processed in more passes.
+  struct PlaneBatch
+  {
+    enum { MaxPlanes = 16 };
+
+    PlaneBatch(const std::vector<Plane>& planes, size_t first)
+    {
+      mCount = 0;
+      for( size_t i = first; i < planes.size() && mCount < MaxPlanes; ++i, ++mCount )
+      {
+        mNX[mCount] = (float)planes[i].normal().x();
+        mNY[mCount] = (float)planes[i].normal().y();
+        mNZ[mCount] = (float)planes[i].normal().z();
+        mO[mCount]  = (float)planes[i].origin();
+      }
+    }
+
+    int mCount;
+    float mNX[MaxPlanes];
+    float mNY[MaxPlanes];
+    float mNZ[MaxPlanes];
+    float mO[MaxPlanes];
+  };
+
+  // Sets the bits of the spheres that are outside at least one plane of the batch. Null spheres are never culled.
+  void cullSpheresBatch(const PlaneBatch& b, int count, const float* cx, const float* cy, const float* cz, const float* r, u32* culled)
+  {
+    int i = 0;
+
+#if defined(VL_SIMD_AVX)
+    const __m256 zero8 = _mm256_setzero_ps();
+    const __m256 sign8 = _mm256_set1_ps( -0.0f );
+    const __m256 slack8 = _mm256_set1_ps( CullSlack );
+    for( ; i + 8 <= count; i += 8 )
+    {
+      __m256 x   = _mm256_loadu_ps( cx + i );
+      __m256 y   = _mm256_loadu_ps( cy + i );
+      __m256 z   = _mm256_loadu_ps( cz + i );
+      __m256 rad = _mm256_loadu_ps( r + i );
+      __m256 out = zero8;
+      for( int p = 0; p < b.mCount; ++p )
+      {
+        __m256 tx = _mm256_mul_ps( x, _mm256_set1_ps( b.mNX[p] ) );
+        __m256 ty = _mm256_mul_ps( y, _mm256_set1_ps( b.mNY[p] ) );
+        __m256 tz = _mm256_mul_ps( z, _mm256_set1_ps( b.mNZ[p] ) );
+        __m256 o  = _mm256_set1_ps( b.mO[p] );
+        __m256 d  = _mm256_sub_ps( _mm256_add_ps( _mm256_add_ps( tx, ty ), tz ), o );
+        __m256 mag = _mm256_add_ps( _mm256_add_ps( _mm256_andnot_ps( sign8, tx ), _mm256_andnot_ps( sign8, ty ) ),
+                                    _mm256_add_ps( _mm256_andnot_ps( sign8, tz ), _mm256_andnot_ps( sign8, o ) ) );
+        __m256 eps = _mm256_mul_ps( _mm256_add_ps( mag, _mm256_andnot_ps( sign8, rad ) ), slack8 );
+        out = _mm256_or_ps( out, _mm256_cmp_ps( _mm256_sub_ps( d, eps ), rad, _CMP_GT_OQ ) );
+      }
+      out = _mm256_andnot_ps( _mm256_cmp_ps( rad, zero8, _CMP_LT_OQ ), out );
+      culled[i >> 5] |= (u32)_mm256_movemask_ps( out ) << ( i & 31 );
+    }
+#endif
+
+#if defined(VL_SIMD_SSE2)
+    const __m128 zero4 = _mm_setzero_ps();
+    const __m128 sign4 = _mm_set1_ps( -0.0f );
+    const __m128 slack4 = _mm_set1_ps( CullSlack );
+    for( ; i + 4 <= count; i += 4 )
+    {
+      __m128 x   = _mm_loadu_ps( cx + i );
+      __m128 y   = _mm_loadu_ps( cy + i );
+      __m128 z   = _mm_loadu_ps( cz + i );
+      __m128 rad = _mm_loadu_ps( r + i );
+      __m128 out = zero4;
+      for( int p = 0; p < b.mCount; ++p )
+      {
+        __m128 tx = _mm_mul_ps( x, _mm_set1_ps( b.mNX[p] ) );
+        __m128 ty = _mm_mul_ps( y, _mm_set1_ps( b.mNY[p] ) );
+        __m128 tz = _mm_mul_ps( z, _mm_set1_ps( b.mNZ[p] ) );
+        __m128 o  = _mm_set1_ps( b.mO[p] );
+        __m128 d  = _mm_sub_ps( _mm_add_ps( _mm_add_ps( tx, ty ), tz ), o );
+        __m128 mag = _mm_add_ps( _mm_add_ps( _mm_andnot_ps( sign4, tx ), _mm_andnot_ps( sign4, ty ) ),
+                                 _mm_add_ps( _mm_andnot_ps( sign4, tz ), _mm_andnot_ps( sign4, o ) ) );
+        __m128 eps = _mm_mul_ps( _mm_add_ps( mag, _mm_andnot_ps( sign4, rad ) ), slack4 );
+        out = _mm_or_ps( out, _mm_cmpgt_ps( _mm_sub_ps( d, eps ), rad ) );
+      }
+      out = _mm_andnot_ps( _mm_cmplt_ps( rad, zero4 ), out );
+      culled[i >> 5] |= (u32)_mm_movemask_ps( out ) << ( i & 31 );
+    }
+#endif
+
+    for( ; i < count; ++i )
+    {
+      if ( r[i] < 0 ) {
+        continue;
+      }
+      for( int p = 0; p < b.mCount; ++p )
+      {
+        float tx = cx[i] * b.mNX[p];
+        float ty = cy[i] * b.mNY[p];
+        float tz = cz[i] * b.mNZ[p];
+        float d = tx + ty + tz - b.mO[p];
+        float eps = ( fabsf( tx ) + fabsf( ty ) + fabsf( tz ) + fabsf( b.mO[p] ) + r[i] ) * CullSlack;
+        if ( d - eps > r[i] )
+        {
+          culled[i >> 5] |= 1u << ( i & 31 );
+          break;
+        }
+      }
+    }
+  }
+
+  // Sets the bits of the boxes that are completely outside at least one plane of the batch. Null boxes are never culled.
+  void cullAABBsBatch(const PlaneBatch& b, int count, const float* min_x, const float* min_y, const float* min_z, const float* max_x, const float* max_y, const float* max_z, u32* culled)
+  {
+    int i = 0;
+
+#if defined(VL_SIMD_AVX)
+    const __m256 sign8 = _mm256_set1_ps( -0.0f );
+    const __m256 slack8 = _mm256_set1_ps( CullSlack );
+    for( ; i + 8 <= count; i += 8 )
+    {
+      __m256 mnx = _mm256_loadu_ps( min_x + i );
+      __m256 mny = _mm256_loadu_ps( min_y + i );
+      __m256 mnz = _mm256_loadu_ps( min_z + i );
+      __m256 mxx = _mm256_loadu_ps( max_x + i );
+      __m256 mxy = _mm256_loadu_ps( max_y + i );
+      __m256 mxz = _mm256_loadu_ps( max_z + i );
+      __m256 out = _mm256_setzero_ps();
+      for( int p = 0; p < b.mCount; ++p )
+      {
+        // the corner nearest to the plane's negative side
+        __m256 tx = _mm256_mul_ps( b.mNX[p] >= 0 ? mnx : mxx, _mm256_set1_ps( b.mNX[p] ) );
+        __m256 ty = _mm256_mul_ps( b.mNY[p] >= 0 ? mny : mxy, _mm256_set1_ps( b.mNY[p] ) );
+        __m256 tz = _mm256_mul_ps( b.mNZ[p] >= 0 ? mnz : mxz, _mm256_set1_ps( b.mNZ[p] ) );
+        __m256 o  = _mm256_set1_ps( b.mO[p] );
+        __m256 d  = _mm256_sub_ps( _mm256_add_ps( _mm256_add_ps( tx, ty ), tz ), o );
+        __m256 mag = _mm256_add_ps( _mm256_add_ps( _mm256_andnot_ps( sign8, tx ), _mm256_andnot_ps( sign8, ty ) ),
+                                    _mm256_add_ps( _mm256_andnot_ps( sign8, tz ), _mm256_andnot_ps( sign8, o ) ) );
+        out = _mm256_or_ps( out, _mm256_cmp_ps( d, _mm256_mul_ps( mag, slack8 ), _CMP_GT_OQ ) );
+      }
+      __m256 null = _mm256_or_ps( _mm256_or_ps( _mm256_cmp_ps( mnx, mxx, _CMP_GT_OQ ), _mm256_cmp_ps( mny, mxy, _CMP_GT_OQ ) ), _mm256_cmp_ps( mnz, mxz, _CMP_GT_OQ ) );
+      out = _mm256_andnot_ps( null, out );
+      culled[i >> 5] |= (u32)_mm256_movemask_ps( out ) << ( i & 31 );
+    }
+#endif
+
+#if defined(VL_SIMD_SSE2)
+    const __m128 sign4 = _mm_set1_ps( -0.0f );
+    const __m128 slack4 = _mm_set1_ps( CullSlack );
+    for( ; i + 4 <= count; i += 4 )
+    {
+      __m128 mnx = _mm_loadu_ps( min_x + i );
+      __m128 mny = _mm_loadu_ps( min_y + i );
+      __m128 mnz = _mm_loadu_ps( min_z + i );
+      __m128 mxx = _mm_loadu_ps( max_x + i );
+      __m128 mxy = _mm_loadu_ps( max_y + i );
+      __m128 mxz = _mm_loadu_ps( max_z + i );
+      __m128 out = _mm_setzero_ps();
+      for( int p = 0; p < b.mCount; ++p )
+      {
+        // the corner nearest to the plane's negative side
+        __m128 tx = _mm_mul_ps( b.mNX[p] >= 0 ? mnx : mxx, _mm_set1_ps( b.mNX[p] ) );
+        __m128 ty = _mm_mul_ps( b.mNY[p] >= 0 ? mny : mxy, _mm_set1_ps( b.mNY[p] ) );
+        __m128 tz = _mm_mul_ps( b.mNZ[p] >= 0 ? mnz : mxz, _mm_set1_ps( b.mNZ[p] ) );
+        __m128 o  = _mm_set1_ps( b.mO[p] );
+        __m128 d  = _mm_sub_ps( _mm_add_ps( _mm_add_ps( tx, ty ), tz ), o );
+        __m128 mag = _mm_add_ps( _mm_add_ps( _mm_andnot_ps( sign4, tx ), _mm_andnot_ps( sign4, ty ) ),
+                                 _mm_add_ps( _mm_andnot_ps( sign4, tz ), _mm_andnot_ps( sign4, o ) ) );
+        out = _mm_or_ps( out, _mm_cmpgt_ps( d, _mm_mul_ps( mag, slack4 ) ) );
+      }
+      __m128 null = _mm_or_ps( _mm_or_ps( _mm_cmpgt_ps( mnx, mxx ), _mm_cmpgt_ps( mny, mxy ) ), _mm_cmpgt_ps( mnz, mxz ) );
+      out = _mm_andnot_ps( null, out );
+      culled[i >> 5] |= (u32)_mm_movemask_ps( out ) << ( i & 31 );
+    }
+#endif
+
+    for( ; i < count; ++i )
+    {
+      if ( min_x[i] > max_x[i] || min_y[i] > max_y[i] || min_z[i] > max_z[i] ) {
+        continue;
+      }
+      for( int p = 0; p < b.mCount; ++p )
+      {
+        float tx = ( b.mNX[p] >= 0 ? min_x[i] : max_x[i] ) * b.mNX[p];
+        float ty = ( b.mNY[p] >= 0 ? min_y[i] : max_y[i] ) * b.mNY[p];
+        float tz = ( b.mNZ[p] >= 0 ? min_z[i] : max_z[i] ) * b.mNZ[p];
+        float d = tx + ty + tz - b.mO[p];
+        float eps = ( fabsf( tx ) + fabsf( ty ) + fabsf( tz ) + fabsf( b.mO[p] ) ) * CullSlack;
+        if ( d > eps )
+        {
+          culled[i >> 5] |= 1u << ( i & 31 );
+          break;
+        }
+      }
+    }
+  }
+
+  // Turns the culled bits into visible bits, leaving the unused bits of the last word cleared.
+  void invertMask(int count, u32* mask)
+  {
+    int words = ( count + 31 ) / 32;
+    for( int w = 0; w < words; ++w ) {
+      mask[w] = ~mask[w];
+    }
+    if ( count & 31 ) {
+      mask[words - 1] &= ( 1u << ( count & 31 ) ) - 1;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void Frustum::cullSpheres(int count, const float* center_x, const float* center_y, const float* center_z, const float* radius, u32* visible) const
+{
+  memset( visible, 0, sizeof(u32) * ( ( count + 31 ) / 32 ) );
+  for( size_t first = 0; first < planes().size(); first += PlaneBatch::MaxPlanes )
+  {
+    PlaneBatch batch( planes(), first );
+    cullSpheresBatch( batch, count, center_x, center_y, center_z, radius, visible );
+  }
+  invertMask( count, visible );
+}
+//-----------------------------------------------------------------------------
+void Frustum::cullAABBs(int count, const float* min_x, const float* min_y, const float* min_z, const float* max_x, const float* max_y, const float* max_z, u32* visible) const
+{
+  memset( visible, 0, sizeof(u32) * ( ( count + 31 ) / 32 ) );
+  for( size_t first = 0; first < planes().size(); first += PlaneBatch::MaxPlanes )
+  {
+    PlaneBatch batch( planes(), first );
+    cullAABBsBatch( batch, count, min_x, min_y, min_z, max_x, max_y, max_z, visible );
+  }
+  invertMask( count, visible );
+}
+//-----------------------------------------------------------------------------
@@ -32,6 +32,7 @@
 #ifndef Frustum_INCLUDE_ONCE
 #define Frustum_INCLUDE_ONCE
 
+#include <vlGraphics/link_config.hpp>
 #include <vlCore/Plane.hpp>
 #include <vlCore/AABB.hpp>
 #include <vlCore/Sphere.hpp>
@@ -46,7 +47,7 @@ namespace vl
    *
    * \sa Camera, Viewport
   */
-  class Frustum: public Object
+  class VLGRAPHICS_EXPORT Frustum: public Object
   {
     VL_INSTRUMENT_CLASS(vl::Frustum, Object)
 
@@ -96,6 +97,24 @@ namespace vl
       return false;
     }
 
+    /**
+     * Tests \p count spheres at once against the frustum planes.
+     * The spheres are given in SoA layout as single precision arrays, a negative radius denotes a null sphere.
+     * On return bit \p i%32 of \p visible[i/32] is set if the i-th sphere is not culled, following the same rules as cull(const Sphere&).
+     * \p visible must provide room for (count+31)/32 words.
+     * Uses SSE2/AVX kernels when available, see vlCore/simd.hpp.
+     */
+    void cullSpheres(int count, const float* center_x, const float* center_y, const float* center_z, const float* radius, u32* visible) const;
+
+    /**
+     * Tests \p count axis aligned boxes at once against the frustum planes.
+     * The boxes are given in SoA layout as single precision arrays, a box whose min corner is greater than its max corner is null.
+     * On return bit \p i%32 of \p visible[i/32] is set if the i-th box is not culled, following the same rules as cull(const AABB&).
+     * \p visible must provide room for (count+31)/32 words.
+     * Uses SSE2/AVX kernels when available, see vlCore/simd.hpp.
+     */
+    void cullAABBs(int count, const float* min_x, const float* min_y, const float* min_z, const float* max_x, const float* max_y, const float* max_z, u32* visible) const;
+
   protected:
     std::vector<Plane> mPlanes;
   };
@@ -284,6 +284,9 @@ GLSLProgram::GLSLProgram()
   mHandle = 0;
   mProgramBinaryRetrievableHint = false;
   mProgramSeparable = false;
+  mUniformDeltaBinding = false;
+  mMaxShadowCount = 1;
+  resetUniformStats();
 
   resetBindingLocations();
 }
@@ -302,6 +305,10 @@ void GLSLProgram::resetBindingLocations()
   m_vl_ModelViewProjectionMatrix = -1;
   m_vl_NormalMatrix = -1;
 
+  // user uniform binding
+  mUniformLocations.clear();
+  invalidateUniformShadows();
+
   // vertex attrib binding
   m_vl_VertexPosition = -1;
   m_vl_VertexNormal = -1;
@@ -553,6 +560,10 @@ void GLSLProgram::postLink()
   m_vl_ModelViewProjectionMatrix = glGetUniformLocation(handle(), "vl_ModelViewProjectionMatrix");
   m_vl_NormalMatrix              = glGetUniformLocation(handle(), "vl_NormalMatrix");
 
+  // track user uniforms
+
+  buildUniformLocationTable();
+
   // track vertex attribute bindings
 
   m_vl_VertexPosition       = glGetAttribLocation( handle(), "vl_VertexPosition" );
@@ -573,6 +584,108 @@ void GLSLProgram::postLink()
   m_vl_VertexTexCoord10     = glGetAttribLocation( handle(), "vl_VertexTexCoord10" );
 }
 //-----------------------------------------------------------------------------
+void GLSLProgram::buildUniformLocationTable()
+{
+  VL_CHECK_OGL();
+
+  mUniformLocations.clear();
+
+  // linking resets all the uniform values
+  invalidateUniformShadows();
+
+  int uniform_count = 0;
+  int max_length = 0;
+  glGetProgramiv(handle(), GL_ACTIVE_UNIFORMS, &uniform_count); VL_CHECK_OGL();
+  glGetProgramiv(handle(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length); VL_CHECK_OGL();
+  if (uniform_count == 0 || max_length == 0)
+    return;
+
+  std::vector<char> name_buffer;
+  name_buffer.resize(max_length + 1);
+  for(int i=0; i<uniform_count; ++i)
+  {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(handle(), i, max_length, &length, &size, &type, &name_buffer[0]); VL_CHECK_OGL();
+    std::string name(&name_buffer[0], length);
+    int location = glGetUniformLocation(handle(), name.c_str()); VL_CHECK_OGL();
+    if (location == -1)
+      continue;
+
+    int id = Uniform::nameToId(name);
+    if (id >= (int)mUniformLocations.size())
+      mUniformLocations.resize(id+1, -2);
+    mUniformLocations[id] = location;
+
+    // arrays are reported as "name[0]" but can also be addressed as "name"
+    if (name.size() > 3 && name.compare(name.size()-3, 3, "[0]") == 0)
+    {
+      id = Uniform::nameToId(name.substr(0, name.size()-3));
+      if (id >= (int)mUniformLocations.size())
+        mUniformLocations.resize(id+1, -2);
+      mUniformLocations[id] = location;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+int GLSLProgram::uniformLocation(const Uniform* uniform) const
+{
+  int id = uniform->nameId();
+  if (id >= (int)mUniformLocations.size())
+    mUniformLocations.resize(Uniform::nameIdCount(), -2);
+
+  int& location = mUniformLocations[id];
+  if (location == -2)
+  {
+    // not among the active uniforms listed at link time: query it once
+    location = glGetUniformLocation(handle(), uniform->name().c_str()); VL_CHECK_OGL();
+    ++mStatsUniformLocationsQueried;
+  }
+  else
+  {
+    ++mStatsUniformLocationsCached;
+  }
+
+  return location;
+}
+//-----------------------------------------------------------------------------
+void GLSLProgram::invalidateUniformShadow(int location, int count) const
+{
+  if (mUniformShadows.empty() || location < 0)
+    return;
+
+  count = count > 1 ? count : 1;
+
+  // shadows starting before location can cover it only if they span up to mMaxShadowCount locations
+  std::map<int, UniformShadow>::iterator it  = mUniformShadows.lower_bound(location - mMaxShadowCount + 1);
+  std::map<int, UniformShadow>::iterator end = mUniformShadows.lower_bound(location + count);
+  while(it != end)
+  {
+    if (it->first + it->second.mCount > location)
+      mUniformShadows.erase(it++);
+    else
+      ++it;
+  }
+}
+//-----------------------------------------------------------------------------
+GLSLProgram::UniformShadow& GLSLProgram::uniformShadow(int location, int count) const
+{
+  count = count > 1 ? count : 1;
+
+  // shadows never overlap: an entry at the same location covering the same range can be reused as is
+  std::map<int, UniformShadow>::iterator it = mUniformShadows.find(location);
+  if (it != mUniformShadows.end() && it->second.mCount == count)
+    return it->second;
+
+  // eg. "arr" and "arr[0]" share the same location: drop whatever overlaps the new range
+  invalidateUniformShadow(location, count);
+  mMaxShadowCount = count > mMaxShadowCount ? count : mMaxShadowCount;
+  UniformShadow& shadow = mUniformShadows[location];
+  shadow.mCount = count;
+  return shadow;
+}
+//-----------------------------------------------------------------------------
 bool GLSLProgram::linkStatus() const
 {
   VL_CHECK_OGL();
@@ -701,14 +814,32 @@ bool GLSLProgram::applyUniformSet(const UniformSet* uniforms) const
       }
       #endif
     #else
-      int location = glGetUniformLocation(handle(), uniform->name().c_str());
+      int location = uniformLocation(uniform);
       if (location == -1) {
         continue;
       }
     #endif
 
+    // per-uniform delta binding: skip values already transmitted to this location
+
+    if ( mUniformDeltaBinding && uniform->mType != UT_NONE )
+    {
+      // compare the bytes: the values can also be written through Uniform::rawData()
+      UniformShadow& shadow = uniformShadow(location, uniform->count());
+      if ( shadow.mType == uniform->mType && shadow.mData == uniform->mData ) {
+        ++mStatsUniformsSkipped;
+        continue;
+      }
+      // the storage is reserved by the first upload and reused by the following ones
+      if (shadow.mType == UT_NONE)
+        shadow.mData.reserve( uniform->mData.size() );
+      shadow.mType = uniform->mType;
+      shadow.mData.assign( uniform->mData.begin(), uniform->mData.end() );
+    }
+
+    ++mStatsUniformsIssued;
+
     // finally transmits the uniform
-    // note: we don't perform delta binding per-uniform variable at the moment!
 
     VL_CHECK_OGL();
     switch(uniform->mType)
@@ -227,13 +227,16 @@ namespace vl
    *
    * \par Uniforms
    * You have 5 ways to set the value of a uniform:
-   * -# call OpenGLContext::useGLSLProgram() to activate the GLSLProgram and directly call glUniform* (see also getUniformLocation()).
+   * -# call OpenGLContext::useGLSLProgram() to activate the GLSLProgram and call the setUniform*() functions taking a location (see also getUniformLocation()).
    * -# add a Uniform to the GLSLProgram UniformSet, see vl::GLSLProgram::getUniformSet().
    * -# add a Uniform to the Actor's UniformSet, see vl::Actor::getUniformSet().
    * -# add a Uniform to the Actor's Shader UniformSet, see vl::Shader::getUniformSet().
-   * -# directly update the uniform value from ActorEventCallback::onActorRenderStarted() using the standard glUniform*() OpenGL functions.
+   * -# directly update the uniform value from ActorEventCallback::onActorRenderStarted() using the GLSLProgram::setUniform*() functions taking a location.
    *    In this case you have to make sure that <i>all</i> the Actors using a given GLSLProgram/Shader write such uniform.
    *
+   * If you call the glUniform*() OpenGL functions directly for options #1 and #5 while uniform delta binding is enabled you must call
+   * invalidateUniformShadow() afterwards, see setUniformDeltaBinding().
+   *
    * \remarks
    * A Uniform must be setup using <i>one and only one</i> of the 5 previously mentioned methods.
    *
@@ -433,6 +436,96 @@ namespace vl
       return location;
     }
 
+    /**
+     * Returns the binding location of the given Uniform using the per-program location table built at link time.
+     * Uniforms not listed among the active uniforms (for example single array elements like "lights[1].position")
+     * are queried once with glGetUniformLocation() and then cached as well.
+     * Returns -1 if the uniform is not used by the program.
+    */
+    int uniformLocation(const Uniform* uniform) const;
+
+    //! Number of uniform locations served by the location table since the last resetUniformStats(), ie. glGetUniformLocation() calls saved.
+    int statsUniformLocationsCached() const { return mStatsUniformLocationsCached; }
+
+    //! Number of glGetUniformLocation() calls issued by uniformLocation() since the last resetUniformStats().
+    int statsUniformLocationsQueried() const { return mStatsUniformLocationsQueried; }
+
+    /**
+     * Enables/disables per-uniform delta binding (disabled by default).
+     * When enabled the GLSLProgram keeps a shadow copy of the last value uploaded to each uniform location and
+     * applyUniformSet() skips the glUniform* call if the bytes of the Uniform's value are the same, including the values written through Uniform::rawData().
+     * The setUniform*() functions taking a location keep the shadow up to date.
+     * \note If you update a uniform directly via glUniform*() call invalidateUniformShadow() afterwards.
+    */
+    void setUniformDeltaBinding(bool enable) { mUniformDeltaBinding = enable; invalidateUniformShadows(); }
+
+    //! Whether per-uniform delta binding is enabled, see setUniformDeltaBinding().
+    bool uniformDeltaBinding() const { return mUniformDeltaBinding; }
+
+    //! Forgets the last uploaded uniform values so that the next applyUniformSet() will transmit all of them.
+    void invalidateUniformShadows() const { mUniformShadows.clear(); mMaxShadowCount = 1; }
+
+    //! Forgets the last uploaded values of the uniform locations from \p location to \p location + \p count - 1,
+    //! including the arrays overlapping them. Call this after updating a uniform via glUniform*() when delta binding is enabled.
+    void invalidateUniformShadow(int location, int count=1) const;
+
+    //! Number of glUniform* calls skipped by delta binding since the last resetUniformStats().
+    int statsUniformsSkipped() const { return mStatsUniformsSkipped; }
+
+    //! Number of glUniform* calls issued by applyUniformSet() since the last resetUniformStats().
+    int statsUniformsIssued() const { return mStatsUniformsIssued; }
+
+    //! Resets the uniform statistics counters, see also Renderer::statsUniformLocationsCached() and Renderer::statsUniformsSkipped().
+    void resetUniformStats() const
+    {
+      mStatsUniformLocationsCached = 0;
+      mStatsUniformLocationsQueried = 0;
+      mStatsUniformsSkipped = 0;
+      mStatsUniformsIssued = 0;
+    }
+
+    // --------------- uniform variables: setters ---------------
+
+    // glUniform* wrappers: they require the GLSLProgram to be bound, see OpenGLContext::useGLSLProgram(),
+    // and keep the delta binding shadow consistent, see setUniformDeltaBinding().
+
+    //! Equivalent to glUniform1fv(location, count, value)
+    void setUniform1fv(int location, int count, const float* value) const { invalidateUniformShadow(location, count); glUniform1fv(location, count, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniform2fv(location, count, value)
+    void setUniform2fv(int location, int count, const float* value) const { invalidateUniformShadow(location, count); glUniform2fv(location, count, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniform3fv(location, count, value)
+    void setUniform3fv(int location, int count, const float* value) const { invalidateUniformShadow(location, count); glUniform3fv(location, count, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniform4fv(location, count, value)
+    void setUniform4fv(int location, int count, const float* value) const { invalidateUniformShadow(location, count); glUniform4fv(location, count, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniform1iv(location, count, value)
+    void setUniform1iv(int location, int count, const int* value) const { invalidateUniformShadow(location, count); glUniform1iv(location, count, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniform2iv(location, count, value)
+    void setUniform2iv(int location, int count, const int* value) const { invalidateUniformShadow(location, count); glUniform2iv(location, count, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniform3iv(location, count, value)
+    void setUniform3iv(int location, int count, const int* value) const { invalidateUniformShadow(location, count); glUniform3iv(location, count, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniform4iv(location, count, value)
+    void setUniform4iv(int location, int count, const int* value) const { invalidateUniformShadow(location, count); glUniform4iv(location, count, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniformMatrix2fv(location, count, GL_FALSE, value)
+    void setUniformMatrix2fv(int location, int count, const float* value) const { invalidateUniformShadow(location, count); glUniformMatrix2fv(location, count, GL_FALSE, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniformMatrix3fv(location, count, GL_FALSE, value)
+    void setUniformMatrix3fv(int location, int count, const float* value) const { invalidateUniformShadow(location, count); glUniformMatrix3fv(location, count, GL_FALSE, value); VL_CHECK_OGL() }
+    //! Equivalent to glUniformMatrix4fv(location, count, GL_FALSE, value)
+    void setUniformMatrix4fv(int location, int count, const float* value) const { invalidateUniformShadow(location, count); glUniformMatrix4fv(location, count, GL_FALSE, value); VL_CHECK_OGL() }
+
+    // utility functions for float, int, fvec2, fvec3, fvec4, ivec2, ivec3, ivec4, fmat2, fmat3, fmat4
+
+    void setUniform(int location, float value) const { setUniform1fv(location, 1, &value); }
+    void setUniform(int location, int value) const { setUniform1iv(location, 1, &value); }
+    void setUniform(int location, const fvec2& vec) const { setUniform2fv(location, 1, vec.ptr()); }
+    void setUniform(int location, const fvec3& vec) const { setUniform3fv(location, 1, vec.ptr()); }
+    void setUniform(int location, const fvec4& vec) const { setUniform4fv(location, 1, vec.ptr()); }
+    void setUniform(int location, const fmat2& mat) const { setUniformMatrix2fv(location, 1, mat.ptr()); }
+    void setUniform(int location, const fmat3& mat) const { setUniformMatrix3fv(location, 1, mat.ptr()); }
+    void setUniform(int location, const fmat4& mat) const { setUniformMatrix4fv(location, 1, mat.ptr()); }
+    void setUniform(int location, const ivec2& vec) const { setUniform2iv(location, 1, vec.ptr()); }
+    void setUniform(int location, const ivec3& vec) const { setUniform3iv(location, 1, vec.ptr()); }
+    void setUniform(int location, const ivec4& vec) const { setUniform4iv(location, 1, vec.ptr()); }
+
     // --------------- uniform variables: getters ---------------
 
     // general uniform getters: use these to access to all the types supported by your GLSL implementation,
@@ -548,6 +641,7 @@ namespace vl
     void postLink();
     void operator=(const GLSLProgram&) { }
     void resetBindingLocations();
+    void buildUniformLocationTable();
 
   protected:
     std::vector< ref<GLSLShader> > mShaders;
@@ -568,6 +662,26 @@ namespace vl
     int m_vl_ModelViewProjectionMatrix;
     int m_vl_NormalMatrix;
 
+    // uniform locations indexed by Uniform::nameId(), -2 = not yet queried
+    mutable std::vector<int> mUniformLocations;
+    mutable int mStatsUniformLocationsCached;
+    mutable int mStatsUniformLocationsQueried;
+
+    // last uniform values uploaded indexed by uniform location, an array covers mCount consecutive locations
+    struct UniformShadow
+    {
+      UniformShadow(): mType(UT_NONE), mCount(0) {}
+      EUniformType mType;
+      int mCount;
+      std::vector<int> mData;
+    };
+    UniformShadow& uniformShadow(int location, int count) const;
+    mutable std::map<int, UniformShadow> mUniformShadows;
+    mutable int mMaxShadowCount;
+    mutable int mStatsUniformsSkipped;
+    mutable int mStatsUniformsIssued;
+    bool mUniformDeltaBinding;
+
     // VL standard vertex attributes
 
     int m_vl_VertexPosition;
@@ -32,13 +32,249 @@
 #include <vlGraphics/Geometry.hpp>
 #include <vlGraphics/OpenGLContext.hpp>
 #include <vlGraphics/DoubleVertexRemover.hpp>
+#include <vlGraphics/VertexCacheOptimizer.hpp>
 #include <vlGraphics/MultiDrawElements.hpp>
 #include <vlGraphics/DrawRangeElements.hpp>
+#include <vlCore/simd.hpp>
 #include <cmath>
+#include <cfloat>
 #include <algorithm>
 
 using namespace vl;
 
+namespace
+{
+  // Index accessors used by the typed kernels below in place of the virtual IndexIterator and TriangleIterator.
+
+  // The indices of a DrawArrays.
+  struct SequentialIndices
+  {
+    SequentialIndices(u32 start): mStart(start) {}
+    u32 operator[](size_t i) const { return mStart + (u32)i; }
+    u32 mStart;
+  };
+
+  // The indices of a DrawElementsUInt/UShort/UByte.
+  template<class index_type>
+  struct ElementIndices
+  {
+    ElementIndices(const index_type* indices, int base_vertex): mIndices(indices), mBaseVertex(base_vertex) {}
+    u32 operator[](size_t i) const { return (u32)(mIndices[i] + mBaseVertex); }
+    const index_type* mIndices;
+    int mBaseVertex;
+  };
+
+  template<class TDrawElements, class TKernel>
+  bool dispatchElements(const TDrawElements* de, TKernel& kernel)
+  {
+    if ( de->primitiveRestartEnabled() )
+      return false;
+    if ( de->indexBuffer()->size() )
+    {
+      typedef typename TDrawElements::index_type index_type;
+      kernel( ElementIndices<index_type>( de->indexBuffer()->begin(), de->baseVertex() ), de->indexBuffer()->size() );
+    }
+    return true;
+  }
+
+  // Runs the kernel on the indices of a DrawArrays or of a DrawElementsUInt/UShort/UByte without primitive restart.
+  // Returns false if the draw call is of a different kind or if \p triangles is true and its primitive type is not PT_TRIANGLES.
+  template<class TKernel>
+  bool dispatchIndices(const DrawCall* dc, bool triangles, TKernel& kernel)
+  {
+    if ( triangles && dc->primitiveType() != PT_TRIANGLES )
+      return false;
+
+    if ( const DrawArrays* da = dc->as<DrawArrays>() )
+    {
+      if ( da->count() > 0 )
+        kernel( SequentialIndices( da->start() ), da->count() );
+      return true;
+    }
+    if ( const DrawElementsUInt* de = dc->as<DrawElementsUInt>() )
+      return dispatchElements( de, kernel );
+    if ( const DrawElementsUShort* de = dc->as<DrawElementsUShort>() )
+      return dispatchElements( de, kernel );
+    if ( const DrawElementsUByte* de = dc->as<DrawElementsUByte>() )
+      return dispatchElements( de, kernel );
+    return false;
+  }
+
+#if defined(VL_SIMD_SSE2)
+  // Loads x, y, z and sets w to 0 without reading past the vertex.
+  inline __m128 loadVec3(const float* p)
+  {
+    return _mm_movelh_ps( _mm_castpd_ps( _mm_load_sd( (const double*)p ) ), _mm_load_ss( p + 2 ) );
+  }
+#endif
+
+  // Single pass bounding box of the indexed vertices, marks the vertices used.
+  struct BoundsKernel
+  {
+    BoundsKernel(size_t vert_count, const float* pos, unsigned char* used): mVertCount(vert_count), mPos(pos), mUsed(used)
+    {
+      for( int k = 0; k < 3; ++k )
+      {
+        mMin[k] = +FLT_MAX;
+        mMax[k] = -FLT_MAX;
+      }
+    }
+
+    template<class TIndices>
+    void operator()(const TIndices& idx, size_t count)
+    {
+#if defined(VL_SIMD_SSE2)
+      __m128 mn = _mm_setr_ps( mMin[0], mMin[1], mMin[2], 0 );
+      __m128 mx = _mm_setr_ps( mMax[0], mMax[1], mMax[2], 0 );
+      for( size_t i = 0; i < count; ++i )
+      {
+        u32 v = idx[i];
+        VL_CHECK( v < mVertCount )
+        mUsed[v] = 1;
+        __m128 p = loadVec3( mPos + v * 3 );
+        mn = _mm_min_ps( mn, p );
+        mx = _mm_max_ps( mx, p );
+      }
+      float tmp[4];
+      _mm_storeu_ps( tmp, mn ); mMin[0] = tmp[0]; mMin[1] = tmp[1]; mMin[2] = tmp[2];
+      _mm_storeu_ps( tmp, mx ); mMax[0] = tmp[0]; mMax[1] = tmp[1]; mMax[2] = tmp[2];
+#else
+      for( size_t i = 0; i < count; ++i )
+      {
+        u32 v = idx[i];
+        VL_CHECK( v < mVertCount )
+        mUsed[v] = 1;
+        const float* p = mPos + v * 3;
+        for( int k = 0; k < 3; ++k )
+        {
+          mMin[k] = p[k] < mMin[k] ? p[k] : mMin[k];
+          mMax[k] = p[k] > mMax[k] ? p[k] : mMax[k];
+        }
+      }
+#endif
+    }
+
+    size_t mVertCount;
+    const float* mPos;
+    unsigned char* mUsed;
+    float mMin[3];
+    float mMax[3];
+  };
+
+  // Accumulates the normalized face normals of the indexed triangles into a 4 floats per vertex buffer.
+  struct NormalsKernel
+  {
+    NormalsKernel(size_t vert_count, const float* pos, float* acc): mVertCount(vert_count), mPos(pos), mAcc(acc) {}
+
+    template<class TIndices>
+    void operator()(const TIndices& idx, size_t count)
+    {
+      for( size_t i = 0; i + 3 <= count; i += 3 )
+      {
+        u32 a = idx[i+0];
+        u32 b = idx[i+1];
+        u32 c = idx[i+2];
+        VL_CHECK( a < mVertCount )
+        VL_CHECK( b < mVertCount )
+        VL_CHECK( c < mVertCount )
+#if defined(VL_SIMD_SSE2)
+        __m128 v0 = loadVec3( mPos + a * 3 );
+        __m128 e1 = _mm_sub_ps( loadVec3( mPos + b * 3 ), v0 );
+        __m128 e2 = _mm_sub_ps( loadVec3( mPos + c * 3 ), v0 );
+        // cross(e1, e2) = e1.yzx * e2.zxy - e1.zxy * e2.yzx
+        __m128 n = _mm_sub_ps( _mm_mul_ps( _mm_shuffle_ps( e1, e1, _MM_SHUFFLE(3,0,2,1) ), _mm_shuffle_ps( e2, e2, _MM_SHUFFLE(3,1,0,2) ) ),
+                               _mm_mul_ps( _mm_shuffle_ps( e1, e1, _MM_SHUFFLE(3,1,0,2) ), _mm_shuffle_ps( e2, e2, _MM_SHUFFLE(3,0,2,1) ) ) );
+        __m128 sq = _mm_mul_ps( n, n );
+        __m128 len = _mm_sqrt_ss( _mm_add_ss( _mm_add_ss( sq, _mm_shuffle_ps( sq, sq, _MM_SHUFFLE(1,1,1,1) ) ), _mm_movehl_ps( sq, sq ) ) );
+        if ( _mm_cvtss_f32( len ) == 0 )
+          continue;
+        n = _mm_div_ps( n, _mm_shuffle_ps( len, len, _MM_SHUFFLE(0,0,0,0) ) );
+        _mm_storeu_ps( mAcc + a * 4, _mm_add_ps( _mm_loadu_ps( mAcc + a * 4 ), n ) );
+        _mm_storeu_ps( mAcc + b * 4, _mm_add_ps( _mm_loadu_ps( mAcc + b * 4 ), n ) );
+        _mm_storeu_ps( mAcc + c * 4, _mm_add_ps( _mm_loadu_ps( mAcc + c * 4 ), n ) );
+#else
+        const fvec3& v0 = *(const fvec3*)( mPos + a * 3 );
+        fvec3 n = cross( *(const fvec3*)( mPos + b * 3 ) - v0, *(const fvec3*)( mPos + c * 3 ) - v0 );
+        float len = n.length();
+        if ( len == 0 )
+          continue;
+        n /= len;
+        u32 tri[] = { a, b, c };
+        for( int k = 0; k < 3; ++k )
+        {
+          mAcc[ tri[k] * 4 + 0 ] += n.x();
+          mAcc[ tri[k] * 4 + 1 ] += n.y();
+          mAcc[ tri[k] * 4 + 2 ] += n.z();
+        }
+#endif
+      }
+    }
+
+    size_t mVertCount;
+    const float* mPos;
+    float* mAcc;
+  };
+
+  // Geometry::computeTangentSpace() inner loop over the indexed triangles.
+  struct TangentKernel
+  {
+    TangentKernel(u32 vert_count, const fvec3* vertex, const fvec2* texcoord, fvec3* tan1, fvec3* tan2):
+      mVertCount(vert_count), mVertex(vertex), mTexCoord(texcoord), mTan1(tan1), mTan2(tan2) {}
+
+    template<class TIndices>
+    void operator()(const TIndices& idx, size_t count)
+    {
+      for( size_t i = 0; i + 3 <= count; i += 3 )
+        addTriangle( idx[i+0], idx[i+1], idx[i+2] );
+    }
+
+    void addTriangle(u32 a, u32 b, u32 c)
+    {
+      VL_CHECK( a < mVertCount )
+      VL_CHECK( b < mVertCount )
+      VL_CHECK( c < mVertCount )
+
+      const fvec3& v1 = mVertex[a];
+      const fvec3& v2 = mVertex[b];
+      const fvec3& v3 = mVertex[c];
+
+      const fvec2& w1 = mTexCoord[a];
+      const fvec2& w2 = mTexCoord[b];
+      const fvec2& w3 = mTexCoord[c];
+
+      float x1 = v2.x() - v1.x();
+      float x2 = v3.x() - v1.x();
+      float y1 = v2.y() - v1.y();
+      float y2 = v3.y() - v1.y();
+      float z1 = v2.z() - v1.z();
+      float z2 = v3.z() - v1.z();
+
+      float s1 = w2.x() - w1.x();
+      float s2 = w3.x() - w1.x();
+      float t1 = w2.y() - w1.y();
+      float t2 = w3.y() - w1.y();
+
+      float r = 1.0F / (s1 * t2 - s2 * t1);
+      fvec3 sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
+      fvec3 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
+
+      mTan1[a] += sdir;
+      mTan1[b] += sdir;
+      mTan1[c] += sdir;
+
+      mTan2[a] += tdir;
+      mTan2[b] += tdir;
+      mTan2[c] += tdir;
+    }
+
+    u32 mVertCount;
+    const fvec3* mVertex;
+    const fvec2* mTexCoord;
+    fvec3* mTan1;
+    fvec3* mTan2;
+  };
+}
+
 //-----------------------------------------------------------------------------
 // Geometry
 //-----------------------------------------------------------------------------
@@ -68,6 +304,46 @@ void Geometry::computeBounds_Implementation()
     return;
   }
 
+  // fast path for the common ArrayFloat3 + DrawArrays/DrawElements case: a single pass over the indices computes the
+  // bounding box and marks the used vertices, the bounding sphere radius is then computed scanning the vertex array.
+  if ( const ArrayFloat3* coords3f = coords->as<ArrayFloat3>() )
+  {
+    std::vector<unsigned char> used( coords3f->size(), 0 );
+    BoundsKernel kernel( coords3f->size(), (const float*)coords3f->begin(), &used[0] );
+    bool supported = true;
+    for(size_t i=0; i<drawCalls().size() && supported; ++i)
+      supported = dispatchIndices( drawCalls().at(i), false, kernel );
+
+    if (supported)
+    {
+      AABB aabb;
+      if ( kernel.mMin[0] <= kernel.mMax[0] )
+      {
+        aabb.setMinCorner( kernel.mMin[0], kernel.mMin[1], kernel.mMin[2] );
+        aabb.setMaxCorner( kernel.mMax[0], kernel.mMax[1], kernel.mMax[2] );
+      }
+
+      real radius = 0;
+      vec3 center = aabb.center();
+      const fvec3* v = coords3f->begin();
+      for(size_t i=0; i<used.size(); ++i)
+      {
+        if ( !used[i] )
+          continue;
+        real dx = v[i].x() - center.x();
+        real dy = v[i].y() - center.y();
+        real dz = v[i].z() - center.z();
+        real r = dx*dx + dy*dy + dz*dz;
+        if (r > radius)
+          radius = r;
+      }
+
+      setBoundingBox( aabb );
+      setBoundingSphere( Sphere(center, sqrt(radius)) );
+      return;
+    }
+  }
+
   AABB aabb;
   for(size_t i=0; i<drawCalls().size(); ++i)
   {
@@ -90,7 +366,7 @@ void Geometry::computeBounds_Implementation()
   }
 
   setBoundingBox( aabb );
-  setBoundingSphere( Sphere(center, radius) );
+  setBoundingSphere( Sphere(center, sqrt(radius)) );
 }
 //-----------------------------------------------------------------------------
 ref<Geometry> Geometry::deepCopy() const
@@ -286,9 +562,24 @@ void Geometry::computeNormals(bool verbose)
   for(u32 i=0; i<norm3f->size(); ++i)
     (*norm3f)[i] = 0;
 
+  // fast path for ArrayFloat3 + PT_TRIANGLES DrawArrays/DrawElements draw calls, the others use the generic loop below
+  const ArrayFloat3* pos3f = posarr->as<ArrayFloat3>();
+  std::vector<float> acc;
+  std::vector<bool> done( drawCalls().size(), false );
+  if (pos3f && !verbose)
+  {
+    acc.resize( pos3f->size() * 4, 0.0f );
+    NormalsKernel kernel( pos3f->size(), (const float*)pos3f->begin(), &acc[0] );
+    for(size_t prim=0; prim<drawCalls().size(); ++prim)
+      done[prim] = dispatchIndices( mDrawCalls[prim].get(), true, kernel );
+  }
+
   // iterate all draw calls
   for(int prim=0; prim<(int)drawCalls().size(); prim++)
   {
+    if (done[prim])
+      continue;
+
     // iterate all triangles, if present
     for(TriangleIterator trit = mDrawCalls[prim]->triangleIterator(); trit.hasNext(); trit.next())
     {
@@ -340,7 +631,11 @@ void Geometry::computeNormals(bool verbose)
 
   // normalize the normals
   for(int i=0; i<(int)norm3f->size(); ++i)
+  {
+    if (!acc.empty())
+      (*norm3f)[i] += fvec3( acc[i*4+0], acc[i*4+1], acc[i*4+2] );
     (*norm3f)[i].normalize();
+  }
 }
 //-----------------------------------------------------------------------------
 void Geometry::deleteBufferObject()
@@ -1165,6 +1460,19 @@ bool Geometry::sortVertices()
   return true;
 }
 //-----------------------------------------------------------------------------
+bool Geometry::optimizeVertexCache(int cache_size, bool optimize_overdraw)
+{
+  VertexCacheOptimizer optimizer;
+  optimizer.setCacheSize(cache_size);
+  optimizer.setOverdrawOptimizationEnabled(optimize_overdraw);
+  if ( !optimizer.optimize(this) )
+    return false;
+
+  Log::debug( Say("Geometry::optimizeVertexCache(): ACMR %.3n -> %.3n, ATVR %.3n -> %.3n\n")
+    << optimizer.acmrBefore() << optimizer.acmrAfter() << optimizer.atvrBefore() << optimizer.atvrAfter() );
+  return true;
+}
+//-----------------------------------------------------------------------------
 void Geometry::colorizePrimitives()
 {
   ArrayAbstract* posarr = vertexArray();
@@ -1204,45 +1512,11 @@ void Geometry::computeTangentSpace(
   tan1.resize(vert_count);
   tan2.resize(vert_count);
 
-  for ( TriangleIterator trit = prim->triangleIterator(); trit.hasNext(); trit.next() )
+  TangentKernel kernel( vert_count, vertex, texcoord, &tan1[0], &tan2[0] );
+  if ( !dispatchIndices( prim, true, kernel ) )
   {
-    int tri[] = { trit.a(), trit.b(), trit.c() };
-
-    VL_CHECK(tri[0] < (int)vert_count );
-    VL_CHECK(tri[1] < (int)vert_count );
-    VL_CHECK(tri[2] < (int)vert_count );
-
-    const fvec3& v1 = vertex[tri[0]];
-    const fvec3& v2 = vertex[tri[1]];
-    const fvec3& v3 = vertex[tri[2]];
-
-    const fvec2& w1 = texcoord[tri[0]];
-    const fvec2& w2 = texcoord[tri[1]];
-    const fvec2& w3 = texcoord[tri[2]];
-
-    float x1 = v2.x() - v1.x();
-    float x2 = v3.x() - v1.x();
-    float y1 = v2.y() - v1.y();
-    float y2 = v3.y() - v1.y();
-    float z1 = v2.z() - v1.z();
-    float z2 = v3.z() - v1.z();
-
-    float s1 = w2.x() - w1.x();
-    float s2 = w3.x() - w1.x();
-    float t1 = w2.y() - w1.y();
-    float t2 = w3.y() - w1.y();
-
-    float r = 1.0F / (s1 * t2 - s2 * t1);
-    fvec3 sdir((t2 * x1 - t1 * x2) * r, (t2 * y1 - t1 * y2) * r, (t2 * z1 - t1 * z2) * r);
-    fvec3 tdir((s1 * x2 - s2 * x1) * r, (s1 * y2 - s2 * y1) * r, (s1 * z2 - s2 * z1) * r);
-
-    tan1[tri[0]] += sdir;
-    tan1[tri[1]] += sdir;
-    tan1[tri[2]] += sdir;
-
-    tan2[tri[0]] += tdir;
-    tan2[tri[1]] += tdir;
-    tan2[tri[2]] += tdir;
+    for ( TriangleIterator trit = prim->triangleIterator(); trit.hasNext(); trit.next() )
+      kernel.addTriangle( trit.a(), trit.b(), trit.c() );
   }
 
   for ( u32 a = 0; a < vert_count; a++)
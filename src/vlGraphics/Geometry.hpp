@@ -212,6 +212,12 @@ namespace vl
     //! \returns true if all the DrawCall are DrawElements* and none of the DrawCalls is using primitive restart.
     bool sortVertices();
 
+    //! Reorders the triangles of the PT_TRIANGLES DrawElements* to maximize the hits of a vertex cache of \p cache_size entries,
+    //! optionally reducing the overdraw, then sorts the vertices with sortVertices() when all the DrawCalls are DrawElements*.
+    //! The ACMR/ATVR before and after the optimization are logged with Log::debug(), use VertexCacheOptimizer to access them.
+    //! \returns true if at least one DrawCall was optimized.
+    bool optimizeVertexCache(int cache_size=32, bool optimize_overdraw=false);
+
     //! Regenerates the vertex position and attributes using the given new-to-old map.
     //! Where 'map_new_to_old[i] == j' means that the i-th new vertex attribute should take it's value from the old j-th vertex attribute.
     void regenerateVertices(const std::vector<u32>& map_new_to_old);
@@ -31,6 +31,8 @@
 
 #include <vlGraphics/PolygonSimplifier.hpp>
 #include <vlGraphics/DoubleVertexRemover.hpp>
+#include <vlGraphics/Actor.hpp>
+#include <vlCore/GlobalSettings.hpp>
 #include <vlCore/Time.hpp>
 #include <vlCore/Log.hpp>
 #include <vlCore/Say.hpp>
@@ -65,6 +67,27 @@ namespace
     }
     PolygonSimplifier::Vertex* mVertex;
   };
+
+  //! Orders the vertices along the given axis.
+  class AxisLess
+  {
+  public:
+    AxisLess(int axis): mAxis(axis) {}
+
+    bool operator()(const PolygonSimplifier::Vertex* a, const PolygonSimplifier::Vertex* b) const
+    {
+      return a->position()[mAxis] < b->position()[mAxis];
+    }
+
+  protected:
+    int mAxis;
+  };
+
+  //! Whether the vertex can be inserted in the collapse queue.
+  bool isCollapsible(const PolygonSimplifier::Vertex* v)
+  {
+    return !v->removed() && !v->isProtected() && !v->isLocked() && v->collapseVertex();
+  }
 }
 //-----------------------------------------------------------------------------
 void PolygonSimplifier::simplify()
@@ -75,15 +98,6 @@ void PolygonSimplifier::simplify()
     return;
   }
 
-  // we don't support vertex attributes of any kind yet
-  #ifndef NDEBUG
-    bool problem = false;
-    for( int i = VA_Position + 1; i < VA_MaxAttribCount; ++i )
-      problem |= mInput->vertexAttribArray(i) != NULL;
-    if (problem)
-      Log::warning("PolygonSimplifier::simplify() simplifies only the position array of a Geometry, the other attibutes will be discarded.\n");
-  #endif
-
   Time timer;
   timer.start();
 
@@ -135,13 +149,59 @@ void PolygonSimplifier::simplify()
     return;
   }
 
-  simplify(verts, indices);
+  // collect the other vertex attributes, the float ones are interpolated during the collapses
+  mAttribArrays.clear();
+  mAttribIndices.clear();
+  mAttribValues.clear();
+  mAttribStride = 0;
+  for( int i = VA_Position + 1; i < VA_MaxAttribCount; ++i )
+  {
+    ArrayAbstract* arr = mInput->vertexAttribArray(i);
+    if (!arr)
+      continue;
+    if (arr->size() != posarr->size())
+    {
+      Log::warning( Say("PolygonSimplifier::simplify() : vertex attribute #%n has a different size than the position array and will be discarded.\n") << i );
+      continue;
+    }
+    mAttribArrays.push_back(arr);
+    mAttribIndices.push_back(i);
+    if (arr->glType() == GL_FLOAT)
+      mAttribStride += (int)arr->glSize();
+  }
+
+  if (mAttribStride)
+  {
+    mAttribValues.resize( verts.size() * mAttribStride );
+    for(size_t i=0, offset=0; i<mAttribArrays.size(); ++i)
+    {
+      if (mAttribArrays[i]->glType() != GL_FLOAT)
+        continue;
+      const int size = (int)mAttribArrays[i]->glSize();
+      const float* src = (const float*)mAttribArrays[i]->ptr();
+      for(size_t ivert=0; ivert<verts.size(); ++ivert)
+        memcpy( &mAttribValues[ivert*mAttribStride + offset], src + ivert*size, size*sizeof(float) );
+      offset += size;
+    }
+  }
+
+  simplifyMesh(verts, indices);
 
   if (verbose())
     Log::print( Say("PolygonSimplifier::simplify() done in %.3ns\n") << timer.elapsed() );
 }
 //-----------------------------------------------------------------------------
 void PolygonSimplifier::simplify(const std::vector<fvec3>& in_verts, const std::vector<int>& in_tris)
+{
+  mAttribArrays.clear();
+  mAttribIndices.clear();
+  mAttribValues.clear();
+  mAttribStride = 0;
+
+  simplifyMesh(in_verts, in_tris);
+}
+//-----------------------------------------------------------------------------
+void PolygonSimplifier::simplifyMesh(const std::vector<fvec3>& in_verts, const std::vector<int>& in_tris)
 {
   if (verbose())
     Log::print("PolygonSimplifier::simplify() starting ... \n");
@@ -265,14 +325,6 @@ void PolygonSimplifier::simplify(const std::vector<fvec3>& in_verts, const std::
   if (verbose())
     Log::print(Say("database setup = %.3n\n") << timer.elapsed() );
 
-  std::set<VertexPtrWrapper> vertex_set;
-  for(int ivert=0; ivert<(int)mSimplifiedVertices.size(); ++ivert)
-    if ( !mSimplifiedVertices[ivert]->mProtected )
-      vertex_set.insert( mSimplifiedVertices[ivert] );
-
-  if (verbose())
-    Log::print(Say("heap setup = %.3n\n") << timer.elapsed() );
-
   // loop through the simplification targets
   for(size_t itarget=0, remove_order=0; itarget<mTargets.size(); ++itarget)
   {
@@ -286,73 +338,259 @@ void PolygonSimplifier::simplify(const std::vector<fvec3>& in_verts, const std::
 
     timer.start(1);
 
-    std::vector< PolygonSimplifier::Vertex* > adj_verts;
-    for( ; (int)vertex_set.size()>target_vertex_count; ++remove_order )
+    if (partitionCount() > 1)
+      remove_order += simplifyPartitions(target_vertex_count, (int)remove_order);
+    else
+      remove_order += simplifyVertices(mSimplifiedVertices, target_vertex_count, (int)remove_order);
+
+    if (verbose())
+      Log::print(Say("simplification = %.3ns (%.3ns)\n") << timer.elapsed() << timer.elapsed(1) );
+
+    outputSimplifiedGeometry();
+  }
+
+  if (verbose() && !output().empty())
+  {
+    float elapsed = (float)timer.elapsed();
+    int polys_after = output().back()->drawCalls().at(0)->countTriangles();
+    int verts_after = output().back()->vertexArray() ? (int)output().back()->vertexArray()->size() : 0;
+    Log::print(Say("POLYS: %n -> %n, %.2n%%, %.1nT/s\n") << polys_before << polys_after << 100.0f*verts_after/verts_before << (polys_before - polys_after)/elapsed );
+    Log::print(Say("VERTS: %n -> %n, %.2n%%, %.1nV/s\n") << verts_before << verts_after << 100.0f*verts_after/verts_before << (verts_before - verts_after)/elapsed );
+  }
+}
+//-----------------------------------------------------------------------------
+int PolygonSimplifier::simplifyVertices(const std::vector<Vertex*>& verts, int target_count, int remove_order)
+{
+  std::set<VertexPtrWrapper> vertex_set;
+  for(size_t ivert=0; ivert<verts.size(); ++ivert)
+    if ( isCollapsible(verts[ivert]) )
+      vertex_set.insert( verts[ivert] );
+
+  int collapse_count = 0;
+  std::vector< PolygonSimplifier::Vertex* > adj_verts;
+  for( ; (int)vertex_set.size()>target_count; ++collapse_count )
+  {
+    std::set<VertexPtrWrapper>::iterator it = vertex_set.begin();
+    PolygonSimplifier::Vertex* v = it->mVertex;
+    v->mRemoveOrder = remove_order + collapse_count;
+    vertex_set.erase(it);
+
+    // remove the adjacent vertices to v and v->collapseVert()
+    adj_verts.clear();
+    for(int i=0; i<v->adjacentVerticesCount(); ++i)
     {
-      std::set<VertexPtrWrapper>::iterator it = vertex_set.begin();
-      PolygonSimplifier::Vertex* v = it->mVertex;
-      v->mRemoveOrder = (int)remove_order;
-      vertex_set.erase(it);
-
-      // remove the adjacent vertices to v and v->collapseVert()
-      adj_verts.clear();
-      for(int i=0; i<v->adjacentVerticesCount(); ++i)
-      {
-        VL_CHECK( v != v->adjacentVertex(i) )
-        VL_CHECK( !v->adjacentVertex(i)->mAlreadyProcessed )
+      VL_CHECK( v != v->adjacentVertex(i) )
+      VL_CHECK( !v->adjacentVertex(i)->mAlreadyProcessed )
 
-        adj_verts.push_back( v->adjacentVertex(i) );
-        adj_verts.back()->mAlreadyProcessed = true;
-        vertex_set.erase( v->adjacentVertex(i) );
-      }
-      for(int i=0; i<v->collapseVertex()->adjacentVerticesCount(); ++i)
+      adj_verts.push_back( v->adjacentVertex(i) );
+      adj_verts.back()->mAlreadyProcessed = true;
+      vertex_set.erase( v->adjacentVertex(i) );
+    }
+    for(int i=0; i<v->collapseVertex()->adjacentVerticesCount(); ++i)
+    {
+      if ( !v->collapseVertex()->adjacentVertex(i)->mAlreadyProcessed )
       {
-        if ( !v->collapseVertex()->adjacentVertex(i)->mAlreadyProcessed )
-        {
-          adj_verts.push_back( v->collapseVertex()->adjacentVertex(i) );
-          vertex_set.erase( v->collapseVertex()->adjacentVertex(i) );
-        }
+        adj_verts.push_back( v->collapseVertex()->adjacentVertex(i) );
+        vertex_set.erase( v->collapseVertex()->adjacentVertex(i) );
       }
+    }
 
-      VL_CHECK(!v->removed())
-      VL_CHECK(v->collapseVertex())
-      VL_CHECK(!v->collapseVertex()->removed())
+    VL_CHECK(!v->removed())
+    VL_CHECK(v->collapseVertex())
+    VL_CHECK(!v->collapseVertex()->removed())
 
-      collapse( v );
+    collapse( v );
 
-      // reinsert the adj_verts if not removed
-      // NOTE: v->collapseVertex() might have been also removed
-      for( int i=(int)adj_verts.size(); i--; )
-      {
-        adj_verts[i]->mAlreadyProcessed = false;
+    // reinsert the adj_verts if not removed
+    // NOTE: v->collapseVertex() might have been also removed
+    for( int i=(int)adj_verts.size(); i--; )
+    {
+      adj_verts[i]->mAlreadyProcessed = false;
+
+      if ( adj_verts[i]->removed() || adj_verts[i]->isProtected() || adj_verts[i]->isLocked() )
+        continue;
+
+      computeCollapseInfo( adj_verts[i] );
+      if ( !adj_verts[i]->collapseVertex() )
+        continue;
+
+      VL_CHECK( adj_verts[i]->checkTriangles() )
+      VL_CHECK( adj_verts[i]->collapseVertex() != v )
+      VL_CHECK( !adj_verts[i]->collapseVertex()->removed() )
+
+      vertex_set.insert( adj_verts[i] );
+    }
+  }
+
+  return collapse_count;
+}
+//-----------------------------------------------------------------------------
+int PolygonSimplifier::simplifyPartitions(int target_count, int remove_order)
+{
+  int thread_count = globalSettings()->threadCount();
+  int collapse_count = 0;
+  std::vector<Vertex*> alive;
+  alive.reserve( mSimplifiedVertices.size() );
+
+  // each round removes at most half of the unlocked vertices of each partition so that the detail decreases
+  // uniformly, the cuts change from round to round so that the locked vertices are simplified in the next one.
+  for(int round=0; round<8; ++round)
+  {
+    alive.clear();
+    for(size_t ivert=0; ivert<mSimplifiedVertices.size(); ++ivert)
+      if ( !mSimplifiedVertices[ivert]->removed() )
+        alive.push_back( mSimplifiedVertices[ivert] );
+
+    const int alive_count = (int)alive.size();
+    const int excess = alive_count - target_count;
+    // the last few collapses are left to the serial pass
+    if ( excess <= alive_count / 100 )
+      break;
+
+    const int part_count = partitionCount() + (round & 1);
+    partitionVertices(alive, 0, alive.size(), 0, part_count);
+
+    // lock the vertices connected to other partitions: the collapses of an unlocked vertex and the
+    // collapse info updates that follow only touch vertices and triangles of its own partition.
+#ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+#endif
+    for(int ivert=0; ivert<alive_count; ++ivert)
+    {
+      Vertex* v = alive[ivert];
+      v->mLocked = false;
+      for(int i=0; i<v->adjacentVerticesCount() && !v->mLocked; ++i)
+        v->mLocked = v->adjacentVertex(i)->mPartition != v->mPartition;
+    }
+
+#ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+#endif
+    for(int ivert=0; ivert<alive_count; ++ivert)
+    {
+      if ( !alive[ivert]->mLocked )
+        computeCollapseInfo( alive[ivert] );
+    }
+
+    std::vector< std::vector<Vertex*> > parts(part_count);
+    for(int ivert=0; ivert<alive_count; ++ivert)
+    {
+      if ( !alive[ivert]->mLocked )
+        parts[ alive[ivert]->mPartition ].push_back( alive[ivert] );
+    }
 
-        if ( adj_verts[i]->removed() )
-          continue;
+    int unlocked_count = 0;
+    for(int ipart=0; ipart<part_count; ++ipart)
+      unlocked_count += (int)parts[ipart].size();
+    if (!unlocked_count)
+      break;
+
+    // each partition removes its share of the excess vertices: a partition collapses at most part_remove
+    // vertices thus it is given the disjoint remove order range [first_order[ipart], first_order[ipart] + part_remove)
+    std::vector<int> part_removes(part_count, 0);
+    std::vector<int> first_order(part_count, 0);
+    for(int ipart=0, order=remove_order+collapse_count; ipart<part_count; ++ipart)
+    {
+      int part_size = (int)parts[ipart].size();
+      part_removes[ipart] = std::min( (int)( (double)excess * part_size / unlocked_count ), part_size / 2 );
+      first_order[ipart] = order;
+      order += part_removes[ipart];
+    }
 
-        computeCollapseInfo( adj_verts[i] );
+    std::vector<int> collapses(part_count, 0);
+    mParallelCollapse = true;
+#ifdef VL_OPENMP
+    #pragma omp parallel for schedule(dynamic) num_threads(thread_count)
+#endif
+    for(int ipart=0; ipart<part_count; ++ipart)
+    {
+      int part_size = (int)parts[ipart].size();
+      collapses[ipart] = simplifyVertices( parts[ipart], part_size - part_removes[ipart], first_order[ipart] );
+      VL_CHECK( collapses[ipart] <= part_removes[ipart] )
+    }
+    mParallelCollapse = false;
 
-        VL_CHECK( adj_verts[i]->checkTriangles() )
-        VL_CHECK( adj_verts[i]->collapseVertex() != v )
-        VL_CHECK( !adj_verts[i]->collapseVertex()->removed() )
+#ifndef NDEBUG
+    // the connectivity checks skipped by collapse() inside the parallel region
+    for(int ivert=0; ivert<alive_count; ++ivert)
+    {
+      VL_CHECK( alive[ivert]->removed() || alive[ivert]->checkAdjacency() )
+    }
+#endif
 
-        vertex_set.insert( adj_verts[i] );
+    // close the gaps left by the partitions that collapsed less than their share so that the remove order stays dense
+    int round_collapses = 0;
+    for(int ipart=0; ipart<part_count; ++ipart)
+    {
+      int shift = first_order[ipart] - (remove_order + collapse_count + round_collapses);
+      if (shift)
+      {
+        for(size_t ivert=0; ivert<parts[ipart].size(); ++ivert)
+          if ( parts[ipart][ivert]->removed() )
+            parts[ipart][ivert]->mRemoveOrder -= shift;
       }
+      round_collapses += collapses[ipart];
     }
+    collapse_count += round_collapses;
 
-    if (verbose())
-      Log::print(Say("simplification = %.3ns (%.3ns)\n") << timer.elapsed() << timer.elapsed(1) );
+    for(int ivert=0; ivert<alive_count; ++ivert)
+      alive[ivert]->mLocked = false;
 
-    outputSimplifiedGeometry();
+    if (!round_collapses)
+      break;
   }
 
-  if (verbose() && !output().empty())
+  // complete the target serially
+  alive.clear();
+  for(size_t ivert=0; ivert<mSimplifiedVertices.size(); ++ivert)
+    if ( !mSimplifiedVertices[ivert]->removed() )
+      alive.push_back( mSimplifiedVertices[ivert] );
+
+  if ( (int)alive.size() > target_count )
   {
-    float elapsed = (float)timer.elapsed();
-    int polys_after = output().back()->drawCalls().at(0)->countTriangles();
-    int verts_after = output().back()->vertexArray() ? (int)output().back()->vertexArray()->size() : 0;
-    Log::print(Say("POLYS: %n -> %n, %.2n%%, %.1nT/s\n") << polys_before << polys_after << 100.0f*verts_after/verts_before << (polys_before - polys_after)/elapsed );
-    Log::print(Say("VERTS: %n -> %n, %.2n%%, %.1nV/s\n") << verts_before << verts_after << 100.0f*verts_after/verts_before << (verts_before - verts_after)/elapsed );
+    const int alive_count = (int)alive.size();
+#ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+#endif
+    for(int ivert=0; ivert<alive_count; ++ivert)
+      computeCollapseInfo( alive[ivert] );
+
+    collapse_count += simplifyVertices( alive, target_count, remove_order + collapse_count );
   }
+
+  return collapse_count;
+}
+//-----------------------------------------------------------------------------
+void PolygonSimplifier::partitionVertices(std::vector<Vertex*>& verts, size_t first, size_t last, int first_part, int part_count)
+{
+  if ( part_count <= 1 || last - first < 2 )
+  {
+    for(size_t ivert=first; ivert<last; ++ivert)
+      verts[ivert]->mPartition = first_part;
+    return;
+  }
+
+  // median cut along the longest axis
+  fvec3 min_corner = verts[first]->position();
+  fvec3 max_corner = min_corner;
+  for(size_t ivert=first+1; ivert<last; ++ivert)
+  {
+    const fvec3& p = verts[ivert]->position();
+    for(int k=0; k<3; ++k)
+    {
+      min_corner[k] = std::min( min_corner[k], p[k] );
+      max_corner[k] = std::max( max_corner[k], p[k] );
+    }
+  }
+  fvec3 size = max_corner - min_corner;
+  int axis = size.x() >= size.y() && size.x() >= size.z() ? 0 : ( size.y() >= size.z() ? 1 : 2 );
+
+  int left_parts = part_count / 2;
+  size_t mid = first + (last - first) * left_parts / part_count;
+  std::nth_element( verts.begin() + first, verts.begin() + mid, verts.begin() + last, AxisLess(axis) );
+
+  partitionVertices( verts, first, mid, first_part, left_parts );
+  partitionVertices( verts, mid, last, first_part + left_parts, part_count - left_parts );
 }
 //-----------------------------------------------------------------------------
 void PolygonSimplifier::outputSimplifiedGeometry()
@@ -365,11 +603,14 @@ void PolygonSimplifier::outputSimplifiedGeometry()
   // regenerate vertex buffer & generate indices for index buffer
   ref<ArrayFloat3> arr_f3 = new ArrayFloat3;
   arr_f3->resize(vert_count);
+  std::vector<u32> map_new_to_old;
+  map_new_to_old.reserve(vert_count);
   for(int i=0, vert_index=0; i<(int)mSimplifiedVertices.size(); ++i)
   {
     if (!mSimplifiedVertices[i]->mRemoved)
     {
       arr_f3->at(vert_index) = mSimplifiedVertices[i]->mPosition;
+      map_new_to_old.push_back( mSimplifiedVertices[i]->mOriginalIndex );
       mSimplifiedVertices[i]->mSimplifiedIndex = vert_index++;
     }
   }
@@ -400,9 +641,40 @@ void PolygonSimplifier::outputSimplifiedGeometry()
   VL_CHECK(ptr == de->indexBuffer()->end());
 
   // output geometry
-  mOutput.push_back( new Geometry );
-  mOutput.back()->setVertexArray( arr_f3.get() );
-  mOutput.back()->drawCalls().push_back( de.get() );
+  ref<Geometry> geom = new Geometry;
+
+  // the other attributes are taken from the surviving vertices, then the float ones are replaced by their interpolated values
+  if (!mAttribArrays.empty())
+  {
+    for(size_t i=0; i<mAttribArrays.size(); ++i)
+      geom->setVertexAttribArray( mAttribIndices[i], mAttribArrays[i].get() );
+    geom->regenerateVertices(map_new_to_old);
+
+    for(size_t i=0, offset=0; i<mAttribArrays.size(); ++i)
+    {
+      ArrayAbstract* arr = geom->vertexAttribArray( mAttribIndices[i] );
+      if (!arr || arr->glType() != GL_FLOAT)
+        continue;
+      const int size = (int)arr->glSize();
+      float* dst = (float*)arr->ptr();
+      for(size_t ivert=0; ivert<map_new_to_old.size(); ++ivert)
+        memcpy( dst + ivert*size, &mAttribValues[map_new_to_old[ivert]*mAttribStride + offset], size*sizeof(float) );
+      if (mAttribIndices[i] == VA_Normal)
+        arr->normalize();
+      offset += size;
+    }
+  }
+
+  geom->setVertexArray( arr_f3.get() );
+  geom->drawCalls().push_back( de.get() );
+  mOutput.push_back( geom );
+}
+//-----------------------------------------------------------------------------
+void PolygonSimplifier::setupLODs(Actor* actor)
+{
+  actor->setLod( 0, mInput.get() );
+  for(int i=0; i<(int)mOutput.size() && i+1<VL_MAX_ACTOR_LOD; ++i)
+    actor->setLod( i+1, mOutput[i].get() );
 }
 //-----------------------------------------------------------------------------
 void PolygonSimplifier::clearTrianglesAndVertices()
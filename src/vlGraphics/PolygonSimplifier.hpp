@@ -33,6 +33,7 @@
 #define PolygonSimplifier_INCLUDE_ONCE
 
 #include <vlGraphics/link_config.hpp>
+#include <vlGraphics/Array.hpp>
 #include <vlCore/Object.hpp>
 #include <vlCore/Vector3.hpp>
 #include <vlCore/glsl_math.hpp>
@@ -42,12 +43,21 @@
 namespace vl
 {
   class Geometry;
+  class Actor;
 //-----------------------------------------------------------------------------
 // PolygonSimplifier
 //-----------------------------------------------------------------------------
   /**
    * The PolygonSimplifier class reduces the amount of polygons present in a Geometry using a quadric error metric.
-   * The algorithm simplifies only the position array of the Geometry all the other vertex attributes will be discarded.
+   *
+   * One output Geometry is generated for each of the targets(), from the most to the least detailed, so that a whole
+   * LOD chain is produced in a single run, see setupLODs(). The position array is simplified using the quadric error
+   * metric while the other vertex attributes of the input Geometry follow the collapses: the attributes stored as
+   * floats (normals, texture coordinates, float colors etc.) are interpolated along the collapsed edges, the other
+   * ones keep the value of the surviving vertex.
+   *
+   * When partitionCount() is greater than 1 the mesh is divided in spatial partitions that are simplified in parallel
+   * using up to GlobalSettings::threadCount() threads, see setPartitionCount().
   */
   class VLGRAPHICS_EXPORT PolygonSimplifier: public Object
   {
@@ -241,8 +251,8 @@ namespace vl
       friend class Triangle;
       friend class PolygonSimplifier;
     public:
-      Vertex(): mCollapseCost(0.0f), mOriginalIndex(-1) , mSimplifiedIndex(-1), mRemoveOrder(-1),
-                mRemoved(false), mProtected(false), mAlreadyProcessed(false)
+      Vertex(): mCollapseVertex(NULL), mCollapseCost(0.0f), mOriginalIndex(-1) , mSimplifiedIndex(-1), mRemoveOrder(-1),
+                mPartition(0), mRemoved(false), mProtected(false), mLocked(false), mAlreadyProcessed(false)
       {
       }
 
@@ -250,6 +260,7 @@ namespace vl
       inline void removeAdjacentVertex(Vertex* v);
       inline void computeAdjacentVertices();
       inline bool checkConnectivity();
+      inline bool checkAdjacency() const;
       inline bool isAdjacentVertex(Vertex*) const;
       inline bool isIncidentTriangle(Triangle*) const;
       inline void discardRemovedTriangles();
@@ -278,6 +289,10 @@ namespace vl
       bool removed() const { return mRemoved; }
       //! is the vertex protected?
       bool isProtected() const { return mProtected; }
+      //! the spatial partition the vertex belongs to, see PolygonSimplifier::setPartitionCount()
+      int partition() const { return mPartition; }
+      //! is the vertex on the boundary of its partition? Locked vertices are not collapsed during the parallel simplification.
+      bool isLocked() const { return mLocked; }
       //! original index of this vertex
       int originalIndex() const { return mOriginalIndex; }
       //! Internally used to regenerated the index buffer
@@ -309,20 +324,30 @@ namespace vl
       int mSimplifiedIndex;
       //! when the vertex has collapsed
       int mRemoveOrder;
+      //! spatial partition
+      int mPartition;
       //! has the vertex been removed
       bool mRemoved;
       //! is the vertex protected?
       bool mProtected;
+      //! is the vertex on the boundary of its partition?
+      bool mLocked;
       //! internally used
       bool mAlreadyProcessed;
     };
 
   public:
-    PolygonSimplifier(): mRemoveDoubles(false), mVerbose(true), mQuick(true) {}
+    PolygonSimplifier(): mAttribStride(0), mPartitionCount(1), mRemoveDoubles(false), mVerbose(true), mQuick(true), mParallelCollapse(false) {}
 
     void simplify();
     void simplify(const std::vector<fvec3>& in_verts, const std::vector<int>& in_tris);
 
+    /**
+     * Installs the input Geometry as LOD 0 of the given Actor and the output Geometries as the following LODs.
+     * The output beyond VL_MAX_ACTOR_LOD - 1 Geometries is ignored.
+     */
+    void setupLODs(Actor* actor);
+
     void setIntput(Geometry* geom) { mInput = geom; }
     Geometry* input() { return mInput.get(); }
     const Geometry* input() const { return mInput.get(); }
@@ -352,8 +377,27 @@ namespace vl
     bool quick() const { return mQuick; }
     void setQuick(bool quick) { mQuick = quick; }
 
+    /**
+     * The number of spatial partitions simplified in parallel, the default is 1 which runs the classic serial algorithm.
+     * The vertices are split in partitions of roughly the same size by recursive median cuts. The vertices connected
+     * to other partitions are locked so that the partitions can be simplified independently, each one with its own
+     * priority queue. The simplification proceeds in rounds, each one removing at most half of the unlocked vertices of
+     * a partition and using different cuts than the previous one, then a final serial pass completes the target.
+     * The result is close to but not the same as the one of the serial algorithm.
+     */
+    void setPartitionCount(int count) { mPartitionCount = count; }
+    int partitionCount() const { return mPartitionCount; }
+
   protected:
+    void simplifyMesh(const std::vector<fvec3>& in_verts, const std::vector<int>& in_tris);
     void outputSimplifiedGeometry();
+    //! Collapses the given vertices in order of cost until target_count of them are left, returns the number of collapses.
+    int simplifyVertices(const std::vector<Vertex*>& verts, int target_count, int remove_order);
+    //! Simplifies the partitions in parallel, then completes the target serially if needed.
+    int simplifyPartitions(int target_count, int remove_order);
+    //! Assigns the vertices in [first, last) to part_count partitions starting from first_part.
+    void partitionVertices(std::vector<Vertex*>& verts, size_t first, size_t last, int first_part, int part_count);
+    float* attribs(const Vertex* v) { return &mAttribValues[v->mOriginalIndex * mAttribStride]; }
     inline void collapse(Vertex* v);
     inline void computeCollapseInfo(Vertex* v);
 
@@ -364,9 +408,18 @@ namespace vl
     std::vector<Vertex*> mSimplifiedVertices;
     std::vector<Triangle*> mSimplifiedTriangles;
     std::vector<int> mProtectedVerts;
+    //! the input vertex attributes other than the position
+    std::vector< ref<ArrayAbstract> > mAttribArrays;
+    std::vector<int> mAttribIndices;
+    //! the float attributes, mAttribStride floats per input vertex
+    std::vector<float> mAttribValues;
+    int mAttribStride;
+    int mPartitionCount;
     bool mRemoveDoubles;
     bool mVerbose;
     bool mQuick;
+    //! collapse() skips its debug checks, which read the adjacency of other partitions, while the partitions are simplified in parallel
+    bool mParallelCollapse;
 
   private:
     std::vector<Triangle> mTriangleLump;
@@ -482,12 +535,18 @@ namespace vl
   //-----------------------------------------------------------------------------
   inline bool PolygonSimplifier::Vertex::checkConnectivity()
   {
-    VL_CHECK( mCollapseVertex )
-    VL_CHECK( !mCollapseVertex->removed() )
+    // the collapse info of the locked vertices is not kept up to date
+    VL_CHECK( mLocked || mCollapseVertex )
+    VL_CHECK( mLocked || !mCollapseVertex->removed() )
+    return checkAdjacency();
+  }
+  //-----------------------------------------------------------------------------
+  inline bool PolygonSimplifier::Vertex::checkAdjacency() const
+  {
     // check connectivity consistency
     for(int ivert=0; ivert<adjacentVerticesCount(); ++ivert)
     {
-      Vertex* adj = mAdjacentVerts[ivert];
+      const Vertex* adj = mAdjacentVerts[ivert];
       if ( adj->removed() )
         return false;
       if( std::find(adj->mAdjacentVerts.begin(), adj->mAdjacentVerts.end(), this) == adj->mAdjacentVerts.end() )
@@ -610,16 +669,31 @@ namespace vl
     VL_CHECK(v->mCollapseVertex)
     VL_CHECK( !v->mCollapseVertex->mRemoved )
 #ifndef NDEBUG
-    v->checkConnectivity();
-    // check connectivity consistency
-    for(int ivert=0; ivert<v->adjacentVerticesCount(); ++ivert)
+    if ( !mParallelCollapse )
     {
-      VL_CHECK( v->mAdjacentVerts[ivert]->checkConnectivity() )
+      v->checkConnectivity();
+      // check connectivity consistency
+      for(int ivert=0; ivert<v->adjacentVerticesCount(); ++ivert)
+      {
+        VL_CHECK( v->mAdjacentVerts[ivert]->checkConnectivity() )
+      }
     }
 #endif
 
     v->mRemoved = true;
 
+    // interpolate the float attributes at the collapse position along the collapsed edge
+    if (mAttribStride)
+    {
+      fvec3 edge = v->mPosition - v->mCollapseVertex->mPosition;
+      float len2 = dot(edge, edge);
+      float t = len2 ? clamp( dot(v->mCollapsePosition - v->mCollapseVertex->mPosition, edge) / len2, 0.0f, 1.0f ) : 0.0f;
+      float* a = attribs(v->mCollapseVertex);
+      const float* b = attribs(v);
+      for(int i=0; i<mAttribStride; ++i)
+        a[i] += (b[i] - a[i]) * t;
+    }
+
     v->mCollapseVertex->mPosition = v->mCollapsePosition;
     v->mCollapseVertex->mQErr += v->mQErr;
 
@@ -709,6 +783,10 @@ namespace vl
     {
       VL_CHECK(!v->mAdjacentVerts[ivert]->mRemoved)
 
+      // the locked vertices are shared with other partitions
+      if (v->mAdjacentVerts[ivert]->mLocked)
+        continue;
+
       double cost = 0.0;
       dvec3 solution;
       if (quick())
@@ -848,8 +926,6 @@ namespace vl
         v->mCollapsePosition = (fvec3)solution;
       }
     }
-
-    VL_CHECK( v->mCollapseVertex )
   }
   //-----------------------------------------------------------------------------
 }
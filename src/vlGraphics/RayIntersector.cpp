@@ -46,11 +46,35 @@ void RayIntersector::intersect(const Ray& ray, SceneManager* scene_manager)
 void RayIntersector::intersect()
 {
   mIntersections.clear();
-  for(size_t i=0; i<actors()->size(); ++i)
+
+  // cull the actors' bounding boxes in batches, see Frustum::cullAABBs()
+  const int batch_size = 64;
+  float min_x[batch_size], min_y[batch_size], min_z[batch_size];
+  float max_x[batch_size], max_y[batch_size], max_z[batch_size];
+  u32 visible[batch_size / 32];
+
+  for(size_t first=0; first<actors()->size(); first+=batch_size)
   {
-    if (!frustum().cull(actors()->at(i)->boundingBox()))
+    int count = (int)std::min( actors()->size() - first, (size_t)batch_size );
+    for(int j=0; j<count; ++j)
+    {
+      const AABB& aabb = actors()->at(first+j)->boundingBox();
+      min_x[j] = (float)aabb.minCorner().x();
+      min_y[j] = (float)aabb.minCorner().y();
+      min_z[j] = (float)aabb.minCorner().z();
+      max_x[j] = (float)aabb.maxCorner().x();
+      max_y[j] = (float)aabb.maxCorner().y();
+      max_z[j] = (float)aabb.maxCorner().z();
+    }
+
+    frustum().cullAABBs(count, min_x, min_y, min_z, max_x, max_y, max_z, visible);
+
+    for(int j=0; j<count; ++j)
     {
-      intersect(actors()->at(i));
+      if ( visible[j >> 5] & (1u << (j & 31)) )
+      {
+        intersect(actors()->at(first+j));
+      }
     }
   }
 
@@ -0,0 +1,299 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+
+#include <vlGraphics/RenderQueue.hpp>
+#include <algorithm>
+
+using namespace vl;
+
+//-----------------------------------------------------------------------------
+RenderQueue::~RenderQueue()
+{
+  for(size_t i=0; i<mTokenBlocks.size(); ++i)
+    delete [] mTokenBlocks[i];
+}
+//-----------------------------------------------------------------------------
+RenderToken* RenderQueue::allocToken()
+{
+  if ( mTokenBlocks.empty() || mBlockUsed == mTokenBlockSizes.back() )
+  {
+    // the blocks grow geometrically, from 256 tokens
+    int block_size = mTokenBlockSizes.empty() ? 256 : mTokenBlockSizes.back() * 2;
+    mTokenBlocks.push_back( new RenderToken[block_size] );
+    mTokenBlockSizes.push_back( block_size );
+    mBlockUsed = 0;
+  }
+  return &mTokenBlocks.back()[mBlockUsed++];
+}
+//-----------------------------------------------------------------------------
+void RenderQueue::sort(RenderQueueSorter* sorter, Camera* camera)
+{
+  VL_CHECK( sorter )
+
+  computeCameraDistances(sorter, camera, 0);
+
+  mKeysValid = radixSortEnabled() && computeSortKeys(sorter, 0);
+  if ( mKeysValid )
+    radixSort();
+  else
+    std::sort( mList.begin(), mList.begin() + size(), Sorter( sorter ) );
+}
+//-----------------------------------------------------------------------------
+void RenderQueue::eraseActors(const std::vector<const Actor*>& actors)
+{
+  if (actors.empty())
+    return;
+
+  // stable compaction, the erased tokens are kept past the end for reuse
+  int count = 0;
+  for(int i=0; i<mSize; ++i)
+  {
+    if ( std::binary_search(actors.begin(), actors.end(), (const Actor*)mList[i]->mActor) )
+      continue;
+    if (count != i)
+      std::swap( mList[count], mList[i] );
+    ++count;
+  }
+  mSize = count;
+
+  count = 0;
+  for(int i=0; i<mSizeMP; ++i)
+  {
+    if ( std::binary_search(actors.begin(), actors.end(), (const Actor*)mListMP[i]->mActor) )
+      continue;
+    if (count != i)
+      std::swap( mListMP[count], mListMP[i] );
+    ++count;
+  }
+  mSizeMP = count;
+}
+//-----------------------------------------------------------------------------
+void RenderQueue::merge(RenderQueue* other, RenderQueueSorter* sorter, Camera* camera)
+{
+  VL_CHECK( sorter )
+  VL_CHECK( other && other != this )
+
+  const int first = size();
+  appendTokens(other);
+  if (first == size())
+    return;
+  if (first == 0)
+  {
+    sort(sorter, camera);
+    return;
+  }
+
+  computeCameraDistances(sorter, camera, first);
+
+  if (mKeysValid)
+  {
+    // the new keys share the shader and renderable ids assigned by the last sort()
+    if ( !radixSortEnabled() || !computeSortKeys(sorter, first) )
+    {
+      sort(sorter, camera);
+      return;
+    }
+    std::stable_sort( mList.begin() + first, mList.begin() + size(), KeySorter() );
+    std::inplace_merge( mList.begin(), mList.begin() + first, mList.begin() + size(), KeySorter() );
+  }
+  else
+  {
+    std::sort( mList.begin() + first, mList.begin() + size(), Sorter( sorter ) );
+    std::inplace_merge( mList.begin(), mList.begin() + first, mList.begin() + size(), Sorter( sorter ) );
+  }
+}
+//-----------------------------------------------------------------------------
+void RenderQueue::appendTokens(RenderQueue* other)
+{
+  for(int i=0; i<other->size(); ++i)
+  {
+    const RenderToken* src = other->at(i);
+    RenderToken* tok = newToken(false);
+    *tok = *src;
+    for(src = src->mNextPass; src; src = src->mNextPass)
+    {
+      RenderToken* pass = newToken(true);
+      *pass = *src;
+      tok->mNextPass = pass;
+      tok = pass;
+    }
+  }
+
+  other->clear();
+}
+//-----------------------------------------------------------------------------
+void RenderQueue::computeCameraDistances(RenderQueueSorter* sorter, Camera* camera, int first)
+{
+  if (sorter->mightNeedZCameraDistance())
+  {
+    for(int i=first; i<size(); ++i)
+    {
+      RenderToken* tok = at(i);
+      vec3 center = tok->mRenderable->boundingBox().isNull() ? vec3(0,0,0) : tok->mRenderable->boundingBox().center();
+      if ( sorter->confirmZCameraDistanceNeed(tok) )
+      {
+        if (tok->mActor->transform())
+          // tok->mCameraDistance = ( camera->viewMatrix() * (tok->mActor->transform()->worldMatrix() * center) ).lengthSquared();
+          tok->mCameraDistance = -( camera->viewMatrix() * (tok->mActor->transform()->worldMatrix() * center) ).z();
+        else
+          // tok->mCameraDistance = ( camera->viewMatrix() * /* I* */ center ).lengthSquared();
+          tok->mCameraDistance = -( camera->viewMatrix() * /* I* */ center ).z();
+      }
+      else
+        tok->mCameraDistance = 0;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+bool RenderQueue::computeSortKeys(RenderQueueSorter* sorter, int first)
+{
+  if (first == 0)
+  {
+    mShaderIds.reset(size());
+    mRenderableIds.reset(size());
+  }
+  for(int i=first; i<size(); ++i)
+  {
+    RenderToken* tok = at(i);
+    u32 shader_id = mShaderIds.id(tok->mShader);
+    u32 renderable_id = mRenderableIds.id(tok->mRenderable);
+    if ( shader_id >= RenderQueueSorter::MaxShaderIds || renderable_id >= RenderQueueSorter::MaxRenderableIds )
+      return false;
+    if ( !sorter->computeSortKey(tok, shader_id, renderable_id, tok->mSortKey) )
+      return false;
+  }
+  return true;
+}
+//-----------------------------------------------------------------------------
+void RenderQueue::radixSort()
+{
+  const int count = size();
+  if (count < 2)
+    return;
+
+  mKeys.resize(count);
+  mKeysTmp.resize(count);
+
+  // one histogram per byte, computed in a single pass
+  u32 histogram[8][256];
+  memset(histogram, 0, sizeof(histogram));
+  for(int i=0; i<count; ++i)
+  {
+    u64 key = at(i)->mSortKey;
+    mKeys[i] = std::make_pair(key, at(i));
+    for(int b=0; b<8; ++b)
+      ++histogram[b][(key >> (b*8)) & 0xFF];
+  }
+
+  // stable counting sort from the least significant byte, skipping the bytes equal in every key
+  std::pair<u64, RenderToken*>* src = &mKeys[0];
+  std::pair<u64, RenderToken*>* dst = &mKeysTmp[0];
+  for(int b=0; b<8; ++b)
+  {
+    if ( histogram[b][(src[0].first >> (b*8)) & 0xFF] == (u32)count )
+      continue;
+
+    u32 offset[256];
+    u32 sum = 0;
+    for(int d=0; d<256; ++d)
+    {
+      offset[d] = sum;
+      sum += histogram[b][d];
+    }
+
+    for(int i=0; i<count; ++i)
+      dst[ offset[(src[i].first >> (b*8)) & 0xFF]++ ] = src[i];
+
+    std::swap(src, dst);
+  }
+
+  for(int i=0; i<count; ++i)
+    mList[i] = src[i].second;
+}
+//-----------------------------------------------------------------------------
+void RenderQueue::IdMap::reset(int capacity)
+{
+  // power of two at least twice the capacity
+  size_t table_size = 16;
+  while( table_size < (size_t)capacity * 2 )
+    table_size *= 2;
+  mPointers.assign(table_size, (const void*)NULL);
+  mIds.resize(table_size);
+  mCount = 0;
+}
+//-----------------------------------------------------------------------------
+u32 RenderQueue::IdMap::id(const void* ptr)
+{
+  if (ptr == NULL)
+    return 0;
+  size_t mask = mPointers.size() - 1;
+  size_t h = ((size_t)ptr >> 4) * 2654435761u;
+  for(size_t i = h & mask; ; i = (i + 1) & mask)
+  {
+    if (mPointers[i] == ptr)
+      return mIds[i];
+    if (mPointers[i] == NULL)
+    {
+      if ( (mCount + 1) * 2 > mPointers.size() )
+      {
+        grow();
+        return id(ptr);
+      }
+      mPointers[i] = ptr;
+      mIds[i] = mCount;
+      return mCount++;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void RenderQueue::IdMap::grow()
+{
+  std::vector<const void*> pointers;
+  std::vector<u32> ids;
+  pointers.swap(mPointers);
+  ids.swap(mIds);
+  mPointers.assign(pointers.size() * 2, (const void*)NULL);
+  mIds.resize(pointers.size() * 2);
+  size_t mask = mPointers.size() - 1;
+  for(size_t j=0; j<pointers.size(); ++j)
+  {
+    if (pointers[j] == NULL)
+      continue;
+    size_t h = ((size_t)pointers[j] >> 4) * 2654435761u;
+    size_t i = h & mask;
+    while(mPointers[i] != NULL)
+      i = (i + 1) & mask;
+    mPointers[i] = pointers[j];
+    mIds[i] = ids[j];
+  }
+}
+//-----------------------------------------------------------------------------
@@ -33,6 +33,7 @@
 #define RenderQueue_INCLUDE_ONCE
 
 #include <vlGraphics/RenderQueueSorter.hpp>
+#include <vector>
 
 namespace vl
 {
@@ -42,37 +43,41 @@ namespace vl
   /**
    * The RenderQueue class collects a list of RenderToken objects to be sorted and rendered.
   */
-  class RenderQueue: public Object
+  class VLGRAPHICS_EXPORT RenderQueue: public Object
   {
     VL_INSTRUMENT_CLASS(vl::RenderQueue, Object)
 
   public:
-    RenderQueue(): mSize(0), mSizeMP(0)
+    RenderQueue(): mBlockUsed(0), mSize(0), mSizeMP(0), mRadixSortEnabled(true), mKeysValid(false), mFillStamp(0)
     {
       VL_DEBUG_SET_OBJECT_NAME()
       mList.reserve(100);
       mListMP.reserve(100);
     }
 
-    const RenderToken* at(int i) const { return mList[i].get(); }
+    ~RenderQueue();
 
-    RenderToken* at(int i) { return mList[i].get(); }
+    const RenderToken* at(int i) const { return mList[i]; }
 
+    RenderToken* at(int i) { return mList[i]; }
+
+    /**
+     * Returns a token to be filled. The tokens are stored by value in blocks owned by the queue and are recycled
+     * by clear(), once the queue has grown to its steady state size no memory is allocated.
+     */
     RenderToken* newToken(bool multipass)
     {
       if (multipass)
       {
-        ++mSizeMP;
-        if ( mSizeMP > (int)mListMP.size() )
-          mListMP.push_back( new RenderToken );
-        return mListMP[mSizeMP-1].get();
+        if ( mSizeMP == (int)mListMP.size() )
+          mListMP.push_back( allocToken() );
+        return mListMP[mSizeMP++];
       }
       else
       {
-        ++mSize;
-        if ( mSize > (int)mList.size() )
-          mList.push_back( new RenderToken );
-        return mList[mSize-1].get();
+        if ( mSize == (int)mList.size() )
+          mList.push_back( allocToken() );
+        return mList[mSize++];
       }
     }
 
@@ -92,57 +97,109 @@ namespace vl
       return mSize;
     }
 
-    void sort(RenderQueueSorter* sorter, Camera* camera)
-    {
-      if (sorter->mightNeedZCameraDistance())
-      {
-        for(int i=0; i<size(); ++i)
-        {
-          RenderToken* tok = at(i);
-          vec3 center = tok->mRenderable->boundingBox().isNull() ? vec3(0,0,0) : tok->mRenderable->boundingBox().center();
-          if ( sorter->confirmZCameraDistanceNeed(tok) )
-          {
-            if (tok->mActor->transform())
-              // tok->mCameraDistance = ( camera->viewMatrix() * (tok->mActor->transform()->worldMatrix() * center) ).lengthSquared();
-              tok->mCameraDistance = -( camera->viewMatrix() * (tok->mActor->transform()->worldMatrix() * center) ).z();
-            else
-              // tok->mCameraDistance = ( camera->viewMatrix() * /* I* */ center ).lengthSquared();
-              tok->mCameraDistance = -( camera->viewMatrix() * /* I* */ center ).z();
-          }
-          else
-            tok->mCameraDistance = 0;
-        }
-      }
+    /**
+     * Sorts the queue according to the given RenderQueueSorter.
+     * If radixSortEnabled() and the sorter supports RenderQueueSorter::computeSortKey() the tokens are sorted by their
+     * RenderToken::mSortKey with an LSD radix sort, otherwise std::sort() and RenderQueueSorter::operator() are used.
+     */
+    void sort(RenderQueueSorter* sorter, Camera* camera);
+
+    /**
+     * Removes the tokens, including the multipass ones, belonging to the given Actors.
+     * The remaining tokens keep their relative order so that a sorted queue stays sorted.
+     * \param actors The Actors to be removed, sorted by address.
+     */
+    void eraseActors(const std::vector<const Actor*>& actors);
+
+    /**
+     * Copies the tokens of \p other into this queue, which must have been sorted with sort() using the same sorter and camera.
+     * The copied tokens are sorted and merged with the existing ones, the result is equivalent to sorting the whole queue
+     * but costs O(N + M log M), M being the number of copied tokens. \p other is cleared.
+     */
+    void merge(RenderQueue* other, RenderQueueSorter* sorter, Camera* camera);
 
-      VL_CHECK( sorter )
-      std::sort( mList.begin(), mList.begin() + size(), Sorter( sorter ) );
+    //! Enables the radix sort of the tokens based on RenderQueueSorter::computeSortKey() (enabled by default).
+    void setRadixSortEnabled(bool enabled) { mRadixSortEnabled = enabled; }
+
+    //! Whether the tokens are radix sorted when the RenderQueueSorter supports it, see setRadixSortEnabled().
+    bool radixSortEnabled() const { return mRadixSortEnabled; }
+
+    //! Used internally by Rendering::fillRenderQueue(): returns a new non-zero stamp identifying the current filling of this queue, see Shader::fillStamp().
+    unsigned int nextFillStamp()
+    {
+      if ( ++mFillStamp == 0 )
+        ++mFillStamp;
+      return mFillStamp;
     }
 
+  private:
+    // Assigns dense ids to pointers in first-seen order.
+    class IdMap
+    {
+    public:
+      void reset(int capacity);
+      u32 id(const void* ptr);
+      u32 count() const { return mCount; }
+    private:
+      void grow();
+    private:
+      std::vector<const void*> mPointers;
+      std::vector<u32> mIds;
+      u32 mCount;
+    };
+
+    void computeCameraDistances(RenderQueueSorter* sorter, Camera* camera, int first);
+    bool computeSortKeys(RenderQueueSorter* sorter, int first);
+    void radixSort();
+    // copies the tokens of other, multipass chains included, after the ones of this queue
+    void appendTokens(RenderQueue* other);
+    RenderToken* allocToken();
+
+  private:
+    RenderQueue(const RenderQueue&);
+    RenderQueue& operator=(const RenderQueue&);
+
   private:
     class Sorter
     {
     public:
       Sorter(const RenderQueueSorter* sorter): mRenderQueueSorter(sorter) {}
-      bool operator()(const ref<RenderToken>& a, const ref<RenderToken>& b) const
+      bool operator()(const RenderToken* a, const RenderToken* b) const
       {
         VL_CHECK(a && b);
-        return mRenderQueueSorter->operator()(a.get(), b.get());
+        return mRenderQueueSorter->operator()(a, b);
       }
     protected:
       const RenderQueueSorter* mRenderQueueSorter;
     };
 
+    class KeySorter
+    {
+    public:
+      bool operator()(const RenderToken* a, const RenderToken* b) const { return a->mSortKey < b->mSortKey; }
+    };
+
   protected:
-    // mic fixme: would be nice not to allocate these dinamically.
-    // Necessary because:
-    // 1- RenderToken.mNextPass: the pointer should be stable across std::vector reallocations.
-    //    Maybe we can use indices?
-    // 2- The sorting sorts only pointers instead of whole structures.
+    // The tokens live in mTokenBlocks, which are never reallocated so that RenderToken.mNextPass stays valid,
+    // while the lists hold pointers so that the sorting moves only pointers instead of whole structures.
+    // The tokens are not reference counted: they are owned by the queue and recycled from frame to frame.
     // Note: we need two lists because the sorting must still respect the multipassing order.
-    std::vector< ref<RenderToken> > mList;
-    std::vector< ref<RenderToken> > mListMP;
+    std::vector<RenderToken*> mList;
+    std::vector<RenderToken*> mListMP;
+    std::vector<RenderToken*> mTokenBlocks;
+    std::vector<int> mTokenBlockSizes;
+    int mBlockUsed;
     int mSize;
     int mSizeMP;
+    bool mRadixSortEnabled;
+    // whether the tokens are ordered by mSortKey
+    bool mKeysValid;
+    // radix sort buffers, kept across frames
+    std::vector< std::pair<u64, RenderToken*> > mKeys;
+    std::vector< std::pair<u64, RenderToken*> > mKeysTmp;
+    IdMap mShaderIds;
+    IdMap mRenderableIds;
+    unsigned int mFillStamp;
   };
   //------------------------------------------------------------------------------
   typedef std::map< float, ref<RenderQueue> > TRenderQueueMap;
@@ -33,6 +33,7 @@
 #define RenderQueueSorter_INCLUDE_ONCE
 
 #include <vlGraphics/RenderToken.hpp>
+#include <cstring>
 
 namespace vl
 {
@@ -54,6 +55,49 @@ namespace vl
     virtual bool operator()(const RenderToken* a, const RenderToken* b) const = 0;
     virtual bool confirmZCameraDistanceNeed(const RenderToken*) const = 0;
     virtual bool mightNeedZCameraDistance() const = 0;
+
+    /**
+     * Describes the sorting order of the RenderQueueSorter as a 64 bits key, so that the RenderQueue can be sorted with a radix sort
+     * instead of calling operator() O(n log n) times. The tokens are rendered in increasing key order, tokens with the same key keep
+     * the order in which they were added to the queue.
+     * \p shader_id and \p renderable_id are dense ids assigned by the RenderQueue to the token's Shader and Renderable, they are
+     * smaller than MaxShaderIds and MaxRenderableIds and replace the pointer comparisons.
+     * Returns false if the sorter has no key representation (the default) or if the token's render block and ranks do not fit in
+     * the key, in which case the RenderQueue is sorted with std::sort() and operator().
+     */
+    virtual bool computeSortKey(const RenderToken* /*tok*/, u32 /*shader_id*/, u32 /*renderable_id*/, u64& /*key*/) const { return false; }
+
+    // Layout of the keys computed by the standard sorters, from the most significant bit:
+    // [63-56] Actor render block, [55-48] Effect render rank, [47-40] Actor render rank, [39] blending,
+    // [38-7] camera distance or [38-19] Shader id + [18-0] Renderable id.
+    enum { MaxShaderIds = 1 << 20, MaxRenderableIds = 1 << 19 };
+
+  protected:
+    //! Packs Actor render block, Effect render rank and Actor render rank in the top 24 bits of \p key, returns false if they are not in the range [-128, 127].
+    static bool packRanks(const RenderToken* tok, u64& key)
+    {
+      int block = tok->mActor->renderBlock() + 128;
+      int effect_rank = tok->mEffectRenderRank + 128;
+      int actor_rank = tok->mActor->renderRank() + 128;
+      if ( (block | effect_rank | actor_rank) & ~0xFF )
+        return false;
+      key = ((u64)block << 56) | ((u64)effect_rank << 48) | ((u64)actor_rank << 40);
+      return true;
+    }
+
+    //! Maps the camera distance to 32 bits preserving its order.
+    static u64 distanceBits(real distance)
+    {
+      float d = (float)distance;
+      u32 bits;
+      memcpy(&bits, &d, sizeof(bits));
+      return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    }
+
+    static u64 packShaderRenderable(u32 shader_id, u32 renderable_id)
+    {
+      return ((u64)shader_id << 19) | renderable_id;
+    }
   };
   //------------------------------------------------------------------------------
   // RenderQueueSorterByShader
@@ -75,6 +119,11 @@ namespace vl
     {
       return a->mShader < b->mShader;
     }
+    virtual bool computeSortKey(const RenderToken*, u32 shader_id, u32, u64& key) const
+    {
+      key = shader_id;
+      return true;
+    }
   };
   //------------------------------------------------------------------------------
   // RenderQueueSorterByRenderable
@@ -96,6 +145,11 @@ namespace vl
     {
       return a->mRenderable < b->mRenderable;
     }
+    virtual bool computeSortKey(const RenderToken*, u32, u32 renderable_id, u64& key) const
+    {
+      key = renderable_id;
+      return true;
+    }
   };
   //------------------------------------------------------------------------------
   // RenderQueueSorterBasic
@@ -133,6 +187,13 @@ namespace vl
       else
         return a->mRenderable < b->mRenderable;
     }
+    virtual bool computeSortKey(const RenderToken* tok, u32 shader_id, u32 renderable_id, u64& key) const
+    {
+      if ( !packRanks(tok, key) )
+        return false;
+      key |= packShaderRenderable(shader_id, renderable_id);
+      return true;
+    }
   };
   //------------------------------------------------------------------------------
   // RenderQueueSorterStandard
@@ -211,6 +272,19 @@ namespace vl
         return a->mRenderable < b->mRenderable;
     }
 
+    virtual bool computeSortKey(const RenderToken* tok, u32 shader_id, u32 renderable_id, u64& key) const
+    {
+      if ( !packRanks(tok, key) )
+        return false;
+      if ( mDepthSortMode != AlwaysDepthSort && tok->mShader->isBlendingEnabled() )
+        key |= (u64)1 << 39;
+      if ( confirmZCameraDistanceNeed(tok) )
+        key |= (~distanceBits(tok->mCameraDistance) & 0xFFFFFFFFu) << 7; // far objects first
+      else
+        key |= packShaderRenderable(shader_id, renderable_id);
+      return true;
+    }
+
     EDepthSortMode depthSortMode() const { return mDepthSortMode; }
     void setDepthSortMode(EDepthSortMode mode) { mDepthSortMode = mode; }
 
@@ -285,6 +359,18 @@ namespace vl
       else
         return a->mRenderable < b->mRenderable;
     }
+
+    //! Tokens at the same distance are not sorted by Shader and Renderable: they keep their queue order.
+    virtual bool computeSortKey(const RenderToken* tok, u32, u32, u64& key) const
+    {
+      if ( !packRanks(tok, key) )
+        return false;
+      if ( tok->mShader->isBlendingEnabled() )
+        key |= ((u64)1 << 39) | ((~distanceBits(tok->mCameraDistance) & 0xFFFFFFFFu) << 7); // far objects first
+      else
+        key |= distanceBits(tok->mCameraDistance) << 7; // close objects first
+      return true;
+    }
   };
   //------------------------------------------------------------------------------
   // RenderQueueSorterAggressive
@@ -43,16 +43,13 @@ namespace vl
   //------------------------------------------------------------------------------
   // RenderToken
   //------------------------------------------------------------------------------
-  //! Internally used by the rendering engine
-  class RenderToken: public Object
+  /** Internally used by the rendering engine.
+   * RenderTokens are plain values owned by the RenderQueue that allocated them: they live in its token pool and are
+   * reused by the following fillings, so they are not reference counted and must not be kept past the queue's next clear(). */
+  class RenderToken
   {
-    VL_INSTRUMENT_CLASS(vl::RenderToken, Object)
-
   public:
-    RenderToken(): mNextPass(NULL), mActor(NULL), mShader(NULL), mEffectRenderRank(0), mCameraDistance(0.0)
-    {
-      VL_DEBUG_SET_OBJECT_NAME()
-    }
+    RenderToken(): mNextPass(NULL), mActor(NULL), mRenderable(NULL), mShader(NULL), mEffectRenderRank(0), mCameraDistance(0.0), mSortKey(0) {}
     const RenderToken* mNextPass;
 
     Actor* mActor; // Actor is non-const as it can be updated by the ActorEventCallback
@@ -61,6 +58,8 @@ namespace vl
     int mEffectRenderRank;
     // Z distance from the camera. Used for object Z-sorting.
     real mCameraDistance;
+    // Computed by RenderQueueSorter::computeSortKey(), the tokens are rendered in increasing key order.
+    u64 mSortKey;
   };
   //------------------------------------------------------------------------------
 }
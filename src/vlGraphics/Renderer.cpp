@@ -51,6 +51,11 @@ Renderer::Renderer()
 
   mDummyEnables  = new EnableSet;
   mDummyStateSet = new RenderStateSet;
+
+  mStatsUniformLocationsCached = 0;
+  mStatsUniformLocationsQueried = 0;
+  mStatsUniformsSkipped = 0;
+  mStatsUniformsIssued = 0;
 }
 //------------------------------------------------------------------------------
 namespace
@@ -93,6 +98,11 @@ const RenderQueue* Renderer::renderRaw(const RenderQueue* render_queue, Camera*
 
   OpenGLContext* opengl_context = framebuffer()->openglContext();
 
+  mStatsUniformLocationsCached = 0;
+  mStatsUniformLocationsQueried = 0;
+  mStatsUniformsSkipped = 0;
+  mStatsUniformsIssued = 0;
+
   // --------------- default scissor ---------------
 
   // non GLSLProgram state sets
@@ -243,6 +253,9 @@ const RenderQueue* Renderer::renderRaw(const RenderQueue* render_queue, Camera*
 
         // create a new glsl-state entry
         glsl_state = &glslprogram_map[cur_glsl_program];
+        if (cur_glsl_program) {
+          cur_glsl_program->resetUniformStats();
+        }
         update_cm = true;
         update_tr = true;
         update_pu = cur_glsl_prog_uniform_set != NULL;
@@ -341,6 +354,18 @@ const RenderQueue* Renderer::renderRaw(const RenderQueue* render_queue, Camera*
     }
   }
 
+  // collect uniform statistics
+  for( std::map<const GLSLProgram*, GLSLProgState>::const_iterator it = glslprogram_map.begin(); it != glslprogram_map.end(); ++it )
+  {
+    if ( it->first )
+    {
+      mStatsUniformLocationsCached  += it->first->statsUniformLocationsCached();
+      mStatsUniformLocationsQueried += it->first->statsUniformLocationsQueried();
+      mStatsUniformsSkipped         += it->first->statsUniformsSkipped();
+      mStatsUniformsIssued          += it->first->statsUniformsIssued();
+    }
+  }
+
   // clear enables
   opengl_context->applyEnables( mDummyEnables.get() ); VL_CHECK_OGL();
 
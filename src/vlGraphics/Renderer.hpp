@@ -102,6 +102,19 @@ namespace vl
     /** The Framebuffer on which the rendering is performed. */
     FramebufferObject* framebuffer() { return mFramebuffer.get(); }
 
+    /** Number of glGetUniformLocation() calls saved during the last render() thanks to the GLSLProgram's uniform location table.
+      * See also GLSLProgram::uniformLocation(). */
+    int statsUniformLocationsCached() const { return mStatsUniformLocationsCached; }
+
+    /** Number of glGetUniformLocation() calls issued during the last render(), normally non-zero only the first time a uniform is seen by a GLSLProgram. */
+    int statsUniformLocationsQueried() const { return mStatsUniformLocationsQueried; }
+
+    /** Number of glUniform* calls skipped during the last render() because the uniform value was already current, see GLSLProgram::setUniformDeltaBinding(). */
+    int statsUniformsSkipped() const { return mStatsUniformsSkipped; }
+
+    /** Number of glUniform* calls issued during the last render(). */
+    int statsUniformsIssued() const { return mStatsUniformsIssued; }
+
   protected:
     ref<FramebufferObject> mFramebuffer;
 
@@ -114,6 +127,11 @@ namespace vl
     std::vector<RenderStateSlot> mOverriddenDefaultRenderStates;
 
     ref<ProjViewTransfCallback> mProjViewTransfCallback;
+
+    int mStatsUniformLocationsCached;
+    int mStatsUniformLocationsQueried;
+    int mStatsUniformsSkipped;
+    int mStatsUniformsIssued;
   };
   //------------------------------------------------------------------------------
 }
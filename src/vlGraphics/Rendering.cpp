@@ -37,16 +37,51 @@
 #include <vlGraphics/GLSL.hpp>
 #include <vlCore/Log.hpp>
 #include <vlCore/Say.hpp>
+#include <algorithm>
 
 using namespace vl;
 
+namespace
+{
+  // FNV-1a over 64 bit words
+  inline u64 hashMix(u64 h, u64 v) { return (h ^ v) * 0x100000001B3ULL; }
+
+  // splitmix64 finalizer, spreads the bits of a hash before summing it with others
+  inline u64 hashFinalize(u64 h)
+  {
+    h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27; h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+  }
+
+  inline u64 hashMix(u64 h, const void* ptr) { return hashMix(h, (u64)(size_t)ptr); }
+
+  u64 hashReals(u64 h, const real* values, int count)
+  {
+    for(int i=0; i<count; ++i)
+    {
+      u64 bits = 0;
+      memcpy(&bits, &values[i], sizeof(real));
+      h = hashMix(h, bits);
+    }
+    return h;
+  }
+}
+
 //------------------------------------------------------------------------------
 Rendering::Rendering():
   mAutomaticResourceInit(true),
   mCullingEnabled(true),
   mEvaluateLOD(true),
   mShaderAnimationEnabled(true),
-  mNearFarClippingPlanesOptimized(false)
+  mNearFarClippingPlanesOptimized(false),
+  mRenderQueueReuseEnabled(false),
+  mRenderQueueHash(0),
+  mRenderQueueCameraHash(0),
+  mStatsRenderQueueHits(0),
+  mStatsRenderQueuePatches(0),
+  mStatsRenderQueueMisses(0)
 {
   VL_DEBUG_SET_OBJECT_NAME()
   mRenderQueueSorter  = new RenderQueueSorterStandard;
@@ -68,6 +103,8 @@ Rendering& Rendering::operator=(const Rendering& other)
   mEvaluateLOD              = other.mEvaluateLOD;
   mShaderAnimationEnabled   = other.mShaderAnimationEnabled;
   mNearFarClippingPlanesOptimized = other.mNearFarClippingPlanesOptimized;
+  mRenderQueueReuseEnabled  = other.mRenderQueueReuseEnabled;
+  invalidateRenderQueue();
 
   mRenderQueueSorter   = other.mRenderQueueSorter;
   /*mActorQueue        = other.mActorQueue;*/
@@ -233,15 +270,20 @@ void Rendering::render()
     camera()->computeFrustumPlanes();
   }
 
-  // render queue filling
+  // render queue filling and sorting
 
-  renderQueue()->clear();
-  fillRenderQueue( actorQueue() );
+  if ( renderQueueReuseEnabled() && renderQueueSorter() )
+    updateRenderQueue();
+  else
+  {
+    renderQueue()->clear();
+    fillRenderQueue( actorQueue() );
 
-  // sort the rendering queue according to this renderer sorting algorithm
+    // sort the rendering queue according to this renderer sorting algorithm
 
-  if (renderQueueSorter())
-    renderQueue()->sort( renderQueueSorter(), camera() );
+    if (renderQueueSorter())
+      renderQueue()->sort( renderQueueSorter(), camera() );
+  }
 
   // --- RENDER THE QUEUE: loop through the renderers, feeding the output of one as input for the next ---
 
@@ -272,7 +314,198 @@ void Rendering::render()
   VL_CHECK_OGL()
 }
 //------------------------------------------------------------------------------
-void Rendering::fillRenderQueue( ActorCollection* actor_list )
+void Rendering::updateRenderQueue()
+{
+  // hash the camera and the state of every visible Actor that affects the filling and sorting of the queue
+
+  u64 camera_hash = hashMix(0xCBF29CE484222325ULL, renderQueueSorter());
+  camera_hash = hashMix(camera_hash, (u64)enableMask());
+  if (camera())
+  {
+    camera_hash = hashReals(camera_hash, camera()->viewMatrix().ptr(), 16);
+    camera_hash = hashReals(camera_hash, camera()->projectionMatrix().ptr(), 16);
+    if (camera()->viewport())
+    {
+      camera_hash = hashMix(camera_hash, (u64)camera()->viewport()->x());
+      camera_hash = hashMix(camera_hash, (u64)camera()->viewport()->y());
+      camera_hash = hashMix(camera_hash, (u64)camera()->viewport()->width());
+      camera_hash = hashMix(camera_hash, (u64)camera()->viewport()->height());
+    }
+  }
+
+  // the resources of the visible Shaders are checked here so that a reused queue gets them too
+  unsigned int fill_stamp = automaticResourceInit() ? renderQueue()->nextFillStamp() : 0;
+
+  mVisibleActors.clear();
+  u64 actors_hash = 0;
+  for(size_t iactor=0; camera() && enableMask() && iactor<actorQueue()->size(); ++iactor)
+  {
+    Actor* actor = actorQueue()->at(iactor);
+    if ( ! isEnabled(actor) )
+      continue;
+
+    actor->computeBounds();
+
+    Effect* effect = actorEffect(actor);
+    if ( !isEnabled(effect->enableMask()) )
+      continue;
+
+    int effect_lod = effect->evaluateLOD( actor, camera() );
+    int geometry_lod = evaluateLOD() ? actor->evaluateLOD( camera() ) : 0;
+    Renderable* renderable = actor->lod(geometry_lod);
+
+    u64 h = hashMix(0xCBF29CE484222325ULL, actor);
+    h = hashMix(h, effect);
+    h = hashMix(h, (u64)effect_lod);
+    h = hashMix(h, renderable);
+    h = hashMix(h, (u64)(renderable ? renderable->boundsUpdateTick() : -1));
+    h = hashMix(h, (u64)(actor->transform() ? actor->transform()->worldMatrixUpdateTick() : -1));
+    h = hashMix(h, (u64)actor->renderRank());
+    h = hashMix(h, (u64)actor->renderBlock());
+    h = hashMix(h, (u64)effect->renderRank());
+    const int pass_count = effect->lod(effect_lod)->size();
+    for(int ipass=0; ipass<pass_count; ++ipass)
+    {
+      Shader* shader = effect->lod(effect_lod)->at(ipass);
+      animateShader(shader);
+      if ( automaticResourceInit() )
+        initShaderResources(shader, renderQueue(), fill_stamp);
+      h = hashMix(h, shader);
+      h = hashMix(h, (u64)shader->isBlendingEnabled());
+    }
+
+    h = hashFinalize(h);
+    mVisibleActors.push_back( std::make_pair(actor, h) );
+    actors_hash += h;
+  }
+
+  // the sum makes the frame hash independent from the culling order
+  camera_hash = hashFinalize(camera_hash);
+  u64 frame_hash = hashFinalize( hashMix( hashMix(camera_hash, actors_hash), (u64)mVisibleActors.size() ) );
+  if (frame_hash == 0)
+    frame_hash = 1;
+
+  if ( frame_hash == mRenderQueueHash )
+  {
+    ++mStatsRenderQueueHits;
+    return;
+  }
+
+  std::sort( mVisibleActors.begin(), mVisibleActors.end() );
+
+  // an Actor queued more than once is not tracked, rebuild the queue
+  bool duplicates = false;
+  for(size_t i=1; i<mVisibleActors.size() && !duplicates; ++i)
+    duplicates = mVisibleActors[i].first == mVisibleActors[i-1].first;
+
+  bool patched = false;
+  if ( !duplicates && mRenderQueueHash && camera_hash == mRenderQueueCameraHash )
+  {
+    // diff the sorted visible lists, a changed Actor is both removed and added
+
+    if (!mRenderQueuePatch)
+    {
+      mRenderQueuePatch = new RenderQueue;
+      mRenderQueuePatchActors = new ActorCollection;
+    }
+    mRenderQueuePatchActors->clear();
+    // the walk is in address order so the removed list comes out sorted
+    std::vector<const Actor*>& removed = mRenderQueueRemoved;
+    removed.clear();
+
+    size_t i = 0, j = 0;
+    while( i<mRenderQueueActors.size() || j<mVisibleActors.size() )
+    {
+      if ( j == mVisibleActors.size() || (i<mRenderQueueActors.size() && mRenderQueueActors[i].mActor.get() < mVisibleActors[j].first) )
+        removed.push_back( mRenderQueueActors[i++].mActor.get() );
+      else
+      if ( i == mRenderQueueActors.size() || mVisibleActors[j].first < mRenderQueueActors[i].mActor.get() )
+        mRenderQueuePatchActors->push_back( mVisibleActors[j++].first );
+      else
+      {
+        if ( mRenderQueueActors[i].mHash != mVisibleActors[j].second )
+        {
+          removed.push_back( mRenderQueueActors[i].mActor.get() );
+          mRenderQueuePatchActors->push_back( mVisibleActors[j].first );
+        }
+        ++i; ++j;
+      }
+    }
+
+    size_t delta = removed.size() + mRenderQueuePatchActors->size();
+    if ( delta * 4 <= mVisibleActors.size() )
+    {
+      renderQueue()->eraseActors(removed);
+      mRenderQueuePatch->clear();
+      fillRenderQueue( mRenderQueuePatch.get(), mRenderQueuePatchActors.get() );
+      renderQueue()->merge( mRenderQueuePatch.get(), renderQueueSorter(), camera() );
+      mRenderQueuePatchActors->clear();
+      removed.clear();
+      patched = true;
+      ++mStatsRenderQueuePatches;
+    }
+  }
+
+  if (!patched)
+  {
+    renderQueue()->clear();
+    fillRenderQueue( actorQueue() );
+    renderQueue()->sort( renderQueueSorter(), camera() );
+    ++mStatsRenderQueueMisses;
+  }
+
+  // remember the queued Actors, the references keep their addresses from being reused
+
+  mRenderQueueActors.clear();
+  for(size_t i=0; i<mVisibleActors.size(); ++i)
+    mRenderQueueActors.push_back( VisibleActor(mVisibleActors[i].first, mVisibleActors[i].second) );
+  mVisibleActors.clear();
+  mRenderQueueHash = duplicates ? 0 : frame_hash;
+  mRenderQueueCameraHash = camera_hash;
+}
+//------------------------------------------------------------------------------
+Effect* Rendering::actorEffect(Actor* actor)
+{
+  Effect* effect = actor->effect();
+  VL_CHECK(effect)
+
+  // effect override: select the first that matches
+
+  for( std::map< unsigned int, ref<Effect> >::iterator eom_it = mEffectOverrideMask.begin();
+       eom_it != mEffectOverrideMask.end();
+       ++eom_it )
+  {
+    if (eom_it->first & actor->enableMask())
+    {
+      effect = eom_it->second.get();
+      break;
+    }
+  }
+
+  return effect;
+}
+//------------------------------------------------------------------------------
+void Rendering::animateShader(Shader* shader)
+{
+  if ( shaderAnimationEnabled() )
+  {
+    VL_CHECK(frameClock() >= 0)
+    if( frameClock() >= 0 )
+    {
+      // note that the condition is != as opposed to <
+      if ( shader->lastUpdateTime() != frameClock() && shader->shaderAnimator() && shader->shaderAnimator()->isEnabled() )
+      {
+        // update
+        shader->shaderAnimator()->updateShader( shader, camera(), frameClock() );
+
+        // note that we update this after
+        shader->setLastUpdateTime( frameClock() );
+      }
+    }
+  }
+}
+//------------------------------------------------------------------------------
+void Rendering::fillRenderQueue( RenderQueue* list, ActorCollection* actor_list )
 {
   if (actor_list == NULL)
     return;
@@ -286,8 +519,8 @@ void Rendering::fillRenderQueue( ActorCollection* actor_list )
   if (enableMask() == 0)
     return;
 
-  RenderQueue* list = renderQueue();
-  std::set<Shader*> shader_set;
+  // identifies this filling, stamped on the Shaders together with the queue as their resources are checked
+  unsigned int fill_stamp = list->nextFillStamp();
 
   // iterate actor list
 
@@ -303,21 +536,7 @@ void Rendering::fillRenderQueue( ActorCollection* actor_list )
     // update the Actor's bounds
     actor->computeBounds();
 
-    Effect* effect = actor->effect();
-    VL_CHECK(effect)
-
-    // effect override: select the first that matches
-
-    for( std::map< unsigned int, ref<Effect> >::iterator eom_it = mEffectOverrideMask.begin();
-         eom_it != mEffectOverrideMask.end();
-         ++eom_it )
-    {
-      if (eom_it->first & actor->enableMask())
-      {
-        effect = eom_it->second.get();
-        break;
-      }
-    }
+    Effect* effect = actorEffect(actor);
 
     if ( !isEnabled(effect->enableMask()) )
       continue;
@@ -356,57 +575,48 @@ void Rendering::fillRenderQueue( ActorCollection* actor_list )
       // set the shader used (multipassing shader or effect->shader())
       tok->mShader = shader;
 
-      if ( shaderAnimationEnabled() )
-      {
-        VL_CHECK(frameClock() >= 0)
-        if( frameClock() >= 0 )
-        {
-          // note that the condition is != as opposed to <
-          if ( shader->lastUpdateTime() != frameClock() && shader->shaderAnimator() && shader->shaderAnimator()->isEnabled() )
-          {
-            // update
-            shader->shaderAnimator()->updateShader( shader, camera(), frameClock() );
-
-            // note that we update this after
-            shader->setLastUpdateTime( frameClock() );
-          }
-        }
-      }
+      animateShader(shader);
 
-      if ( automaticResourceInit() && shader_set.find(shader) == shader_set.end() )
-      {
-        shader_set.insert(shader);
+      if ( automaticResourceInit() )
+        initShaderResources(shader, list, fill_stamp);
 
-        // link GLSLProgram
-        if ( shader->glslProgram() && ! shader->glslProgram()->linked() )
-        {
-          shader->glslProgram()->linkProgram();
-          // VL_CHECK( shader->glslProgram()->linked() );
-        }
+      tok->mEffectRenderRank = effect->renderRank();
+    }
+  }
+}
+//------------------------------------------------------------------------------
+void Rendering::initShaderResources(Shader* shader, const RenderQueue* list, unsigned int fill_stamp)
+{
+  if ( shader->fillStamp() == fill_stamp && shader->fillQueue() == list )
+    return;
 
-        // lazy texture creation
-        if ( shader->gocRenderStateSet() )
+  shader->setFillStamp(list, fill_stamp);
+
+  // link GLSLProgram
+  if ( shader->glslProgram() && ! shader->glslProgram()->linked() )
+  {
+    shader->glslProgram()->linkProgram();
+    // VL_CHECK( shader->glslProgram()->linked() );
+  }
+
+  // lazy texture creation
+  if ( shader->gocRenderStateSet() )
+  {
+    size_t count = shader->gocRenderStateSet()->renderStatesCount();
+    RenderStateSlot* states = shader->gocRenderStateSet()->renderStates();
+    for( size_t i=0; i<count; ++i )
+    {
+      if (states[i].mRS->type() == RS_TextureImageUnit)
+      {
+        TextureImageUnit* tex_unit = static_cast<TextureImageUnit*>( states[i].mRS.get() );
+        VL_CHECK(tex_unit);
+        if (tex_unit)
         {
-          size_t count = shader->gocRenderStateSet()->renderStatesCount();
-          RenderStateSlot* states = shader->gocRenderStateSet()->renderStates();
-          for( size_t i=0; i<count; ++i )
-          {
-            if (states[i].mRS->type() == RS_TextureImageUnit)
-            {
-              TextureImageUnit* tex_unit = static_cast<TextureImageUnit*>( states[i].mRS.get() );
-              VL_CHECK(tex_unit);
-              if (tex_unit)
-              {
-                if (tex_unit->texture() && tex_unit->texture()->setupParams() && ! tex_unit->texture()->handle() ) {
-                  tex_unit->texture()->createTexture();
-                }
-              }
-            }
+          if (tex_unit->texture() && tex_unit->texture()->setupParams() && ! tex_unit->texture()->handle() ) {
+            tex_unit->texture()->createTexture();
           }
         }
       }
-
-      tok->mEffectRenderRank = effect->renderRank();
     }
   }
 }
@@ -201,15 +201,62 @@ namespace vl
         See also vl::Actor::enableMask() and vl::Renderer::shaderOverrideMask(). */
     std::map<unsigned int, ref<Effect> >& effectOverrideMask() { return mEffectOverrideMask; }
 
+    /** Enables the reuse of the sorted RenderQueue across frames (disabled by default), useful for mostly static viewers.
+      * Every frame the visible Actors are hashed together with their Effect, Effect and geometry LOD, Transform, ranks and
+      * blending state of the selected Shaders, and with the Camera matrices and viewport. If nothing changed the previous
+      * RenderQueue is rendered again without being refilled and sorted. If only a few Actors appeared, disappeared or changed
+      * and the Camera did not change, their tokens are removed from the previous RenderQueue and the new ones are sorted
+      * and merged into it. Otherwise the RenderQueue is rebuilt as usual. Shader animation and, if automaticResourceInit()
+      * is enabled, GLSL program linking and lazy texture creation are performed every frame for the visible Shaders.
+      * \note Changes not covered by the hashing, for example the RenderQueueSorter settings, require invalidateRenderQueue().
+      * Used only when a renderQueueSorter() is installed. */
+    void setRenderQueueReuseEnabled(bool enabled) { mRenderQueueReuseEnabled = enabled; invalidateRenderQueue(); }
+
+    /** Whether the RenderQueue is reused across frames, see setRenderQueueReuseEnabled(). */
+    bool renderQueueReuseEnabled() const { return mRenderQueueReuseEnabled; }
+
+    /** Forces the RenderQueue to be rebuilt at the next frame, see setRenderQueueReuseEnabled(). */
+    void invalidateRenderQueue() { mRenderQueueActors.clear(); mRenderQueueHash = 0; mRenderQueueCameraHash = 0; }
+
+    /** Number of frames that reused the previous RenderQueue as is, see setRenderQueueReuseEnabled(). */
+    int statsRenderQueueHits() const { return mStatsRenderQueueHits; }
+
+    /** Number of frames that patched the previous RenderQueue, see setRenderQueueReuseEnabled(). */
+    int statsRenderQueuePatches() const { return mStatsRenderQueuePatches; }
+
+    /** Number of frames that rebuilt the RenderQueue while the reuse was enabled, see setRenderQueueReuseEnabled(). */
+    int statsRenderQueueMisses() const { return mStatsRenderQueueMisses; }
+
+    /** Resets statsRenderQueueHits(), statsRenderQueuePatches() and statsRenderQueueMisses(). */
+    void resetRenderQueueStats() { mStatsRenderQueueHits = mStatsRenderQueuePatches = mStatsRenderQueueMisses = 0; }
+
   protected:
     // mic fixme: it would be nice to have a mechanism to request the visible actors at will and to
     // compile and save the render-queue for later renderings to be reused without recomputing the culling.
     // The user could be able to install actor-list or render-queue and use the flags READ|WRITE|TERMINATE
     // to define wether the list should be used for reading, filled, cleaned up after rendering.
-    void fillRenderQueue( ActorCollection* actor_list );
+    void fillRenderQueue( ActorCollection* actor_list ) { fillRenderQueue( renderQueue(), actor_list ); }
+    void fillRenderQueue( RenderQueue* list, ActorCollection* actor_list );
+    //! Fills and sorts the render queue reusing the one of the previous frame when possible, see setRenderQueueReuseEnabled().
+    void updateRenderQueue();
+    //! Returns the Effect used to render the given Actor taking into account effectOverrideMask().
+    Effect* actorEffect(Actor* actor);
+    //! Updates the Shader using its ShaderAnimator if shaderAnimationEnabled(), at most once per frame.
+    void animateShader(Shader* shader);
+    //! Links the Shader's GLSLProgram and creates its textures if needed, at most once per \p fill_stamp of the given queue, see automaticResourceInit().
+    void initShaderResources(Shader* shader, const RenderQueue* list, unsigned int fill_stamp);
     RenderQueue* renderQueue() { return mRenderQueue.get(); }
     ActorCollection* actorQueue() { return mActorQueue.get(); }
 
+  protected:
+    struct VisibleActor
+    {
+      VisibleActor(Actor* actor, u64 hash): mActor(actor), mHash(hash) {}
+      bool operator<(const VisibleActor& other) const { return mActor < other.mActor; }
+      ref<Actor> mActor;
+      u64 mHash;
+    };
+
   protected:
     ref<RenderQueueSorter> mRenderQueueSorter;
     ref<ActorCollection> mActorQueue;
@@ -225,6 +272,18 @@ namespace vl
     bool mEvaluateLOD;
     bool mShaderAnimationEnabled;
     bool mNearFarClippingPlanesOptimized;
+    // render queue reuse
+    bool mRenderQueueReuseEnabled;
+    ref<RenderQueue> mRenderQueuePatch;
+    ref<ActorCollection> mRenderQueuePatchActors;
+    std::vector<VisibleActor> mRenderQueueActors;
+    std::vector< std::pair<Actor*, u64> > mVisibleActors;
+    std::vector<const Actor*> mRenderQueueRemoved;
+    u64 mRenderQueueHash;
+    u64 mRenderQueueCameraHash;
+    int mStatsRenderQueueHits;
+    int mStatsRenderQueuePatches;
+    int mStatsRenderQueueMisses;
   };
 }
 
@@ -46,6 +46,7 @@ SceneManager::SceneManager()
   // mActors = new ActorCollection;
   mBoundsDirty = true;
   mCullingEnabled = true;
+  mParallelCullingEnabled = false;
   mEnableMask = 0xFFFFFFFF;
 }
 //-----------------------------------------------------------------------------
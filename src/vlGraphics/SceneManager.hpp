@@ -66,6 +66,7 @@ namespace vl
    * - SceneManager
    * - SceneManagerActorKdTree
    * - SceneManagerActorTree
+   * - SceneManagerLinearBVH
    * - SceneManagerPortals
    * - Actor
   */
@@ -107,6 +108,11 @@ namespace vl
     //! Used to enable or disable frustum culling or whichever culling system the scene manager implements.
     bool cullingEnabled() const { return mCullingEnabled; }
 
+    //! Enables multithreaded culling for those scene managers that support it (disabled by default), see ActorTreeAbstract::extractVisibleActorsParallel() and GlobalSettings::threadCount().
+    void setParallelCullingEnabled(bool enable) { mParallelCullingEnabled = enable; }
+    //! Whether multithreaded culling is enabled, see setParallelCullingEnabled().
+    bool parallelCullingEnabled() const { return mParallelCullingEnabled; }
+
     //! The enable mask to be used by extractVisibleActors()
     //! \see \see Actor::enableMask(), Actor::isEnabled(), ActorTreeAbstract::isEnabled(), SceneManager::enableMask(), Rendering::enableMask(), Rendering::effectOverrideMask(), Renderer::enableMask(), Renderer::shaderOverrideMask().
     void setEnableMask(unsigned int enabled) { mEnableMask = enabled; }
@@ -123,6 +129,7 @@ namespace vl
     unsigned int mEnableMask;
     bool mBoundsDirty;
     bool mCullingEnabled;
+    bool mParallelCullingEnabled;
   };
 }
 
@@ -68,7 +68,11 @@ namespace vl
     {
       // extracts Actors from the hierarchical volume tree
       if ( cullingEnabled() ) {
-        tree()->extractVisibleActors( list, camera, enableMask() );
+        if ( parallelCullingEnabled() ) {
+          tree()->extractVisibleActorsParallel( list, camera, enableMask() );
+        } else {
+          tree()->extractVisibleActors( list, camera, enableMask() );
+        }
       }
       else {
         extractActors(list);
@@ -46,6 +46,8 @@ Shader::Shader()
 {
   VL_DEBUG_SET_OBJECT_NAME()
   mLastUpdateTime = 0;
+  mFillQueue = NULL;
+  mFillStamp = 0;
   // shader user data
   #ifdef VL_USER_DATA_SHADER
     mShaderUserData = NULL;
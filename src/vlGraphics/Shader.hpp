@@ -50,6 +50,7 @@ namespace vl
   class Light;
   class ClipPlane;
   class Shader;
+  class RenderQueue;
   //------------------------------------------------------------------------------
   // VertexAttrib
   //------------------------------------------------------------------------------
@@ -2332,6 +2333,15 @@ namespace vl
     //! Used internally.
     void setLastUpdateTime(real time) { mLastUpdateTime = time; }
 
+    //! Used internally by Rendering::fillRenderQueue() to process the Shader's resources once per queue filling, see RenderQueue::nextFillStamp().
+    unsigned int fillStamp() const { return mFillStamp; }
+
+    //! Used internally, the RenderQueue whose filling fillStamp() refers to.
+    const RenderQueue* fillQueue() const { return mFillQueue; }
+
+    //! Used internally.
+    void setFillStamp(const RenderQueue* queue, unsigned int stamp) { mFillQueue = queue; mFillStamp = stamp; }
+
 #ifdef VL_USER_DATA_SHADER
   public:
     const Object* shaderUserData() const { return mShaderUserData.get(); }
@@ -2349,6 +2359,8 @@ namespace vl
     ref<Scissor> mScissor;
     ref<ShaderAnimator> mShaderAnimator;
     real mLastUpdateTime;
+    const RenderQueue* mFillQueue;
+    unsigned int mFillStamp;
   };
 }
 
@@ -32,6 +32,7 @@
 #ifndef Uniform_INCLUDE_ONCE
 #define Uniform_INCLUDE_ONCE
 
+#include <vlGraphics/link_config.hpp>
 #include <vlCore/vlnamespace.hpp>
 #include <vlCore/Object.hpp>
 #include <vlCore/Vector4.hpp>
@@ -56,7 +57,7 @@ namespace vl
    * - Actor
    * - UniformSet
   */
-  class Uniform: public Object
+  class VLGRAPHICS_EXPORT Uniform: public Object
   {
     VL_INSTRUMENT_CLASS(vl::Uniform, Object)
 
@@ -64,12 +65,12 @@ namespace vl
 
   public:
 
-    Uniform(): mType(UT_NONE)
+    Uniform(): mType(UT_NONE), mNameId(-1)
     {
       VL_DEBUG_SET_OBJECT_NAME()
     }
 
-    Uniform(const char* name): mType(UT_NONE)
+    Uniform(const char* name): mType(UT_NONE), mNameId(-1)
     {
       VL_DEBUG_SET_OBJECT_NAME()
       mName = name;
@@ -86,13 +87,28 @@ namespace vl
     const std::string& name() const { return mName; }
 
     //! Returns the name of the uniform variable
-    std::string& name() { return mName; }
+    std::string& name() { mNameId = -1; return mName; }
 
     //! Sets the name of the uniform variable
-    void setName(const char* name) { mName = name; }
+    void setName(const char* name) { mName = name; mNameId = -1; }
 
     //! Sets the name of the uniform variable
-    void setName(const std::string& name) { mName = name; }
+    void setName(const std::string& name) { mName = name; mNameId = -1; }
+
+    //! Returns the small integer id associated to the uniform's name, see nameToId().
+    //! The id is resolved once and reused until the name changes, it's used by GLSLProgram to look up uniform locations without querying OpenGL.
+    int nameId() const
+    {
+      if (mNameId == -1)
+        mNameId = nameToId(mName);
+      return mNameId;
+    }
+
+    //! Returns the id uniquely associated to the given uniform name. Ids are allocated sequentially starting from 0 and are shared by all the GLSLProgram-s.
+    static int nameToId(const std::string& name);
+
+    //! Returns the number of uniform name ids allocated so far.
+    static int nameIdCount();
 
     // generic array setters
 
@@ -331,6 +347,7 @@ namespace vl
     EUniformType mType;
     std::vector<int> mData;
     std::string mName;
+    mutable int mNameId;
   };
 }
 
@@ -0,0 +1,449 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+
+#include <vlGraphics/VertexCacheOptimizer.hpp>
+#include <vlCore/Log.hpp>
+#include <vlCore/Say.hpp>
+#include <algorithm>
+#include <cmath>
+
+using namespace vl;
+
+namespace
+{
+  // Forsyth's scoring parameters
+  const int MaxCacheSize = 64;
+  const int MaxValence = 64;
+  const float CacheDecayPower = 1.5f;
+  const float LastTriScore = 0.75f;
+  const float ValenceBoostScale = 2.0f;
+  const float ValenceBoostPower = 0.5f;
+
+  class VertexScorer
+  {
+  public:
+    VertexScorer(int cache_size)
+    {
+      for(int i=0; i<cache_size; ++i)
+      {
+        // the vertices of the last triangle get a fixed score so that the next triangle does not reuse them on purpose
+        if (i < 3)
+          mCacheScore[i] = LastTriScore;
+        else
+          mCacheScore[i] = powf(1.0f - (float)(i - 3) / (cache_size - 3), CacheDecayPower);
+      }
+      mValenceScore[0] = 0;
+      for(int i=1; i<MaxValence; ++i)
+        mValenceScore[i] = ValenceBoostScale * powf((float)i, -ValenceBoostPower);
+    }
+
+    float score(int cache_pos, u32 remaining) const
+    {
+      // vertices without triangles left never contribute
+      if (remaining == 0)
+        return -1.0f;
+      float score = cache_pos >= 0 ? mCacheScore[cache_pos] : 0.0f;
+      score += remaining < (u32)MaxValence ? mValenceScore[remaining] : ValenceBoostScale * powf((float)remaining, -ValenceBoostPower);
+      return score;
+    }
+
+  protected:
+    float mCacheScore[MaxCacheSize];
+    float mValenceScore[MaxValence];
+  };
+
+  struct Cluster
+  {
+    Cluster(): mFirst(0), mCount(0), mSortKey(0) {}
+    bool operator<(const Cluster& other) const { return mSortKey > other.mSortKey; }
+    size_t mFirst;
+    size_t mCount;
+    float mSortKey;
+  };
+
+  // FIFO cache simulation using per-vertex timestamps: a vertex is in the cache if it was inserted less than
+  // cache_size insertions ago. Returns the number of vertices of the triangle that were transformed.
+  inline int simulateTriangle(const u32* tri, std::vector<u32>& timestamps, u32& time, int cache_size)
+  {
+    int misses = 0;
+    for(int i=0; i<3; ++i)
+    {
+      if (time - timestamps[tri[i]] > (u32)cache_size)
+      {
+        timestamps[tri[i]] = time++;
+        ++misses;
+      }
+    }
+    return misses;
+  }
+}
+//-----------------------------------------------------------------------------
+void VertexCacheOptimizer::simulateVertexCache(const u32* indices, size_t index_count, u32 vertex_count, int cache_size, size_t& transformed, size_t& referenced)
+{
+  std::vector<u32> timestamps(vertex_count, 0);
+  std::vector<u8> used(vertex_count, 0);
+  u32 time = cache_size + 1;
+  transformed = 0;
+  referenced = 0;
+  for(size_t i=0; i<index_count; ++i)
+  {
+    u32 v = indices[i];
+    if (time - timestamps[v] > (u32)cache_size)
+    {
+      timestamps[v] = time++;
+      ++transformed;
+    }
+    if (!used[v])
+    {
+      used[v] = 1;
+      ++referenced;
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void VertexCacheOptimizer::optimizeTriangleOrder(const u32* indices, size_t index_count, u32 vertex_count, int cache_size, u32* out)
+{
+  const size_t tri_count = index_count / 3;
+  if (tri_count == 0)
+    return;
+
+  cache_size = clamp(cache_size, 4, MaxCacheSize);
+  VertexScorer scorer(cache_size);
+
+  // vertex -> triangles adjacency, the triangles still to be emitted are kept at the front of each range
+
+  std::vector<u32> remaining(vertex_count, 0);
+  for(size_t i=0; i<tri_count*3; ++i)
+    ++remaining[indices[i]];
+
+  std::vector<u32> offsets(vertex_count + 1, 0);
+  for(u32 v=0; v<vertex_count; ++v)
+    offsets[v+1] = offsets[v] + remaining[v];
+
+  std::vector<u32> adjacency(tri_count * 3);
+  std::vector<u32> fill(offsets.begin(), offsets.end() - 1);
+  for(size_t t=0; t<tri_count; ++t)
+    for(int i=0; i<3; ++i)
+      adjacency[ fill[indices[t*3+i]]++ ] = (u32)t;
+
+  std::vector<int> cache_pos(vertex_count, -1);
+  std::vector<float> vertex_score(vertex_count);
+  for(u32 v=0; v<vertex_count; ++v)
+    vertex_score[v] = scorer.score(-1, remaining[v]);
+
+  std::vector<float> tri_score(tri_count);
+  std::vector<u8> emitted(tri_count, 0);
+  size_t best_tri = 0;
+  for(size_t t=0; t<tri_count; ++t)
+  {
+    tri_score[t] = vertex_score[indices[t*3]] + vertex_score[indices[t*3+1]] + vertex_score[indices[t*3+2]];
+    if (tri_score[t] > tri_score[best_tri])
+      best_tri = t;
+  }
+
+  // the simulated LRU cache, with room for the 3 vertices pushed by a triangle
+  std::vector<u32> cache, new_cache;
+  cache.reserve(cache_size + 3);
+  new_cache.reserve(cache_size + 3);
+
+  size_t cursor = 0;
+  for(size_t out_tri=0; out_tri<tri_count; ++out_tri)
+  {
+    // no candidate in the cache: restart from the next triangle in input order
+    if (best_tri == (size_t)-1)
+    {
+      while(emitted[cursor])
+        ++cursor;
+      best_tri = cursor;
+    }
+
+    const u32* tri = &indices[best_tri*3];
+    out[out_tri*3+0] = tri[0];
+    out[out_tri*3+1] = tri[1];
+    out[out_tri*3+2] = tri[2];
+    emitted[best_tri] = 1;
+
+    // remove the triangle from its vertices
+    for(int i=0; i<3; ++i)
+    {
+      u32 v = tri[i];
+      u32* adj = &adjacency[offsets[v]];
+      for(u32 j=0; j<remaining[v]; ++j)
+      {
+        if (adj[j] == best_tri)
+        {
+          adj[j] = adj[remaining[v] - 1];
+          break;
+        }
+      }
+      --remaining[v];
+    }
+
+    // push the triangle's vertices at the front of the cache
+    new_cache.clear();
+    new_cache.push_back(tri[0]);
+    new_cache.push_back(tri[1]);
+    new_cache.push_back(tri[2]);
+    for(size_t i=0; i<cache.size(); ++i)
+      if (cache[i] != tri[0] && cache[i] != tri[1] && cache[i] != tri[2])
+        new_cache.push_back(cache[i]);
+    cache.swap(new_cache);
+
+    // update the scores of the vertices in the cache and of the ones evicted
+    for(size_t i=0; i<cache.size(); ++i)
+    {
+      u32 v = cache[i];
+      cache_pos[v] = i < (size_t)cache_size ? (int)i : -1;
+      vertex_score[v] = scorer.score(cache_pos[v], remaining[v]);
+    }
+
+    // rescore the triangles touched by the cache and pick the best one
+    best_tri = (size_t)-1;
+    float best_score = -1;
+    for(size_t i=0; i<cache.size(); ++i)
+    {
+      u32 v = cache[i];
+      const u32* adj = &adjacency[offsets[v]];
+      for(u32 j=0; j<remaining[v]; ++j)
+      {
+        u32 t = adj[j];
+        tri_score[t] = vertex_score[indices[t*3]] + vertex_score[indices[t*3+1]] + vertex_score[indices[t*3+2]];
+        if (tri_score[t] > best_score)
+        {
+          best_score = tri_score[t];
+          best_tri = t;
+        }
+      }
+    }
+
+    if (cache.size() > (size_t)cache_size)
+      cache.resize(cache_size);
+  }
+}
+//-----------------------------------------------------------------------------
+void VertexCacheOptimizer::optimizeOverdraw(u32* indices, size_t index_count, const std::vector<fvec3>& positions, int cache_size, float threshold)
+{
+  const size_t tri_count = index_count / 3;
+  if (tri_count < 2)
+    return;
+
+  std::vector<u32> timestamps(positions.size(), 0);
+  u32 time = cache_size + 1;
+
+  // hard boundaries: the triangles whose vertices are all transformed start a new cluster anyway
+
+  std::vector<size_t> hard;
+  for(size_t t=0; t<tri_count; ++t)
+  {
+    if (simulateTriangle(&indices[t*3], timestamps, time, cache_size) == 3)
+      hard.push_back(t);
+  }
+  if (hard.empty() || hard[0] != 0)
+    hard.insert(hard.begin(), 0);
+  hard.push_back(tri_count);
+
+  // soft boundaries: split the hard clusters as long as the ACMR of each piece, simulated starting
+  // with an empty cache, stays within threshold times the ACMR of the whole cluster
+
+  std::vector<Cluster> clusters;
+  for(size_t h=0; h+1<hard.size(); ++h)
+  {
+    const size_t first = hard[h];
+    const size_t end = hard[h+1];
+
+    time += cache_size + 1;
+    size_t cluster_misses = 0;
+    for(size_t t=first; t<end; ++t)
+      cluster_misses += simulateTriangle(&indices[t*3], timestamps, time, cache_size);
+    const float max_acmr = threshold * cluster_misses / (end - first);
+
+    time += cache_size + 1;
+    Cluster cluster;
+    cluster.mFirst = first;
+    size_t misses = 0;
+    for(size_t t=first; t<end; ++t)
+    {
+      misses += simulateTriangle(&indices[t*3], timestamps, time, cache_size);
+      ++cluster.mCount;
+      if ( t+1 < end && (float)misses / cluster.mCount <= max_acmr )
+      {
+        clusters.push_back(cluster);
+        cluster.mFirst = t + 1;
+        cluster.mCount = 0;
+        misses = 0;
+        time += cache_size + 1;
+      }
+    }
+    if (cluster.mCount)
+      clusters.push_back(cluster);
+  }
+
+  if (clusters.size() < 2)
+    return;
+
+  // sort key: how much the cluster faces away from the center of the mesh, the outer clusters are drawn first
+
+  fvec3 mesh_center;
+  float mesh_area = 0;
+  std::vector<fvec3> centers(clusters.size());
+  std::vector<fvec3> normals(clusters.size());
+  for(size_t c=0; c<clusters.size(); ++c)
+  {
+    float area = 0;
+    for(size_t t=clusters[c].mFirst; t<clusters[c].mFirst+clusters[c].mCount; ++t)
+    {
+      const fvec3& a = positions[indices[t*3+0]];
+      const fvec3& b = positions[indices[t*3+1]];
+      const fvec3& d = positions[indices[t*3+2]];
+      fvec3 n = cross(b - a, d - a);
+      float tri_area = n.length();
+      centers[c] += (a + b + d) * (tri_area / 3.0f);
+      normals[c] += n;
+      area += tri_area;
+    }
+    mesh_center += centers[c];
+    mesh_area += area;
+    if (area > 0)
+      centers[c] /= area;
+    normals[c].normalize();
+  }
+  if (mesh_area > 0)
+    mesh_center /= mesh_area;
+
+  for(size_t c=0; c<clusters.size(); ++c)
+    clusters[c].mSortKey = dot(centers[c] - mesh_center, normals[c]);
+
+  std::stable_sort(clusters.begin(), clusters.end());
+
+  std::vector<u32> sorted;
+  sorted.reserve(tri_count * 3);
+  for(size_t c=0; c<clusters.size(); ++c)
+    sorted.insert(sorted.end(), indices + clusters[c].mFirst*3, indices + (clusters[c].mFirst+clusters[c].mCount)*3);
+  std::copy(sorted.begin(), sorted.end(), indices);
+}
+//-----------------------------------------------------------------------------
+template<class TDrawElements>
+bool VertexCacheOptimizer::optimizeDrawElements(TDrawElements* de, u32 vertex_count, const std::vector<fvec3>& positions)
+{
+  if (de->primitiveType() != PT_TRIANGLES || de->primitiveRestartEnabled())
+    return false;
+
+  typedef typename TDrawElements::index_type index_type;
+  const size_t first = de->offset() / sizeof(index_type);
+  if (first > de->indexBuffer()->size())
+    return false;
+  const size_t count = (de->count() < 0 ? de->indexBuffer()->size() - first : (size_t)de->count()) / 3 * 3;
+  if (count < 6 || first + count > de->indexBuffer()->size())
+    return false;
+
+  // vertex indices with the base vertex baked in
+  std::vector<u32> indices(count);
+  index_type* ptr = de->indexBuffer()->begin() + first;
+  for(size_t i=0; i<count; ++i)
+  {
+    indices[i] = (u32)ptr[i] + de->baseVertex();
+    if (indices[i] >= vertex_count)
+    {
+      Log::error( Say("VertexCacheOptimizer: index %n out of range.\n") << indices[i] );
+      return false;
+    }
+  }
+
+  size_t transformed = 0, referenced = 0;
+  simulateVertexCache(&indices[0], count, vertex_count, cacheSize(), transformed, referenced);
+  mTriangles += count / 3;
+  mReferenced += referenced;
+  mTransformedBefore += transformed;
+
+  std::vector<u32> optimized(count);
+  optimizeTriangleOrder(&indices[0], count, vertex_count, cacheSize(), &optimized[0]);
+  if ( overdrawOptimizationEnabled() && !positions.empty() )
+    optimizeOverdraw(&optimized[0], count, positions, cacheSize(), overdrawThreshold());
+
+  simulateVertexCache(&optimized[0], count, vertex_count, cacheSize(), transformed, referenced);
+  mTransformedAfter += transformed;
+
+  for(size_t i=0; i<count; ++i)
+    ptr[i] = (index_type)(optimized[i] - de->baseVertex());
+  de->indexBuffer()->setBufferObjectDirty(true);
+  return true;
+}
+//-----------------------------------------------------------------------------
+bool VertexCacheOptimizer::optimize(Geometry* geom)
+{
+  resetStats();
+
+  ArrayAbstract* posarr = geom->vertexArray();
+  if (!posarr)
+  {
+    Log::warning("VertexCacheOptimizer::optimize() failed. No vertices found.\n");
+    return false;
+  }
+
+  const u32 vertex_count = (u32)posarr->size();
+  std::vector<fvec3> positions;
+  if ( overdrawOptimizationEnabled() )
+  {
+    positions.resize(vertex_count);
+    for(u32 i=0; i<vertex_count; ++i)
+      positions[i] = (fvec3)posarr->getAsVec3(i);
+  }
+
+  bool optimized = false;
+  bool all_elements = true;
+  for(size_t i=0; i<geom->drawCalls().size(); ++i)
+  {
+    DrawCall* dc = geom->drawCalls().at(i);
+    if ( DrawElementsUInt* de = dc->as<DrawElementsUInt>() )
+      optimized |= optimizeDrawElements(de, vertex_count, positions);
+    else
+    if ( DrawElementsUShort* de = dc->as<DrawElementsUShort>() )
+      optimized |= optimizeDrawElements(de, vertex_count, positions);
+    else
+    if ( DrawElementsUByte* de = dc->as<DrawElementsUByte>() )
+      optimized |= optimizeDrawElements(de, vertex_count, positions);
+    else
+      all_elements = false;
+    all_elements &= !dc->primitiveRestartEnabled();
+  }
+
+  if (optimized)
+  {
+    geom->setBufferObjectDirty(true);
+    // sorting the vertices does not change the cache behavior, only the memory locality of the fetches
+    if ( vertexReorderEnabled() && all_elements )
+      geom->sortVertices();
+  }
+
+  return optimized;
+}
+//-----------------------------------------------------------------------------
@@ -0,0 +1,151 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+
+#ifndef VertexCacheOptimizer_INCLUDE_ONCE
+#define VertexCacheOptimizer_INCLUDE_ONCE
+
+#include <vlGraphics/Geometry.hpp>
+#include <vector>
+
+namespace vl
+{
+  //-----------------------------------------------------------------------------
+  // VertexCacheOptimizer
+  //-----------------------------------------------------------------------------
+  /**
+   * Reorders the triangles of indexed triangle lists to improve the post-transform vertex cache hit rate and
+   * optionally the overdraw, then reorders the vertices to follow the index order.
+   *
+   * The triangles are sorted with Tom Forsyth's "Linear-Speed Vertex Cache Optimisation" which scores the vertices
+   * by their position in a simulated LRU cache and by the number of their remaining triangles. The optional overdraw
+   * pass follows Sander, Nehab and Barczak's "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw"
+   * (Tipsify): the optimized sequence is split in clusters whose ACMR stays within overdrawThreshold() times the
+   * original one and the clusters are sorted so that the ones facing outwards are drawn first.
+   *
+   * The efficiency is reported as ACMR (average cache miss ratio, transformed vertices per triangle, ideally 0.5)
+   * and ATVR (average transform to vertex ratio, transformed vertices per referenced vertex, ideally 1) simulating
+   * a FIFO cache of cacheSize() entries, before and after the optimization.
+   *
+   * \sa
+   * - Geometry::optimizeVertexCache()
+   * - Geometry::sortVertices()
+   * - TriangleStripGenerator
+   */
+  class VLGRAPHICS_EXPORT VertexCacheOptimizer: public Object
+  {
+    VL_INSTRUMENT_CLASS(vl::VertexCacheOptimizer, Object)
+
+  public:
+    VertexCacheOptimizer(): mCacheSize(32), mOverdrawThreshold(1.05f), mOverdrawOptimizationEnabled(false), mVertexReorderEnabled(true)
+    {
+      VL_DEBUG_SET_OBJECT_NAME()
+      resetStats();
+    }
+
+    /**
+     * Optimizes the PT_TRIANGLES DrawElementsUInt/UShort/UByte of the given Geometry, the other draw calls and
+     * the ones using primitive restart are left untouched.
+     * If vertexReorderEnabled() and all the draw calls are DrawElements* the vertices are then sorted
+     * with Geometry::sortVertices(), which generates DrawElementsUInt draw calls.
+     * \returns true if at least one draw call was optimized.
+     */
+    bool optimize(Geometry* geom);
+
+    /**
+     * Writes in \p out the triangles of \p indices sorted to maximize the hits of a vertex cache of \p cache_size entries.
+     * \p out must be able to contain \p index_count indices and must not overlap \p indices.
+     */
+    static void optimizeTriangleOrder(const u32* indices, size_t index_count, u32 vertex_count, int cache_size, u32* out);
+
+    /**
+     * Reorders in place the triangles of a sequence optimized with optimizeTriangleOrder() to reduce the overdraw.
+     * \p threshold is the maximum ACMR increase allowed, i.e. 1.05 allows the ACMR to grow by 5%.
+     */
+    static void optimizeOverdraw(u32* indices, size_t index_count, const std::vector<fvec3>& positions, int cache_size, float threshold);
+
+    //! Simulates a FIFO vertex cache of \p cache_size entries: returns the number of transformed vertices and the number of distinct vertices referenced.
+    static void simulateVertexCache(const u32* indices, size_t index_count, u32 vertex_count, int cache_size, size_t& transformed, size_t& referenced);
+
+    //! The number of entries of the vertex cache to optimize for, the default is 32.
+    void setCacheSize(int size) { mCacheSize = size; }
+
+    //! The number of entries of the vertex cache to optimize for, the default is 32.
+    int cacheSize() const { return mCacheSize; }
+
+    //! Enables the overdraw optimization pass (disabled by default).
+    void setOverdrawOptimizationEnabled(bool enabled) { mOverdrawOptimizationEnabled = enabled; }
+
+    //! Whether the overdraw optimization pass is enabled.
+    bool overdrawOptimizationEnabled() const { return mOverdrawOptimizationEnabled; }
+
+    //! The maximum ACMR increase allowed by the overdraw optimization pass, the default is 1.05.
+    void setOverdrawThreshold(float threshold) { mOverdrawThreshold = threshold; }
+
+    //! The maximum ACMR increase allowed by the overdraw optimization pass, the default is 1.05.
+    float overdrawThreshold() const { return mOverdrawThreshold; }
+
+    //! If enabled (default) the vertices are sorted by first use after the triangles are reordered.
+    void setVertexReorderEnabled(bool enabled) { mVertexReorderEnabled = enabled; }
+
+    //! If enabled (default) the vertices are sorted by first use after the triangles are reordered.
+    bool vertexReorderEnabled() const { return mVertexReorderEnabled; }
+
+    //! Average cache miss ratio of the optimized draw calls before the last optimize().
+    float acmrBefore() const { return mTriangles ? (float)mTransformedBefore / mTriangles : 0; }
+
+    //! Average cache miss ratio of the optimized draw calls after the last optimize().
+    float acmrAfter() const { return mTriangles ? (float)mTransformedAfter / mTriangles : 0; }
+
+    //! Average transform to vertex ratio of the optimized draw calls before the last optimize().
+    float atvrBefore() const { return mReferenced ? (float)mTransformedBefore / mReferenced : 0; }
+
+    //! Average transform to vertex ratio of the optimized draw calls after the last optimize().
+    float atvrAfter() const { return mReferenced ? (float)mTransformedAfter / mReferenced : 0; }
+
+  protected:
+    void resetStats() { mTriangles = mReferenced = mTransformedBefore = mTransformedAfter = 0; }
+    template<class TDrawElements>
+    bool optimizeDrawElements(TDrawElements* de, u32 vertex_count, const std::vector<fvec3>& positions);
+
+  protected:
+    int mCacheSize;
+    float mOverdrawThreshold;
+    bool mOverdrawOptimizationEnabled;
+    bool mVertexReorderEnabled;
+    size_t mTriangles;
+    size_t mReferenced;
+    size_t mTransformedBefore;
+    size_t mTransformedAfter;
+  };
+}
+
+#endif
@@ -39,9 +39,13 @@
 #include <vlCore/LoadWriterManager.hpp>
 #include <vlGraphics/Effect.hpp>
 #include <vlGraphics/Actor.hpp>
+#include <vlCore/GlobalSettings.hpp>
 #include <string>
 #include <vector>
 #include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <math.h>
 
 using namespace vl;
 
@@ -57,6 +61,417 @@ namespace
       vec.reserve( vec.size() + alloc_step );
     vec.push_back(data);
   }
+  //-----------------------------------------------------------------------------
+  // Block parser, see ObjLoader::setBlockParser()
+  //-----------------------------------------------------------------------------
+  //! The characters separating the tokens of a statement, a backslash at the end of a line joins the next line.
+  inline bool isObjBlank(char c)
+  {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\\';
+  }
+
+  //! Whether the line ending at data[eol] ends with a backslash, i.e. whether the statement continues on the next line.
+  inline bool continuesOnNextLine(const char* data, size_t eol)
+  {
+    while( eol > 0 && (data[eol-1] == ' ' || data[eol-1] == '\t' || data[eol-1] == '\r') )
+      --eol;
+    return eol > 0 && data[eol-1] == '\\';
+  }
+
+  //! Returns the position following the first statement end at or after \p from, or \p to if there is none.
+  size_t nextStatementEnd(const char* data, size_t from, size_t to)
+  {
+    while( from < to )
+    {
+      const char* eol = (const char*)memchr(data + from, '\n', to - from);
+      if (!eol)
+        return to;
+      from = eol - data + 1;
+      if ( !continuesOnNextLine(data, from - 1) )
+        return from;
+    }
+    return to;
+  }
+
+  //! Returns the position following the last statement end before \p size, or 0 if there is none.
+  size_t lastStatementEnd(const char* data, size_t size)
+  {
+    for( size_t i=size; i>0; --i )
+    {
+      if ( data[i-1] == '\n' && !continuesOnNextLine(data, i-1) )
+        return i;
+    }
+    return 0;
+  }
+
+  //! Locale independent and allocation free parsing of an integer, on success \p p is moved past the number.
+  inline bool parseObjInt(const char*& p, const char* end, int& value)
+  {
+    const char* s = p;
+    bool negative = false;
+    if ( s < end && (*s == '-' || *s == '+') )
+      negative = *s++ == '-';
+    if ( s == end || *s < '0' || *s > '9' )
+      return false;
+    int v = 0;
+    for( ; s < end && *s >= '0' && *s <= '9'; ++s )
+    {
+      if ( v < 214748364 )
+        v = v * 10 + (*s - '0');
+    }
+    value = negative ? -v : v;
+    p = s;
+    return true;
+  }
+
+  //! Locale independent and allocation free parsing of a decimal floating point number, on success \p p is moved past the number.
+  //! Up to 19 significant digits are considered, enough to round correctly the numbers written with float precision.
+  inline bool parseObjFloat(const char*& p, const char* end, float& value)
+  {
+    static const double powers[] =
+    {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    const char* s = p;
+    bool negative = false;
+    if ( s < end && (*s == '-' || *s == '+') )
+      negative = *s++ == '-';
+
+    unsigned long long mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool valid = false;
+    for( ; s < end && *s >= '0' && *s <= '9'; ++s, valid = true )
+    {
+      if ( digits < 19 )
+      {
+        mantissa = mantissa * 10 + (*s - '0');
+        digits += mantissa != 0;
+      }
+      else
+        ++exponent;
+    }
+    if ( s < end && *s == '.' )
+    {
+      for( ++s; s < end && *s >= '0' && *s <= '9'; ++s, valid = true )
+      {
+        if ( digits < 19 )
+        {
+          mantissa = mantissa * 10 + (*s - '0');
+          digits += mantissa != 0;
+          --exponent;
+        }
+      }
+    }
+    if ( !valid )
+      return false;
+    if ( s < end && (*s == 'e' || *s == 'E') )
+    {
+      const char* e = s + 1;
+      int exp = 0;
+      if ( parseObjInt(e, end, exp) )
+      {
+        exponent += exp;
+        s = e;
+      }
+    }
+
+    // exact for up to 15 digits and |exponent| <= 22 since both operands are exactly representable
+    double v = (double)mantissa;
+    if ( exponent < 0 )
+      v = exponent >= -22 ? v / powers[-exponent] : v * pow(10.0, exponent);
+    else
+    if ( exponent > 0 )
+      v = exponent <= 22 ? v * powers[exponent] : v * pow(10.0, exponent);
+    value = (float)(negative ? -v : v);
+    p = s;
+    return true;
+  }
+
+  //! Position in the face arrays of an ObjChunk.
+  struct ObjFaceCursor
+  {
+    ObjFaceCursor(): mFace(0), mPosition(0), mNormal(0), mTexCoord(0) {}
+    int mFace;
+    int mPosition;
+    int mNormal;
+    int mTexCoord;
+  };
+
+  typedef enum { OS_Object, OS_UseMaterial, OS_MaterialLibrary } EObjStatement;
+
+  //! An "o", "usemtl" or "mtllib" statement and the faces preceding it in its ObjChunk.
+  struct ObjStatement
+  {
+    EObjStatement mType;
+    std::string mArgument;
+    ObjFaceCursor mCursor;
+  };
+
+  //! The vertices, faces and statements parsed from a range of lines of an OBJ file.
+  struct ObjChunk
+  {
+    void clear()
+    {
+      mCoords.clear();
+      mNormals.clear();
+      mTexCoords.clear();
+      mFaceType.clear();
+      mPositionIndex.clear();
+      mNormalIndex.clear();
+      mTexCoordIndex.clear();
+      mRelativePosition.clear();
+      mRelativeNormal.clear();
+      mRelativeTexCoord.clear();
+      mStatements.clear();
+    }
+
+    ObjFaceCursor cursor() const
+    {
+      ObjFaceCursor c;
+      c.mFace     = (int)mFaceType.size();
+      c.mPosition = (int)mPositionIndex.size();
+      c.mNormal   = (int)mNormalIndex.size();
+      c.mTexCoord = (int)mTexCoordIndex.size();
+      return c;
+    }
+
+    void parse(const char* p, const char* end)
+    {
+      while( p < end )
+      {
+        const char* eol = p + nextStatementEnd(p, 0, end - p);
+        // comments cannot be multiline
+        const char* s = p;
+        while( s < eol && (*s == ' ' || *s == '\t') )
+          ++s;
+        if ( s < eol && *s == '#' )
+          eol = p + nextLineEnd(p, end);
+        parseStatement(s, eol);
+        p = eol;
+      }
+    }
+
+    static size_t nextLineEnd(const char* p, const char* end)
+    {
+      const char* eol = (const char*)memchr(p, '\n', end - p);
+      return eol ? eol - p + 1 : end - p;
+    }
+
+    void parseStatement(const char* p, const char* end)
+    {
+      const char* cmd = p;
+      while( p < end && !isObjBlank(*p) )
+        ++p;
+      size_t cmd_len = p - cmd;
+
+      if ( cmd_len == 1 && cmd[0] == 'v' ) // Geometric vertices
+      {
+        float v[] = { 0, 0, 0 };
+        parseFloats(p, end, v);
+        mCoords.push_back( fvec4(v[0], v[1], v[2], 1.0f) );
+      }
+      else
+      if ( cmd_len == 2 && cmd[0] == 'v' && cmd[1] == 't' ) // Texture vertices
+      {
+        float v[] = { 0, 0, 0 };
+        parseFloats(p, end, v);
+        mTexCoords.push_back( fvec3(v[0], v[1], v[2]) );
+      }
+      else
+      if ( cmd_len == 2 && cmd[0] == 'v' && cmd[1] == 'n' ) // Vertex normals
+      {
+        float v[] = { 0, 0, 0 };
+        parseFloats(p, end, v);
+        mNormals.push_back( fvec3(v[0], v[1], v[2]) );
+      }
+      else
+      if ( cmd_len == 1 && cmd[0] == 'f' ) // Face
+        parseFace(p, end);
+      else
+      if ( cmd_len == 1 && cmd[0] == 'o' ) // Object name
+        addStatement(OS_Object, p, end);
+      else
+      if ( cmd_len == 6 && memcmp(cmd, "usemtl", 6) == 0 ) // Material name
+        addStatement(OS_UseMaterial, p, end);
+      else
+      if ( cmd_len == 6 && memcmp(cmd, "mtllib", 6) == 0 ) // Material library
+        addStatement(OS_MaterialLibrary, p, end);
+    }
+
+    //! Parses up to 3 numbers stopping at the first invalid one like sscanf("%f %f %f") does.
+    static void parseFloats(const char* p, const char* end, float* v)
+    {
+      for( int i=0; i<3; ++i )
+      {
+        while( p < end && isObjBlank(*p) )
+          ++p;
+        if ( !parseObjFloat(p, end, v[i]) )
+          break;
+      }
+    }
+
+    //! Parses the "v", "v/vt", "v//vn" and "v/vt/vn" vertices of a face.
+    void parseFace(const char* p, const char* end)
+    {
+      int face_type = 0;
+      for(;;)
+      {
+        while( p < end && isObjBlank(*p) )
+          ++p;
+        if ( p == end )
+          break;
+        int iv = 0, ivt = 0, ivn = 0;
+        if ( parseObjInt(p, end, iv) )
+        {
+          addIndex(mPositionIndex, mRelativePosition, iv, (int)mCoords.size());
+          if ( p < end && *p == '/' )
+          {
+            ++p;
+            if ( parseObjInt(p, end, ivt) )
+              addIndex(mTexCoordIndex, mRelativeTexCoord, ivt, (int)mTexCoords.size());
+            if ( p < end && *p == '/' )
+            {
+              ++p;
+              if ( parseObjInt(p, end, ivn) )
+                addIndex(mNormalIndex, mRelativeNormal, ivn, (int)mNormals.size());
+            }
+          }
+          ++face_type;
+        }
+        // skip the rest of the token
+        while( p < end && !isObjBlank(*p) )
+          ++p;
+      }
+      mFaceType.push_back(face_type);
+    }
+
+    //! Negative indices refer to the vertices preceding the face, they are stored relative to the first vertex of the chunk and resolved by mergeObjChunk().
+    static void addIndex(std::vector<int>& indices, std::vector<int>& relative, int index, int count)
+    {
+      if ( index > 0 )
+        indices.push_back( index - 1 );
+      else
+      {
+        relative.push_back( (int)indices.size() );
+        indices.push_back( count + index );
+      }
+    }
+
+    void addStatement(EObjStatement type, const char* p, const char* end)
+    {
+      mStatements.push_back( ObjStatement() );
+      mStatements.back().mType = type;
+      mStatements.back().mArgument.assign(p, end);
+      mStatements.back().mCursor = cursor();
+    }
+
+    std::vector<fvec4> mCoords;
+    std::vector<fvec3> mNormals;
+    std::vector<fvec3> mTexCoords;
+    std::vector<int> mFaceType;
+    std::vector<int> mPositionIndex;
+    std::vector<int> mNormalIndex;
+    std::vector<int> mTexCoordIndex;
+    std::vector<int> mRelativePosition;
+    std::vector<int> mRelativeNormal;
+    std::vector<int> mRelativeTexCoord;
+    std::vector<ObjStatement> mStatements;
+  };
+
+  //! The state carried from one chunk to the next while merging, the same kept by ObjLoader::parseLines().
+  struct ObjMergeState
+  {
+    ObjMergeState(): mStartsNewGeom(true) {}
+    ref<ObjMaterial> mMaterial;
+    ref<ObjMesh> mMesh;
+    std::string mObjectName;
+    bool mStartsNewGeom;
+  };
+
+  template<typename T>
+  void appendRange(std::vector<T>& dst, const std::vector<T>& src, int begin, int end)
+  {
+    dst.insert( dst.end(), src.begin() + begin, src.begin() + end );
+  }
+
+  //! Appends the faces of \p chunk in [from,to) to the current mesh, starting a new one if needed.
+  void appendObjFaces(ObjLoader& loader, const ObjChunk& chunk, ObjMergeState& state, const ObjFaceCursor& from, const ObjFaceCursor& to)
+  {
+    if ( from.mFace == to.mFace )
+      return;
+    if ( state.mStartsNewGeom )
+    {
+      state.mMesh = new ObjMesh;
+      state.mMesh->setObjectName(state.mObjectName.c_str());
+      loader.meshes().push_back( state.mMesh );
+      state.mStartsNewGeom = false;
+      state.mMesh->setMaterial(state.mMaterial.get());
+    }
+    appendRange( state.mMesh->face_type(), chunk.mFaceType, from.mFace, to.mFace );
+    appendRange( state.mMesh->facePositionIndex(), chunk.mPositionIndex, from.mPosition, to.mPosition );
+    appendRange( state.mMesh->faceNormalIndex(), chunk.mNormalIndex, from.mNormal, to.mNormal );
+    appendRange( state.mMesh->faceTexCoordIndex(), chunk.mTexCoordIndex, from.mTexCoord, to.mTexCoord );
+  }
+
+  //! Appends the vertices of \p chunk to the loader and replays its faces and statements in file order.
+  void mergeObjChunk(ObjLoader& loader, ObjChunk& chunk, ObjMergeState& state, VirtualFile* file)
+  {
+    for( size_t i=0; i<chunk.mRelativePosition.size(); ++i )
+      chunk.mPositionIndex[ chunk.mRelativePosition[i] ] += (int)loader.vertexArray().size();
+    for( size_t i=0; i<chunk.mRelativeNormal.size(); ++i )
+      chunk.mNormalIndex[ chunk.mRelativeNormal[i] ] += (int)loader.normalArray().size();
+    for( size_t i=0; i<chunk.mRelativeTexCoord.size(); ++i )
+      chunk.mTexCoordIndex[ chunk.mRelativeTexCoord[i] ] += (int)loader.texCoordsArray().size();
+
+    loader.vertexArray().insert( loader.vertexArray().end(), chunk.mCoords.begin(), chunk.mCoords.end() );
+    loader.normalArray().insert( loader.normalArray().end(), chunk.mNormals.begin(), chunk.mNormals.end() );
+    loader.texCoordsArray().insert( loader.texCoordsArray().end(), chunk.mTexCoords.begin(), chunk.mTexCoords.end() );
+
+    ObjFaceCursor cursor;
+    for( size_t i=0; i<chunk.mStatements.size(); ++i )
+    {
+      const ObjStatement& statement = chunk.mStatements[i];
+      appendObjFaces( loader, chunk, state, cursor, statement.mCursor );
+      cursor = statement.mCursor;
+
+      if ( statement.mType == OS_Object )
+      {
+        state.mStartsNewGeom = true;
+        state.mObjectName = String::trimStdString(statement.mArgument);
+      }
+      else
+      if ( statement.mType == OS_UseMaterial )
+      {
+        state.mStartsNewGeom = true;
+        std::string mat_name = String(statement.mArgument.c_str()).trim().toStdString();
+        // can also become NULL
+        state.mMaterial = loader.materials()[mat_name];
+      }
+      else
+      {
+        // creates the path for the mtl
+        String path = file->path().extractPath() + String(statement.mArgument.c_str()).trim();
+        ref<VirtualFile> vfile = defFileSystem()->locateFile(path, file->path().extractPath());
+        if (vfile)
+        {
+          // reads the material
+          std::vector<ObjMaterial> mats;
+          loader.loadObjMaterials(vfile.get(), mats);
+          // updates the material library
+          for(size_t j=0; j < mats.size(); ++j)
+            loader.materials()[mats[j].objectName()] = new ObjMaterial(mats[j]);
+        }
+        else
+        {
+          Log::error( Say("Could not find OBJ material file '%s'.\n") << path );
+        }
+      }
+    }
+    appendObjFaces( loader, chunk, state, cursor, chunk.cursor() );
+  }
 }
 //-----------------------------------------------------------------------------
 // ObjTexture
@@ -300,25 +715,9 @@ void ObjLoader::loadObjMaterials(VirtualFile* input, std::vector<ObjMaterial>& m
   }
 }
 //-----------------------------------------------------------------------------
-ref<ResourceDatabase> ObjLoader::loadOBJ( VirtualFile* file )
+void ObjLoader::parseLines( VirtualFile* file )
 {
-  if (!file)
-  {
-    Log::error("loadOBJ() called with NULL argument.\n");
-    return NULL;
-  }
   ref<TextStream> stream = new TextStream(file);
-  if ( !stream->inputFile()->open(OM_ReadOnly) )
-  {
-    Log::error( Say("loadOBJ(): could not open source file.\n") );
-    return NULL;
-  }
-
-  mCoords.clear();
-  mNormals.clear();
-  mTexCoords.clear();
-  mMaterials.clear();
-  mMeshes.clear();
 
   ref<ObjMaterial> cur_material;
   ref<ObjMesh> cur_mesh;
@@ -470,28 +869,28 @@ ref<ResourceDatabase> ObjLoader::loadOBJ( VirtualFile* file )
           {
           case 0:
             sscanf(line.c_str()+i, "%d", &iv);
-            if (iv>0)  --iv; else  iv  = (int)mCoords.size()    - iv;
+            if (iv>0)  --iv; else  iv  = (int)mCoords.size()    + iv;
             append(cur_mesh->facePositionIndex(), iv);
             break;
           case 1:
             sscanf(line.c_str()+i, "%d/%d", &iv,&ivt);
-            if (iv>0)  --iv; else  iv  = (int)mCoords.size()    - iv;
-            if (ivt>0) --ivt; else ivt = (int)mTexCoords.size() - ivt;
+            if (iv>0)  --iv; else  iv  = (int)mCoords.size()    + iv;
+            if (ivt>0) --ivt; else ivt = (int)mTexCoords.size() + ivt;
             append(cur_mesh->facePositionIndex(), iv);
             append(cur_mesh->faceTexCoordIndex(), ivt);
             break;
           case 2:
             sscanf(line.c_str()+i, "%d//%d", &iv,&ivn);
-            if (iv>0)  --iv; else  iv  = (int)mCoords.size()    - iv;
-            if (ivn>0) --ivn; else ivn = (int)mNormals.size()   - ivn;
+            if (iv>0)  --iv; else  iv  = (int)mCoords.size()    + iv;
+            if (ivn>0) --ivn; else ivn = (int)mNormals.size()   + ivn;
             append(cur_mesh->facePositionIndex(), iv);
             append(cur_mesh->faceNormalIndex(), ivn);
             break;
           case 3:
             sscanf(line.c_str()+i, "%d/%d/%d", &iv,&ivt,&ivn);
-            if (iv>0)  --iv; else  iv  = (int)mCoords.size()    - iv;
-            if (ivt>0) --ivt; else ivt = (int)mTexCoords.size() - ivt;
-            if (ivn>0) --ivn; else ivn = (int)mNormals.size()   - ivn;
+            if (iv>0)  --iv; else  iv  = (int)mCoords.size()    + iv;
+            if (ivt>0) --ivt; else ivt = (int)mTexCoords.size() + ivt;
+            if (ivn>0) --ivn; else ivn = (int)mNormals.size()   + ivn;
             append(cur_mesh->facePositionIndex(), iv);
             append(cur_mesh->faceTexCoordIndex(), ivt);
             append(cur_mesh->faceNormalIndex(), ivn);
@@ -666,6 +1065,31 @@ ref<ResourceDatabase> ObjLoader::loadOBJ( VirtualFile* file )
     {
     }*/
   }
+}
+//-----------------------------------------------------------------------------
+ref<ResourceDatabase> ObjLoader::loadOBJ( VirtualFile* file )
+{
+  if (!file)
+  {
+    Log::error("loadOBJ() called with NULL argument.\n");
+    return NULL;
+  }
+  if ( !file->open(OM_ReadOnly) )
+  {
+    Log::error( Say("loadOBJ(): could not open source file.\n") );
+    return NULL;
+  }
+
+  mCoords.clear();
+  mNormals.clear();
+  mTexCoords.clear();
+  mMaterials.clear();
+  mMeshes.clear();
+
+  if (mBlockParser)
+    parseBlocks(file);
+  else
+    parseLines(file);
 
   ref<ResourceDatabase> res_db = new ResourceDatabase;
 
@@ -918,11 +1342,75 @@ ref<ResourceDatabase> ObjLoader::loadOBJ( VirtualFile* file )
     actor->setEffect(effect.get());
   }
 
-  stream->inputFile()->close();
+  file->close();
 
   return res_db;
 }
 //-----------------------------------------------------------------------------
+void ObjLoader::parseBlocks( VirtualFile* file )
+{
+  int thread_count = globalSettings()->threadCount();
+  // 16MB per thread up to 64MB, and no more than what is left of the file when its size is known
+  long long block_size = std::min( 16 * 1024 * 1024 * (long long)thread_count, 64 * 1024 * 1024LL );
+  long long remaining = file->size() - file->position();
+  if ( file->size() >= 0 && remaining >= 0 && remaining < block_size )
+    block_size = remaining + 1;
+
+  std::vector<char> buffer;
+  std::vector<ObjChunk> chunks( thread_count );
+  std::vector<size_t> bounds( thread_count + 1 );
+  ObjMergeState state;
+  size_t carry = 0;
+  bool eof = false;
+  while( !eof )
+  {
+    // read the next block after the incomplete statement left by the previous one
+    buffer.resize( carry + block_size );
+    long long bytes = 0;
+    while( bytes < block_size )
+    {
+      long long count = file->read( &buffer[carry + bytes], block_size - bytes );
+      if ( count <= 0 )
+        break;
+      bytes += count;
+    }
+    eof = bytes < block_size;
+    size_t size = carry + (size_t)bytes;
+    const char* data = &buffer[0];
+
+    // only complete statements are parsed, a statement longer than a block needs more data
+    size_t parsed = eof ? size : lastStatementEnd(data, size);
+    if ( !parsed && !eof )
+    {
+      carry = size;
+      continue;
+    }
+
+    // split at statement boundaries and parse the chunks in parallel
+    bounds[0] = 0;
+    for( int i=1; i<thread_count; ++i )
+      bounds[i] = nextStatementEnd( data, std::max(parsed / thread_count * i, bounds[i-1]), parsed );
+    bounds[thread_count] = parsed;
+
+    #ifdef VL_OPENMP
+      #pragma omp parallel for schedule(dynamic, 1) num_threads(thread_count)
+    #endif
+    for( int i=0; i<thread_count; ++i )
+    {
+      chunks[i].clear();
+      chunks[i].parse( data + bounds[i], data + bounds[i+1] );
+    }
+
+    // merge in file order
+    for( int i=0; i<thread_count; ++i )
+      mergeObjChunk( *this, chunks[i], state, file );
+
+    carry = size - parsed;
+    if ( carry )
+      memmove( &buffer[0], &buffer[parsed], carry );
+  }
+}
+//-----------------------------------------------------------------------------
 ref<ResourceDatabase> vl::loadOBJ( const String& path )
 {
   ref<VirtualFile> file = defFileSystem()->locateFile( path );
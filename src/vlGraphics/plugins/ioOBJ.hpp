@@ -341,6 +341,8 @@ namespace vl
   class ObjLoader
   {
   public:
+    ObjLoader(): mBlockParser(true) {}
+
     const std::vector<fvec4>& vertexArray() const { return mCoords; }
     const std::vector<fvec3>& normalArray() const { return mNormals; }
     const std::vector<fvec3>& texCoordsArray() const { return mTexCoords; }
@@ -355,19 +357,34 @@ namespace vl
 
     //! Loads a Wavefront OBJ file.
     //! \param file The OBJ file to be loaded
+    //! \sa setBlockParser()
     ref<ResourceDatabase> loadOBJ( VirtualFile* file );
 
+    //! If enabled (default) loadOBJ() reads the file in large blocks which are split at line boundaries into chunks parsed in parallel
+    //! with a locale independent number parser, the vertices and faces of the chunks are then merged in file order.
+    //! If disabled the file is parsed line by line using a TextStream and sscanf().
+    //! Both parsers produce the same vertexArray(), normalArray(), texCoordsArray() and meshes().
+    void setBlockParser(bool enable) { mBlockParser = enable; }
+
+    //! Whether loadOBJ() uses the parallel block parser, see setBlockParser().
+    bool blockParser() const { return mBlockParser; }
+
     //! Loads a Wavefront MTL file.
     //! \param file The MTL file to be loaded
     //! \param materials Is filled with the loaded materials
     void loadObjMaterials(VirtualFile* file, std::vector<ObjMaterial>& materials );
 
+  protected:
+    void parseLines( VirtualFile* file );
+    void parseBlocks( VirtualFile* file );
+
   protected:
     std::vector<fvec4> mCoords;
     std::vector<fvec3> mNormals;
     std::vector<fvec3> mTexCoords;
     std::map< std::string, ref<ObjMaterial> > mMaterials;
     std::vector< ref<ObjMesh> > mMeshes;
+    bool mBlockParser;
   };
 //-----------------------------------------------------------------------------
 }
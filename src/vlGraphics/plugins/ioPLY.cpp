@@ -39,8 +39,157 @@
 #include <vlGraphics/Effect.hpp>
 #include <vlGraphics/Actor.hpp>
 #include <vlCore/LoadWriterManager.hpp>
+#include <vlCore/simd.hpp>
+#include <algorithm>
 
 using namespace vl;
+
+namespace
+{
+  //! Reads up to \p byte_count bytes looping over VirtualFile::read(), which can return less bytes than requested before the end of the file.
+  long long readBlock(VirtualFile* file, void* buffer, long long byte_count)
+  {
+    long long bytes = 0;
+    while( bytes < byte_count )
+    {
+      long long count = file->read( (u8*)buffer + bytes, byte_count - bytes );
+      if ( count <= 0 )
+        break;
+      bytes += count;
+    }
+    return bytes;
+  }
+
+  int plyScalarSize(PlyLoader::EType type)
+  {
+    switch(type)
+    {
+      case PlyLoader::PlyChar:
+      case PlyLoader::PlyUChar:  return 1;
+      case PlyLoader::PlyShort:
+      case PlyLoader::PlyUShort: return 2;
+      case PlyLoader::PlyInt:
+      case PlyLoader::PlyUInt:
+      case PlyLoader::PlyFloat:  return 4;
+      case PlyLoader::PlyDouble: return 8;
+      default:                   return 0;
+    }
+  }
+
+  bool littleEndianCPU()
+  {
+    unsigned short bet = 0x00FF;
+    return ((unsigned char*)&bet)[0] == 0xFF;
+  }
+
+  //! Reverses the byte order of \p count consecutive scalars of \p size bytes, 16 bytes at a time when SSE2 is available.
+  void swapScalars(unsigned char* ptr, int size, size_t count)
+  {
+    size_t i = 0;
+  #if defined(VL_SIMD_SSE2)
+    const size_t vec_count = count * size / 16;
+    __m128i* vptr = (__m128i*)ptr;
+    for(size_t j=0; j<vec_count; ++j)
+    {
+      __m128i v = _mm_loadu_si128(vptr + j);
+      // swap the bytes of each 16 bit word, then the order of the words
+      v = _mm_or_si128( _mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8) );
+      if (size == 4)
+        v = _mm_shufflehi_epi16( _mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)), _MM_SHUFFLE(2,3,0,1) );
+      else
+      if (size == 8)
+        v = _mm_shufflehi_epi16( _mm_shufflelo_epi16(v, _MM_SHUFFLE(0,1,2,3)), _MM_SHUFFLE(0,1,2,3) );
+      _mm_storeu_si128(vptr + j, v);
+    }
+    i = vec_count * 16 / size;
+  #endif
+    for(; i<count; ++i)
+      std::reverse(ptr + i*size, ptr + (i+1)*size);
+  }
+
+  // Same conversions as PlyScalar::getAsFloat() and getAsInt()
+  template<typename S> inline void convertScalar(S s, float& d) { d = (float)s; }
+  template<typename S> inline void convertScalar(S s, unsigned char& d) { d = (unsigned char)(int)s; }
+
+  template<typename S, bool swap, typename D>
+  void decodeColumn(const unsigned char* src, int stride, int count, D* dst, int dst_stride)
+  {
+    for(int i=0; i<count; ++i, src+=stride, dst+=dst_stride)
+    {
+      S s;
+      memcpy(&s, src, sizeof(S));
+      if (swap)
+        swapBytes(s);
+      convertScalar(s, *dst);
+    }
+  }
+
+  //! Converts the property found every \p stride bytes starting at \p src and stores it every \p dst_stride components starting at \p dst.
+  template<bool swap, typename D>
+  void decodeColumn(PlyLoader::EType type, const unsigned char* src, int stride, int count, D* dst, int dst_stride)
+  {
+    switch(type)
+    {
+      case PlyLoader::PlyChar:   decodeColumn<char, swap>(src, stride, count, dst, dst_stride); break;
+      case PlyLoader::PlyUChar:  decodeColumn<unsigned char, swap>(src, stride, count, dst, dst_stride); break;
+      case PlyLoader::PlyShort:  decodeColumn<short, swap>(src, stride, count, dst, dst_stride); break;
+      case PlyLoader::PlyUShort: decodeColumn<unsigned short, swap>(src, stride, count, dst, dst_stride); break;
+      case PlyLoader::PlyInt:    decodeColumn<int, swap>(src, stride, count, dst, dst_stride); break;
+      case PlyLoader::PlyUInt:   decodeColumn<unsigned int, swap>(src, stride, count, dst, dst_stride); break;
+      case PlyLoader::PlyFloat:  decodeColumn<float, swap>(src, stride, count, dst, dst_stride); break;
+      case PlyLoader::PlyDouble: decodeColumn<double, swap>(src, stride, count, dst, dst_stride); break;
+      default: break;
+    }
+  }
+
+  //! A component of the vertex, normal or color arrays filled by PlyLoader::readElementBlocks().
+  template<typename D>
+  struct PlyColumn
+  {
+    PlyColumn(): mType(PlyLoader::PlyError), mOffset(0), mDst(NULL), mDstStride(0), mDefault(0) {}
+    PlyLoader::EType mType; // PlyError if the element does not have the property
+    int mOffset;
+    D* mDst;
+    int mDstStride;
+    D mDefault;
+
+    void decode(const unsigned char* block, int stride, int count, bool swap, size_t first) const
+    {
+      D* dst = mDst + first * mDstStride;
+      if (mType == PlyLoader::PlyError)
+      {
+        for(int i=0; i<count; ++i, dst+=mDstStride)
+          *dst = mDefault;
+      }
+      else
+      if (swap)
+        decodeColumn<true>(mType, block + mOffset, stride, count, dst, mDstStride);
+      else
+        decodeColumn<false>(mType, block + mOffset, stride, count, dst, mDstStride);
+    }
+  };
+
+  template<typename D>
+  void setupColumns(std::vector< PlyColumn<D> >& columns, const std::vector< ref<PlyLoader::PlyScalar> >& scalars,
+                    const std::vector<int>& offsets, const PlyLoader::PlyElement* el, D* dst, D def)
+  {
+    for(size_t i=0; i<scalars.size(); ++i)
+    {
+      PlyColumn<D> column;
+      column.mDst = dst + i;
+      column.mDstStride = (int)scalars.size();
+      column.mDefault = def;
+      if (scalars[i])
+      {
+        column.mType = scalars[i]->scalarType();
+        for(size_t j=0; j<el->properties().size(); ++j)
+          if (el->properties()[j] == scalars[i])
+            column.mOffset = offsets[j];
+      }
+      columns.push_back(column);
+    }
+  }
+}
 //-----------------------------------------------------------------------------
 ref<ResourceDatabase> vl::loadPLY(const String& path)
 {
@@ -175,6 +324,18 @@ void PlyLoader::PlyElement::analyze()
     }
   }
 }
+int PlyLoader::PlyElement::binaryStride() const
+{
+  int stride = 0;
+  for(unsigned int i=0; i<mProperties.size(); ++i)
+  {
+    const PlyScalar* scalar = cast_const<PlyScalar>(mProperties[i].get());
+    if (!scalar || !plyScalarSize(scalar->scalarType()))
+      return 0;
+    stride += plyScalarSize(scalar->scalarType());
+  }
+  return stride;
+}
 void PlyLoader::readElements(VirtualFile* file)
 {
   // reposition to the correct location
@@ -194,11 +355,83 @@ void PlyLoader::readElements(VirtualFile* file)
   } while(true);
 
   for(unsigned i=0; i<mElements.size(); ++i)
+  {
+    if (bulkDecoding() && mElements[i]->binaryStride())
+    {
+      readElementBlocks(file, mElements[i].get());
+      continue;
+    }
     for(int j=0; j<mElements[i]->elemCount(); ++j)
     {
       mElements[i]->read(file, littleEndian());
       newElement(mElements[i].get());
     }
+  }
+}
+void PlyLoader::readElementBlocks(VirtualFile* file, PlyElement* el)
+{
+  const int stride = el->binaryStride();
+  const int count  = el->elemCount();
+
+  // newElement() uses only the "vertex" and "face" elements, and the faces always contain a list.
+  if (el->name() != "vertex")
+  {
+    file->seekCur( (long long)stride * count );
+    return;
+  }
+
+  // offset of each property within the element, and common size of the properties if they all have the same
+  std::vector<int> offsets;
+  int uniform_size = plyScalarSize( cast<PlyScalar>(el->properties()[0].get())->scalarType() );
+  for(unsigned int i=0, offset=0; i<el->properties().size(); ++i)
+  {
+    int size = plyScalarSize( cast<PlyScalar>(el->properties()[i].get())->scalarType() );
+    offsets.push_back(offset);
+    offset += size;
+    if (size != uniform_size)
+      uniform_size = 0;
+  }
+
+  std::vector< PlyColumn<float> > float_columns;
+  std::vector< PlyColumn<unsigned char> > ubyte_columns;
+  if (mVerts)
+    setupColumns(float_columns, el->vertexScalars(), offsets, el, (float*)mVerts->ptr(), 0.0f);
+  if (mNormals)
+    setupColumns(float_columns, el->normalScalars(), offsets, el, (float*)mNormals->ptr(), 0.0f);
+  if (mColors)
+  {
+    setupColumns(ubyte_columns, el->colorScalars(), offsets, el, (unsigned char*)mColors->ptr(), (unsigned char)0);
+    ubyte_columns[3].mDefault = 255;
+  }
+
+  bool swap = littleEndian() != littleEndianCPU();
+  const int block_count = std::max(1, (1<<20) / stride);
+  std::vector<unsigned char> block( (size_t)block_count * stride );
+  for(int first=0; first<count; first+=block_count)
+  {
+    int n = std::min(block_count, count - first);
+    long long bytes = (long long)n * stride;
+    long long read_bytes = readBlock(file, &block[0], bytes);
+    if (read_bytes < bytes)
+    {
+      Log::error( Say("PlyLoader: unexpected end of file in '%s', the missing elements are set to zero.\n") << file->path() );
+      memset(&block[0] + read_bytes, 0, (size_t)(bytes - read_bytes));
+    }
+
+    // scalars of the same size can be byte swapped in place all together
+    bool swap_columns = swap;
+    if (swap && uniform_size > 1)
+    {
+      swapScalars(&block[0], uniform_size, (size_t)bytes / uniform_size);
+      swap_columns = false;
+    }
+
+    for(size_t i=0; i<float_columns.size(); ++i)
+      float_columns[i].decode(&block[0], stride, n, swap_columns, mVertexIndex);
+    for(size_t i=0; i<ubyte_columns.size(); ++i)
+      ubyte_columns[i].decode(&block[0], stride, n, swap_columns, mVertexIndex);
+    mVertexIndex += n;
+  }
 }
 void PlyLoader::readElements(TextStream* text)
 {
@@ -213,15 +446,12 @@ void PlyLoader::newElement(PlyElement*el)
 {
   if (el->name() == "vertex")
   {
-    for(unsigned int j=0; j<el->properties().size(); ++j)
-    {
-      if (mVerts)
-        mVerts->at(mVertexIndex)   = el->getVertex();
-      if (mNormals)
-        mNormals->at(mVertexIndex) = el->getNormal();
-      if (mColors)
-        mColors->at(mVertexIndex)  = el->getColor();
-    }
+    if (mVerts)
+      mVerts->at(mVertexIndex)   = el->getVertex();
+    if (mNormals)
+      mNormals->at(mVertexIndex) = el->getNormal();
+    if (mColors)
+      mColors->at(mVertexIndex)  = el->getColor();
 
     ++mVertexIndex;
   }
@@ -249,7 +479,7 @@ PlyLoader::EType PlyLoader::translateType(const String& type)
 {
   if (type == "int8")   return PlyChar; else
   if (type == "char")   return PlyChar; else
-  if (type == "uint8")   return PlyChar; else
+  if (type == "uint8")  return PlyUChar; else
   if (type == "uchar")  return PlyUChar; else
   if (type == "ushort") return PlyUShort; else
   if (type == "uint16") return PlyUShort; else
@@ -404,17 +634,25 @@ ref<ResourceDatabase> PlyLoader::loadPly(VirtualFile* file)
     readElements(line_reader.get());
   file->close();
 
-  if (mIndices.empty() || !mVerts)
+  if (!mVerts || mVerts->size() == 0)
     return NULL;
 
   ref<Geometry> geom = new Geometry;
   geom->setVertexArray(mVerts.get());
   geom->setNormalArray(mNormals.get());
   geom->setColorArray(mColors.get());
-  ref<DrawElementsUInt> de = new DrawElementsUInt(PT_TRIANGLES);
-  geom->drawCalls().push_back(de.get());
-  de->indexBuffer()->resize(mIndices.size());
-  memcpy(de->indexBuffer()->ptr(), &mIndices[0], sizeof(unsigned int)*mIndices.size());
+  if (mIndices.empty())
+  {
+    // point cloud
+    geom->drawCalls().push_back( new DrawArrays(PT_POINTS, 0, (int)mVerts->size()) );
+  }
+  else
+  {
+    ref<DrawElementsUInt> de = new DrawElementsUInt(PT_TRIANGLES);
+    geom->drawCalls().push_back(de.get());
+    de->indexBuffer()->resize(mIndices.size());
+    memcpy(de->indexBuffer()->ptr(), &mIndices[0], sizeof(unsigned int)*mIndices.size());
+  }
 
   // Effect
   ref<Effect> effect = new Effect;
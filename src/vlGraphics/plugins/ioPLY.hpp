@@ -218,7 +218,7 @@ namespace vl
       }
       ubvec4 getColor() const
       {
-        ubvec4 v;
+        ubvec4 v(0,0,0,255);
         if (mColor[0]) v.r() = (unsigned char)mColor[0]->getAsInt();
         if (mColor[1]) v.g() = (unsigned char)mColor[1]->getAsInt();
         if (mColor[2]) v.b() = (unsigned char)mColor[2]->getAsInt();
@@ -226,6 +226,14 @@ namespace vl
         return v;
       }
       void analyze();
+      //! The size in bytes of a binary element, 0 if the element contains a list property.
+      int binaryStride() const;
+      //! The x, y and z properties found by analyze(), NULL if missing.
+      const std::vector< ref<PlyScalar> >& vertexScalars() const { return mVertex; }
+      //! The nx, ny and nz properties found by analyze(), NULL if missing.
+      const std::vector< ref<PlyScalar> >& normalScalars() const { return mNormal; }
+      //! The red, green, blue and alpha properties found by analyze(), NULL if missing.
+      const std::vector< ref<PlyScalar> >& colorScalars() const { return mColor; }
     protected:
       std::vector< ref<PlyPropertyAbstract> > mProperties;
       std::vector< ref<PlyScalar> > mVertex;
@@ -236,15 +244,23 @@ namespace vl
     };
   public:
     //! Constructor
-    PlyLoader(): mBinary(false), mLittleEndian(false) {}
+    PlyLoader(): mBinary(false), mLittleEndian(false), mBulkDecoding(true) {}
     //! Loads a PLY file.
+    //! Files without faces, like point clouds, are loaded as a Geometry drawn with PT_POINTS.
     ref<ResourceDatabase> loadPly(VirtualFile* file);
+    //! If enabled (default) the binary elements made only of scalar properties, like the vertices of most files,
+    //! are read a block of elements at a time and decoded directly into the vertex, normal and color arrays.
+    //! Elements containing a list property, like the faces, are always read one property at a time.
+    void setBulkDecoding(bool enable) { mBulkDecoding = enable; }
+    //! Whether the binary elements made only of scalar properties are read a block at a time, see setBulkDecoding().
+    bool bulkDecoding() const { return mBulkDecoding; }
     const std::vector< ref<PlyElement> >& elements() const { return mElements; }
     std::vector< ref<PlyElement> >& elements() { return mElements; }
     bool binary() const { return mBinary; }
     bool littleEndian() const { return mLittleEndian; }
     void readElements(VirtualFile* file);
     void readElements(TextStream* text);
+    void readElementBlocks(VirtualFile* file, PlyElement* el);
     void newElement(PlyElement*el);
     EType translateType(const String& type);
     void analyzeHeader();
@@ -258,6 +274,7 @@ namespace vl
     int mVertexIndex;
     bool mBinary;
     bool mLittleEndian;
+    bool mBulkDecoding;
 };
 };
 
@@ -39,9 +39,119 @@
 #include <vlGraphics/Effect.hpp>
 #include <vlGraphics/Actor.hpp>
 #include <vlCore/LoadWriterManager.hpp>
+#include <vlCore/MurmurHash3.hpp>
 #include <stdio.h>
 
 using namespace vl;
+
+namespace
+{
+  //! Welds the identical vertices of the triangles while they are read using an open addressing hash map,
+  //! the welded vertices are kept in the order of their first occurrence.
+  class STLWelder
+  {
+  public:
+    STLWelder(bool normals, size_t expected_verts): mNormals(normals)
+    {
+      size_t table_size = 1024;
+      while( table_size < expected_verts * 2 )
+        table_size <<= 1;
+      mTable.resize(table_size, 0xFFFFFFFF);
+    }
+
+    //! Returns the index of the welded vertex, when welding the normals too the vertices are shared only by the triangles with the same face normal.
+    u32 addVertex(const fvec3& v, const fvec3& n)
+    {
+      if ( mVerts.size() * 2 >= mTable.size() )
+        rehash();
+      size_t mask = mTable.size() - 1;
+      for( size_t h = hash(v, n) & mask; ; h = (h+1) & mask )
+      {
+        u32 i = mTable[h];
+        if ( i == 0xFFFFFFFF )
+        {
+          mTable[h] = (u32)mVerts.size();
+          mVerts.push_back(v);
+          if ( mNormals )
+            mNorms.push_back(n);
+          return mTable[h];
+        }
+        if ( mVerts[i] == v && (!mNormals || mNorms[i] == n) )
+          return i;
+      }
+    }
+
+    //! Copies the welded vertices and normals to the given arrays and releases them.
+    void fill(ArrayFloat3* verts, ArrayFloat3* normals)
+    {
+      verts->resize( mVerts.size() );
+      if ( !mVerts.empty() )
+        memcpy( verts->ptr(), &mVerts[0], sizeof(mVerts[0]) * mVerts.size() );
+      if ( mNormals )
+      {
+        normals->resize( mNorms.size() );
+        if ( !mNorms.empty() )
+          memcpy( normals->ptr(), &mNorms[0], sizeof(mNorms[0]) * mNorms.size() );
+      }
+      std::vector<fvec3>().swap(mVerts);
+      std::vector<fvec3>().swap(mNorms);
+      std::vector<u32>().swap(mTable);
+    }
+
+  protected:
+    u32 hash(const fvec3& v, const fvec3& n) const
+    {
+      u64 key = floatBitsKey(v.x(), v.y(), v.z());
+      if ( mNormals )
+        key ^= floatBitsKey(n.x(), n.y(), n.z()) * 0xc2b2ae3d27d4eb4fULL;
+      return murmurFinalize64(key);
+    }
+
+    void rehash()
+    {
+      std::vector<u32> table( mTable.size() * 2, 0xFFFFFFFF );
+      size_t mask = table.size() - 1;
+      for( u32 i=0; i<mVerts.size(); ++i )
+      {
+        size_t h = hash( mVerts[i], mNormals ? mNorms[i] : fvec3() ) & mask;
+        while( table[h] != 0xFFFFFFFF )
+          h = (h+1) & mask;
+        table[h] = i;
+      }
+      mTable.swap(table);
+    }
+
+  protected:
+    bool mNormals;
+    std::vector<fvec3> mVerts;
+    std::vector<fvec3> mNorms;
+    std::vector<u32> mTable;
+  };
+
+  //! Reads up to \p byte_count bytes, returns less only at the end of the file.
+  long long readBlock(VirtualFile* file, void* buffer, long long byte_count)
+  {
+    long long bytes = 0;
+    while( bytes < byte_count )
+    {
+      long long count = file->read( (u8*)buffer + bytes, byte_count - bytes );
+      if ( count <= 0 )
+        break;
+      bytes += count;
+    }
+    return bytes;
+  }
+
+  ref<ResourceDatabase> makeResourceDatabase(Geometry* geom)
+  {
+    ref<ResourceDatabase> res_db = new ResourceDatabase;
+    ref<Effect> effect = new Effect;
+    res_db->resources().push_back( geom );
+    res_db->resources().push_back( new Actor(geom, effect.get(), NULL ) );
+    res_db->resources().push_back( effect.get() );
+    return res_db;
+  }
+}
 //-----------------------------------------------------------------------------
 ref<ResourceDatabase> vl::loadSTL(const String& path)
 {
@@ -72,45 +182,76 @@ ref<ResourceDatabase> STLLoader::loadBinary(VirtualFile* file)
 
   ref<ArrayFloat3>  verts   = new ArrayFloat3;
   ref<ArrayFloat3>  normals = new ArrayFloat3;
-  verts->resize(tri_count*3);
-  normals->resize(tri_count*3);
-  ref<DrawArrays> de = new DrawArrays(PT_TRIANGLES,0,tri_count*3);
+  ref<DrawElementsUInt> de = new DrawElementsUInt(PT_TRIANGLES);
   ref<Geometry> geom = new Geometry;
-  geom->drawCalls().push_back(de.get());
   geom->setVertexArray(verts.get());
-  geom->setNormalArray(normals.get());
-
-  struct STriangle {
-    fvec3 n;
-    fvec3 v0;
-    fvec3 v1;
-    fvec3 v2;
-    vl::u16 abc; // attribute byte count
-  };
+  if (mFaceNormals)
+    geom->setNormalArray(normals.get());
 
-  std::vector<u8> tris;
-  tris.resize( tri_count * 50 );
-  file->read( &tris[0], tri_count * 50 );
+  STLWelder welder( mFaceNormals, mWeldVertices ? tri_count / 2 : 0 );
+  if (mWeldVertices)
+    de->indexBuffer()->resize(tri_count*3);
+  else
+  {
+    verts->resize(tri_count*3);
+    if (mFaceNormals)
+      normals->resize(tri_count*3);
+  }
 
-  // read triangles
-  for(unsigned int i=0; i<tri_count; ++i)
+  // read the triangles in blocks, each one is a record of 50 bytes: normal, 3 vertices and attribute byte count
+  const unsigned int block_size = mBlockSize > 0 ? mBlockSize : 4096;
+  std::vector<u8> block( block_size * 50 );
+  unsigned int read_count = 0;
+  while( read_count < tri_count )
   {
-    STriangle& tri = *((STriangle*)&tris[ i * 50 ]);
-
-    normals->at(i*3+0) = tri.n;
-    normals->at(i*3+1) = tri.n;
-    normals->at(i*3+2) = tri.n;
-    verts->at(i*3+0) = tri.v0;
-    verts->at(i*3+1) = tri.v1;
-    verts->at(i*3+2) = tri.v2;
+    unsigned int count = tri_count - read_count < block_size ? tri_count - read_count : block_size;
+    unsigned int block_count = (unsigned int)( readBlock( file, &block[0], count * 50 ) / 50 );
+    for(unsigned int i=0; i<block_count; ++i)
+    {
+      float f[12];
+      memcpy( f, &block[ i * 50 ], sizeof(f) );
+      fvec3 n( f[0], f[1], f[2] );
+      unsigned int ivert = (read_count + i) * 3;
+      for(int k=0; k<3; ++k)
+      {
+        fvec3 v( f[3+k*3], f[4+k*3], f[5+k*3] );
+        if (mWeldVertices)
+          de->indexBuffer()->begin()[ivert+k] = welder.addVertex(v, n);
+        else
+        {
+          verts->begin()[ivert+k] = v;
+          if (mFaceNormals)
+            normals->begin()[ivert+k] = n;
+        }
+      }
+    }
+    read_count += block_count;
+    if (block_count < count)
+    {
+      Log::warning( Say("STLLoader::loadBinary(): '%s' is truncated, %n of %n triangles read.\n") << file->path() << read_count << tri_count );
+      break;
+    }
   }
 
-  ref<ResourceDatabase> res_db = new ResourceDatabase;
-  ref<Effect> effect = new Effect;
-  res_db->resources().push_back( geom );
-  res_db->resources().push_back( new Actor(geom.get(), effect.get(), NULL ) );
-  res_db->resources().push_back( effect.get() );
-  return res_db;
+  if (mWeldVertices)
+  {
+    de->indexBuffer()->resize(read_count*3);
+    welder.fill(verts.get(), normals.get());
+    geom->drawCalls().push_back(de.get());
+  }
+  else
+  {
+    verts->resize(read_count*3);
+    if (mFaceNormals)
+      normals->resize(read_count*3);
+    geom->drawCalls().push_back( new DrawArrays(PT_TRIANGLES, 0, read_count*3) );
+  }
+
+  long long unwelded = (long long)read_count * 3 * sizeof(fvec3) * 2;
+  mStatsMemorySaved = unwelded - ( verts->bytesUsed() + (mFaceNormals ? normals->bytesUsed() : 0) + (mWeldVertices ? de->indexBuffer()->bytesUsed() : 0) );
+  Log::debug( Say("STLLoader::loadBinary(): %n triangles, %n vertices, %n bytes saved.\n") << read_count << verts->size() << mStatsMemorySaved );
+
+  return makeResourceDatabase(geom.get());
 }
 //-----------------------------------------------------------------------------
 ref<ResourceDatabase> STLLoader::loadAscii(VirtualFile* file)
@@ -151,22 +292,37 @@ ref<ResourceDatabase> STLLoader::loadAscii(VirtualFile* file)
 
   ref<ArrayFloat3>  vertices   = new ArrayFloat3;
   ref<ArrayFloat3>  normals = new ArrayFloat3;
-  vertices->resize(verts.size());
-  normals->resize(verts.size());
-  memcpy(normals ->ptr(), &norms[0], sizeof(norms[0])*norms.size());
-  memcpy(vertices->ptr(), &verts[0], sizeof(verts[0])*verts.size());
-  ref<DrawArrays> de = new DrawArrays(PT_TRIANGLES,0,verts.size());
   ref<Geometry> geom = new Geometry;
-  geom->drawCalls().push_back(de.get());
   geom->setVertexArray(vertices.get());
-  geom->setNormalArray(normals.get());
+  if (mFaceNormals)
+    geom->setNormalArray(normals.get());
+  if (mWeldVertices)
+  {
+    STLWelder welder( mFaceNormals, verts.size() / 6 );
+    ref<DrawElementsUInt> de = new DrawElementsUInt(PT_TRIANGLES);
+    de->indexBuffer()->resize(verts.size());
+    for(size_t i=0; i<verts.size(); ++i)
+      de->indexBuffer()->begin()[i] = welder.addVertex(verts[i], norms[i]);
+    welder.fill(vertices.get(), normals.get());
+    geom->drawCalls().push_back(de.get());
+    mStatsMemorySaved = (long long)verts.size() * sizeof(fvec3) * 2 - ( vertices->bytesUsed() + (mFaceNormals ? normals->bytesUsed() : 0) + de->indexBuffer()->bytesUsed() );
+  }
+  else
+  {
+    vertices->resize(verts.size());
+    if (!verts.empty())
+      memcpy(vertices->ptr(), &verts[0], sizeof(verts[0])*verts.size());
+    if (mFaceNormals)
+    {
+      normals->resize(verts.size());
+      if (!norms.empty())
+        memcpy(normals ->ptr(), &norms[0], sizeof(norms[0])*norms.size());
+    }
+    geom->drawCalls().push_back( new DrawArrays(PT_TRIANGLES,0,verts.size()) );
+    mStatsMemorySaved = mFaceNormals ? 0 : (long long)verts.size() * sizeof(fvec3);
+  }
 
-  ref<ResourceDatabase> res_db = new ResourceDatabase;
-  ref<Effect> effect = new Effect;
-  res_db->resources().push_back( geom );
-  res_db->resources().push_back( new Actor(geom.get(), effect.get(), NULL ) );
-  res_db->resources().push_back( effect.get() );
-  return res_db;
+  return makeResourceDatabase(geom.get());
 }
 //-----------------------------------------------------------------------------
 ref<ResourceDatabase> STLLoader::loadSTL(VirtualFile* file)
@@ -87,14 +87,49 @@ namespace vl
 //-----------------------------------------------------------------------------
   /**
    * Loads an STL file.
+   *
+   * By default the loaded Geometry contains three vertices and three copies of the face normal per triangle drawn with a DrawArrays.
+   * If weldVertices() is enabled the identical vertices are welded while the triangles are read, using a hash map, and the
+   * Geometry is drawn with a DrawElementsUInt. Binary files are always read in blocks of blockSize() triangles.
    */
   class VLGRAPHICS_EXPORT STLLoader
   {
   public:
+    STLLoader(): mWeldVertices(false), mFaceNormals(true), mBlockSize(4096), mStatsMemorySaved(0) {}
+
     //! Loads a STL file.
     ref<ResourceDatabase> loadSTL(VirtualFile* file);
     ref<ResourceDatabase> loadAscii(VirtualFile* file);
     ref<ResourceDatabase> loadBinary(VirtualFile* file);
+
+    //! If enabled the identical vertices are welded and the Geometry is drawn with a DrawElementsUInt, disabled by default.
+    void setWeldVertices(bool weld) { mWeldVertices = weld; }
+
+    //! If enabled the identical vertices are welded and the Geometry is drawn with a DrawElementsUInt, disabled by default.
+    bool weldVertices() const { return mWeldVertices; }
+
+    //! Whether the Geometry gets a normal array with the face normals stored in the file, enabled by default.
+    //! When welding, the vertices are shared only by the triangles with the same face normal: disable the face normals to
+    //! weld all the vertices with the same position and compute smooth normals with Geometry::computeNormals().
+    void setFaceNormals(bool face_normals) { mFaceNormals = face_normals; }
+
+    //! Whether the Geometry gets a normal array with the face normals stored in the file, enabled by default.
+    bool faceNormals() const { return mFaceNormals; }
+
+    //! The number of triangles read at once from a binary file, the default is 4096.
+    void setBlockSize(int triangles) { mBlockSize = triangles; }
+
+    //! The number of triangles read at once from a binary file, the default is 4096.
+    int blockSize() const { return mBlockSize; }
+
+    //! The bytes saved by the last load with respect to the default output, i.e. three vertices and three normals per triangle.
+    long long statsMemorySaved() const { return mStatsMemorySaved; }
+
+  protected:
+    bool mWeldVertices;
+    bool mFaceNormals;
+    int mBlockSize;
+    long long mStatsMemorySaved;
   };
 };
 
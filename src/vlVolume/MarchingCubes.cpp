@@ -33,6 +33,7 @@
 
 #include <vlVolume/MarchingCubes.hpp>
 #include <vlCore/Time.hpp>
+#include <vlCore/GlobalSettings.hpp>
 #include <vlGraphics/DoubleVertexRemover.hpp>
 
 using namespace vl;
@@ -71,16 +72,40 @@ MarchingCubes::MarchingCubes()
 #endif
   mVolumeInfo.setAutomaticDelete(false);
   mHighQualityNormals = true;
+  mSlabCount = 0;
+  mBrickSize = 0;
+  mExtractedBrickCount = 0;
 }
 //------------------------------------------------------------------------------
 // MarchingCubes
 //------------------------------------------------------------------------------
-void MarchingCubes::computeEdges(Volume* vol, float threshold)
+void MarchingCubes::markActiveBlocks(const Volume* vol, float threshold, int level, int x, int y, int z)
 {
-  // mEdges.clear();
-  mEdges.resize(vol->slices().x() * vol->slices().y() * vol->slices().z());
-  mCubes.clear();
-  mCubes.reserve(1024);
+  if (!vol->block(level, x, y, z).includes(threshold))
+    return;
+
+  if (level == 0)
+  {
+    const ivec3& size = vol->pyramidLevelSize(0);
+    mActiveBlocks[ x + y*size.x() + z*size.x()*size.y() ] = 1;
+    return;
+  }
+
+  const ivec3& size = vol->pyramidLevelSize(level-1);
+  for(int cz = z*2; cz < z*2+2 && cz < size.z(); ++cz)
+    for(int cy = y*2; cy < y*2+2 && cy < size.y(); ++cy)
+      for(int cx = x*2; cx < x*2+2 && cx < size.x(); ++cx)
+        markActiveBlocks(vol, threshold, level-1, cx, cy, cz);
+}
+//------------------------------------------------------------------------------
+void MarchingCubes::computeEdges(Volume* vol, float threshold, Region& region)
+{
+  // the vertices are numbered starting from 0 within each region, processCube() adds the Region::mVert0 offset.
+  // Each region only writes the mEdges entries of its own points so disjoint regions can be processed concurrently.
+  region.mVerts.clear();
+  region.mNorms.clear();
+  region.mCubes.clear();
+  region.mEdgeCells.clear();
 
   /////////////////////////////////////////////////////////////////////////////////
   // note: this funtion can generate double vertices when the 't' is 0.0 or 1.0
@@ -93,38 +118,45 @@ void MarchingCubes::computeEdges(Volume* vol, float threshold)
   const float dy = vol->cellSize().y() * 0.25f;
   const float dz = vol->cellSize().z() * 0.25f;
   float v0, v1, v2, v3, t;
-  int iedge = 0;
   int w = vol->slices().x() -1;
   int h = vol->slices().y() -1;
   int d = vol->slices().z() -1;
-  for(unsigned short z = 0; z < vol->slices().z(); ++z)
+  // no edge and no cube starts from the points on the boundary of a region
+  const ivec3& boundary = region.mBoundary;
+  // the points on the far sides of the volume belong to the blocks of their adjacent cubes
+  const int block_size = Volume::blockSize();
+  const ivec3& blocks  = vol->pyramidLevelSize(0);
+  for(int z = region.mFirst.z(); z <= region.mLast.z(); ++z)
   {
-    for(unsigned short y = 0; y < vol->slices().y(); ++y)
+    const unsigned char* active_z = &mActiveBlocks[ std::min(z, d-1) / block_size * blocks.x() * blocks.y() ];
+    for(int y = region.mFirst.y(); y <= region.mLast.y(); ++y)
     {
-      for(unsigned short x = 0; x < vol->slices().x(); ++x, ++iedge)
+      const unsigned char* active_row = active_z + std::min(y, h-1) / block_size * blocks.x();
+      int row = (z * vol->slices().y() + y) * vol->slices().x();
+      for(int x = region.mFirst.x(); x <= region.mLast.x(); ++x)
       {
-        if (x != w && y != h && z != d)
+        int iedge = row + x;
+
+        // skip the blocks that do not contain the threshold
+        int bx = std::min(x, w-1) / block_size;
+        if (!active_row[bx])
         {
-          if (vol->cube(x,y,z).includes(threshold))
-          {
-            if (mCubes.capacity()-mCubes.size() == 0)
-              mCubes.reserve(mCubes.size()*2);
-            mCubes.push_back( usvec3(x,y,z) );
-          }
-          else
-            continue;
+          x = std::max(x, (bx+1) * block_size - 1);
+          continue;
         }
 
-        if (mVerts.capacity() - mVerts.size() == 0)
+        if (x != boundary.x() && y != boundary.y() && z != boundary.z())
         {
-          mVerts.reserve( mVerts.size() * 2 );
-          mNorms.reserve( mNorms.size() * 2 );
+          if (vol->cube(x,y,z).includes(threshold))
+            region.mCubes.push_back( usvec3((unsigned short)x, (unsigned short)y, (unsigned short)z) );
+          else
+            continue;
         }
 
         v0 = vol->value( x,y,z );
         fvec3 v0_coord = vol->coordinate(x, y, z);
 
-        if (x != w)
+        if (x != boundary.x())
         {
           v1 = vol->value( x + 1, y, z );
           if (v1!=v0)
@@ -135,19 +167,19 @@ void MarchingCubes::computeEdges(Volume* vol, float threshold)
               t = (threshold-v0)/(v1-v0);
               VL_CHECK(t>=-0.001f && t<=1.001f)
               // emit vertex
-              mEdges[iedge].mX = (int)mVerts.size();
+              mEdges[iedge].mX = (int)region.mVerts.size();
               // compute vertex and normal position
-              mVerts.push_back( v0_coord * (1.0f-t) + vol->coordinate(x + 1, y, z) * t );
+              region.mVerts.push_back( v0_coord * (1.0f-t) + vol->coordinate(x + 1, y, z) * t );
               if (mHighQualityNormals)
               {
                 fvec3 n;
-                vol->normalHQ(n, mVerts.back(), dx, dy, dz);
-                mNorms.push_back(n);
+                vol->normalHQ(n, region.mVerts.back(), dx, dy, dz);
+                region.mNorms.push_back(n);
               }
             }
           }
         }
-        if (y != h)
+        if (y != boundary.y())
         {
           v2 = vol->value( x, y + 1, z );
           if (v2!=v0)
@@ -158,19 +190,19 @@ void MarchingCubes::computeEdges(Volume* vol, float threshold)
               t = (threshold-v0)/(v2-v0);
               VL_CHECK(t>=-0.001f && t<=1.001f)
               // emit vertex
-              mEdges[iedge].mY = (int)mVerts.size();
+              mEdges[iedge].mY = (int)region.mVerts.size();
               // compute vertex and normal position
-              mVerts.push_back( v0_coord * (1.0f-t) + vol->coordinate(x, y + 1, z) * t );
+              region.mVerts.push_back( v0_coord * (1.0f-t) + vol->coordinate(x, y + 1, z) * t );
               if (mHighQualityNormals)
               {
                 fvec3 n;
-                vol->normalHQ(n, mVerts.back(), dx, dy, dz);
-                mNorms.push_back(n);
+                vol->normalHQ(n, region.mVerts.back(), dx, dy, dz);
+                region.mNorms.push_back(n);
               }
             }
           }
         }
-        if (z != d)
+        if (z != boundary.z())
         {
           v3 = vol->value( x, y, z + 1 );
           if (v3!=v0)
@@ -181,24 +213,28 @@ void MarchingCubes::computeEdges(Volume* vol, float threshold)
               t = (threshold-v0)/(v3-v0);
               VL_CHECK(t>=-0.001f && t<=1.001f)
               // emit vertex
-              mEdges[iedge].mZ = (int)mVerts.size();
+              mEdges[iedge].mZ = (int)region.mVerts.size();
               // compute vertex and normal position
-              mVerts.push_back( v0_coord * (1.0f-t) + vol->coordinate(x, y, z + 1) * t );
+              region.mVerts.push_back( v0_coord * (1.0f-t) + vol->coordinate(x, y, z + 1) * t );
               if (mHighQualityNormals)
               {
                 fvec3 n;
-                vol->normalHQ(n, mVerts.back(), dx, dy, dz);
-                mNorms.push_back(n);
+                vol->normalHQ(n, region.mVerts.back(), dx, dy, dz);
+                region.mNorms.push_back(n);
               }
             }
           }
         }
+
+        // remember the edges to be cleared before the next volume is processed
+        if (mEdges[iedge].mX >= 0 || mEdges[iedge].mY >= 0 || mEdges[iedge].mZ >= 0)
+          region.mEdgeCells.push_back(iedge);
       }
     }
   }
 }
 //------------------------------------------------------------------------------
-void MarchingCubes::processCube(int x, int y, int z, Volume* vol, float threshold)
+void MarchingCubes::processCube(int x, int y, int z, Volume* vol, float threshold, Region& region, int vert0_z0, int vert0_z1)
 {
   int inner_corners = 0;
 
@@ -239,6 +275,8 @@ void MarchingCubes::processCube(int x, int y, int z, Volume* vol, float threshol
   int cell5 = x     + y1 + z0;
   int cell6 = x     + y1 + z1;
 
+  // the edges are shared with the neighboring cubes and the ones on the z+1 slice might belong to the next region:
+  // convert their region local vertex index into the final vertex index.
   int edge_ivert[12] =
   {
     mEdges[cell0].mX,
@@ -256,13 +294,15 @@ void MarchingCubes::processCube(int x, int y, int z, Volume* vol, float threshol
     mEdges[cell4].mZ,
     mEdges[cell5].mZ,
   };
+  for(int i=0; i<12; ++i)
+  {
+    if (edge_ivert[i] >= 0)
+      edge_ivert[i] += (i>=4 && i<8) ? vert0_z1 : vert0_z0;
+  }
 
   int ivertex;
   for(int icorner = 0; mTriangleConnectionTable[inner_corners][icorner]>=0; icorner+=3)
   {
-    if (mIndices.capacity() - mIndices.size() == 0)
-      mIndices.reserve( mIndices.size()*2 );
-
     ivertex = mTriangleConnectionTable[inner_corners][icorner+0];
     int a = edge_ivert[ivertex];
 
@@ -288,9 +328,9 @@ void MarchingCubes::processCube(int x, int y, int z, Volume* vol, float threshol
         continue;
     #endif
 
-    mIndices.push_back((IndexType)a);
-    mIndices.push_back((IndexType)b);
-    mIndices.push_back((IndexType)c);
+    region.mIndices.push_back((IndexType)a);
+    region.mIndices.push_back((IndexType)b);
+    region.mIndices.push_back((IndexType)c);
   }
 }
 //------------------------------------------------------------------------------
@@ -304,11 +344,163 @@ void MarchingCubes::reset()
   mVerts.clear();
   mNorms.clear();
   mColors.clear();
-  mCubes.clear();
+  mSlabs.clear();
+  mBrickedVolumes.clear();
+  mActiveBlocks.clear();
   mEdges.clear();
   mVolumeInfo.clear();
 }
 //------------------------------------------------------------------------------
+void MarchingCubes::extractSlabs(Volume* vol, float threshold)
+{
+  // split the volume in slabs of z-slices
+  int slices_z = vol->slices().z();
+  int slab_count = mSlabCount > 0 ? mSlabCount : globalSettings()->threadCount();
+  slab_count = clamp(slab_count, 1, slices_z);
+  int slab_depth = (slices_z + slab_count - 1) / slab_count;
+  slab_count = (slices_z + slab_depth - 1) / slab_depth;
+  mSlabs.resize(slab_count);
+  for(int islab=0; islab<slab_count; ++islab)
+  {
+    mSlabs[islab].mFirst = ivec3(0, 0, islab * slab_depth);
+    mSlabs[islab].mLast  = ivec3(vol->slices().x()-1, vol->slices().y()-1, std::min(slices_z, (islab+1) * slab_depth)-1);
+    mSlabs[islab].mBoundary = vol->slices() - ivec3(1, 1, 1);
+  }
+
+  int thread_count = globalSettings()->threadCount();
+
+  // note: this function takes the 90% of the time
+  #ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+  #endif
+  for(int islab=0; islab<slab_count; ++islab)
+    computeEdges(vol, threshold, mSlabs[islab]);
+
+  // the vertices of each slab follow the ones of the previous slab like in a single threaded run
+  int vert0 = (int)mVerts.size();
+  for(int islab=0; islab<slab_count; ++islab)
+  {
+    mSlabs[islab].mVert0 = vert0;
+    vert0 += (int)mSlabs[islab].mVerts.size();
+  }
+
+  // note: this loop takes the remaining 10% of the time
+  // the cubes on the last slice of a slab use the vertices computed by the next slab
+  #ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+  #endif
+  for(int islab=0; islab<slab_count; ++islab)
+  {
+    Region& slab = mSlabs[islab];
+    slab.mIndices.clear();
+    for(unsigned int i=0; i<slab.mCubes.size(); ++i)
+    {
+      const usvec3& cube = slab.mCubes[i];
+      int vert0_z1 = cube.z()+1 <= slab.mLast.z() ? slab.mVert0 : mSlabs[islab+1].mVert0;
+      processCube(cube.x(), cube.y(), cube.z(), vol, threshold, slab, slab.mVert0, vert0_z1);
+    }
+  }
+
+  // concatenate the slabs
+  for(int islab=0; islab<slab_count; ++islab)
+  {
+    const Region& slab = mSlabs[islab];
+    mVerts.insert(mVerts.end(), slab.mVerts.begin(), slab.mVerts.end());
+    mNorms.insert(mNorms.end(), slab.mNorms.begin(), slab.mNorms.end());
+    mIndices.insert(mIndices.end(), slab.mIndices.begin(), slab.mIndices.end());
+  }
+}
+//------------------------------------------------------------------------------
+void MarchingCubes::extractBricks(BrickedVolume& bricked, Volume* vol, float threshold, bool dirty, const ivec3& dirty_min, const ivec3& dirty_max)
+{
+  int w = vol->slices().x() -1;
+  int h = vol->slices().y() -1;
+  int d = vol->slices().z() -1;
+
+  // find the range of bricks to be recomputed
+  ivec3 bmin(0, 0, 0);
+  ivec3 bmax(-1, -1, -1);
+  if ( bricked.mVolume.get() != vol || bricked.mThreshold != threshold || bricked.mSlices != vol->slices() ||
+       bricked.mBrickSize != mBrickSize || bricked.mHighQualityNormals != mHighQualityNormals )
+  {
+    bricked.mVolume = vol;
+    bricked.mThreshold = threshold;
+    bricked.mSlices = vol->slices();
+    bricked.mBrickSize = mBrickSize;
+    bricked.mHighQualityNormals = mHighQualityNormals;
+    bricked.mBrickCount = ivec3( (w+mBrickSize-1)/mBrickSize, (h+mBrickSize-1)/mBrickSize, (d+mBrickSize-1)/mBrickSize );
+    bricked.mBricks.clear();
+    bricked.mBricks.resize( bricked.mBrickCount.x() * bricked.mBrickCount.y() * bricked.mBrickCount.z() );
+    for(int bz=0, ibrick=0; bz<bricked.mBrickCount.z(); ++bz)
+      for(int by=0; by<bricked.mBrickCount.y(); ++by)
+        for(int bx=0; bx<bricked.mBrickCount.x(); ++bx, ++ibrick)
+        {
+          bricked.mBricks[ibrick].mFirst = ivec3(bx, by, bz) * mBrickSize;
+          bricked.mBricks[ibrick].mLast  = ivec3( std::min((bx+1)*mBrickSize, w), std::min((by+1)*mBrickSize, h), std::min((bz+1)*mBrickSize, d) );
+          bricked.mBricks[ibrick].mBoundary = bricked.mBricks[ibrick].mLast;
+        }
+    bmax = bricked.mBrickCount - ivec3(1, 1, 1);
+  }
+  else
+  if (dirty)
+  {
+    // the cubes sharing the modified values, see Volume::setupInternalData()
+    ivec3 cmin = dirty_min - ivec3(1, 1, 1);
+    ivec3 cmax = dirty_max;
+    // Volume::normalHQ() samples 1/4 of a cell around the vertices, reaching one more value on each side
+    if (mHighQualityNormals)
+    {
+      cmin = dirty_min - ivec3(2, 2, 2);
+      cmax = dirty_max + ivec3(1, 1, 1);
+    }
+    bmin = ivec3( std::max(cmin.x(), 0),   std::max(cmin.y(), 0),   std::max(cmin.z(), 0) ) / mBrickSize;
+    bmax = ivec3( std::min(cmax.x(), w-1), std::min(cmax.y(), h-1), std::min(cmax.z(), d-1) ) / mBrickSize;
+  }
+
+  // adjacent bricks share the points of their common side in mEdges: each pass extracts in parallel a set of non adjacent bricks
+  int thread_count = globalSettings()->threadCount();
+  std::vector<Region*> bricks;
+  for(int pass=0; pass<8; ++pass)
+  {
+    bricks.clear();
+    for(int bz = bmin.z() + ((bmin.z() ^ (pass>>2)) & 1); bz <= bmax.z(); bz+=2)
+      for(int by = bmin.y() + ((bmin.y() ^ (pass>>1)) & 1); by <= bmax.y(); by+=2)
+        for(int bx = bmin.x() + ((bmin.x() ^ pass) & 1); bx <= bmax.x(); bx+=2)
+          bricks.push_back( &bricked.mBricks[ bx + by*bricked.mBrickCount.x() + bz*bricked.mBrickCount.x()*bricked.mBrickCount.y() ] );
+
+    #ifdef VL_OPENMP
+      #pragma omp parallel for num_threads(thread_count)
+    #endif
+    for(int ibrick=0; ibrick<(int)bricks.size(); ++ibrick)
+    {
+      Region& brick = *bricks[ibrick];
+      computeEdges(vol, threshold, brick);
+      brick.mIndices.clear();
+      for(unsigned int i=0; i<brick.mCubes.size(); ++i)
+        processCube(brick.mCubes[i].x(), brick.mCubes[i].y(), brick.mCubes[i].z(), vol, threshold, brick, 0, 0);
+
+      // leave mEdges clean for the adjacent bricks
+      for(size_t i=0; i<brick.mEdgeCells.size(); ++i)
+        mEdges[ brick.mEdgeCells[i] ] = Edge();
+      brick.mEdgeCells.clear();
+    }
+    mExtractedBrickCount += (int)bricks.size();
+  }
+
+  // splice all the bricks in the output arrays
+  for(size_t ibrick=0; ibrick<bricked.mBricks.size(); ++ibrick)
+  {
+    const Region& brick = bricked.mBricks[ibrick];
+    size_t vert0  = mVerts.size();
+    size_t index0 = mIndices.size();
+    mVerts.insert(mVerts.end(), brick.mVerts.begin(), brick.mVerts.end());
+    mNorms.insert(mNorms.end(), brick.mNorms.begin(), brick.mNorms.end());
+    mIndices.resize( index0 + brick.mIndices.size() );
+    for(size_t i=0; i<brick.mIndices.size(); ++i)
+      mIndices[index0 + i] = (IndexType)(vert0 + brick.mIndices[i]);
+  }
+}
+//------------------------------------------------------------------------------
 void MarchingCubes::run(bool generate_colors)
 {
   mVerts.clear();
@@ -318,6 +510,20 @@ void MarchingCubes::run(bool generate_colors)
   mNorms.reserve(1024);
   mColors.reserve(1024);
   mIndices.reserve(1024);
+  mExtractedBrickCount = 0;
+  mBrickedVolumes.resize( mBrickSize > 0 ? mVolumeInfo.size() : 0 );
+
+  // collect the dirty boxes before updating the volumes since a volume can be used more than once
+  std::vector<int> dirty( mVolumeInfo.size() );
+  std::vector<ivec3> dirty_min( mVolumeInfo.size() );
+  std::vector<ivec3> dirty_max( mVolumeInfo.size() );
+  for(size_t ivol=0; ivol<mVolumeInfo.size(); ++ivol)
+  {
+    const Volume* vol = mVolumeInfo.at(ivol)->volume();
+    dirty[ivol]     = vol->dataIsDirty() ? 1 : 0;
+    dirty_min[ivol] = vol->dirtyMin();
+    dirty_max[ivol] = vol->dirtyMax();
+  }
 
   /*Time time; time.start();*/
 
@@ -330,19 +536,36 @@ void MarchingCubes::run(bool generate_colors)
     if (vol->dataIsDirty())
       vol->setupInternalData();
 
-    // note: this function takes the 90% of the time
-    computeEdges(vol, threshold);
+    // volumes with no cubes produce no triangles
+    if (vol->pyramidLevelCount() == 0)
+    {
+      mVolumeInfo.at(ivol)->setVert0(start);
+      mVolumeInfo.at(ivol)->setVertC(0);
+      continue;
+    }
+
+    // clear the edges set by the previous volume
+    int edge_count = vol->slices().x() * vol->slices().y() * vol->slices().z();
+    if ((int)mEdges.size() != edge_count)
+      mEdges.assign(edge_count, Edge());
+    else
+    {
+      for(size_t islab=0; islab<mSlabs.size(); ++islab)
+        for(size_t i=0; i<mSlabs[islab].mEdgeCells.size(); ++i)
+          mEdges[ mSlabs[islab].mEdgeCells[i] ] = Edge();
+    }
+    for(size_t islab=0; islab<mSlabs.size(); ++islab)
+      mSlabs[islab].mEdgeCells.clear();
 
-    // note: this loop takes the remaining 10% of the time
-    //// the z->y->x order is important in order to minimize cache misses
-    //for(int z = 0; z < mVolume->slices().z()-1; ++z)
-    //  for(int y = 0; y < mVolume->slices().y()-1; ++y)
-    //    for(int x = 0; x < mVolume->slices().x()-1; ++x)
-    //      if(vol->cube(x,y,z).includes(threshold))
-    //        processCube(x, y, z, vol, threshold);
+    // descend the min/max pyramid to find the blocks of cubes containing the threshold
+    const ivec3& blocks = vol->pyramidLevelSize(0);
+    mActiveBlocks.assign(blocks.x() * blocks.y() * blocks.z(), 0);
+    markActiveBlocks(vol, threshold, vol->pyramidLevelCount()-1, 0, 0, 0);
 
-    for(unsigned int i=0; i<mCubes.size(); ++i)
-      processCube(mCubes[i].x(), mCubes[i].y(), mCubes[i].z(), vol, threshold);
+    if (mBrickSize > 0)
+      extractBricks(mBrickedVolumes[ivol], vol, threshold, dirty[ivol] != 0, dirty_min[ivol], dirty_max[ivol]);
+    else
+      extractSlabs(vol, threshold);
 
     int count = (int)mVerts.size() - start;
     mVolumeInfo.at(ivol)->setVert0(start);
@@ -503,16 +726,53 @@ ref<Volume> Volume::downsample() const
 //------------------------------------------------------------------------------
 void Volume::setupInternalData()
 {
-  mDataIsDirty = false;
   int w = slices().x() -1;
   int h = slices().y() -1;
   int d = slices().z() -1;
+  const int block_size = blockSize();
+
+  // a volume with a single slice along an axis contains no cubes
+  if (w <= 0 || h <= 0 || d <= 0)
+  {
+    mDataIsDirty = false;
+    mCubes.clear();
+    mPyramid.clear();
+    mPyramidSize.clear();
+    return;
+  }
+
+  // a value is shared by the cubes on its negative side
+  ivec3 cmin(0, 0, 0);
+  ivec3 cmax(w-1, h-1, d-1);
+  if (mDataIsDirty && (int)mCubes.size() == w*h*d)
+  {
+    cmin = ivec3( std::max(mDirtyMin.x()-1, 0),   std::max(mDirtyMin.y()-1, 0),   std::max(mDirtyMin.z()-1, 0) );
+    cmax = ivec3( std::min(mDirtyMax.x(),   w-1), std::min(mDirtyMax.y(),   h-1), std::min(mDirtyMax.z(),   d-1) );
+  }
+  mDataIsDirty = false;
   mCubes.resize(w*h*d);
-  for(int z = 0; z < d; ++z)
+
+  // compute the pyramid level sizes, the last level is a single block
+  mPyramidSize.clear();
+  mPyramidSize.push_back( ivec3( (w+block_size-1)/block_size, (h+block_size-1)/block_size, (d+block_size-1)/block_size ) );
+  while( mPyramidSize.back() != ivec3(1,1,1) )
+  {
+    const ivec3& size = mPyramidSize.back();
+    mPyramidSize.push_back( ivec3( (size.x()+1)/2, (size.y()+1)/2, (size.z()+1)/2 ) );
+  }
+  mPyramid.resize( mPyramidSize.size() );
+  for(size_t level=0; level<mPyramid.size(); ++level)
+    mPyramid[level].resize( mPyramidSize[level].x() * mPyramidSize[level].y() * mPyramidSize[level].z() );
+
+  int thread_count = globalSettings()->threadCount();
+  #ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+  #endif
+  for(int z = cmin.z(); z <= cmax.z(); ++z)
   {
-    for(int y = 0; y < h; ++y)
+    for(int y = cmin.y(); y <= cmax.y(); ++y)
     {
-      for(int x = 0; x < w; ++x)
+      for(int x = cmin.x(); x <= cmax.x(); ++x)
       {
         float v[] =
         {
@@ -536,6 +796,75 @@ void Volume::setupInternalData()
       }
     }
   }
+
+  // update the blocks of level 0 covering the updated cubes
+  ivec3 bmin( cmin.x()/block_size, cmin.y()/block_size, cmin.z()/block_size );
+  ivec3 bmax( cmax.x()/block_size, cmax.y()/block_size, cmax.z()/block_size );
+  const ivec3& size0 = mPyramidSize[0];
+  #ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+  #endif
+  for(int bz = bmin.z(); bz <= bmax.z(); ++bz)
+  {
+    for(int by = bmin.y(); by <= bmax.y(); ++by)
+    {
+      for(int bx = bmin.x(); bx <= bmax.x(); ++bx)
+      {
+        Cube& block = mPyramid[0][ bx + by*size0.x() + bz*size0.x()*size0.y() ];
+        block = cube(bx*block_size, by*block_size, bz*block_size);
+        for(int z = bz*block_size; z < std::min((bz+1)*block_size, d); ++z)
+          for(int y = by*block_size; y < std::min((by+1)*block_size, h); ++y)
+            for(int x = bx*block_size; x < std::min((bx+1)*block_size, w); ++x)
+            {
+              const Cube& c = mCubes[x+w*y+w*h*z];
+              if (block.mMin > c.mMin) block.mMin = c.mMin;
+              if (block.mMax < c.mMax) block.mMax = c.mMax;
+            }
+      }
+    }
+  }
+
+  // propagate to the upper levels
+  for(size_t level=1; level<mPyramid.size(); ++level)
+  {
+    bmin = ivec3( bmin.x()/2, bmin.y()/2, bmin.z()/2 );
+    bmax = ivec3( bmax.x()/2, bmax.y()/2, bmax.z()/2 );
+    const ivec3& csize = mPyramidSize[level-1];
+    for(int bz = bmin.z(); bz <= bmax.z(); ++bz)
+    {
+      for(int by = bmin.y(); by <= bmax.y(); ++by)
+      {
+        for(int bx = bmin.x(); bx <= bmax.x(); ++bx)
+        {
+          Cube& b = mPyramid[level][ bx + by*mPyramidSize[level].x() + bz*mPyramidSize[level].x()*mPyramidSize[level].y() ];
+          b = block((int)level-1, bx*2, by*2, bz*2);
+          for(int z = bz*2; z < std::min(bz*2+2, csize.z()); ++z)
+            for(int y = by*2; y < std::min(by*2+2, csize.y()); ++y)
+              for(int x = bx*2; x < std::min(bx*2+2, csize.x()); ++x)
+              {
+                const Cube& c = block((int)level-1, x, y, z);
+                if (b.mMin > c.mMin) b.mMin = c.mMin;
+                if (b.mMax < c.mMax) b.mMax = c.mMax;
+              }
+        }
+      }
+    }
+  }
+}
+//------------------------------------------------------------------------------
+void Volume::setDataDirty(const ivec3& min, const ivec3& max)
+{
+  if (mDataIsDirty)
+  {
+    mDirtyMin = ivec3( std::min(mDirtyMin.x(), min.x()), std::min(mDirtyMin.y(), min.y()), std::min(mDirtyMin.z(), min.z()) );
+    mDirtyMax = ivec3( std::max(mDirtyMax.x(), max.x()), std::max(mDirtyMax.y(), max.y()), std::max(mDirtyMax.z(), max.z()) );
+  }
+  else
+  {
+    mDirtyMin = min;
+    mDirtyMax = max;
+  }
+  mDataIsDirty = true;
 }
 //------------------------------------------------------------------------------
 void Volume::setup( float* data, bool use_directly, bool copy_data, const fvec3& bottom_left, const fvec3& top_right, const ivec3& slices )
@@ -569,7 +898,8 @@ void Volume::setup( float* data, bool use_directly, bool copy_data, const fvec3&
   mMinimum = +1;
   mMaximum = -1;
   mAverage = 0;
-  mDataIsDirty = true;
+  mDataIsDirty = false;
+  setDataDirty();
 }
 //------------------------------------------------------------------------------
 void Volume::setup(const Volume& volume)
@@ -578,7 +908,8 @@ void Volume::setup(const Volume& volume)
   mMinimum = +1;
   mMaximum = -1;
   mAverage = 0;
-  mDataIsDirty = true;
+  mDataIsDirty = false;
+  setDataDirty();
 }
 //------------------------------------------------------------------------------
 float Volume::sampleNearest(float x, float y, float z) const
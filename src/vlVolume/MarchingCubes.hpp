@@ -42,6 +42,8 @@ namespace vl
   //------------------------------------------------------------------------------
   /**
    * Defines the volume data to be used with a MarchingCube object.
+   * setupInternalData() computes the value range of every cube and a min/max pyramid of blocks of cubes
+   * which MarchingCubes descends to skip the regions of the volume that cannot contain the isosurface.
    */
   class VLVOLUME_EXPORT Volume: public Object
   {
@@ -134,10 +136,42 @@ namespace vl
     bool dataIsDirty() const { return mDataIsDirty; }
 
     //! Notifies that the data of a Volume has changed and that the internal acceleration structures should be recomputed.
-    void setDataDirty() { mDataIsDirty = true; }
+    void setDataDirty() { setDataDirty(ivec3(0,0,0), mSlices - ivec3(1,1,1)); }
 
+    //! Notifies that the values from \p min to \p max (inclusive voxel coordinates) have changed: setupInternalData() will
+    //! recompute only the cubes and the blocks of the min/max pyramid depending on them. Successive calls enlarge the dirty box.
+    void setDataDirty(const ivec3& min, const ivec3& max);
+
+    //! The first corner of the box containing the values changed since the last setupInternalData(), meaningful only if dataIsDirty() is \p true.
+    const ivec3& dirtyMin() const { return mDirtyMin; }
+
+    //! The second corner of the box containing the values changed since the last setupInternalData(), meaningful only if dataIsDirty() is \p true.
+    const ivec3& dirtyMax() const { return mDirtyMax; }
+
+    //! Updates the min/max of the cubes and of the min/max pyramid blocks within the dirty box, see setDataDirty().
     void setupInternalData();
 
+    //! The number of cubes along each side of the blocks of level 0 of the min/max pyramid.
+    static int blockSize() { return 8; }
+
+    //! The number of levels of the min/max pyramid built by setupInternalData().
+    //! Level 0 has a block every blockSize()^3 cubes, each block of the next levels covers 2x2x2 blocks of the previous one and the last level is a single block.
+    //! Returns 0 when the volume has a single slice along one of its axes, since it contains no cubes.
+    int pyramidLevelCount() const { return (int)mPyramid.size(); }
+
+    //! The number of blocks along x, y and z of the given level of the min/max pyramid.
+    const ivec3& pyramidLevelSize(int level) const { return mPyramidSize[level]; }
+
+    //! The minimum and maximum value of the cubes covered by the given block of the min/max pyramid.
+    const Volume::Cube& block(int level, int x, int y, int z) const
+    {
+      const ivec3& size = mPyramidSize[level];
+      VL_CHECK(x<size.x())
+      VL_CHECK(y<size.y())
+      VL_CHECK(z<size.z())
+      return mPyramid[level][ x + y*size.x() + z*size.x()*size.y() ];
+    }
+
   protected:
     std::vector<float> mInternalValues;
     float* mValues;
@@ -150,8 +184,12 @@ namespace vl
     float mMaximum;
     float mAverage;
     bool mDataIsDirty;
+    ivec3 mDirtyMin;
+    ivec3 mDirtyMax;
 
     std::vector<Cube> mCubes;
+    std::vector< std::vector<Cube> > mPyramid;
+    std::vector<ivec3> mPyramidSize;
   };
   //------------------------------------------------------------------------------
   // VolumeInfo
@@ -241,6 +279,25 @@ namespace vl
     //! Select hight quality normals for best rendering quality, select low quality normals for best performances.
     bool highQualityNormals() const { return mHighQualityNormals; }
 
+    //! The number of z-slabs each volume is split into by run(), the slabs are processed in parallel when VL is compiled with OpenMP support.
+    //! The default is 0 which means one slab per thread as specified by GlobalSettings::threadCount().
+    //! The generated geometry does not depend on the number of slabs.
+    void setSlabCount(int count) { mSlabCount = count; }
+    //! The number of z-slabs each volume is split into by run(), see setSlabCount().
+    int slabCount() const { return mSlabCount; }
+
+    //! Enables the incremental extraction of the isosurfaces: each volume is divided in bricks of \p size^3 cubes whose geometry is kept
+    //! between the calls to run(), only the bricks touched by the values marked with Volume::setDataDirty() are recomputed and spliced
+    //! back into the vertex and index arrays. The default is 0 which disables the bricks.
+    //! \note The vertices on the sides shared by two bricks are duplicated.
+    //! \note When the bricks are enabled the volumes should be updated only by run(): calling Volume::setupInternalData() discards their dirty box.
+    void setBrickSize(int size) { mBrickSize = size; }
+    //! The number of cubes along each side of the bricks, see setBrickSize().
+    int brickSize() const { return mBrickSize; }
+
+    //! The number of bricks recomputed by the last call to run(), see setBrickSize().
+    int extractedBrickCount() const { return mExtractedBrickCount; }
+
   public:
     ref<ArrayFloat3> mVertsArray;
     ref<ArrayFloat3> mNormsArray;
@@ -253,20 +310,56 @@ namespace vl
     ref<DrawElementsUShort> mDrawElements;
 #endif
 
-  protected:
-    void computeEdges(Volume*, float threshold);
-    void processCube(int x, int y, int z, Volume* vol, float threshold);
-
   private:
-    std::vector<fvec3> mVerts;
-    std::vector<fvec3> mNorms;
-    std::vector<fvec4> mColors;
-
 #if defined(VL_OPENGL)
     typedef unsigned int IndexType;
 #else
     typedef unsigned short IndexType;
 #endif
+
+    /**
+     * A box of points of a volume, a z-slab or a brick, and the vertices, cubes and triangles generated from it.
+     * No edge and no cube starts from the points whose x, y or z coordinate is equal to the one of mBoundary.
+     */
+    struct Region
+    {
+      Region(): mVert0(0) {}
+      ivec3 mFirst, mLast;
+      ivec3 mBoundary;
+      int mVert0;
+      std::vector<fvec3> mVerts;
+      std::vector<fvec3> mNorms;
+      std::vector<usvec3> mCubes;
+      std::vector<IndexType> mIndices;
+      std::vector<int> mEdgeCells;
+    };
+
+    /**
+     * The bricks of a volume kept between the calls to run() and the parameters they were computed with.
+     */
+    struct BrickedVolume
+    {
+      BrickedVolume(): mThreshold(0), mBrickSize(0), mHighQualityNormals(false) {}
+      ref<Volume> mVolume;
+      float mThreshold;
+      ivec3 mSlices;
+      int mBrickSize;
+      bool mHighQualityNormals;
+      ivec3 mBrickCount;
+      std::vector<Region> mBricks;
+    };
+
+  protected:
+    void markActiveBlocks(const Volume* vol, float threshold, int level, int x, int y, int z);
+    void computeEdges(Volume*, float threshold, Region& region);
+    void processCube(int x, int y, int z, Volume* vol, float threshold, Region& region, int vert0_z0, int vert0_z1);
+    void extractSlabs(Volume* vol, float threshold);
+    void extractBricks(BrickedVolume& bricked, Volume* vol, float threshold, bool dirty, const ivec3& dirty_min, const ivec3& dirty_max);
+
+  private:
+    std::vector<fvec3> mVerts;
+    std::vector<fvec3> mNorms;
+    std::vector<fvec4> mColors;
     std::vector<IndexType> mIndices;
 
     struct Edge
@@ -275,9 +368,14 @@ namespace vl
       int mX, mY, mZ;
     };
     std::vector<Edge>  mEdges;
-    std::vector<usvec3> mCubes;
+    std::vector<Region> mSlabs;
+    std::vector<BrickedVolume> mBrickedVolumes;
+    std::vector<unsigned char> mActiveBlocks;
     Collection<VolumeInfo> mVolumeInfo;
     bool mHighQualityNormals;
+    int mSlabCount;
+    int mBrickSize;
+    int mExtractedBrickCount;
 
   protected:
     static const int mTriangleConnectionTable[256][16];
@@ -0,0 +1,515 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+
+#include <vlVolume/RaycastVolumeCPU.hpp>
+#include <vlVolume/RaycastVolume.hpp>
+#include <vlGraphics/Camera.hpp>
+#include <vlCore/Transform.hpp>
+#include <vlCore/GlobalSettings.hpp>
+#include <vlCore/Log.hpp>
+#include <cmath>
+
+using namespace vl;
+
+namespace
+{
+  //! Size in cells of the blocks of the volume whose density range is tested by the empty space skipping.
+  const int BlockSize = 8;
+
+  //! Converts one row of a luminance volume to normalized floats.
+  template<typename T>
+  void convertRow(const T* in, float* out, int count, float normalizer)
+  {
+    for(int i=0; i<count; ++i)
+      out[i] = in[i] * normalizer;
+  }
+
+  //! The state shared by all the rays of a render() call.
+  struct RayCaster
+  {
+    //! Marches the ray starting at \p v0 in voxel space along the unit direction \p dir for \p len voxels.
+    fvec4 march(const float* v0, const float* dir, float len, long long& samples, long long& skipped) const;
+
+    //! Casts the rays of the pixels in [x0,x1)x[y0,y1) and returns the number of rays that hit the box.
+    long long renderTile(int x0, int y0, int x1, int y1, long long& samples, long long& skipped) const;
+
+    // volume
+    const float* mDensity;
+    int mSize[3];
+    int mPitch[3];
+    int mStride[3];
+    int mLastCell[3];
+    int mBlockCount[3];
+    const unsigned char* mEmptyBlocks;
+    // premultiplied and opacity corrected transfer function, mTable[mTableSize] repeats the last entry
+    const fvec4* mTable;
+    int mTableSize;
+    float mStep;
+    float mEarlyTerminationAlpha;
+    // clip space to object space
+    mat4 mInverse;
+    vec3 mBoxMin;
+    vec3 mBoxMax;
+    // object space to voxel space
+    vec3 mVoxelOrigin;
+    vec3 mVoxelAxis[3];
+    // output
+    int mWidth;
+    int mHeight;
+    unsigned char* mPixelsUByte;
+    float* mPixelsFloat;
+  };
+  //-----------------------------------------------------------------------------
+  fvec4 RayCaster::march(const float* v0, const float* dir, float len, long long& samples, long long& skipped) const
+  {
+    float r = 0, g = 0, b = 0, a = 0;
+    const int sample_count = (int)(len / mStep) + 1;
+    for(int i=0; i<sample_count; )
+    {
+      const float t = i * mStep;
+      float p[3], f[3];
+      int cell[3];
+      for(int k=0; k<3; ++k)
+      {
+        p[k] = v0[k] + dir[k] * t;
+        float q = clamp(p[k], 0.0f, (float)(mSize[k]-1));
+        cell[k] = (int)q < mLastCell[k] ? (int)q : mLastCell[k];
+        f[k] = q - cell[k];
+      }
+
+      if (mEmptyBlocks)
+      {
+        int block[] = { cell[0] / BlockSize, cell[1] / BlockSize, cell[2] / BlockSize };
+        if (mEmptyBlocks[ (block[2] * mBlockCount[1] + block[1]) * mBlockCount[0] + block[0] ])
+        {
+          // distance to the exit of the block, the first and last blocks extend to infinity because of the clamping
+          float exit = 1.0e30f;
+          for(int k=0; k<3; ++k)
+          {
+            if (dir[k] > 0 && block[k] < mBlockCount[k]-1)
+              exit = min(exit, ((block[k]+1) * BlockSize - p[k]) / dir[k]);
+            else
+            if (dir[k] < 0 && block[k] > 0)
+              exit = min(exit, (block[k] * BlockSize - p[k]) / dir[k]);
+          }
+          // resume from the last sample before the exit: the samples in between are at least one step
+          // inside the block and would not contribute, so the result is the same as without skipping
+          float next = ceilf( (t + exit) / mStep ) - 1.0f;
+          int inext = next < sample_count ? (int)next : sample_count;
+          if (inext <= i)
+            inext = i+1;
+          skipped += inext - i;
+          i = inext;
+          continue;
+        }
+      }
+
+      // trilinear density
+      const float* v = mDensity + cell[0] * mPitch[0] + cell[1] * mPitch[1] + cell[2] * mPitch[2];
+      const int sx = mStride[0], sy = mStride[1], sz = mStride[2];
+      float c00 = v[0]       + (v[sx]         - v[0])       * f[0];
+      float c10 = v[sy]      + (v[sy+sx]      - v[sy])      * f[0];
+      float c01 = v[sz]      + (v[sz+sx]      - v[sz])      * f[0];
+      float c11 = v[sz+sy]   + (v[sz+sy+sx]   - v[sz+sy])   * f[0];
+      float c0 = c00 + (c10 - c00) * f[1];
+      float c1 = c01 + (c11 - c01) * f[1];
+      float density = c0 + (c1 - c0) * f[2];
+
+      // linear transfer function lookup
+      float pos = clamp(density * mTableSize - 0.5f, 0.0f, (float)(mTableSize-1));
+      int j = (int)pos;
+      float w = pos - j;
+      const fvec4& e0 = mTable[j];
+      const fvec4& e1 = mTable[j+1];
+      float sa = e0.a() + (e1.a() - e0.a()) * w;
+
+      // front to back compositing
+      float transparency = 1.0f - a;
+      r += transparency * ( e0.r() + (e1.r() - e0.r()) * w );
+      g += transparency * ( e0.g() + (e1.g() - e0.g()) * w );
+      b += transparency * ( e0.b() + (e1.b() - e0.b()) * w );
+      a += transparency * sa;
+      ++samples;
+
+      // early ray termination
+      if (a >= mEarlyTerminationAlpha)
+        break;
+      ++i;
+    }
+    return fvec4(r, g, b, a);
+  }
+  //-----------------------------------------------------------------------------
+  long long RayCaster::renderTile(int x0, int y0, int x1, int y1, long long& samples, long long& skipped) const
+  {
+    long long rays = 0;
+    for(int y=y0; y<y1; ++y)
+    {
+      for(int x=x0; x<x1; ++x)
+      {
+        // ray through the pixel center from the near to the far clipping plane in object space
+        real nx = (x + (real)0.5) / mWidth  * 2 - 1;
+        real ny = (y + (real)0.5) / mHeight * 2 - 1;
+        vec4 near_point = mInverse * vec4(nx, ny, -1, 1);
+        vec4 far_point  = mInverse * vec4(nx, ny, +1, 1);
+        vec3 origin = near_point.xyz() / near_point.w();
+        vec3 delta  = far_point.xyz() / far_point.w() - origin;
+
+        // clip the ray against the box
+        real s0 = 0, s1 = 1;
+        for(int k=0; k<3 && s0<=s1; ++k)
+        {
+          if (delta[k] == 0)
+          {
+            if (origin[k] < mBoxMin[k] || origin[k] > mBoxMax[k])
+              s1 = -1;
+            continue;
+          }
+          real ta = (mBoxMin[k] - origin[k]) / delta[k];
+          real tb = (mBoxMax[k] - origin[k]) / delta[k];
+          if (ta > tb)
+            std::swap(ta, tb);
+          s0 = max(s0, ta);
+          s1 = min(s1, tb);
+        }
+
+        fvec4 color;
+        if (s0 <= s1)
+        {
+          vec3 p0 = origin + delta * s0 - mBoxMin;
+          vec3 p1 = origin + delta * s1 - mBoxMin;
+          vec3 v0 = mVoxelOrigin + mVoxelAxis[0] * p0.x() + mVoxelAxis[1] * p0.y() + mVoxelAxis[2] * p0.z();
+          vec3 v1 = mVoxelOrigin + mVoxelAxis[0] * p1.x() + mVoxelAxis[1] * p1.y() + mVoxelAxis[2] * p1.z();
+          vec3 dir = v1 - v0;
+          real len = dir.length();
+          if (len > 0)
+            dir /= len;
+          float fv0[]  = { (float)v0.x(), (float)v0.y(), (float)v0.z() };
+          float fdir[] = { (float)dir.x(), (float)dir.y(), (float)dir.z() };
+          color = march(fv0, fdir, (float)len, samples, skipped);
+          ++rays;
+        }
+
+        int ipx = (y * mWidth + x) * 4;
+        if (mPixelsFloat)
+        {
+          for(int k=0; k<4; ++k)
+            mPixelsFloat[ipx+k] = color[k];
+        }
+        else
+        {
+          for(int k=0; k<4; ++k)
+            mPixelsUByte[ipx+k] = (unsigned char)(clamp(color[k], 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+      }
+    }
+    return rays;
+  }
+}
+//-----------------------------------------------------------------------------
+// RaycastVolumeCPU
+//-----------------------------------------------------------------------------
+RaycastVolumeCPU::RaycastVolumeCPU()
+{
+  VL_DEBUG_SET_OBJECT_NAME()
+  mSampleStep = 0.5f;
+  mTileSize = 16;
+  mEmptySpaceSkipping = true;
+  mEarlyTerminationAlpha = 0.99f;
+  mStatsRayCount = 0;
+  mStatsSampleCount = 0;
+  mStatsSkippedSampleCount = 0;
+}
+//-----------------------------------------------------------------------------
+void RaycastVolumeCPU::setVolume(const Image* volume)
+{
+  mDensity.clear();
+  mBlockMin.clear();
+  mBlockMax.clear();
+  mVolumeSize = ivec3(0,0,0);
+  mBlockCount = ivec3(0,0,0);
+
+  if ( !volume )
+  {
+    Log::error("RaycastVolumeCPU::setVolume() called with NULL volume.\n");
+    return;
+  }
+  if ( volume->format() != IF_LUMINANCE )
+  {
+    Log::error("RaycastVolumeCPU::setVolume() called with non IF_LUMINANCE data format().\n");
+    return;
+  }
+  if ( volume->type() != IT_UNSIGNED_BYTE && volume->type() != IT_UNSIGNED_SHORT && volume->type() != IT_FLOAT )
+  {
+    Log::error("RaycastVolumeCPU::setVolume() called with invalid data type().\n");
+    return;
+  }
+  if ( volume->dimension() != ID_3D )
+  {
+    Log::error("RaycastVolumeCPU::setVolume() called with non 3D data.\n");
+    return;
+  }
+
+  const int w = volume->width();
+  const int h = volume->height();
+  const int d = volume->depth();
+  const int slice = w * h;
+  const int pitch = volume->pitch();
+  mVolumeSize = ivec3(w, h, d);
+  mDensity.resize( (size_t)slice * d );
+
+  int thread_count = globalSettings()->threadCount();
+
+  // normalize the density like an OpenGL texture, the rows of the image are pitch() bytes apart
+  #ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+  #endif
+  for(int z=0; z<d; ++z)
+  {
+    for(int y=0; y<h; ++y)
+    {
+      const unsigned char* in = volume->pixels() + (size_t)pitch * (y + (size_t)h * z);
+      float* out = &mDensity[0] + (size_t)slice * z + (size_t)w * y;
+      switch(volume->type())
+      {
+      case IT_UNSIGNED_BYTE:  convertRow( (const unsigned char*)in, out, w, 1.0f / 255.0f ); break;
+      case IT_UNSIGNED_SHORT: convertRow( (const unsigned short*)in, out, w, 1.0f / 65535.0f ); break;
+      default:                convertRow( (const float*)in, out, w, 1.0f ); break;
+      }
+    }
+  }
+
+  // density range of each block of cells, a block also covers the last voxel of the cells of the next block
+  const int cells[] = { w > 1 ? w-1 : 1, h > 1 ? h-1 : 1, d > 1 ? d-1 : 1 };
+  mBlockCount = ivec3( (cells[0] + BlockSize-1) / BlockSize, (cells[1] + BlockSize-1) / BlockSize, (cells[2] + BlockSize-1) / BlockSize );
+  const int block_count = mBlockCount.x() * mBlockCount.y() * mBlockCount.z();
+  mBlockMin.resize(block_count);
+  mBlockMax.resize(block_count);
+
+  #ifdef VL_OPENMP
+    #pragma omp parallel for num_threads(thread_count)
+  #endif
+  for(int bz=0; bz<mBlockCount.z(); ++bz)
+  {
+    int z0 = bz * BlockSize, z1 = min(z0 + BlockSize, d-1);
+    for(int by=0; by<mBlockCount.y(); ++by)
+    {
+      int y0 = by * BlockSize, y1 = min(y0 + BlockSize, h-1);
+      for(int bx=0; bx<mBlockCount.x(); ++bx)
+      {
+        int x0 = bx * BlockSize, x1 = min(x0 + BlockSize, w-1);
+        float vmin = mDensity[ (size_t)slice * z0 + y0 * w + x0 ];
+        float vmax = vmin;
+        for(int z=z0; z<=z1; ++z)
+          for(int y=y0; y<=y1; ++y)
+          {
+            const float* row = &mDensity[0] + (size_t)slice * z + y * w;
+            for(int x=x0; x<=x1; ++x)
+            {
+              vmin = min(vmin, row[x]);
+              vmax = max(vmax, row[x]);
+            }
+          }
+        int iblock = (bz * mBlockCount.y() + by) * mBlockCount.x() + bx;
+        mBlockMin[iblock] = vmin;
+        mBlockMax[iblock] = vmax;
+      }
+    }
+  }
+}
+//-----------------------------------------------------------------------------
+void RaycastVolumeCPU::setTransferFunction(const Image* trfunc)
+{
+  mTransferFunction.clear();
+  if ( !trfunc )
+  {
+    Log::error("RaycastVolumeCPU::setTransferFunction() called with NULL transfer function.\n");
+    return;
+  }
+  if ( trfunc->dimension() != ID_1D )
+  {
+    Log::error("RaycastVolumeCPU::setTransferFunction() transfer function image must be an 1D image.\n");
+    return;
+  }
+  mTransferFunction.resize( trfunc->width() );
+  for(int i=0; i<trfunc->width(); ++i)
+    mTransferFunction[i] = trfunc->sample(i);
+}
+//-----------------------------------------------------------------------------
+ref<Image> RaycastVolumeCPU::render(const RaycastVolume* raycast_volume, const Camera* camera, const Transform* transform, EImageType type)
+{
+  mStatsRayCount = 0;
+  mStatsSampleCount = 0;
+  mStatsSkippedSampleCount = 0;
+
+  if ( mDensity.empty() )
+  {
+    Log::error("RaycastVolumeCPU::render(): no volume, see setVolume().\n");
+    return NULL;
+  }
+  if ( mTransferFunction.empty() )
+  {
+    Log::error("RaycastVolumeCPU::render(): no transfer function, see setTransferFunction().\n");
+    return NULL;
+  }
+  if ( type != IT_UNSIGNED_BYTE && type != IT_FLOAT )
+  {
+    Log::error("RaycastVolumeCPU::render(): the image type must be IT_UNSIGNED_BYTE or IT_FLOAT.\n");
+    return NULL;
+  }
+  if ( mSampleStep <= 0 )
+  {
+    Log::error("RaycastVolumeCPU::render(): the sample step must be greater than 0.\n");
+    return NULL;
+  }
+
+  const Viewport* viewport = camera->viewport();
+  const int width  = viewport->width();
+  const int height = viewport->height();
+  const AABB& box = raycast_volume->box();
+  if ( width <= 0 || height <= 0 || box.isNull() || !box.width() || !box.height() || !box.depth() )
+  {
+    Log::error("RaycastVolumeCPU::render(): empty viewport or volume box.\n");
+    return NULL;
+  }
+
+  RayCaster caster;
+
+  // clip space to object space
+  mat4 matrix = camera->projectionMatrix() * camera->viewMatrix();
+  if ( transform )
+    matrix = matrix * transform->worldMatrix();
+  real det = 0;
+  caster.mInverse = matrix.getInverse(&det);
+  if ( !det )
+  {
+    Log::error("RaycastVolumeCPU::render(): the view projection matrix is not invertible.\n");
+    return NULL;
+  }
+  caster.mBoxMin = box.minCorner();
+  caster.mBoxMax = box.maxCorner();
+
+  // object space to voxel space: the box corners are mapped to the voxel centers via their texture coordinates
+  // as the texture sampler would do, see RaycastVolume::setBox() for the order of the corners
+  const fvec3* texc = raycast_volume->texCoords();
+  vec3 size( (real)mVolumeSize.x(), (real)mVolumeSize.y(), (real)mVolumeSize.z() );
+  vec3 extent = box.maxCorner() - box.minCorner();
+  caster.mVoxelOrigin  = (vec3)texc[4] * size - vec3(0.5, 0.5, 0.5);
+  caster.mVoxelAxis[0] = (vec3)(texc[5] - texc[4]) * size / extent.x();
+  caster.mVoxelAxis[1] = (vec3)(texc[7] - texc[4]) * size / extent.y();
+  caster.mVoxelAxis[2] = (vec3)(texc[0] - texc[4]) * size / extent.z();
+
+  caster.mDensity = &mDensity[0];
+  for(int k=0; k<3; ++k)
+  {
+    caster.mSize[k] = mVolumeSize[k];
+    caster.mLastCell[k] = max(mVolumeSize[k] - 2, 0);
+    caster.mBlockCount[k] = mBlockCount[k];
+  }
+  caster.mPitch[0] = 1;
+  caster.mPitch[1] = mVolumeSize.x();
+  caster.mPitch[2] = mVolumeSize.x() * mVolumeSize.y();
+  for(int k=0; k<3; ++k)
+    caster.mStride[k] = mVolumeSize[k] > 1 ? caster.mPitch[k] : 0;
+
+  // premultiplied transfer function whose opacity is corrected for the sample step
+  const int table_size = (int)mTransferFunction.size();
+  std::vector<fvec4> table(table_size + 1);
+  std::vector<int> opaque_count(table_size + 2, 0);
+  for(int i=0; i<table_size; ++i)
+  {
+    const fvec4& c = mTransferFunction[i];
+    float alpha = 1.0f - powf( 1.0f - clamp(c.a(), 0.0f, 1.0f), mSampleStep );
+    table[i] = fvec4(c.r() * alpha, c.g() * alpha, c.b() * alpha, alpha);
+  }
+  table[table_size] = table[table_size-1];
+  for(int i=0; i<=table_size; ++i)
+    opaque_count[i+1] = opaque_count[i] + (table[i].a() != 0 ? 1 : 0);
+  caster.mTable = &table[0];
+  caster.mTableSize = table_size;
+  caster.mStep = mSampleStep;
+  caster.mEarlyTerminationAlpha = mEarlyTerminationAlpha;
+
+  // a block is empty if all the table entries its density range can reach are transparent,
+  // one more entry on each side accounts for the rounding of the interpolation
+  std::vector<unsigned char> empty_blocks;
+  caster.mEmptyBlocks = NULL;
+  if ( mEmptySpaceSkipping )
+  {
+    empty_blocks.resize( mBlockMin.size() );
+    for(size_t i=0; i<empty_blocks.size(); ++i)
+    {
+      int e0 = (int)clamp(mBlockMin[i] * table_size - 0.5f, 0.0f, (float)(table_size-1)) - 1;
+      int e1 = (int)clamp(mBlockMax[i] * table_size - 0.5f, 0.0f, (float)(table_size-1)) + 2;
+      e0 = max(e0, 0);
+      e1 = min(e1, table_size);
+      empty_blocks[i] = opaque_count[e1+1] == opaque_count[e0];
+    }
+    caster.mEmptyBlocks = &empty_blocks[0];
+  }
+
+  ref<Image> img = new Image(width, height, 0, 1, IF_RGBA, type);
+  caster.mWidth = width;
+  caster.mHeight = height;
+  caster.mPixelsUByte = type == IT_UNSIGNED_BYTE ? img->pixels() : NULL;
+  caster.mPixelsFloat = type == IT_FLOAT ? (float*)img->pixels() : NULL;
+
+  // the tiles are independent and share no pixels
+  const int tile_size = mTileSize > 0 ? mTileSize : 16;
+  const int tiles_x = (width  + tile_size - 1) / tile_size;
+  const int tiles_y = (height + tile_size - 1) / tile_size;
+  const int tile_count = tiles_x * tiles_y;
+  std::vector<long long> stats(tile_count * 3);
+
+  int thread_count = globalSettings()->threadCount();
+  #ifdef VL_OPENMP
+    #pragma omp parallel for schedule(dynamic, 1) num_threads(thread_count)
+  #endif
+  for(int itile=0; itile<tile_count; ++itile)
+  {
+    int x0 = (itile % tiles_x) * tile_size;
+    int y0 = (itile / tiles_x) * tile_size;
+    long long samples = 0, skipped = 0;
+    stats[itile*3+0] = caster.renderTile( x0, y0, min(x0 + tile_size, width), min(y0 + tile_size, height), samples, skipped );
+    stats[itile*3+1] = samples;
+    stats[itile*3+2] = skipped;
+  }
+
+  for(int i=0; i<tile_count; ++i)
+  {
+    mStatsRayCount += stats[i*3+0];
+    mStatsSampleCount += stats[i*3+1];
+    mStatsSkippedSampleCount += stats[i*3+2];
+  }
+
+  return img;
+}
+//-----------------------------------------------------------------------------
@@ -0,0 +1,143 @@
+/**************************************************************************************/
+/*                                                                                    */
+/*  Visualization Library                                                             */
+/*  http://visualizationlibrary.org                                                   */
+/*                                                                                    */
+/*  Copyright (c) 2005-2020, Michele Bosi                                             */
+/*  All rights reserved.                                                              */
+/*                                                                                    */
+/*  Redistribution and use in source and binary forms, with or without modification,  */
+/*  are permitted provided that the following conditions are met:                     */
+/*                                                                                    */
+/*  - Redistributions of source code must retain the above copyright notice, this     */
+/*  list of conditions and the following disclaimer.                                  */
+/*                                                                                    */
+/*  - Redistributions in binary form must reproduce the above copyright notice, this  */
+/*  list of conditions and the following disclaimer in the documentation and/or       */
+/*  other materials provided with the distribution.                                   */
+/*                                                                                    */
+/*  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND   */
+/*  ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED     */
+/*  WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE            */
+/*  DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR  */
+/*  ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES    */
+/*  (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;      */
+/*  LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON    */
+/*  ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT           */
+/*  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS     */
+/*  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.                      */
+/*                                                                                    */
+/**************************************************************************************/
+
+
+#ifndef RaycastVolumeCPU_INCLUDE_ONCE
+#define RaycastVolumeCPU_INCLUDE_ONCE
+
+#include <vlVolume/link_config.hpp>
+#include <vlCore/Image.hpp>
+#include <vector>
+
+namespace vl
+{
+  class Camera;
+  class Transform;
+  class RaycastVolume;
+
+  /**
+   * Renders a volume by casting rays on the CPU.
+   *
+   * RaycastVolumeCPU consumes the same data used by the GPU raycasting: an IF_LUMINANCE volume Image, an 1D transfer function Image and the
+   * box and texture coordinates of a RaycastVolume seen by a Camera, and produces an IF_RGBA Image as large as the Camera's Viewport.
+   * The pixels are laid out like the ones returned by glReadPixels(), i.e. the first row is the bottom one, which makes the result
+   * usable as a reference for golden image tests of the raycasting shaders and as a fallback when no suitable GPU is available.
+   *
+   * The image is divided in square tiles which are rendered in parallel when VL is compiled with OpenMP support and
+   * GlobalSettings::threadCount() is greater than 1. Each ray is marched front to back at a fixed step, the density is sampled with
+   * trilinear filtering, the transfer function is sampled linearly and the samples are composited with the emission/absorption model.
+   * The rays skip the blocks of the volume whose density range maps to a fully transparent region of the transfer function and stop
+   * as soon as the accumulated opacity reaches earlyTerminationAlpha(). Skipping the empty blocks does not change the result, nor do
+   * the tile size and the number of threads.
+   *
+   * \sa
+   * - RaycastVolume
+   * - genRGBAVolume()
+   */
+  class VLVOLUME_EXPORT RaycastVolumeCPU: public Object
+  {
+    VL_INSTRUMENT_CLASS(vl::RaycastVolumeCPU, Object)
+
+  public:
+    RaycastVolumeCPU();
+
+    /** Converts the given volume into the internal density grid and computes the density range of each block of the volume.
+     * The volume must have format() IF_LUMINANCE and type() IT_UNSIGNED_BYTE, IT_UNSIGNED_SHORT or IT_FLOAT, integer values are normalized
+     * to 0..1 like an OpenGL texture would do. The Image is not referenced: call setVolume() again after modifying it. */
+    void setVolume(const Image* volume);
+
+    /** The size in voxels of the volume passed to setVolume(). */
+    const ivec3& volumeSize() const { return mVolumeSize; }
+
+    /** The 1D Image mapping the density to color and opacity, the opacity is the one of a sample taken every voxel.
+     * The transfer function is sampled with linear filtering like an OpenGL 1D texture. */
+    void setTransferFunction(const Image* trfunc);
+
+    /** The distance in voxels between two samples along a ray, the default is 0.5. The opacity of the transfer function
+     * is corrected accordingly so that the appearance of the volume does not depend on the sample step. */
+    void setSampleStep(float step) { mSampleStep = step; }
+
+    /** The distance in voxels between two samples along a ray, the default is 0.5. */
+    float sampleStep() const { return mSampleStep; }
+
+    /** The width and height in pixels of the tiles distributed among the threads, the default is 16. */
+    void setTileSize(int size) { mTileSize = size; }
+
+    /** The width and height in pixels of the tiles distributed among the threads, the default is 16. */
+    int tileSize() const { return mTileSize; }
+
+    /** Enables or disables the skipping of the fully transparent blocks of the volume, the default is true. */
+    void setEmptySpaceSkipping(bool enabled) { mEmptySpaceSkipping = enabled; }
+
+    /** Whether the fully transparent blocks of the volume are skipped, the default is true. */
+    bool emptySpaceSkipping() const { return mEmptySpaceSkipping; }
+
+    /** A ray stops once its accumulated opacity reaches this value, the default is 0.99. Use a value greater than 1 to disable early ray termination. */
+    void setEarlyTerminationAlpha(float alpha) { mEarlyTerminationAlpha = alpha; }
+
+    /** A ray stops once its accumulated opacity reaches this value, the default is 0.99. */
+    float earlyTerminationAlpha() const { return mEarlyTerminationAlpha; }
+
+    /** Renders the volume as seen by the given Camera.
+     * \param raycast_volume Provides the box enclosing the volume in object space and the texture coordinates of its corners.
+     * \param camera The Camera whose viewport, projection and view matrices define the rays, one per pixel.
+     * \param transform The Transform of the Actor bound to \p raycast_volume, can be NULL.
+     * \param type The type of the generated IF_RGBA image, either IT_UNSIGNED_BYTE or IT_FLOAT.
+     * \return The rendered image whose alpha channel contains the accumulated opacity, NULL in case of error. */
+    ref<Image> render(const RaycastVolume* raycast_volume, const Camera* camera, const Transform* transform=NULL, EImageType type=IT_UNSIGNED_BYTE);
+
+    //! Number of rays that hit the volume box during the last render().
+    long long statsRayCount() const { return mStatsRayCount; }
+
+    //! Number of samples composited during the last render().
+    long long statsSampleCount() const { return mStatsSampleCount; }
+
+    //! Number of samples skipped because they lay in a fully transparent block during the last render().
+    long long statsSkippedSampleCount() const { return mStatsSkippedSampleCount; }
+
+  protected:
+    ivec3 mVolumeSize;
+    ivec3 mBlockCount;
+    std::vector<float> mDensity;
+    std::vector<float> mBlockMin;
+    std::vector<float> mBlockMax;
+    std::vector<fvec4> mTransferFunction;
+    float mSampleStep;
+    int mTileSize;
+    bool mEmptySpaceSkipping;
+    float mEarlyTerminationAlpha;
+    long long mStatsRayCount;
+    long long mStatsSampleCount;
+    long long mStatsSkippedSampleCount;
+  };
+}
+
+#endif
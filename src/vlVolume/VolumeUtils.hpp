@@ -58,7 +58,8 @@ namespace vl
   /** Generates an image whose RGB components represent the normals computed from the input image gradient packed into 0..1 range.
   * The format of the image is IF_RGB/IT_FLOAT which is equivalent to a 3D grid of fvec3.
   * The generated image is ready to be used as a texture for normal lookup.
-  * The original normal can be recomputed as N = (RGB - 0.5)*2.0. */
+  * The original normal can be recomputed as N = (RGB - 0.5)*2.0.
+  * IF_LUMINANCE images of type IT_UNSIGNED_BYTE, IT_UNSIGNED_SHORT and IT_FLOAT are read directly, the other ones are first converted to IF_LUMINANCE/IT_FLOAT. */
   VLVOLUME_EXPORT ref<Image> genGradientNormals(const Image* data);
 
   /** Internally used. */